@@ -36,8 +36,43 @@ OF SUCH DAMAGE.
 #include <sys/select.h>
 #include "spnav.h"
 
+/* USDT static probes of the libspnav provider, for tracing with bpftrace, perf
+ * or systemtap (see the spacenavd doc/bpftrace directory):
+ *   read_event_entry(socket)         read_event_return(event type, queued)
+ *   remove_events_entry(event type)  remove_events_return(count)
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define PROBE1(name, a)			DTRACE_PROBE1(libspnav, name, a)
+#define PROBE2(name, a, b)		DTRACE_PROBE2(libspnav, name, a, b)
+#else
+#define PROBE1(name, a)			((void)(a))
+#define PROBE2(name, a, b)		((void)(a), (void)(b))
+#endif
+
 #define SPNAV_SOCK_PATH "/var/run/spnav.sock"
 
+/* daemon requests through the AF_UNIX socket (see spacenavd src/proto.h) */
+#define REQ_TAG			0x7faa0000
+#define REQ_TAG_MASK	0xffff0000
+#define REQ_STATUS		6
+
+enum {
+	REQ_SET_EVMASK = 0x300,
+	REQ_GET_EVMASK,
+	REQ_SUBSCRIBE_DEV,
+	REQ_UNSUBSCRIBE_DEV,
+	REQ_GET_DEV_IDS,
+	REQ_GET_DEV_NAME,
+	REQ_SET_RATE,
+	REQ_GET_RATE,
+	REQ_XFORM_ROW,
+	REQ_XFORM_DEADZONE,
+	REQ_XFORM_CLAMP,
+	REQ_XFORM_COMMIT,
+	REQ_XFORM_RESET
+};
+
 #ifdef USE_X11
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -67,6 +102,12 @@ struct event_node {
 /* only used for non-X mode, with spnav_remove_events */
 static struct event_node *ev_queue, *ev_queue_tail;
 
+static int decode_event(int *data, spnav_event *event);
+static int remove_events(int type);
+static int enqueue_event(spnav_event *event, struct event_node **tailptr);
+static int request(int req, int *data);
+static int request_ext(int req, int *data, int extra);
+
 /* AF_UNIX socket used for alternative communication with daemon */
 static int sock = -1;
 
@@ -256,6 +297,179 @@ int spnav_sensitivity(double sens)
 	return -1;
 }
 
+int spnav_evmask(unsigned int mask)
+{
+	int data[6] = {0};
+
+	data[0] = mask;
+	return request(REQ_SET_EVMASK, data);
+}
+
+int spnav_dev_subscribe(int devid)
+{
+	int data[6] = {0};
+
+	data[0] = devid;
+	return request(REQ_SUBSCRIBE_DEV, data);
+}
+
+int spnav_dev_unsubscribe(int devid)
+{
+	int data[6] = {0};
+
+	data[0] = devid;
+	return request(REQ_UNSUBSCRIBE_DEV, data);
+}
+
+int spnav_rate_limit(int max_rate, int mode)
+{
+	int data[6] = {0};
+
+	data[0] = max_rate;
+	data[1] = mode;
+	return request(REQ_SET_RATE, data);
+}
+
+int spnav_xform(const float *mat, const int *deadzone, const int *clamp)
+{
+	int i, j, data[6];
+
+	for(i=0; i<6; i++) {
+		for(j=0; j<6; j++) {
+			float val = mat ? mat[i * 6 + j] : (i == j ? 1.0f : 0.0f);
+			memcpy(data + j, &val, sizeof val);
+		}
+		if(request_ext(REQ_XFORM_ROW, data, i) == -1) {
+			return -1;
+		}
+	}
+	for(i=0; i<2; i++) {
+		const int *src = i ? clamp : deadzone;
+		for(j=0; j<6; j++) {
+			data[j] = src ? src[j] : 0;
+		}
+		if(request(i ? REQ_XFORM_CLAMP : REQ_XFORM_DEADZONE, data) == -1) {
+			return -1;
+		}
+	}
+	return request(REQ_XFORM_COMMIT, data);
+}
+
+int spnav_xform_reset(void)
+{
+	int data[6] = {0};
+	return request(REQ_XFORM_RESET, data);
+}
+
+int spnav_dev_list(int *ids, int max)
+{
+	int i, count = 0;
+	int data[6];
+
+	while(count < max) {
+		memset(data, 0, sizeof data);
+		data[0] = count;
+		if(request(REQ_GET_DEV_IDS, data) == -1) {
+			return -1;
+		}
+		for(i=0; i<6; i++) {
+			if(data[i] == -1) {
+				return count;
+			}
+			if(count < max) {
+				ids[count++] = data[i];
+			}
+		}
+	}
+	return count;
+}
+
+int spnav_dev_name(int devid, char *buf, int bufsz)
+{
+	int offs = 0;
+	int data[6];
+	char *chunk = (char*)(data + 2);
+
+	if(bufsz <= 0) {
+		return -1;
+	}
+
+	while(offs < bufsz - 1) {
+		int i, len = 4 * sizeof *data;
+
+		data[0] = devid;
+		data[1] = offs;
+		if(request(REQ_GET_DEV_NAME, data) == -1) {
+			return -1;
+		}
+		for(i=0; i<len && chunk[i] && offs < bufsz - 1; i++) {
+			buf[offs++] = chunk[i];
+		}
+		if(i < len) break;
+	}
+	buf[offs] = 0;
+	return offs;
+}
+
+/* Sends a request to the daemon and waits for the response. Any events
+ * received in the meantime are appended to the event queue. Only available
+ * in AF_UNIX mode.
+ */
+static int request(int req, int *data)
+{
+	return request_ext(req, data, 0);
+}
+
+/* extra goes in the last int of the request, which carries the status in
+ * the response.
+ */
+static int request_ext(int req, int *data, int extra)
+{
+	int i, rd, resp[8];
+	char *ptr;
+	spnav_event event;
+
+	if(sock == -1) {
+		return -1;
+	}
+
+	resp[0] = req | REQ_TAG;
+	for(i=0; i<6; i++) {
+		resp[i + 1] = data[i];
+	}
+	resp[7] = extra;
+
+	while((rd = write(sock, resp, sizeof resp)) == -1 && errno == EINTR);
+	if(rd != sizeof resp) {
+		return -1;
+	}
+
+	for(;;) {
+		ptr = (char*)resp;
+		rd = 0;
+		while(rd < (int)sizeof resp) {
+			int res = read(sock, ptr + rd, sizeof resp - rd);
+			if(res <= 0) {
+				if(res == -1 && errno == EINTR) continue;
+				return -1;
+			}
+			rd += res;
+		}
+
+		if(resp[0] == (req | REQ_TAG)) {
+			break;
+		}
+		if((resp[0] & REQ_TAG_MASK) != REQ_TAG && decode_event(resp, &event)) {
+			enqueue_event(&event, 0);
+		}
+	}
+
+	for(i=0; i<6; i++) {
+		data[i] = resp[i + 1];
+	}
+	return resp[REQ_STATUS + 1] ? -1 : 0;
+}
+
 int spnav_fd(void)
 {
 #ifdef USE_X11
@@ -298,9 +512,11 @@ static int event_pending(int s)
  */
 static int read_event(int s, spnav_event *event)
 {
-	int i, rd;
+	int rd, res;
 	int data[8];
 
+	PROBE1(read_event_entry, s);
+
 	/* if we have a queued event, deliver that one */
 	if(ev_queue->next) {
 		struct event_node *node = ev_queue->next;
@@ -313,6 +529,7 @@ static int read_event(int s, spnav_event *event)
 
 		memcpy(event, &node->event, sizeof *event);
 		free(node);
+		PROBE2(read_event_return, event->type, 1);
 		return event->type;
 	}
 
@@ -321,9 +538,14 @@ static int read_event(int s, spnav_event *event)
 		rd = read(s, data, sizeof data);
 	} while(rd == -1 && errno == EINTR);
 
-	if(rd <= 0) {
-		return 0;
-	}
+	res = rd > 0 ? decode_event(data, event) : 0;
+	PROBE2(read_event_return, res, 0);
+	return res;
+}
+
+static int decode_event(int *data, spnav_event *event)
+{
+	int i;
 
 	if(data[0] < 0 || data[0] > 2) {
 		return 0;
@@ -436,6 +658,16 @@ static int enqueue_event(spnav_event *event, struct event_node **tailptr)
 }
 
 int spnav_remove_events(int type)
+{
+	int res;
+
+	PROBE1(remove_events_entry, type);
+	res = remove_events(type);
+	PROBE1(remove_events_return, res);
+	return res;
+}
+
+static int remove_events(int type)
 {
 	int rm_count = 0;
 
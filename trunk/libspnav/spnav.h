@@ -89,6 +89,58 @@ int spnav_fd(void);
 /* TODO: document */
 int spnav_sensitivity(double sens);
 
+/* Event type mask for spnav_evmask */
+#define SPNAV_EVMASK_MOTION		1
+#define SPNAV_EVMASK_PRESS		2
+#define SPNAV_EVMASK_RELEASE	4
+#define SPNAV_EVMASK_ALL		7
+
+/* Selects which types of events the daemon should send to this client
+ * (by default all). AF_UNIX mode only. Returns -1 on failure.
+ */
+int spnav_evmask(unsigned int mask);
+
+/* Device subscriptions (AF_UNIX mode only). By default events from all devices
+ * are received. Subscribing to a specific device id restricts events to the
+ * explicitly subscribed devices; devid -1 subscribes to all of them again, or
+ * unsubscribes from everything. Device ids remain valid for as long as the
+ * device stays connected. Return -1 on failure.
+ */
+int spnav_dev_subscribe(int devid);
+int spnav_dev_unsubscribe(int devid);
+
+/* Motion coalescing modes for spnav_rate_limit */
+#define SPNAV_RATE_LATEST	0
+#define SPNAV_RATE_AVERAGE	1
+
+/* Limits the rate of motion events the daemon sends to this client to max_rate
+ * events per second (0: unlimited). Motion between events is coalesced either
+ * by keeping the latest sample, or by averaging. Button events are not
+ * affected. AF_UNIX mode only. Returns -1 on failure.
+ */
+int spnav_rate_limit(int max_rate, int mode);
+
+/* Sets a transformation for motion events sent to this client (AF_UNIX mode
+ * only). Each input axis value below its dead zone is zeroed, the motion vector
+ * (x, y, z, rx, ry, rz) is multiplied by the 6x6 row-major matrix mat, and each
+ * output axis is clamped to [-clamp, clamp] (0 for no clamping). Any of the
+ * arguments can be null, meaning identity, no dead zone and no clamping
+ * respectively. Replaces any sensitivity set with spnav_sensitivity.
+ * Matrix elements must be finite and within +-10000.
+ * Returns -1 on failure.
+ */
+int spnav_xform(const float *mat, const int *deadzone, const int *clamp);
+/* Reverts to untransformed motion events */
+int spnav_xform_reset(void);
+
+/* Fills ids with the ids of up to max currently connected devices, and returns
+ * their number, or -1 on failure.
+ */
+int spnav_dev_list(int *ids, int max);
+
+/* Retrieves the name of a device. Returns the length of the name or -1 */
+int spnav_dev_name(int devid, char *buf, int bufsz);
+
 /* blocks waiting for space-nav events. returns 0 if an error occurs */
 int spnav_wait_event(spnav_event *event);
 
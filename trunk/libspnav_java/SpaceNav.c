@@ -28,6 +28,12 @@ OF SUCH DAMAGE.
 
 #include <jni.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include "net_sf_spacenav_SpaceNav.h"
 
 #include <spnav.h>
@@ -41,6 +47,87 @@ OF SUCH DAMAGE.
 #define debug_printf(fmt, ...)
 #endif
 
+/* record layout of the bulk event functions, see SpaceNav.java */
+#define EVENT_INTS	net_sf_spacenav_SpaceNav_EVENT_INTS
+/* events read from libspnav per copy into the java buffer */
+#define EVENT_CHUNK	64
+/* max events coalesced by the listener thread per state update */
+#define LISTENER_BATCH	256
+
+/* The event classes and their constructors (and the update method of the
+ * listener state) are looked up once when the library is loaded, instead of
+ * for every event.
+ */
+static jclass motion_class, button_class, state_class;
+static jmethodID motion_ctor, button_ctor, state_update;
+
+static JavaVM *jvm;
+
+/* listener thread, see SpaceNav.startListener */
+static pthread_t listener;
+static int listening;
+static int stop_pipe[2];
+static jobject listener_state;
+
+static int cache_class(JNIEnv *env, const char *name, const char *method,
+    const char *sig, jclass *cls, jmethodID *mid) {
+  jclass c;
+
+  if((c = (*env)->FindClass(env, name)) == NULL) {
+    return -1; /* exception thrown */
+  }
+  *cls = (*env)->NewGlobalRef(env, c);
+  (*env)->DeleteLocalRef(env, c);
+  if(*cls == NULL) {
+    return -1;
+  }
+
+  if((*mid = (*env)->GetMethodID(env, *cls, method, sig)) == NULL) {
+    return -1; /* exception thrown */
+  }
+  return 0;
+}
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+  JNIEnv *env;
+
+  if((*vm)->GetEnv(vm, (void**)&env, JNI_VERSION_1_4) != JNI_OK) {
+    return JNI_ERR;
+  }
+  jvm = vm;
+
+  if(cache_class(env, "net/sf/spacenav/SpaceNavMotionEvent", "<init>",
+	"(IIIIII)V", &motion_class, &motion_ctor) == -1 ||
+      cache_class(env, "net/sf/spacenav/SpaceNavButtonEvent", "<init>",
+	"(IZ)V", &button_class, &button_ctor) == -1 ||
+      cache_class(env, "net/sf/spacenav/SpaceNavState", "update",
+	"(IIIIIIJJJJJJJJI)I", &state_class, &state_update) == -1) {
+    debug_print("failed to look up the event classes");
+    return JNI_ERR;
+  }
+  return JNI_VERSION_1_4;
+}
+
+JNIEXPORT void JNICALL JNI_OnUnload(JavaVM *vm, void *reserved) {
+  JNIEnv *env;
+
+  if((*vm)->GetEnv(vm, (void**)&env, JNI_VERSION_1_4) != JNI_OK) {
+    return;
+  }
+  if(motion_class) {
+    (*env)->DeleteGlobalRef(env, motion_class);
+    motion_class = NULL;
+  }
+  if(button_class) {
+    (*env)->DeleteGlobalRef(env, button_class);
+    button_class = NULL;
+  }
+  if(state_class) {
+    (*env)->DeleteGlobalRef(env, state_class);
+    state_class = NULL;
+  }
+}
+
 JNIEXPORT void JNICALL Java_net_sf_spacenav_SpaceNav_open(JNIEnv *env, jobject obj) {
   debug_print("Java_SpaceNav_open called");
   if(spnav_open()!=0) {
@@ -65,15 +152,27 @@ JNIEXPORT void JNICALL Java_net_sf_spacenav_SpaceNav_sensitivity(JNIEnv *env,
 }
 
 
-JNIEXPORT jobject JNICALL Java_net_sf_spacenav_SpaceNav_wait_1event(JNIEnv *env, jobject obj) {
+/* creates the java object for an event, or returns NULL for unknown events */
+static jobject new_event(JNIEnv *env, spnav_event *e) {
+  struct spnav_event_motion *me=&e->motion;
+  struct spnav_event_button *be=&e->button;
 
-  jclass eventClass;
-  jmethodID cid;
-  jstring result;
+  if(e->type == SPNAV_EVENT_MOTION) {
+    return (*env)->NewObject(env, motion_class, motion_ctor,
+	me->x, me->y, me->z,
+	me->rx, me->ry, me->rz /*, me->period*/);
+  }
+  else if(e->type == SPNAV_EVENT_BUTTON) {
+    return (*env)->NewObject(env, button_class, button_ctor,
+	(jint)be->bnum, (jboolean)(be->press != 0));
+  }
 
+  debug_printf("Unknown event-type: %d", e->type);
+  return NULL;
+}
+
+JNIEXPORT jobject JNICALL Java_net_sf_spacenav_SpaceNav_wait_1event(JNIEnv *env, jobject obj) {
   spnav_event e;
-  struct spnav_event_motion *me=&e.motion;
-  struct spnav_event_button *be=&e.button;
 
   debug_print("Java_SpaceNav_wait_1event called");
 
@@ -81,55 +180,251 @@ JNIEXPORT jobject JNICALL Java_net_sf_spacenav_SpaceNav_wait_1event(JNIEnv *env,
     debug_print("spnav_wait_event() failed");
     return NULL;
   }
+  return new_event(env, &e);
+}
 
+JNIEXPORT jobject JNICALL Java_net_sf_spacenav_SpaceNav_poll_1event(JNIEnv *env, jobject obj) {
+  spnav_event e;
 
-  if(e.type == SPNAV_EVENT_MOTION) {
+  if(spnav_poll_event(&e)==0) {
+    return NULL;
+  }
+  return new_event(env, &e);
+}
 
-    eventClass = (*env)->FindClass(env, "net/sf/spacenav/SpaceNavMotionEvent");
-    if (eventClass == NULL) {
-      return NULL; /* exception thrown */
+/* stores an event as an EVENT_INTS record (see SpaceNav.java) */
+static void pack_event(jint *rec, spnav_event *e) {
+  memset(rec, 0, EVENT_INTS * sizeof *rec);
+  rec[0] = e->type;
+
+  if(e->type == SPNAV_EVENT_MOTION) {
+    rec[1] = e->motion.x;
+    rec[2] = e->motion.y;
+    rec[3] = e->motion.z;
+    rec[4] = e->motion.rx;
+    rec[5] = e->motion.ry;
+    rec[6] = e->motion.rz;
+    rec[7] = e->motion.period;
+  }
+  else if(e->type == SPNAV_EVENT_BUTTON) {
+    rec[1] = e->button.bnum;
+    rec[2] = e->button.press != 0;
+  }
+}
+
+/* Reads up to max pending events into the array arr, or
+ * the memory at dest, waiting for the first one if wait is set. The events
+ * are packed into a local buffer and copied over in chunks, so that the
+ * java array is never pinned while waiting. Returns the number of events
+ * read, or -1 if waiting failed.
+ */
+static jint read_events(JNIEnv *env, jintArray arr, char *dest,
+    int max, int wait) {
+  jint buf[EVENT_CHUNK * EVENT_INTS];
+  spnav_event e;
+  int n, count = 0;
+
+  while(count < max) {
+    n = 0;
+    if(wait && count == 0) {
+      if(spnav_wait_event(&e)==0) {
+	debug_print("spnav_wait_event() failed");
+	return -1;
+      }
+      pack_event(buf, &e);
+      n++;
+    }
+    while(n < EVENT_CHUNK && count + n < max && spnav_poll_event(&e)) {
+      pack_event(buf + n * EVENT_INTS, &e);
+      n++;
+    }
+    if(n == 0) {
+      break;
     }
 
-    cid = (*env)->GetMethodID(env, eventClass,
-	"<init>", "(IIIIII)V");
-    if (cid == NULL) {
-      return NULL; /* exception thrown */
+    if(arr) {
+      (*env)->SetIntArrayRegion(env, arr, count * EVENT_INTS, n * EVENT_INTS, buf);
+    } else {
+      memcpy(dest + count * EVENT_INTS * sizeof *buf, buf, n * EVENT_INTS * sizeof *buf);
     }
+    count += n;
 
-    /* Construct a new object */
-    result = (*env)->NewObject(env, eventClass, cid,
-	me->x, me->y, me->z,
-	me->rx, me->ry, me->rz /*, me->period*/);
-    /* Free local references */
-    (*env)->DeleteLocalRef(env, eventClass);
-    return result;
+    if(n < EVENT_CHUNK) {
+      break;	/* no more pending */
+    }
+  }
+  return count;
+}
+
+JNIEXPORT jint JNICALL Java_net_sf_spacenav_SpaceNav_read_1events(JNIEnv *env,
+    jobject obj, jintArray arr, jboolean wait) {
+  int max = (*env)->GetArrayLength(env, arr) / EVENT_INTS;
+
+  return read_events(env, arr, NULL, max, wait);
+}
+
+JNIEXPORT jint JNICALL Java_net_sf_spacenav_SpaceNav_read_1events_1direct(JNIEnv *env,
+    jobject obj, jobject bbuf, jint pos, jint len, jboolean wait) {
+  char *addr;
+
+  if((addr = (*env)->GetDirectBufferAddress(env, bbuf)) == NULL) {
+    debug_print("not a direct buffer");
+    return -1;
+  }
+  return read_events(env, NULL, addr + pos, len / (EVENT_INTS * sizeof(jint)), wait);
+}
 
+/* the daemon closed the connection, if it's readable without an event */
+static int connection_closed(int fd) {
+  char c;
+  int res = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
 
+  return res == 0 || (res == -1 && errno != EAGAIN && errno != EINTR);
+}
+
+/* Waits for events and coalesces everything pending (up to LISTENER_BATCH
+ * events) into one call of SpaceNavState.update: the latest motion, the sum
+ * of the motion since the last update, the state of the buttons and the
+ * buttons pressed since the last update. update returns the milliseconds
+ * until it wants to be called again even without new events (for rate
+ * limited callbacks), or -1.
+ */
+static void *listener_thread(void *arg) {
+  JNIEnv *env;
+  JavaVMAttachArgs args;
+  spnav_event e;
+  struct pollfd pfd[2];
+  jint motion[6] = {0, 0, 0, 0, 0, 0};
+  jlong delta[6], buttons = 0, presses, bit;
+  int fd, count, readable, timeout = -1;
+  int drain = 1;	/* libspnav may have queued events already */
+
+  args.version = JNI_VERSION_1_4;
+  args.name = "SpaceNav listener";
+  args.group = NULL;
+  if((*jvm)->AttachCurrentThreadAsDaemon(jvm, (void**)&env, &args) != JNI_OK) {
+    debug_print("failed to attach the listener thread");
+    return 0;
   }
-  else if(e.type == SPNAV_EVENT_BUTTON) {
 
-    eventClass = (*env)->FindClass(env, "net/sf/spacenav/SpaceNavButtonEvent");
-    if (eventClass == NULL) {
-      return NULL; /* exception thrown */
+  /* poll rather than select, the JVM can easily have descriptors beyond
+   * FD_SETSIZE open
+   */
+  fd = spnav_fd();
+  pfd[0].fd = fd;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = stop_pipe[0];
+  pfd[1].events = POLLIN;
+
+  for(;;) {
+    readable = 0;
+    if(!drain) {
+      if(poll(pfd, 2, timeout) == -1) {	/* negative: no timeout */
+	if(errno == EINTR) {
+	  continue;
+	}
+	debug_printf("poll failed: %s", strerror(errno));
+	break;
+      }
+      if(pfd[1].revents) {
+	break;
+      }
+      readable = pfd[0].revents != 0;
     }
 
-    cid = (*env)->GetMethodID(env, eventClass,
-	"<init>", "(IZ)V");
-    if (cid == NULL) {
-      return NULL; /* exception thrown */
+    memset(delta, 0, sizeof delta);
+    presses = 0;
+    count = 0;
+
+    if(readable || drain) {
+      while(count < LISTENER_BATCH && spnav_poll_event(&e)) {
+	if(e.type == SPNAV_EVENT_MOTION) {
+	  motion[0] = e.motion.x;
+	  motion[1] = e.motion.y;
+	  motion[2] = e.motion.z;
+	  motion[3] = e.motion.rx;
+	  motion[4] = e.motion.ry;
+	  motion[5] = e.motion.rz;
+	  delta[0] += e.motion.x;
+	  delta[1] += e.motion.y;
+	  delta[2] += e.motion.z;
+	  delta[3] += e.motion.rx;
+	  delta[4] += e.motion.ry;
+	  delta[5] += e.motion.rz;
+	}
+	else if(e.type == SPNAV_EVENT_BUTTON && e.button.bnum >= 0 && e.button.bnum < 64) {
+	  bit = (jlong)1 << e.button.bnum;
+	  if(e.button.press) {
+	    buttons |= bit;
+	    presses |= bit;
+	  } else {
+	    buttons &= ~bit;
+	  }
+	}
+	count++;
+      }
+
+      if(count == 0 && readable && connection_closed(fd)) {
+	debug_print("connection to the daemon closed, listener stopped");
+	break;
+      }
     }
+    drain = count == LISTENER_BATCH;
 
-    /* Construct a new object */
-    result = (*env)->NewObject(env, eventClass, cid,
-	(jint)be->bnum, (jint)be->press);
-    /* Free local references */
-    (*env)->DeleteLocalRef(env, eventClass);
-    return result;
+    timeout = (*env)->CallIntMethod(env, listener_state, state_update,
+	motion[0], motion[1], motion[2], motion[3], motion[4], motion[5],
+	delta[0], delta[1], delta[2], delta[3], delta[4], delta[5],
+	buttons, presses, (jint)count);
+    if((*env)->ExceptionCheck(env)) {
+      (*env)->ExceptionDescribe(env);
+      (*env)->ExceptionClear(env);
+      timeout = -1;
+    }
   }
-  else {
-    debug_printf("Unknown event-type: %d", e.type);
+
+  (*jvm)->DetachCurrentThread(jvm);
+  return 0;
+}
+
+JNIEXPORT jboolean JNICALL Java_net_sf_spacenav_SpaceNav_start_1listener(JNIEnv *env,
+    jobject obj, jobject state) {
+  if(listening || spnav_fd() == -1) {
+    debug_print("not connected, or already listening");
+    return JNI_FALSE;
+  }
+
+  if(pipe(stop_pipe) == -1) {
+    debug_printf("failed to create the listener stop pipe: %s", strerror(errno));
+    return JNI_FALSE;
+  }
+  if((listener_state = (*env)->NewGlobalRef(env, state)) == NULL) {
+    goto err;
+  }
+  if(pthread_create(&listener, 0, listener_thread, 0) != 0) {
+    debug_print("failed to start the listener thread");
+    (*env)->DeleteGlobalRef(env, listener_state);
+    goto err;
   }
+  listening = 1;
+  return JNI_TRUE;
 
-  debug_print("Java_SpaceNav_wait_1event returning");
+err:
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+  return JNI_FALSE;
 }
 
+JNIEXPORT void JNICALL Java_net_sf_spacenav_SpaceNav_stop_1listener(JNIEnv *env, jobject obj) {
+  if(!listening) {
+    return;
+  }
+
+  while(write(stop_pipe[1], "", 1) == -1 && errno == EINTR);
+  pthread_join(listener, 0);
+
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+  (*env)->DeleteGlobalRef(env, listener_state);
+  listener_state = NULL;
+  listening = 0;
+}
@@ -0,0 +1,167 @@
+/*
+This file is part of libspnav, part of the spacenav project (spacenav.sf.net)
+Copyright (C) 2007 John Tsiombikas <nuclear@siggraph.org>
+Copyright (C) 2008 Michael Arndt <scriptkiller@gmx.de>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+import java.lang.management.GarbageCollectorMXBean;
+import java.lang.management.ManagementFactory;
+import java.lang.management.ThreadMXBean;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import net.sf.spacenav.*;
+
+/**
+ * Compares the cost of reading events through waitForEvent() (one object per
+ * event), waitEvents(int[]) and waitEvents(ByteBuffer). Each path is run for
+ * a number of warmup iterations, which are discarded, and then for a number
+ * of measured iterations, reporting CPU time per event (the waiting for
+ * events doesn't count), events per second, and garbage collector activity.
+ *
+ * It needs a steady stream of events, for example from the serial device
+ * simulator of spacenavd running as fast as possible (spnavd_sersim -r 0).
+ *
+ * Usage: java Bench [iterations [warmup iterations [seconds per iteration]]]
+ */
+public class Bench {
+
+  interface Path {
+    /** reads some events, returns how many */
+    int read();
+  }
+
+  static int iterations = 5, warmup = 3;
+  static double seconds = 1.0;
+
+  static ThreadMXBean threads = ManagementFactory.getThreadMXBean();
+
+  public static void main(String args[]) {
+    if(args.length > 0) iterations = Integer.parseInt(args[0]);
+    if(args.length > 1) warmup = Integer.parseInt(args[1]);
+    if(args.length > 2) seconds = Double.parseDouble(args[2]);
+
+    final SpaceNav s = new SpaceNav();
+    final int[] records = new int[256 * SpaceNav.EVENT_INTS];
+    final ByteBuffer direct = ByteBuffer.allocateDirect(256 * SpaceNav.EVENT_BYTES)
+      .order(ByteOrder.nativeOrder());
+
+    System.out.printf("%-10s %12s %14s %10s %10s\n",
+	"path", "ns/event", "events/s", "gc count", "gc ms");
+
+    run("object", new Path() {
+      public int read() {
+	SpaceNavEvent e = s.waitForEvent();
+	if(e instanceof SpaceNavMotionEvent) {
+	  sink += ((SpaceNavMotionEvent)e).getX();
+	}
+	return e != null ? 1 : 0;
+      }
+    });
+
+    run("int[]", new Path() {
+      public int read() {
+	int n = s.waitEvents(records);
+	for(int i=0; i<n; i++) {
+	  sink += records[i * SpaceNav.EVENT_INTS + 1];
+	}
+	return n;
+      }
+    });
+
+    run("direct", new Path() {
+      public int read() {
+	direct.clear();
+	int n = s.waitEvents(direct);
+	for(int i=0; i<n; i++) {
+	  sink += direct.getInt(i * SpaceNav.EVENT_BYTES + 4);
+	}
+	return n;
+      }
+    });
+
+    s.closeDevice();
+    if(sink == 42) System.out.println();	/* keep sink alive */
+  }
+
+  /** consumed event data, so that reading the events can't be optimized out */
+  static long sink;
+
+  static void run(String name, Path path) {
+    for(int i=0; i<warmup; i++) {
+      iteration(path);
+    }
+
+    double[] nsev = new double[iterations];
+    double evsec = 0;
+    long gcCount = gcCount(), gcTime = gcTime();
+
+    for(int i=0; i<iterations; i++) {
+      double[] res = iteration(path);
+      nsev[i] = res[0];
+      evsec += res[1];
+    }
+
+    double mean = 0, dev = 0;
+    for(int i=0; i<iterations; i++) mean += nsev[i];
+    mean /= iterations;
+    for(int i=0; i<iterations; i++) dev += (nsev[i] - mean) * (nsev[i] - mean);
+    dev = Math.sqrt(dev / iterations);
+
+    System.out.printf("%-10s %6.0f +-%4.0f %14.0f %10d %10d\n", name, mean, dev,
+	evsec / iterations, gcCount() - gcCount, gcTime() - gcTime);
+  }
+
+  /** returns CPU ns per event and events per second */
+  static double[] iteration(Path path) {
+    long events = 0;
+    long start = System.nanoTime(), end = start + (long)(seconds * 1e9);
+    long cpu = threads.getCurrentThreadCpuTime();
+    long now;
+
+    do {
+      events += path.read();
+    } while((now = System.nanoTime()) < end);
+
+    cpu = threads.getCurrentThreadCpuTime() - cpu;
+    if(events == 0) events = 1;
+    return new double[] { (double)cpu / events, events * 1e9 / (now - start) };
+  }
+
+  static long gcCount() {
+    long n = 0;
+    for(GarbageCollectorMXBean gc : ManagementFactory.getGarbageCollectorMXBeans()) {
+      n += gc.getCollectionCount();
+    }
+    return n;
+  }
+
+  static long gcTime() {
+    long t = 0;
+    for(GarbageCollectorMXBean gc : ManagementFactory.getGarbageCollectorMXBeans()) {
+      t += gc.getCollectionTime();
+    }
+    return t;
+  }
+}
@@ -28,6 +28,9 @@ OF SUCH DAMAGE.
 
 package net.sf.spacenav;
 
+import java.nio.ByteBuffer;
+import java.util.concurrent.Executor;
+
 /**
  * This class provides an interface to the free spacenavd for 3D input
  * devices from 3DConnection (TM),
@@ -36,10 +39,33 @@ package net.sf.spacenav;
  */
 public class SpaceNav {
 
+  /** event type of motion records, see pollEvents() */
+  public static final int EVENT_MOTION = 1;
+  /** event type of button records, see pollEvents() */
+  public static final int EVENT_BUTTON = 2;
+
+  /**
+   * Number of ints of each event record filled in by pollEvents() and
+   * waitEvents(). Every record starts with the event type, followed by
+   * x, y, z, rx, ry, rz, period for EVENT_MOTION, and by the button number
+   * and 1 (pressed) or 0 (released) for EVENT_BUTTON. Unused ints are 0.
+   */
+  public static final int EVENT_INTS = 8;
+  /** size in bytes of each event record in a ByteBuffer */
+  public static final int EVENT_BYTES = EVENT_INTS * 4;
+
   private native void open();
   private native void close();
   private native void sensitivity(double sens);
   private native SpaceNavEvent wait_event();
+  private native SpaceNavEvent poll_event();
+  private native int read_events(int[] buf, boolean wait);
+  private native int read_events_direct(ByteBuffer buf, int pos, int len, boolean wait);
+  private native boolean start_listener(SpaceNavState state);
+  private native void stop_listener();
+
+  /** state updated by the listener, while it's running */
+  private SpaceNavState listenerState;
 
   static {
     System.loadLibrary("SpaceNav");
@@ -60,6 +86,7 @@ public class SpaceNav {
    * Close the connection to the SpaceNav device
    */
   public void closeDevice() {
+    stopListener();
     /* close device */
     close();
   }
@@ -82,4 +109,115 @@ public class SpaceNav {
     return wait_event();
   }
 
+  /**
+   * Get the next pending event, without waiting.
+   * @return the next SpaceNavEvent, or null if there are none
+   */
+  public SpaceNavEvent pollEvent() {
+    return poll_event();
+  }
+
+  /**
+   * Read all pending events (as many as fit) into buffer, without waiting
+   * and without creating an object for each event. Every event is stored as
+   * a record of EVENT_INTS ints, see EVENT_INTS.
+   * @param buffer the array to fill with event records
+   * @return the number of events read
+   */
+  public int pollEvents(int[] buffer) {
+    return read_events(buffer, false);
+  }
+
+  /**
+   * Same as pollEvents(int[]), but waits for at least one event.
+   * @param buffer the array to fill with event records
+   * @return the number of events read, or -1 on failure
+   */
+  public int waitEvents(int[] buffer) {
+    return read_events(buffer, true);
+  }
+
+  /**
+   * Read all pending events (as many as fit) into a direct buffer, without
+   * waiting. The event records (see EVENT_INTS) are stored in native byte
+   * order from the position of the buffer onwards, and the position is
+   * advanced past them. Read them through
+   * buffer.order(ByteOrder.nativeOrder()).
+   * @param buffer a direct buffer to fill with event records
+   * @return the number of events read
+   */
+  public int pollEvents(ByteBuffer buffer) {
+    return readEvents(buffer, false);
+  }
+
+  /**
+   * Same as pollEvents(ByteBuffer), but waits for at least one event.
+   * @param buffer a direct buffer to fill with event records
+   * @return the number of events read, or -1 on failure
+   */
+  public int waitEvents(ByteBuffer buffer) {
+    return readEvents(buffer, true);
+  }
+
+  /**
+   * Start the listener mode: a native thread reads all events and keeps
+   * the returned SpaceNavState up to date, which can then be read at any
+   * time without calling into native code (see SpaceNavState). While the
+   * listener is running, don't call any of the other methods except
+   * stopListener() and closeDevice().
+   * @return the state updated by the listener, or null on failure
+   */
+  public SpaceNavState startListener() {
+    return startListener(null, null, 0);
+  }
+
+  /**
+   * Start the listener mode (see startListener()), calling listener when
+   * the state changes, but at most maxRate times per second. If events
+   * arrive faster, the callback sees all of them coalesced in the state.
+   * @param listener called when the state changes (can be null)
+   * @param executor runs the callbacks, or null to call them directly from
+   *   the listener thread, which delays reading events until they return
+   * @param maxRate the max number of callbacks per second, 0 for no limit
+   * @return the state updated by the listener, or null on failure
+   */
+  public synchronized SpaceNavState startListener(SpaceNavListener listener,
+      Executor executor, int maxRate) {
+    if(listenerState != null) {
+      throw new IllegalStateException("listener already running");
+    }
+    SpaceNavState state = new SpaceNavState(listener, executor, maxRate);
+    if(!start_listener(state)) {
+      return null;
+    }
+    listenerState = state;
+    return state;
+  }
+
+  /**
+   * Stop the listener mode. Can't be called from a callback running on the
+   * listener thread.
+   */
+  public synchronized void stopListener() {
+    if(listenerState == null) {
+      return;
+    }
+    if(listenerState.getThread() == Thread.currentThread()) {
+      throw new IllegalStateException("can't stop the listener from its own thread");
+    }
+    stop_listener();
+    listenerState = null;
+  }
+
+  private int readEvents(ByteBuffer buffer, boolean wait) {
+    if(!buffer.isDirect()) {
+      throw new IllegalArgumentException("not a direct buffer");
+    }
+    int count = read_events_direct(buffer, buffer.position(), buffer.remaining(), wait);
+    if(count > 0) {
+      buffer.position(buffer.position() + count * EVENT_BYTES);
+    }
+    return count;
+  }
+
 }
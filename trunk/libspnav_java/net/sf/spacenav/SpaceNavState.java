@@ -0,0 +1,245 @@
+/*
+This file is part of libspnav, part of the spacenav project (spacenav.sf.net)
+Copyright (C) 2007 John Tsiombikas <nuclear@siggraph.org>
+Copyright (C) 2008 Michael Arndt <scriptkiller@gmx.de>
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+3. The name of the author may not be used to endorse or promote products
+   derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+package net.sf.spacenav;
+
+import java.util.concurrent.Executor;
+
+/**
+ * The state of the device as maintained by the listener mode (see
+ * SpaceNav.startListener()): the latest motion, the motion accumulated since
+ * the last drainTo(), and the buttons. It is updated by the native listener
+ * thread, and can be read from any thread without calling into native code,
+ * for example once per frame by a render loop:
+ *
+ * <pre>
+ *   SpaceNavState state = nav.startListener();
+ *   SpaceNavState frame = new SpaceNavState();
+ *   ...
+ *   state.drainTo(frame);
+ *   camera.move(frame.getDeltaX(), frame.getDeltaY(), frame.getDeltaZ());
+ * </pre>
+ *
+ * The getters don't synchronize, use them on a copy made with copyTo() or
+ * drainTo(), which copy the whole state atomically.
+ */
+public class SpaceNavState {
+
+  /** latest motion */
+  private int x, y, z, rx, ry, rz;
+  /** sum of the motion since the last drainTo() */
+  private long dx, dy, dz, drx, dry, drz;
+  /** buttons held down, and pressed since the last drainTo() (bit n: button n) */
+  private long buttons, presses;
+  /** number of events */
+  private long events;
+
+  /* listener mode */
+  private SpaceNavListener listener;
+  private Executor executor;
+  private long interval;		/* ns between callbacks */
+  private long lastCall;
+  private boolean changed;
+  private volatile boolean inCall;
+  private volatile Thread thread;
+
+  private final Runnable call = new Runnable() {
+    public void run() {
+      try {
+	listener.stateChanged(SpaceNavState.this);
+      } finally {
+	inCall = false;
+      }
+    }
+  };
+
+  /**
+   * Create an empty state, for use with copyTo() and drainTo().
+   */
+  public SpaceNavState() {}
+
+  SpaceNavState(SpaceNavListener listener, Executor executor, int maxRate) {
+    this.listener = listener;
+    this.executor = executor;
+    interval = maxRate > 0 ? 1000000000L / maxRate : 0;
+  }
+
+  /**
+   * Copy the state into dest.
+   * @param dest the state to overwrite
+   */
+  public synchronized void copyTo(SpaceNavState dest) {
+    dest.x = x;
+    dest.y = y;
+    dest.z = z;
+    dest.rx = rx;
+    dest.ry = ry;
+    dest.rz = rz;
+    dest.dx = dx;
+    dest.dy = dy;
+    dest.dz = dz;
+    dest.drx = drx;
+    dest.dry = dry;
+    dest.drz = drz;
+    dest.buttons = buttons;
+    dest.presses = presses;
+    dest.events = events;
+  }
+
+  /**
+   * Copy the state into dest, and reset the accumulated motion and the
+   * pressed buttons, so that the next drainTo() returns what happened since.
+   * @param dest the state to overwrite
+   */
+  public synchronized void drainTo(SpaceNavState dest) {
+    copyTo(dest);
+    dx = dy = dz = 0;
+    drx = dry = drz = 0;
+    presses = 0;
+  }
+
+  /** @return the latest X-translation */
+  public int getX() { return x; }
+  /** @return the latest Y-translation */
+  public int getY() { return y; }
+  /** @return the latest Z-translation */
+  public int getZ() { return z; }
+  /** @return the latest X-rotation */
+  public int getRX() { return rx; }
+  /** @return the latest Y-rotation */
+  public int getRY() { return ry; }
+  /** @return the latest Z-rotation */
+  public int getRZ() { return rz; }
+
+  /** @return the sum of the X-translation of all motion events */
+  public long getDeltaX() { return dx; }
+  /** @return the sum of the Y-translation of all motion events */
+  public long getDeltaY() { return dy; }
+  /** @return the sum of the Z-translation of all motion events */
+  public long getDeltaZ() { return dz; }
+  /** @return the sum of the X-rotation of all motion events */
+  public long getDeltaRX() { return drx; }
+  /** @return the sum of the Y-rotation of all motion events */
+  public long getDeltaRY() { return dry; }
+  /** @return the sum of the Z-rotation of all motion events */
+  public long getDeltaRZ() { return drz; }
+
+  /** @return the buttons held down, bit n for button n (0-63) */
+  public long getButtons() { return buttons; }
+
+  /**
+   * @param button button number (0-63)
+   * @return true if the button is held down
+   */
+  public boolean isPressed(int button) {
+    return (buttons & (1L << button)) != 0;
+  }
+
+  /**
+   * Buttons pressed since the last drainTo(), even if they were released
+   * again in the meantime.
+   * @return the pressed buttons, bit n for button n (0-63)
+   */
+  public long getPresses() { return presses; }
+
+  /**
+   * @param button button number (0-63)
+   * @return true if the button was pressed since the last drainTo()
+   */
+  public boolean wasPressed(int button) {
+    return (presses & (1L << button)) != 0;
+  }
+
+  /** @return the number of events received */
+  public long getEventCount() { return events; }
+
+  /** the thread updating this state, if any */
+  Thread getThread() {
+    return thread;
+  }
+
+  /* Called by the native listener thread with the events coalesced since the
+   * last call (count can be 0). Returns the milliseconds until it should be
+   * called again even without events, or -1.
+   */
+  private int update(int x, int y, int z, int rx, int ry, int rz,
+      long dx, long dy, long dz, long drx, long dry, long drz,
+      long buttons, long presses, int count) {
+    thread = Thread.currentThread();
+
+    if(count > 0) {
+      synchronized(this) {
+	this.x = x;
+	this.y = y;
+	this.z = z;
+	this.rx = rx;
+	this.ry = ry;
+	this.rz = rz;
+	this.dx += dx;
+	this.dy += dy;
+	this.dz += dz;
+	this.drx += drx;
+	this.dry += dry;
+	this.drz += drz;
+	this.buttons = buttons;
+	this.presses |= presses;
+	events += count;
+      }
+      changed = true;
+    }
+
+    if(listener == null || !changed) {
+      return -1;
+    }
+
+    /* at most one callback every interval, and one at a time */
+    long now = System.nanoTime();
+    long wait = lastCall + interval - now;
+    if(inCall) {
+      wait = Math.max(wait, 1000000L);
+    }
+    if(wait > 0) {
+      return (int)((wait + 999999) / 1000000);
+    }
+
+    changed = false;
+    lastCall = now;
+    inCall = true;
+    if(executor == null) {
+      call.run();
+    } else {
+      try {
+	executor.execute(call);
+      } catch(RuntimeException e) {
+	inCall = false;
+	throw e;
+      }
+    }
+    return -1;
+  }
+}
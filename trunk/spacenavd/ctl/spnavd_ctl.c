@@ -0,0 +1,341 @@
+/*
+spnavd_ctl - control utility for the spacenavd daemon.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "proto.h"
+#include "flightrec.h"
+
+#define SOCK_NAME	"/var/run/spnav.sock"
+
+static int connect_daemon(void);
+static int request(int s, struct reqresp *req);
+static int getset(int s, int set, int argc, char **argv);
+static void usage(const char *argv0);
+
+static const char *axis_name[] = {"tx", "ty", "tz", "rx", "ry", "rz"};
+
+int main(int argc, char **argv)
+{
+	int s, res = 0;
+	struct reqresp req;
+
+	if(argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+	if(strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+		usage(argv[0]);
+		return 0;
+	}
+
+	/* reading a flight recorder file doesn't need the daemon, it might not
+	 * even be running anymore.
+	 */
+	if(strcmp(argv[1], "flight") == 0 && argc > 2 && !isdigit((unsigned char)argv[2][0])) {
+		return frec_print_file(stdout, argv[2], argc > 3 ? atoi(argv[3]) : 0) == 0 ? 0 : 1;
+	}
+
+	if((s = connect_daemon()) == -1) {
+		return 1;
+	}
+
+	memset(&req, 0, sizeof req);
+
+	if(strcmp(argv[1], "x11") == 0) {
+		if(argc < 3) {
+			fprintf(stderr, "you must specify either \"start\" or \"stop\".\n");
+			res = -1;
+		} else if(strcmp(argv[2], "start") == 0) {
+			req.type = REQ_X11_START;
+			if((res = request(s, &req)) == 0) {
+				printf("spacenavd should now start sending X events.\n");
+			}
+		} else if(strcmp(argv[2], "stop") == 0) {
+			req.type = REQ_X11_STOP;
+			if((res = request(s, &req)) == 0) {
+				printf("spacenavd stopped sending X events.\n");
+			}
+		} else {
+			fprintf(stderr, "you must specify either \"start\" or \"stop\".\n");
+			res = -1;
+		}
+
+	} else if(strcmp(argv[1], "get") == 0) {
+		res = getset(s, 0, argc - 2, argv + 2);
+
+	} else if(strcmp(argv[1], "set") == 0) {
+		res = getset(s, 1, argc - 2, argv + 2);
+
+	} else if(strcmp(argv[1], "persist") == 0 || strcmp(argv[1], "save") == 0) {
+		req.type = REQ_CFG_SAVE;
+		res = request(s, &req);
+
+	} else if(strcmp(argv[1], "reload") == 0) {
+		req.type = REQ_CFG_RELOAD;
+		res = request(s, &req);
+
+	} else if(strcmp(argv[1], "flight") == 0) {
+		req.type = REQ_FLIGHT_DUMP;
+		req.data[0] = argc > 2 ? atoi(argv[2]) : 0;
+		if((res = request(s, &req)) == 0) {
+			printf("flight recorder dumped to the spacenavd log.\n");
+		}
+
+	} else {
+		fprintf(stderr, "invalid command: %s\n", argv[1]);
+		usage(argv[0]);
+		res = -1;
+	}
+
+	close(s);
+	return res == 0 ? 0 : 1;
+}
+
+static int connect_daemon(void)
+{
+	int s;
+	struct sockaddr_un addr;
+
+	if((s = socket(PF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("failed to create socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SOCK_NAME);
+
+	if(connect(s, (struct sockaddr*)&addr, sizeof addr) == -1) {
+		fprintf(stderr, "failed to connect to spacenavd (%s): %s\n", SOCK_NAME, strerror(errno));
+		close(s);
+		return -1;
+	}
+	return s;
+}
+
+/* sends a request and waits for the response, skipping any events the daemon
+ * sends in the meantime.
+ */
+static int request(int s, struct reqresp *req)
+{
+	int type = req->type | REQ_TAG;
+	struct reqresp resp;
+	char *ptr;
+	int sz, rdbytes;
+
+	req->type = type;
+	while(write(s, req, sizeof *req) == -1) {
+		if(errno != EINTR) {
+			perror("failed to send request");
+			return -1;
+		}
+	}
+
+	for(;;) {
+		ptr = (char*)&resp;
+		sz = sizeof resp;
+		while(sz > 0) {
+			if((rdbytes = read(s, ptr, sz)) <= 0) {
+				if(rdbytes == -1 && errno == EINTR) continue;
+				fprintf(stderr, "lost connection to spacenavd\n");
+				return -1;
+			}
+			ptr += rdbytes;
+			sz -= rdbytes;
+		}
+
+		if(resp.type == type) break;
+	}
+
+	*req = resp;
+	if(req->data[REQ_STATUS] != 0) {
+		fprintf(stderr, "request failed (permission denied or invalid argument)\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int float_to_int(float f)
+{
+	int x;
+	memcpy(&x, &f, sizeof x);
+	return x;
+}
+
+static float int_to_float(int x)
+{
+	float f;
+	memcpy(&f, &x, sizeof f);
+	return f;
+}
+
+static int getset(int s, int set, int argc, char **argv)
+{
+	int i;
+	struct reqresp req;
+	const char *param;
+
+	if(argc < 1) {
+		fprintf(stderr, "missing parameter name\n");
+		return -1;
+	}
+	param = argv[0];
+	argv++;
+	argc--;
+
+	memset(&req, 0, sizeof req);
+
+	if(strcmp(param, "sensitivity") == 0) {
+		if(set) {
+			if(argc < 1) goto missing;
+			req.type = REQ_SET_SENS;
+			req.data[0] = float_to_int(atof(argv[0]));
+			return request(s, &req);
+		}
+		req.type = REQ_GET_SENS;
+		if(request(s, &req) == -1) return -1;
+		printf("%g\n", int_to_float(req.data[0]));
+
+	} else if(strcmp(param, "axis-sensitivity") == 0) {
+		if(set) {
+			if(argc < 6) goto missing;
+			req.type = REQ_SET_SENS_AXIS;
+			for(i=0; i<6; i++) {
+				req.data[i] = float_to_int(atof(argv[i]));
+			}
+			return request(s, &req);
+		}
+		req.type = REQ_GET_SENS_AXIS;
+		if(request(s, &req) == -1) return -1;
+		for(i=0; i<6; i++) {
+			printf("%s: %g\n", axis_name[i], int_to_float(req.data[i]));
+		}
+
+	} else if(strcmp(param, "deadzone") == 0) {
+		if(set) {
+			/* set deadzone [axis] value */
+			if(argc < 1) goto missing;
+			req.type = REQ_SET_DEADZONE;
+			req.data[0] = argc > 1 ? atoi(argv[0]) : -1;
+			req.data[1] = atoi(argv[argc > 1 ? 1 : 0]);
+			return request(s, &req);
+		}
+		if(argc < 1) goto missing;
+		req.type = REQ_GET_DEADZONE;
+		req.data[0] = atoi(argv[0]);
+		if(request(s, &req) == -1) return -1;
+		printf("%d\n", req.data[1]);
+
+	} else if(strcmp(param, "invert") == 0) {
+		/* set invert <axis names...>: inverts the listed axes, the rest are reset */
+		if(set) {
+			req.type = REQ_SET_INVERT;
+			for(i=0; i<argc; i++) {
+				int j;
+				for(j=0; j<6; j++) {
+					if(strcmp(argv[i], axis_name[j]) == 0) {
+						req.data[j] = 1;
+						break;
+					}
+				}
+				if(j >= 6) {
+					fprintf(stderr, "invalid axis: %s\n", argv[i]);
+					return -1;
+				}
+			}
+			return request(s, &req);
+		}
+		req.type = REQ_GET_INVERT;
+		if(request(s, &req) == -1) return -1;
+		for(i=0; i<6; i++) {
+			if(req.data[i]) printf("%s ", axis_name[i]);
+		}
+		putchar('\n');
+
+	} else if(strcmp(param, "axismap") == 0 || strcmp(param, "bnmap") == 0) {
+		int bn = param[0] == 'b';
+		if(argc < (set ? 2 : 1)) goto missing;
+		req.type = bn ? (set ? REQ_SET_BNMAP : REQ_GET_BNMAP) : (set ? REQ_SET_AXISMAP : REQ_GET_AXISMAP);
+		req.data[0] = atoi(argv[0]);
+		if(set) {
+			req.data[1] = atoi(argv[1]);
+			return request(s, &req);
+		}
+		if(request(s, &req) == -1) return -1;
+		printf("%d\n", req.data[1]);
+
+	} else if(strcmp(param, "led") == 0) {
+		if(set) {
+			if(argc < 1) goto missing;
+			req.type = REQ_SET_LED;
+			req.data[0] = strcmp(argv[0], "on") == 0 || atoi(argv[0]) != 0;
+			return request(s, &req);
+		}
+		req.type = REQ_GET_LED;
+		if(request(s, &req) == -1) return -1;
+		printf("%s\n", req.data[0] ? "on" : "off");
+
+	} else if(strcmp(param, "repeat") == 0) {
+		if(set) {
+			if(argc < 1) goto missing;
+			req.type = REQ_SET_REPEAT;
+			req.data[0] = atoi(argv[0]);
+			return request(s, &req);
+		}
+		req.type = REQ_GET_REPEAT;
+		if(request(s, &req) == -1) return -1;
+		printf("%d\n", req.data[0]);
+
+	} else {
+		fprintf(stderr, "invalid parameter: %s\n", param);
+		return -1;
+	}
+	return 0;
+
+missing:
+	fprintf(stderr, "missing value for %s\n", param);
+	return -1;
+}
+
+static void usage(const char *argv0)
+{
+	printf("Usage: %s <command> [args]\n", argv0);
+	printf("commands:\n");
+	printf("  x11 start|stop              start/stop sending X11 events\n");
+	printf("  get <param> [index]         query a configuration parameter\n");
+	printf("  set <param> [index] <value> change a configuration parameter\n");
+	printf("  persist                     write the current configuration to /etc/spnavrc\n");
+	printf("  reload                      discard changes and re-read /etc/spnavrc\n");
+	printf("  flight [records]            dump the flight recorder to the daemon log\n");
+	printf("  flight <file> [records]     print a flight recorder file (flight-recorder-file)\n");
+	printf("parameters:\n");
+	printf("  sensitivity <value>\n");
+	printf("  axis-sensitivity <tx> <ty> <tz> <rx> <ry> <rz>\n");
+	printf("  deadzone [axis] <value>     (all axes if axis is omitted)\n");
+	printf("  invert [axis names...]      (e.g. set invert ty tz)\n");
+	printf("  axismap <dev axis> <axis>\n");
+	printf("  bnmap <dev button> <button>\n");
+	printf("  led on|off\n");
+	printf("  repeat <msec>               (-1 disables)\n");
+}
@@ -0,0 +1,770 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* Micro-benchmarks of the hot paths of the daemon (input processing, event
+ * dispatching, client writes, the serial and /proc parsers, the config
+ * reader) and of libspnav (bench_lib.c), without any devices or clients:
+ *
+ *   $ make bench
+ *   $ spnavd_bench [-r <repeats>] [-t <msec>] [-o out.json] [-c baseline.json] [name ...]
+ *
+ * Each benchmark is calibrated to run for about -t msec, and then repeated
+ * -r times. The median of the repeats is reported in ns per operation, with
+ * the spread around it. Running with -o writes the results as JSON, which a
+ * later run can be compared against with -c, for instance before and after
+ * a change:
+ *
+ *   $ git stash; make bench; cp bench.json /tmp/base.json
+ *   $ git stash pop; make spnavd_bench; ./spnavd_bench -c /tmp/base.json
+ *
+ * Names given on the command line select the benchmarks starting with them.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include "bench.h"
+#include "sergen.h"
+#include "spnavd.h"
+#include "core_impl.h"
+#include "client.h"
+#include "proto_unix.h"
+#include "dev_usb.h"
+#include "flightrec.h"
+#include "serial/sball.h"
+#include "magellan/smag.h"
+
+#define JSON_VERSION	1
+#define MAX_REPEATS		101
+#define MAX_BASELINE	256
+#define MAX_CLIENTS		64
+#define DRAIN_INTERVAL	64
+#define PARSE_BUF_SIZE	16384
+#define NUM_PROC_DEV	24
+
+/* the daemon globals (spnavd.c) */
+struct cfg cfg;
+int verbose;
+struct spnav_core *core;
+
+struct result {
+	double median, min, max, mean, stddev;
+	int repeats;
+	long n;
+};
+
+struct baseline {
+	char name[64];
+	double ns;
+};
+
+static int run_bench(struct bench *b, struct result *res);
+static void print_result(struct bench *b, struct result *res);
+static void write_json(FILE *fp, struct bench *b, struct result *res);
+static int read_baseline(const char *fname);
+static int cmp_double(const void *a, const void *b);
+
+static int setup_core(struct bench *b);
+static void cleanup_core(struct bench *b);
+static double run_motion(struct bench *b, long n);
+static double run_button(struct bench *b, long n);
+static double run_report(struct bench *b, long n);
+static int setup_dispatch(struct bench *b);
+static void cleanup_dispatch(struct bench *b);
+static double run_dispatch(struct bench *b, long n);
+static double run_send_uevent(struct bench *b, long n);
+static int setup_parser(struct bench *b);
+static void cleanup_parser(struct bench *b);
+static double run_parser(struct bench *b, long n);
+#ifdef __linux__
+static int setup_proc(struct bench *b);
+static double run_proc(struct bench *b, long n);
+#endif
+static int setup_cfg(struct bench *b);
+static double run_cfg(struct bench *b, long n);
+static void cleanup_file(struct bench *b);
+
+static struct bench benches[] = {
+	{"process_input/motion", 0, setup_core, run_motion, cleanup_core, 0},
+	{"process_input/button", 0, setup_core, run_button, cleanup_core, 0},
+	{"process_input/report", 0, setup_core, run_report, cleanup_core, 0},
+	{"process_input/report+flightrec", 0, setup_core, run_report, cleanup_core, 1},
+	{"dispatch_event/clients=0", 0, setup_dispatch, run_dispatch, cleanup_dispatch, 0},
+	{"dispatch_event/clients=1", 0, setup_dispatch, run_dispatch, cleanup_dispatch, 1},
+	{"dispatch_event/clients=4", 0, setup_dispatch, run_dispatch, cleanup_dispatch, 4},
+	{"dispatch_event/clients=16", 0, setup_dispatch, run_dispatch, cleanup_dispatch, 16},
+	{"dispatch_event/clients=64", 0, setup_dispatch, run_dispatch, cleanup_dispatch, 64},
+	{"send_uevent/motion", 0, setup_dispatch, run_send_uevent, cleanup_dispatch, 1},
+	{"sball_parse/packet", 0, setup_parser, run_parser, cleanup_parser, PARSER_SBALL},
+	{"smag_parse/packet", 0, setup_parser, run_parser, cleanup_parser, PARSER_SMAG},
+#ifdef __linux__
+	{"find_usb_devices/proc", 0, setup_proc, run_proc, cleanup_file, 0},
+#endif
+	{"read_cfg", 0, setup_cfg, run_cfg, cleanup_file, 0},
+	{0, 0, 0, 0, 0, 0}
+};
+
+static int num_repeats = 11;
+static double target_sec = 0.02;
+
+static struct baseline base[MAX_BASELINE];
+static int num_base;
+
+static struct device *dev;
+static int num_events;
+static struct client *clients[MAX_CLIENTS];
+static int client_fd[MAX_CLIENTS][2];
+static void *parser;
+static unsigned char *parse_buf;
+static int parse_size;
+static char tmp_fname[64];
+
+
+int main(int argc, char **argv)
+{
+	int i, j, num_sel = 0, found = 0;
+	char **sel;
+	FILE *json = 0;
+	struct bench *b;
+	struct result res;
+
+	if(!(sel = malloc(argc * sizeof *sel))) {
+		perror("failed to allocate memory");
+		return 1;
+	}
+
+	for(i=1; i<argc; i++) {
+		if(strcmp(argv[i], "-r") == 0 && i < argc - 1) {
+			num_repeats = atoi(argv[++i]);
+			if(num_repeats < 1 || num_repeats > MAX_REPEATS) {
+				fprintf(stderr, "repeats must be 1-%d\n", MAX_REPEATS);
+				return 1;
+			}
+		} else if(strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+			target_sec = atof(argv[++i]) / 1000.0;
+		} else if(strcmp(argv[i], "-o") == 0 && i < argc - 1) {
+			if(!(json = fopen(argv[++i], "w"))) {
+				fprintf(stderr, "failed to open %s: %s\n", argv[i], strerror(errno));
+				return 1;
+			}
+		} else if(strcmp(argv[i], "-c") == 0 && i < argc - 1) {
+			if(read_baseline(argv[++i]) == -1) {
+				return 1;
+			}
+		} else if(argv[i][0] == '-') {
+			fprintf(stderr, "usage: %s [-r <repeats>] [-t <msec>] [-o out.json] [-c baseline.json] [name ...]\n", argv[0]);
+			return 1;
+		} else {
+			sel[num_sel++] = argv[i];
+		}
+	}
+
+	if(json) {
+		fprintf(json, "{\n\"version\": %d,\n\"benchmarks\": [\n", JSON_VERSION);
+	}
+
+	for(i=0; i<2; i++) {
+		for(b = i ? lib_benches : benches; b->name; b++) {
+			if(num_sel) {
+				for(j=0; j<num_sel; j++) {
+					if(strncmp(b->name, sel[j], strlen(sel[j])) == 0) break;
+				}
+				if(j >= num_sel) continue;
+			}
+
+			if(b->setup && b->setup(b) == -1) {
+				fprintf(stderr, "%s: setup failed, skipped\n", b->name);
+				continue;
+			}
+			run_bench(b, &res);
+			if(b->cleanup) {
+				b->cleanup(b);
+			}
+
+			print_result(b, &res);
+			if(json) {
+				if(found) fputs(",\n", json);
+				write_json(json, b, &res);
+			}
+			found++;
+		}
+	}
+
+	if(json) {
+		fputs("\n]\n}\n", json);
+		fclose(json);
+	}
+	free(sel);
+
+	if(!found) {
+		fprintf(stderr, "no benchmarks selected\n");
+		return 1;
+	}
+	return 0;
+}
+
+/* calibrates the number of operations to run for about target_sec, warms up,
+ * and then runs the repeats
+ */
+static int run_bench(struct bench *b, struct result *res)
+{
+	int i, ops = b->ops > 0 ? b->ops : 1;
+	long n = 1;
+	double dt, sum = 0.0, var = 0.0;
+	double ns[MAX_REPEATS], sorted[MAX_REPEATS];
+
+	while((dt = b->run(b, n)) < target_sec / 10.0 && n < 1000000000) {
+		n *= dt < target_sec / 1000.0 ? 10 : 2;
+	}
+	if((n = (long)(n * target_sec / dt)) < 1) {
+		n = 1;
+	}
+	b->run(b, n);
+
+	for(i=0; i<num_repeats; i++) {
+		ns[i] = b->run(b, n) * 1e9 / ((double)n * ops);
+		sum += ns[i];
+	}
+	memcpy(sorted, ns, num_repeats * sizeof *ns);
+	qsort(sorted, num_repeats, sizeof *sorted, cmp_double);
+
+	res->repeats = num_repeats;
+	res->n = n * ops;
+	res->min = sorted[0];
+	res->max = sorted[num_repeats - 1];
+	res->median = num_repeats & 1 ? sorted[num_repeats / 2] :
+		(sorted[num_repeats / 2 - 1] + sorted[num_repeats / 2]) / 2.0;
+	res->mean = sum / num_repeats;
+	for(i=0; i<num_repeats; i++) {
+		var += (ns[i] - res->mean) * (ns[i] - res->mean);
+	}
+	res->stddev = sqrt(var / num_repeats);
+	return 0;
+}
+
+/* the spread is relative to the mean, a large one means the numbers are not
+ * to be trusted (frequency scaling, other load), and are marked with a '?'
+ */
+static void print_result(struct bench *b, struct result *res)
+{
+	int i;
+	double spread = res->mean > 0.0 ? 100.0 * res->stddev / res->mean : 0.0;
+
+	printf("%-32s %10.1f ns/op  (min %.1f, max %.1f, sd %4.1f%%)%s", b->name, res->median,
+			res->min, res->max, spread, spread > 5.0 ? " ?" : "");
+
+	for(i=0; i<num_base; i++) {
+		if(strcmp(base[i].name, b->name) == 0) {
+			printf("  %+6.1f%% (was %.1f)", 100.0 * (res->median - base[i].ns) / base[i].ns, base[i].ns);
+			break;
+		}
+	}
+	putchar('\n');
+	fflush(stdout);
+}
+
+/* one benchmark per line, which is what read_baseline expects */
+static void write_json(FILE *fp, struct bench *b, struct result *res)
+{
+	fprintf(fp, "{\"name\": \"%s\", \"ns_per_op\": %.2f, \"min\": %.2f, \"max\": %.2f, "
+			"\"mean\": %.2f, \"stddev\": %.2f, \"repeats\": %d, \"ops\": %ld}", b->name,
+			res->median, res->min, res->max, res->mean, res->stddev, res->repeats, res->n);
+}
+
+static int read_baseline(const char *fname)
+{
+	FILE *fp;
+	char buf[512], *name, *ns, *end;
+
+	if(!(fp = fopen(fname, "r"))) {
+		fprintf(stderr, "failed to open baseline %s: %s\n", fname, strerror(errno));
+		return -1;
+	}
+	while(num_base < MAX_BASELINE && fgets(buf, sizeof buf, fp)) {
+		if(!(name = strstr(buf, "\"name\": \"")) || !(ns = strstr(buf, "\"ns_per_op\": "))) {
+			continue;
+		}
+		name += 9;
+		if(!(end = strchr(name, '"')) || end - name >= (int)sizeof base->name) {
+			continue;
+		}
+		memcpy(base[num_base].name, name, end - name);
+		base[num_base].name[end - name] = 0;
+		if((base[num_base].ns = atof(ns + 13)) > 0.0) {
+			num_base++;
+		}
+	}
+	fclose(fp);
+
+	if(!num_base) {
+		fprintf(stderr, "no benchmark results found in %s\n", fname);
+		return -1;
+	}
+	return 0;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+double bench_time(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+	}
+#endif
+	{
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+		return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+	}
+}
+
+
+/* ---- input processing, with a device which is not backed by anything ---- */
+
+static void count_event(struct device *dev, spnav_event *ev, void *cls)
+{
+	num_events++;
+}
+
+static int setup_core(struct bench *b)
+{
+	default_cfg(&cfg);
+	if(!(core = spnav_core_create(&cfg))) {
+		return -1;
+	}
+	spnav_core_set_event_func(core, count_event, 0);
+
+	if(!(dev = calloc(1, sizeof *dev))) {
+		perror("failed to allocate device");
+		return -1;
+	}
+	dev->id = core->next_dev_id++;
+	dev->fd = -1;
+	dev->core = core;
+	strcpy(dev->name, "benchmark device");
+	strcpy(dev->path, "none");
+
+	if(b->arg) {
+		frec_init(DEF_FLIGHT_SIZE, "");
+	}
+	return 0;
+}
+
+static void cleanup_core(struct bench *b)
+{
+	frec_shutdown();
+	remove_dev_event(dev);
+	free(dev->subs);
+	free(dev);
+	spnav_core_destroy(core);
+	core = 0;
+}
+
+static double run_motion(struct bench *b, long n)
+{
+	long i;
+	double t0;
+	struct dev_input inp;
+
+	memset(&inp, 0, sizeof inp);
+
+	t0 = bench_time();
+	for(i=0; i<n; i++) {
+		inp.type = INP_MOTION;
+		inp.idx = i % 6;
+		inp.val = (int)(i & 0x1ff) - 256;
+		process_input(dev, &inp);
+	}
+	return bench_time() - t0;
+}
+
+static double run_button(struct bench *b, long n)
+{
+	long i;
+	double t0;
+	struct dev_input inp;
+
+	memset(&inp, 0, sizeof inp);
+
+	t0 = bench_time();
+	for(i=0; i<n; i++) {
+		inp.type = INP_BUTTON;
+		inp.idx = (i >> 1) & 1;
+		inp.val = !(i & 1);
+		process_input(dev, &inp);
+	}
+	return bench_time() - t0;
+}
+
+/* a whole input report: the 6 axes and the flush emitting the motion event */
+static double run_report(struct bench *b, long n)
+{
+	long i;
+	int j;
+	double t0;
+	struct dev_input inp;
+
+	memset(&inp, 0, sizeof inp);
+
+	t0 = bench_time();
+	for(i=0; i<n; i++) {
+		for(j=0; j<6; j++) {
+			inp.type = INP_MOTION;
+			inp.idx = j;
+			inp.val = (int)((i + j * 37) & 0x1ff) - 256;
+			process_input(dev, &inp);
+		}
+		inp.type = INP_FLUSH;
+		process_input(dev, &inp);
+	}
+	return bench_time() - t0;
+}
+
+
+/* ---- event dispatching to AF_UNIX clients, over socketpairs ---- */
+
+static int setup_dispatch(struct bench *b)
+{
+	int i;
+
+	if(setup_core(b) == -1) {
+		return -1;
+	}
+	init_dispatch(core);
+
+	for(i=0; i<b->arg; i++) {
+		if(socketpair(AF_UNIX, SOCK_STREAM, 0, client_fd[i]) == -1) {
+			perror("failed to create socket pair");
+			return -1;
+		}
+		fcntl(client_fd[i][1], F_SETFL, fcntl(client_fd[i][1], F_GETFL) | O_NONBLOCK);
+
+		if(!(clients[i] = add_client(CLIENT_UNIX, client_fd[i]))) {
+			fprintf(stderr, "failed to add client\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void cleanup_dispatch(struct bench *b)
+{
+	int i;
+
+	for(i=0; i<b->arg; i++) {
+		remove_client(clients[i]);
+		close(client_fd[i][0]);
+		close(client_fd[i][1]);
+	}
+	cleanup_core(b);
+}
+
+static void drain_clients(int count)
+{
+	int i;
+	char buf[4096];
+
+	for(i=0; i<count; i++) {
+		while(read(client_fd[i][1], buf, sizeof buf) > 0);
+	}
+}
+
+static void init_motion_event(spnav_event *ev)
+{
+	memset(ev, 0, sizeof *ev);
+	ev->type = EVENT_MOTION;
+	ev->motion.data = &ev->motion.x;
+	ev->motion.x = 12;
+	ev->motion.y = -40;
+	ev->motion.z = 3;
+	ev->motion.rx = 120;
+	ev->motion.ry = 0;
+	ev->motion.rz = -7;
+	ev->motion.period = 8;
+}
+
+static double run_dispatch(struct bench *b, long n)
+{
+	long i, j, count;
+	double t0, sum = 0.0;
+	spnav_event ev;
+
+	init_motion_event(&ev);
+
+	for(i=0; i<n; i+=count) {
+		count = n - i < DRAIN_INTERVAL ? n - i : DRAIN_INTERVAL;
+
+		t0 = bench_time();
+		for(j=0; j<count; j++) {
+			core->event_func(dev, &ev, core->event_cls);
+		}
+		sum += bench_time() - t0;
+
+		drain_clients(b->arg);
+	}
+	return sum;
+}
+
+static double run_send_uevent(struct bench *b, long n)
+{
+	long i, j, count;
+	double t0, sum = 0.0;
+	spnav_event ev;
+
+	init_motion_event(&ev);
+
+	for(i=0; i<n; i+=count) {
+		count = n - i < DRAIN_INTERVAL ? n - i : DRAIN_INTERVAL;
+
+		t0 = bench_time();
+		for(j=0; j<count; j++) {
+			send_uevent(&ev, clients[0]);
+		}
+		sum += bench_time() - t0;
+
+		drain_clients(1);
+	}
+	return sum;
+}
+
+
+/* ---- serial parsers, per packet, in read-sized chunks ---- */
+
+static int setup_parser(struct bench *b)
+{
+	if(!parse_buf && !(parse_buf = malloc(PARSE_BUF_SIZE))) {
+		perror("failed to allocate buffer");
+		return -1;
+	}
+
+	sergen_seed(1);
+	parse_size = 0;
+	b->ops = 0;
+	while(parse_size < PARSE_BUF_SIZE - 64) {
+		parse_size += sergen_packet(b->arg, parse_buf + parse_size);
+		b->ops++;
+	}
+
+	parser = b->arg == PARSER_SBALL ? sball_open_parser() : (void*)smag_create(-1);
+	if(!parser) {
+		perror("failed to create parser");
+		return -1;
+	}
+	return 0;
+}
+
+static void cleanup_parser(struct bench *b)
+{
+	if(b->arg == PARSER_SBALL) {
+		sball_close(parser);
+	} else {
+		smag_destroy(parser);
+	}
+	parser = 0;
+}
+
+static double run_parser(struct bench *b, long n)
+{
+	long i;
+	int pos, sz;
+	double t0;
+	struct dev_input inp;
+
+	t0 = bench_time();
+	for(i=0; i<n; i++) {
+		for(pos=0; pos<parse_size; pos+=sz) {
+			if(b->arg == PARSER_SBALL) {
+				sz = parse_size - pos < SBALL_READ_SIZE ? parse_size - pos : SBALL_READ_SIZE;
+				sball_parse(parser, parse_buf + pos, sz);
+				while(sball_get_input(parser, &inp));
+			} else {
+				sz = parse_size - pos < SMAG_READ_SIZE ? parse_size - pos : SMAG_READ_SIZE;
+				smag_parse(parser, parse_buf + pos, sz);
+				while(smag_get_input(parser, &inp));
+			}
+		}
+	}
+	return bench_time() - t0;
+}
+
+
+/* ---- device detection and configuration files ---- */
+
+static FILE *create_tmp_file(void)
+{
+	int fd;
+	FILE *fp;
+
+	strcpy(tmp_fname, "/tmp/spnavd_bench.XXXXXX");
+	if((fd = mkstemp(tmp_fname)) == -1) {
+		perror("failed to create temporary file");
+		return 0;
+	}
+	if(!(fp = fdopen(fd, "w"))) {
+		perror("failed to open temporary file");
+		close(fd);
+		unlink(tmp_fname);
+		return 0;
+	}
+	return fp;
+}
+
+static void cleanup_file(struct bench *b)
+{
+	unlink(tmp_fname);
+	if(core) {
+		spnav_core_destroy(core);
+		core = 0;
+	}
+}
+
+#ifdef __linux__
+static int match_3dx(struct spnav_core *core, const struct usb_device_info *devinfo)
+{
+	return devinfo->vendorid == 0x256f || (devinfo->vendorid == 0x46d && (devinfo->productid & 0xff00) == 0xc600);
+}
+
+/* a /proc/bus/input/devices of a typical desktop, with two space mice */
+static int setup_proc(struct bench *b)
+{
+	int i;
+	FILE *fp;
+
+	default_cfg(&cfg);
+	if(!(core = spnav_core_create(&cfg)) || !(fp = create_tmp_file())) {
+		return -1;
+	}
+
+	for(i=0; i<NUM_PROC_DEV; i++) {
+		int vendor = 0x46d, product = 0xc52b;
+		const char *name = "Logitech USB Receiver";
+
+		if(i == 5) {
+			vendor = 0x256f;
+			product = 0xc635;
+			name = "3Dconnexion SpaceMouse Compact";
+		} else if(i == 17) {
+			product = 0xc626;
+			name = "3Dconnexion SpaceNavigator";
+		} else if(i & 1) {
+			vendor = 0;
+			product = 0;
+			name = "Power Button";
+		}
+
+		fprintf(fp, "I: Bus=0003 Vendor=%04x Product=%04x Version=0111\n", vendor, product);
+		fprintf(fp, "N: Name=\"%s\"\n", name);
+		fprintf(fp, "P: Phys=usb-0000:00:14.0-%d/input0\n", i);
+		fprintf(fp, "S: Sysfs=/devices/pci0000:00/0000:00:14.0/usb1/1-%d/1-%d:1.0/0003:%04X:%04X.%04X/input/input%d\n",
+				i, i, vendor, product, i, i);
+		fprintf(fp, "U: Uniq=\n");
+		fprintf(fp, "H: Handlers=sysrq kbd leds event%d\n", i);
+		fprintf(fp, "B: PROP=0\nB: EV=120013\n");
+		fprintf(fp, "B: KEY=1000000000007 ff9f207ac14057ff febeffdfffefffff fffffffffffffffe\n");
+		fprintf(fp, "B: MSC=10\nB: LED=1f\n\n");
+	}
+	fclose(fp);
+	return 0;
+}
+
+static double run_proc(struct bench *b, long n)
+{
+	long i;
+	double t0;
+	struct usb_device_info *list;
+
+	t0 = bench_time();
+	for(i=0; i<n; i++) {
+		list = find_usb_devices_proc(core, tmp_fname, match_3dx);
+		free_usb_devices_list(list);
+	}
+	return bench_time() - t0;
+}
+#endif	/* __linux__ */
+
+/* a configuration file with some of everything */
+static int setup_cfg(struct bench *b)
+{
+	int i;
+	FILE *fp;
+
+	if(!(fp = create_tmp_file())) {
+		return -1;
+	}
+	fclose(fp);
+
+	default_cfg(&cfg);
+	cfg.sensitivity = 1.5;
+	cfg.sens_rot[2] = 0.5;
+	for(i=0; i<MAX_AXES; i++) {
+		cfg.dead_threshold[i] = 4;
+	}
+	cfg.invert[1] = cfg.invert[4] = 1;
+	cfg.map_button[0] = 1;
+	cfg.map_button[1] = 0;
+	cfg.kbmap_str[2] = strdup("Escape");
+	cfg.kbmap_str[3] = strdup("Control_L");
+	cfg.devname[0] = strdup("3Dconnexion SpaceMouse Wireless");
+	strcpy(cfg.serial_dev, "/dev/ttyS0");
+
+	i = write_cfg(tmp_fname, &cfg);
+	destroy_cfg(&cfg);
+	return i;
+}
+
+static double run_cfg(struct bench *b, long n)
+{
+	long i;
+	double t0;
+	static struct cfg rcfg;
+
+	t0 = bench_time();
+	for(i=0; i<n; i++) {
+		read_cfg(tmp_fname, &rcfg);
+		destroy_cfg(&rcfg);
+	}
+	return bench_time() - t0;
+}
+
+void schedule_cfg_reload(void)
+{
+}
+
+int save_cfg(void)
+{
+	return 0;
+}
+
+#ifndef BENCH_LIBSPNAV
+struct bench lib_benches[] = {
+	{0, 0, 0, 0, 0, 0}
+};
+#endif
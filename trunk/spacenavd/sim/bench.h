@@ -0,0 +1,40 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BENCH_H_
+#define BENCH_H_
+
+/* A benchmark runs its operation n times and returns the seconds spent in
+ * it, leaving out any work it does in between which is not being measured
+ * (refilling or draining sockets). An operation can stand for a batch of ops
+ * smaller ones, in which case the result is per small one.
+ */
+struct bench {
+	const char *name;
+	int ops;		/* ops per operation (0: 1) */
+	int (*setup)(struct bench *b);
+	double (*run)(struct bench *b, long n);
+	void (*cleanup)(struct bench *b);
+	long arg;
+};
+
+double bench_time(void);
+
+/* libspnav client side benchmarks (bench_lib.c), null terminated */
+extern struct bench lib_benches[];
+
+#endif	/* BENCH_H_ */
@@ -0,0 +1,135 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/* libspnav benchmarks for spnavd_bench, built from the libspnav source next
+ * to spacenavd, so that they can get at its internals: the library is
+ * connected to one end of a socketpair instead of the daemon, and the
+ * benchmark writes the daemon side of the protocol to the other end.
+ * Compiled without X11, the AF_UNIX path is the one being measured.
+ */
+#define SPNAV_CONFIG_H_
+#undef USE_X11
+#include "spnav.c"
+#include "bench.h"
+
+#define BATCH	64
+
+static int setup_lib(struct bench *b);
+static void cleanup_lib(struct bench *b);
+static double run_poll(struct bench *b, long n);
+static double run_remove(struct bench *b, long n);
+
+struct bench lib_benches[] = {
+	{"libspnav/spnav_poll_event", 0, setup_lib, run_poll, cleanup_lib, 0},
+	{"libspnav/spnav_remove_events/64", 0, setup_lib, run_remove, cleanup_lib, 0},
+	{0, 0, 0, 0, 0, 0}
+};
+
+static int daemon_fd;
+
+
+static int setup_lib(struct bench *b)
+{
+	int sv[2];
+
+	if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+		perror("failed to create socket pair");
+		return -1;
+	}
+	if(!(ev_queue = malloc(sizeof *ev_queue))) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	ev_queue->next = 0;
+	ev_queue_tail = ev_queue;
+
+	sock = sv[0];
+	daemon_fd = sv[1];
+	return 0;
+}
+
+static void cleanup_lib(struct bench *b)
+{
+	spnav_close();
+	close(daemon_fd);
+}
+
+/* writes count events to the client, every 8th a button event, as
+ * send_uevent does.
+ */
+static void send_events(int count)
+{
+	int i, data[BATCH][8];
+
+	memset(data, 0, sizeof data);
+	for(i=0; i<count; i++) {
+		if((i & 7) == 7) {
+			data[i][0] = 1 + (i & 8 ? 1 : 0);
+			data[i][1] = i & 1;
+		} else {
+			data[i][1] = i;
+			data[i][2] = -i;
+			data[i][4] = 100;
+			data[i][7] = 8;
+		}
+	}
+	if(write(daemon_fd, data, count * sizeof *data) == -1) {
+		perror("failed to write events");
+	}
+}
+
+static double run_poll(struct bench *b, long n)
+{
+	long i, j, count;
+	double t0, sum = 0.0;
+	spnav_event ev;
+
+	for(i=0; i<n; i+=count) {
+		count = n - i < BATCH ? n - i : BATCH;
+		send_events(count);
+
+		t0 = bench_time();
+		for(j=0; j<count; j++) {
+			spnav_poll_event(&ev);
+		}
+		sum += bench_time() - t0;
+	}
+	return sum;
+}
+
+/* removing the motion events out of a batch, typically done to skip ahead to
+ * the latest state. The button events are left in the queue, and taken out
+ * afterwards.
+ */
+static double run_remove(struct bench *b, long n)
+{
+	long i;
+	double t0, sum = 0.0;
+	spnav_event ev;
+
+	for(i=0; i<n; i++) {
+		send_events(BATCH);
+
+		t0 = bench_time();
+		spnav_remove_events(SPNAV_EVENT_MOTION);
+		sum += bench_time() - t0;
+
+		while(spnav_poll_event(&ev));
+	}
+	return sum;
+}
@@ -0,0 +1,286 @@
+/*
+spnavd_netrelay - lossy UDP relay for testing spacenavd event forwarding.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Relays UDP datagrams from a local port to another address, dropping,
+ * duplicating and reordering them at the requested rates, so that the
+ * forwarding between two spacenavd instances (forward and receive in
+ * spnavrc) can be tested against a bad network over loopback:
+ *
+ *   forward = 127.0.0.1:11012
+ *   receive = 11011
+ *   $ spnavd_netrelay -l 11012 -f 127.0.0.1:11011 -d 0.1 -r 0.05
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MAX_DGRAM	2048
+
+static int parse_args(int argc, char **argv);
+static int parse_addr(const char *str, struct sockaddr_in *sa);
+static double frand(void);
+static void relay(int s, const void *buf, int size);
+static void sig_handler(int s);
+
+static int listen_port = 11012;
+static struct sockaddr_in dest;
+static double drop_prob, dup_prob, reorder_prob;
+static double duration;
+static int verbose;
+
+static volatile sig_atomic_t quit;
+
+static unsigned long received, sent, dropped, duplicated, reordered;
+
+/* datagram held back to be sent after the next one */
+static unsigned char held[MAX_DGRAM];
+static int held_size = -1;
+
+
+int main(int argc, char **argv)
+{
+	int s, sz;
+	unsigned char buf[MAX_DGRAM];
+	struct sockaddr_in sa;
+	struct timeval tv, start, now;
+	fd_set rset;
+
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	dest.sin_port = htons(11011);
+
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
+
+	if((s = socket(PF_INET, SOCK_DGRAM, 0)) == -1) {
+		perror("failed to create socket");
+		return 1;
+	}
+	memset(&sa, 0, sizeof sa);
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_ANY);
+	sa.sin_port = htons(listen_port);
+	if(bind(s, (struct sockaddr*)&sa, sizeof sa) == -1) {
+		fprintf(stderr, "failed to bind to port %d: %s\n", listen_port, strerror(errno));
+		return 1;
+	}
+
+	signal(SIGINT, sig_handler);
+	signal(SIGTERM, sig_handler);
+
+	printf("relaying port %d to %s:%d\n", listen_port, inet_ntoa(dest.sin_addr), ntohs(dest.sin_port));
+	fflush(stdout);
+
+	gettimeofday(&start, 0);
+	while(!quit) {
+		FD_ZERO(&rset);
+		FD_SET(s, &rset);
+		tv.tv_sec = 0;
+		tv.tv_usec = 100000;
+
+		if(select(s + 1, &rset, 0, 0, &tv) > 0) {
+			if((sz = recv(s, buf, sizeof buf, 0)) > 0) {
+				received++;
+				relay(s, buf, sz);
+			}
+		}
+
+		if(duration > 0.0) {
+			gettimeofday(&now, 0);
+			if((now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec) / 1000000.0 >= duration) {
+				break;
+			}
+		}
+	}
+
+	printf("received %lu, sent %lu, dropped %lu, duplicated %lu, reordered %lu\n",
+			received, sent, dropped, duplicated, reordered);
+	return 0;
+}
+
+static void send_dgram(int s, const void *buf, int size)
+{
+	if(sendto(s, buf, size, 0, (struct sockaddr*)&dest, sizeof dest) == -1) {
+		if(verbose) {
+			perror("send failed");
+		}
+		return;
+	}
+	sent++;
+}
+
+static void relay(int s, const void *buf, int size)
+{
+	if(frand() < drop_prob) {
+		dropped++;
+		return;
+	}
+
+	if(held_size < 0 && frand() < reorder_prob) {
+		/* hold it back, it goes out after the next one */
+		memcpy(held, buf, size);
+		held_size = size;
+		reordered++;
+		return;
+	}
+
+	send_dgram(s, buf, size);
+	if(frand() < dup_prob) {
+		send_dgram(s, buf, size);
+		duplicated++;
+	}
+
+	if(held_size >= 0) {
+		send_dgram(s, held, held_size);
+		held_size = -1;
+	}
+}
+
+static double frand(void)
+{
+	return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+static int parse_addr(const char *str, struct sockaddr_in *sa)
+{
+	char host[256];
+	const char *colon;
+	int port;
+
+	if(!(colon = strrchr(str, ':')) || colon - str >= (int)sizeof host) {
+		return -1;
+	}
+	memcpy(host, str, colon - str);
+	host[colon - str] = 0;
+
+	if((port = atoi(colon + 1)) <= 0 || port > 65535 || !inet_aton(host, &sa->sin_addr)) {
+		return -1;
+	}
+	sa->sin_port = htons(port);
+	return 0;
+}
+
+static void sig_handler(int s)
+{
+	quit = 1;
+}
+
+static const char *usage_fmt =
+	"Usage: %s [options]\n"
+	"Relays UDP datagrams from a local port to another address, dropping,\n"
+	"duplicating and reordering them.\n"
+	"Options:\n"
+	"  -l <port>        port to receive on (default: 11012)\n"
+	"  -f <addr:port>   address to relay to (default: 127.0.0.1:11011)\n"
+	"  -d <prob>        probability of dropping a datagram (default: 0)\n"
+	"  -u <prob>        probability of duplicating a datagram (default: 0)\n"
+	"  -r <prob>        probability of sending a datagram after the next one (default: 0)\n"
+	"  -t <sec>         stop after sec seconds\n"
+	"  -s <seed>        random seed\n"
+	"  -v               print send errors\n"
+	"  -h               print this usage information and exit\n";
+
+static int parse_args(int argc, char **argv)
+{
+	int i;
+	char *arg, *endp;
+	double val;
+
+	for(i=1; i<argc; i++) {
+		if(argv[i][0] != '-' || !argv[i][1] || argv[i][2]) {
+			goto invalid;
+		}
+
+		switch(argv[i][1]) {
+		case 'v':
+			verbose = 1;
+			continue;
+
+		case 'h':
+			printf(usage_fmt, argv[0]);
+			exit(0);
+
+		case 'l':
+		case 'f':
+		case 'd':
+		case 'u':
+		case 'r':
+		case 't':
+		case 's':
+			break;
+
+		default:
+			goto invalid;
+		}
+
+		if(!(arg = argv[++i])) {
+			fprintf(stderr, "%s must be followed by a value\n", argv[i - 1]);
+			return -1;
+		}
+
+		if(argv[i - 1][1] == 'f') {
+			if(parse_addr(arg, &dest) == -1) {
+				fprintf(stderr, "invalid address: %s, expected addr:port\n", arg);
+				return -1;
+			}
+			continue;
+		}
+
+		val = strtod(arg, &endp);
+		if(endp == arg || *endp || val < 0.0) {
+			fprintf(stderr, "invalid value for %s: %s\n", argv[i - 1], arg);
+			return -1;
+		}
+
+		switch(argv[i - 1][1]) {
+		case 'l':
+			listen_port = (int)val;
+			break;
+		case 'd':
+			drop_prob = val;
+			break;
+		case 'u':
+			dup_prob = val;
+			break;
+		case 'r':
+			reorder_prob = val;
+			break;
+		case 't':
+			duration = val;
+			break;
+		case 's':
+			srand((unsigned int)val);
+			break;
+		}
+	}
+	return 0;
+
+invalid:
+	fprintf(stderr, "invalid argument: %s\n", argv[i]);
+	fprintf(stderr, usage_fmt, argv[0]);
+	return -1;
+}
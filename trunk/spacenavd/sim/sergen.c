@@ -0,0 +1,125 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sergen.h"
+
+/* the magellan nibble encoding */
+static const int smag_first_parity[16] = {
+	0xE0, 0xA0, 0xA0, 0x60, 0xA0, 0x60, 0x60, 0xA0,
+	0x90, 0x50, 0x50, 0x90, 0xD0, 0x90, 0x90, 0x50
+};
+static const int smag_second_parity[64] = {
+	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
+	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
+	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
+	0x80, 0x40, 0x40, 0x80, 0xC0, 0x80, 0x80, 0x40,
+	0xC0, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
+	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
+	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
+	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x00, 0x80
+};
+
+static unsigned int rnd_state = 1;
+
+int sergen_stream(int type, unsigned char *buf, int size, int noisy)
+{
+	int i, len, pos = 0;
+
+	while(pos < size - 64) {
+		if(noisy && sergen_rnd() % 8 == 0) {
+			/* line noise */
+			len = 1 + sergen_rnd() % 8;
+			for(i=0; i<len; i++) {
+				buf[pos++] = sergen_rnd();
+			}
+		}
+		pos += sergen_packet(type, buf + pos);
+	}
+	return pos;
+}
+
+static int put_sball_byte(unsigned char *buf, int c)
+{
+	c &= 0xff;
+	if(c == '^' || c == 0x0d || c == 0x11 || c == 0x13) {
+		buf[0] = '^';
+		buf[1] = c == '^' ? '^' : c | 0x40;
+		return 2;
+	}
+	buf[0] = c;
+	return 1;
+}
+
+int sergen_packet(int type, unsigned char *buf)
+{
+	int i, val, n, sum, offset, len = 0;
+
+	if(type == PARSER_SBALL) {
+		if(sergen_rnd() % 16) {
+			buf[len++] = 'D';
+			for(i=0; i<14; i++) {
+				len += put_sball_byte(buf + len, sergen_rnd());
+			}
+		} else {
+			buf[len++] = sergen_rnd() & 1 ? 'K' : '.';
+			len += put_sball_byte(buf + len, 0x40 | (sergen_rnd() & 0x3f));
+			len += put_sball_byte(buf + len, 0x40 | (sergen_rnd() & 0xbf));
+		}
+		buf[len++] = '\r';
+		return len;
+	}
+
+	if(sergen_rnd() % 16) {
+		buf[len++] = 'd';
+		sum = offset = 0;
+		for(i=0; i<6; i++) {
+			val = (int)(sergen_rnd() % 1023) - 511;
+			n = val & 0x3ff;
+			buf[len++] = smag_first_parity[n >> 6] | (n >> 6);
+			buf[len++] = smag_second_parity[n & 0x3f] | (n & 0x3f);
+			sum += val;
+			offset += val < 0 ? (val + 1) / 64 - 1 : val / 64;
+		}
+		sum = (short)sum & 0x3f;
+		sum += offset;
+		if(sum < 0) sum += 64;
+		if(sum > 63) sum -= 64;
+		buf[len++] = smag_second_parity[0];
+		buf[len++] = smag_second_parity[sum] | sum;
+	} else {
+		buf[len++] = 'k';
+		for(i=0; i<3; i++) {
+			n = sergen_rnd() & 0xf;
+			buf[len++] = smag_first_parity[n] | n;
+		}
+	}
+	buf[len++] = '\r';
+	return len;
+}
+
+void sergen_seed(unsigned int seed)
+{
+	rnd_state = seed ? seed : 1;
+}
+
+unsigned int sergen_rnd(void)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
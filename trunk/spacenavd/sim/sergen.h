@@ -0,0 +1,38 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SERGEN_H_
+#define SERGEN_H_
+
+/* generates spaceball and magellan serial data, for the parser benchmarks
+ * and the fuzzer.
+ */
+
+enum { PARSER_SBALL, PARSER_SMAG };
+
+/* random motion (mostly) and button packets, optionally with line noise
+ * between them, up to size bytes. returns the number of bytes generated.
+ */
+int sergen_stream(int type, unsigned char *buf, int size, int noisy);
+/* a single packet, returns its size (< 64) */
+int sergen_packet(int type, unsigned char *buf);
+
+/* xorshift, reproducible for the same seed */
+void sergen_seed(unsigned int seed);
+unsigned int sergen_rnd(void);
+
+#endif	/* SERGEN_H_ */
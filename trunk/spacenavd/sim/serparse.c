@@ -0,0 +1,356 @@
+/*
+spnavd_serparse - serial protocol parser benchmark and fuzzer for spacenavd.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Runs the spaceball and magellan packet parsers on generated data, without a
+ * device:
+ *
+ *  bench: parser throughput, on clean and on noisy streams of packets.
+ *  fuzz:  parses random and mutated streams (or the given files) once in the
+ *         largest chunks the parsers take, and once in random chunks, and
+ *         checks that the results are identical and nothing was dropped.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "serial/sball.h"
+#include "magellan/smag.h"
+#include "dev_serial.h"
+#include "sergen.h"
+
+#define STREAM_SIZE		(1 << 20)
+#define MAX_FUZZ_SIZE	4096
+#define MAX_INPUTS		(MAX_FUZZ_SIZE * 4)
+
+struct parser {
+	const char *name;
+	int type;
+	int max_chunk;
+};
+
+static struct parser parsers[] = {
+	{"spaceball", PARSER_SBALL, SBALL_READ_SIZE},
+	{"magellan", PARSER_SMAG, SMAG_READ_SIZE},
+	{0, 0, 0}
+};
+
+struct result {
+	struct dev_input *inp;
+	int num_inp;
+	struct serial_stats st;
+};
+
+static int bench(double sec);
+static int fuzz(unsigned long iter, int argc, char **argv);
+static void mutate(unsigned char *buf, int *size, int max_size);
+static void *open_parser(int type);
+static void close_parser(int type, void *p);
+static int parse(int type, void *p, const unsigned char *data, int sz, struct result *res);
+static int check(int type, const unsigned char *data, int sz, const char *what);
+static double get_time(void);
+
+
+int main(int argc, char **argv)
+{
+	int i;
+	double sec = 1.0;
+	unsigned long iter = 100000;
+
+	for(i=2; i<argc; i++) {
+		if(strcmp(argv[i], "-t") == 0 && i < argc - 1) {
+			sec = atof(argv[++i]);
+		} else if(strcmp(argv[i], "-n") == 0 && i < argc - 1) {
+			iter = strtoul(argv[++i], 0, 0);
+		} else if(strcmp(argv[i], "-s") == 0 && i < argc - 1) {
+			sergen_seed(strtoul(argv[++i], 0, 0));
+		} else {
+			break;
+		}
+	}
+
+	if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+		return bench(sec) == 0 ? 0 : 1;
+	}
+	if(argc > 1 && strcmp(argv[1], "fuzz") == 0) {
+		return fuzz(iter, argc - i, argv + i) == 0 ? 0 : 1;
+	}
+
+	fprintf(stderr, "usage: %s bench [-t <sec>] [-s <seed>]\n", argv[0]);
+	fprintf(stderr, "       %s fuzz [-n <iterations>] [-s <seed>] [files ...]\n", argv[0]);
+	return 1;
+}
+
+static int bench(double sec)
+{
+	int i, j, noisy, size, pos, sz;
+	unsigned long passes;
+	unsigned long long bytes, inputs;
+	double start, dt;
+	void *p;
+	unsigned char *buf;
+	struct dev_input inp;
+	struct serial_stats st;
+
+	if(!(buf = malloc(STREAM_SIZE))) {
+		perror("failed to allocate buffer");
+		return -1;
+	}
+
+	for(i=0; parsers[i].name; i++) {
+		for(noisy=0; noisy<2; noisy++) {
+			size = sergen_stream(parsers[i].type, buf, STREAM_SIZE, noisy);
+			p = open_parser(parsers[i].type);
+
+			/* read-sized chunks, draining the input after each, like the
+			 * driver does.
+			 */
+			bytes = inputs = 0;
+			passes = 0;
+			start = get_time();
+			do {
+				for(pos=0; pos<size; pos+=sz) {
+					sz = size - pos < parsers[i].max_chunk ? size - pos : parsers[i].max_chunk;
+					parse(parsers[i].type, p, buf + pos, sz, 0);
+					j = 0;
+					while(parsers[i].type == PARSER_SBALL ? sball_get_input(p, &inp) : smag_get_input(p, &inp)) {
+						j++;
+					}
+					inputs += j;
+				}
+				bytes += size;
+				passes++;
+			} while((dt = get_time() - start) < sec);
+
+			if(parsers[i].type == PARSER_SBALL) {
+				sball_get_stats(p, &st);
+			} else {
+				smag_get_stats(p, &st);
+			}
+			close_parser(parsers[i].type, p);
+
+			printf("%-10s %-6s %8.2f MB/s %7.2f ns/byte %10.0f inputs/s  (%lu packets, %lu bad, %lu unknown, %lu overruns)\n",
+					parsers[i].name, noisy ? "noisy" : "clean", bytes / dt / 1048576.0, dt * 1e9 / bytes,
+					inputs / dt, st.packets, st.bad_packets, st.unknown, st.overruns);
+		}
+	}
+
+	free(buf);
+	return 0;
+}
+
+static int fuzz(unsigned long iter, int argc, char **argv)
+{
+	int i, j, size;
+	unsigned long n;
+	unsigned char buf[MAX_FUZZ_SIZE];
+	char what[64];
+	FILE *fp;
+
+	/* given inputs, for running under an external fuzzer, or reproducing */
+	if(argc > 0) {
+		for(i=0; i<argc; i++) {
+			if(!(fp = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "rb"))) {
+				perror(argv[i]);
+				return -1;
+			}
+			size = fread(buf, 1, sizeof buf, fp);
+			if(fp != stdin) fclose(fp);
+
+			for(j=0; parsers[j].name; j++) {
+				if(check(parsers[j].type, buf, size, argv[i]) == -1) {
+					return -1;
+				}
+			}
+		}
+		return 0;
+	}
+
+	for(n=0; n<iter; n++) {
+		for(j=0; parsers[j].name; j++) {
+			/* valid packets, and then damage them */
+			size = 0;
+			while(size < (int)sizeof buf - 64 && (size < 64 || sergen_rnd() % 32)) {
+				size += sergen_packet(parsers[j].type, buf + size);
+			}
+			mutate(buf, &size, sizeof buf);
+
+			sprintf(what, "iteration %lu", n);
+			if(check(parsers[j].type, buf, size, what) == -1) {
+				sprintf(what, "serfuzz-fail-%s-%lu.bin", parsers[j].name, n);
+				if((fp = fopen(what, "wb"))) {
+					fwrite(buf, 1, size, fp);
+					fclose(fp);
+					fprintf(stderr, "input written to %s\n", what);
+				}
+				return -1;
+			}
+		}
+	}
+	printf("fuzz: %lu iterations ok\n", iter);
+	return 0;
+}
+
+/* parses the data in the largest chunks and in random ones, and compares */
+static int check(int type, const unsigned char *data, int sz, const char *what)
+{
+	int i, pos, chunk, max_chunk, res = 0;
+	void *p;
+	struct result whole, split;
+	const char *name = type == PARSER_SBALL ? "spaceball" : "magellan";
+
+	max_chunk = type == PARSER_SBALL ? SBALL_READ_SIZE : SMAG_READ_SIZE;
+
+	whole.inp = malloc(MAX_INPUTS * sizeof *whole.inp);
+	split.inp = malloc(MAX_INPUTS * sizeof *split.inp);
+	if(!whole.inp || !split.inp) {
+		perror("failed to allocate input buffers");
+		free(whole.inp);
+		free(split.inp);
+		return -1;
+	}
+	whole.num_inp = split.num_inp = 0;
+	memset(&whole.st, 0, sizeof whole.st);
+	memset(&split.st, 0, sizeof split.st);
+
+	p = open_parser(type);
+	for(pos=0; pos<sz; pos+=chunk) {
+		chunk = sz - pos < max_chunk ? sz - pos : max_chunk;
+		parse(type, p, data + pos, chunk, &whole);
+	}
+	close_parser(type, p);
+
+	p = open_parser(type);
+	for(pos=0; pos<sz; pos+=chunk) {
+		chunk = 1 + sergen_rnd() % max_chunk;
+		if(chunk > sz - pos) chunk = sz - pos;
+		parse(type, p, data + pos, chunk, &split);
+	}
+	close_parser(type, p);
+
+	if(whole.st.dropped || split.st.dropped) {
+		fprintf(stderr, "%s %s: input dropped\n", name, what);
+		res = -1;
+	} else if(whole.num_inp != split.num_inp) {
+		fprintf(stderr, "%s %s: %d inputs in one go, %d in chunks\n", name, what, whole.num_inp, split.num_inp);
+		res = -1;
+	} else if(memcmp(&whole.st, &split.st, sizeof whole.st) != 0) {
+		fprintf(stderr, "%s %s: different parser stats in chunks\n", name, what);
+		res = -1;
+	} else {
+		for(i=0; i<whole.num_inp; i++) {
+			if(whole.inp[i].type != split.inp[i].type || whole.inp[i].idx != split.inp[i].idx ||
+					whole.inp[i].val != split.inp[i].val) {
+				fprintf(stderr, "%s %s: input %d differs in chunks\n", name, what, i);
+				res = -1;
+				break;
+			}
+		}
+	}
+
+	free(whole.inp);
+	free(split.inp);
+	return res;
+}
+
+static void *open_parser(int type)
+{
+	void *p = type == PARSER_SBALL ? sball_open_parser() : (void*)smag_create(-1);
+	if(!p) {
+		perror("failed to create parser");
+		exit(1);
+	}
+	return p;
+}
+
+static void close_parser(int type, void *p)
+{
+	if(type == PARSER_SBALL) {
+		sball_close(p);
+	} else {
+		smag_destroy(p);
+	}
+}
+
+/* parses a chunk, and collects the input and stats in res (if not null) */
+static int parse(int type, void *p, const unsigned char *data, int sz, struct result *res)
+{
+	int n;
+	struct dev_input inp;
+
+	n = type == PARSER_SBALL ? sball_parse(p, data, sz) : smag_parse(p, data, sz);
+	if(!res) {
+		return n;
+	}
+
+	while(type == PARSER_SBALL ? sball_get_input(p, &inp) : smag_get_input(p, &inp)) {
+		if(res->num_inp < MAX_INPUTS) {
+			res->inp[res->num_inp++] = inp;
+		}
+	}
+	if(type == PARSER_SBALL) {
+		sball_get_stats(p, &res->st);
+	} else {
+		smag_get_stats(p, &res->st);
+	}
+	return n;
+}
+
+/* bit flips, random bytes, deleted and duplicated ranges */
+static void mutate(unsigned char *buf, int *size, int max_size)
+{
+	int i, num, pos, len, sz = *size;
+
+	num = sergen_rnd() % 8;
+	for(i=0; i<num && sz > 0; i++) {
+		pos = sergen_rnd() % sz;
+
+		switch(sergen_rnd() % 4) {
+		case 0:
+			buf[pos] ^= 1 << (sergen_rnd() % 8);
+			break;
+
+		case 1:
+			buf[pos] = sergen_rnd();
+			break;
+
+		case 2:
+			len = sergen_rnd() % 32;
+			if(len > sz - pos) len = sz - pos;
+			memmove(buf + pos, buf + pos + len, sz - pos - len);
+			sz -= len;
+			break;
+
+		case 3:
+			len = sergen_rnd() % 32;
+			if(len > sz - pos) len = sz - pos;
+			if(sz + len <= max_size) {
+				memmove(buf + pos + len, buf + pos, sz - pos);
+				sz += len;
+			}
+			break;
+		}
+	}
+	*size = sz;
+}
+
+static double get_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
@@ -0,0 +1,764 @@
+/*
+spnavd_sersim - serial 6dof device simulator for testing spacenavd.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Creates a pseudo-terminal and speaks the protocol of a serial Spaceball
+ * (2003, 3003, 4000 FLX) or Magellan on it, so that the serial drivers can be
+ * tested and benchmarked without the hardware: point the serial option of
+ * spacenavd to the slave device printed on startup (or to the -l link).
+ *
+ * It answers the commands the drivers send (spaceball reset, magellan version
+ * query and mode commands), and generates motion and button packets, error
+ * packets, resets and garbage at the requested rates.
+ */
+#define _XOPEN_SOURCE	600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/time.h>
+#include <sys/select.h>
+
+#define OUTBUF_SIZE		4096
+#define MAX_CMD_LEN		64
+
+#define SBALL_RESET_MSG		"@1 Spaceball alive and well after a poweron reset.\r"
+#define SMAG_VERSION_MSG	"v  MAGELLAN  Version 6.60  3Dconnexion GmbH 05/11/01\r"
+
+enum { MODEL_2003, MODEL_3003, MODEL_4000, MODEL_MAGELLAN };
+
+/* a button is a bit in one of the bytes of the button packet */
+struct button {
+	int byte, mask;
+};
+
+static const struct button sball2003_buttons[] = {
+	{2, 0x01}, {2, 0x02}, {2, 0x04}, {2, 0x08},	/* 1-4 */
+	{1, 0x01}, {1, 0x02}, {1, 0x04},			/* 5-7 */
+	{1, 0x10},									/* pick */
+	{0, 0}
+};
+static const struct button sball3003_buttons[] = {
+	{2, 0x10}, {2, 0x20},	/* left, right */
+	{1, 0x20},				/* rezero */
+	{0, 0}
+};
+static const struct button sball4000_buttons[] = {
+	{2, 0x01}, {2, 0x02}, {2, 0x04}, {2, 0x08}, {2, 0x10}, {2, 0x20},	/* 1-6 */
+	{2, 0x80},															/* 7 */
+	{1, 0x01}, {1, 0x02}, {1, 0x04}, {1, 0x08}, {1, 0x10},				/* 8-12 */
+	{0, 0}
+};
+static const struct button smag_buttons[] = {
+	{1, 0x01}, {1, 0x02}, {1, 0x04}, {1, 0x08},	/* 1-4 */
+	{2, 0x01}, {2, 0x02}, {2, 0x04}, {2, 0x08},	/* 5-8 */
+	{3, 0x02}, {3, 0x04},						/* left, right (magellan plus) */
+	{0, 0}
+};
+
+static struct {
+	const char *name;
+	int model;
+	const struct button *buttons;
+	int max_val;
+} models[] = {
+	{"2003", MODEL_2003, sball2003_buttons, 32767},
+	{"3003", MODEL_3003, sball3003_buttons, 32767},
+	{"4000", MODEL_4000, sball4000_buttons, 32767},
+	{"magellan", MODEL_MAGELLAN, smag_buttons, 511},
+	{0, 0, 0, 0}
+};
+
+/* magellan nibble encoding, the upper bits make the parity come out right */
+static const int smag_first_parity[16] = {
+	0xE0, 0xA0, 0xA0, 0x60, 0xA0, 0x60, 0x60, 0xA0,
+	0x90, 0x50, 0x50, 0x90, 0xD0, 0x90, 0x90, 0x50
+};
+static const int smag_second_parity[64] = {
+	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
+	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
+	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
+	0x80, 0x40, 0x40, 0x80, 0xC0, 0x80, 0x80, 0x40,
+	0xC0, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
+	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
+	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
+	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x00, 0x80
+};
+
+struct stats {
+	unsigned long motion, button, error, reset, garbage, dropped;
+	unsigned long bytes, commands;
+};
+
+static int model = MODEL_2003;
+static const struct button *buttons = sball2003_buttons;
+static int max_val = 32767;
+static double motion_rate = 50.0;	/* 0: as fast as the pty takes them */
+static double button_rate = 0.5;
+static double error_rate, reset_rate;
+static int amplitude = -1;
+static int noise;
+static double garbage_prob;
+static unsigned long max_count;
+static double duration;
+static const char *link_path;
+static int verbose;
+
+static int master_fd = -1, slave_fd = -1;
+static unsigned char outbuf[OUTBUF_SIZE];
+static int outlen;
+static int smag_streaming;
+static int button_state[4], pressed = -1;
+static struct stats stats;
+
+static volatile sig_atomic_t quit;
+
+static int open_pty(void);
+static void handle_input(void);
+static void handle_cmd(const char *cmd);
+static int room(void);
+static void put(const void *data, int sz);
+static void put_sball_byte(int c);
+static int gen_motion(double t, double dt);
+static void gen_button(void);
+static void gen_error(void);
+static void gen_reset(void);
+static void gen_garbage(void);
+static int flush_out(void);
+static double get_time(void);
+static void print_stats(double elapsed);
+static void sig_handler(int s);
+static int parse_args(int argc, char **argv);
+
+
+int main(int argc, char **argv)
+{
+	int res;
+	double start, now, prev_motion, next_motion, next_button, next_error, next_reset, next;
+	fd_set rdset, wrset;
+	struct timeval tv;
+
+	if(parse_args(argc, argv) == -1) {
+		return 1;
+	}
+	if(amplitude < 0) {
+		amplitude = max_val / 2;
+	}
+	if(amplitude > max_val) {
+		amplitude = max_val;
+	}
+
+	if(open_pty() == -1) {
+		return 1;
+	}
+	printf("%s\n", ptsname(master_fd));
+	fflush(stdout);
+
+	signal(SIGINT, sig_handler);
+	signal(SIGTERM, sig_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	start = prev_motion = next_motion = get_time();
+	next_button = button_rate > 0.0 ? start + 1.0 / button_rate : -1.0;
+	next_error = error_rate > 0.0 ? start + 1.0 / error_rate : -1.0;
+	next_reset = reset_rate > 0.0 ? start + 1.0 / reset_rate : -1.0;
+
+	while(!quit) {
+		now = get_time();
+		if(duration > 0.0 && now - start >= duration) {
+			break;
+		}
+		if(max_count && stats.motion >= max_count && !outlen) {
+			break;
+		}
+
+		/* generate everything which is due */
+		if(!max_count || stats.motion < max_count) {
+			if(motion_rate <= 0.0) {
+				/* flood: keep the output buffer topped up */
+				while(room() >= 64 && (!max_count || stats.motion < max_count)) {
+					if(!gen_motion(now - start, now - prev_motion)) {
+						break;
+					}
+					prev_motion = now;
+				}
+			} else if(now >= next_motion) {
+				gen_motion(now - start, now - prev_motion);
+				prev_motion = now;
+				next_motion += 1.0 / motion_rate;
+				if(next_motion < now) {
+					next_motion = now + 1.0 / motion_rate;
+				}
+			}
+		}
+		if(next_button > 0.0 && now >= next_button) {
+			gen_button();
+			next_button += 1.0 / button_rate;
+		}
+		if(next_error > 0.0 && now >= next_error) {
+			gen_error();
+			next_error += 1.0 / error_rate;
+		}
+		if(next_reset > 0.0 && now >= next_reset) {
+			gen_reset();
+			next_reset += 1.0 / reset_rate;
+		}
+
+		/* wait for the next one, host commands, or room in the pty */
+		next = motion_rate > 0.0 ? next_motion : now + 0.1;
+		if(next_button > 0.0 && next_button < next) next = next_button;
+		if(next_error > 0.0 && next_error < next) next = next_error;
+		if(next_reset > 0.0 && next_reset < next) next = next_reset;
+		next -= get_time();
+		if(next < 0.0) next = 0.0;
+		tv.tv_sec = (long)next;
+		tv.tv_usec = (long)((next - (double)tv.tv_sec) * 1000000.0);
+
+		FD_ZERO(&rdset);
+		FD_ZERO(&wrset);
+		FD_SET(master_fd, &rdset);
+		if(outlen) {
+			FD_SET(master_fd, &wrset);
+		}
+
+		if((res = select(master_fd + 1, &rdset, &wrset, 0, &tv)) == -1) {
+			if(errno == EINTR) continue;
+			perror("select failed");
+			break;
+		}
+		if(res > 0 && FD_ISSET(master_fd, &rdset)) {
+			handle_input();
+		}
+		if(res > 0 && FD_ISSET(master_fd, &wrset)) {
+			if(flush_out() == -1) {
+				break;
+			}
+		}
+	}
+
+	print_stats(get_time() - start);
+
+	if(link_path) {
+		unlink(link_path);
+	}
+	close(slave_fd);
+	close(master_fd);
+	return 0;
+}
+
+static int open_pty(void)
+{
+	struct termios term;
+
+	if((master_fd = posix_openpt(O_RDWR | O_NOCTTY)) == -1) {
+		perror("failed to open pseudo-terminal");
+		return -1;
+	}
+	if(grantpt(master_fd) == -1 || unlockpt(master_fd) == -1) {
+		perror("failed to set up pseudo-terminal");
+		close(master_fd);
+		return -1;
+	}
+	fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+
+	/* keep the slave open, so that the driver can close and re-open it (device
+	 * detection) without the master side getting hung up. The driver sets up
+	 * the port itself, but make it raw until then, to avoid echoing our output
+	 * back to us.
+	 */
+	if((slave_fd = open(ptsname(master_fd), O_RDWR | O_NOCTTY)) == -1) {
+		perror("failed to open the pseudo-terminal slave");
+		close(master_fd);
+		return -1;
+	}
+	if(tcgetattr(slave_fd, &term) == 0) {
+		term.c_iflag = IGNBRK | IGNPAR;
+		term.c_oflag = 0;
+		term.c_lflag = 0;
+		term.c_cflag = CREAD | CS8 | CLOCAL;
+		term.c_cc[VMIN] = 0;
+		term.c_cc[VTIME] = 0;
+		tcsetattr(slave_fd, TCSANOW, &term);
+	}
+
+	if(link_path) {
+		unlink(link_path);
+		if(symlink(ptsname(master_fd), link_path) == -1) {
+			fprintf(stderr, "failed to create link %s: %s\n", link_path, strerror(errno));
+		}
+	}
+	return 0;
+}
+
+/* collects the commands sent by the driver, up to the carriage return */
+static void handle_input(void)
+{
+	static char cmd[MAX_CMD_LEN];
+	static int cmd_len;
+	char buf[256];
+	int i, sz;
+
+	while((sz = read(master_fd, buf, sizeof buf)) > 0) {
+		for(i=0; i<sz; i++) {
+			if(buf[i] == '\r' || buf[i] == '\n') {
+				if(cmd_len) {
+					cmd[cmd_len] = 0;
+					handle_cmd(cmd);
+					cmd_len = 0;
+				}
+			} else if(buf[i] && cmd_len < MAX_CMD_LEN - 1) {
+				cmd[cmd_len++] = buf[i];
+			}
+		}
+	}
+}
+
+static void handle_cmd(const char *cmd)
+{
+	char reply[8];
+
+	stats.commands++;
+	if(verbose) {
+		fprintf(stderr, "command: %s\n", cmd);
+	}
+
+	if(model != MODEL_MAGELLAN) {
+		if(cmd[0] == '@') {
+			/* reset: the ball reports it and waits to be initialized again */
+			put(SBALL_RESET_MSG, sizeof SBALL_RESET_MSG - 1);
+		}
+		return;
+	}
+
+	switch(cmd[0]) {
+	case 'v':
+		if(cmd[1] == 'Q') {
+			/* the version query stops everything else */
+			smag_streaming = 0;
+			put(SMAG_VERSION_MSG, sizeof SMAG_VERSION_MSG - 1);
+		}
+		break;
+
+	case 'c':
+		/* translation/rotation mode, echoed back like the real thing */
+		if(cmd[1]) {
+			smag_streaming = (cmd[1] & 3) != 0;
+		}
+		/* fall through */
+	case 'n':
+	case 'q':
+		if(strlen(cmd) < sizeof reply - 1) {
+			sprintf(reply, "%s\r", cmd);
+			put(reply, strlen(reply));
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static int room(void)
+{
+	return OUTBUF_SIZE - outlen;
+}
+
+static void put(const void *data, int sz)
+{
+	if(sz > room()) {
+		stats.dropped++;
+		return;
+	}
+	memcpy(outbuf + outlen, data, sz);
+	outlen += sz;
+}
+
+/* spaceball packets can't contain XON, XOFF or CR, they are escaped with ^ */
+static void put_sball_byte(int c)
+{
+	unsigned char esc[2];
+
+	c &= 0xff;
+	switch(c) {
+	case '^':
+		esc[0] = esc[1] = '^';
+		put(esc, 2);
+		break;
+
+	case 0x0d:	/* ^M */
+	case 0x11:	/* ^Q */
+	case 0x13:	/* ^S */
+		esc[0] = '^';
+		esc[1] = c | 0x40;
+		put(esc, 2);
+		break;
+
+	default:
+		esc[0] = c;
+		put(esc, 1);
+	}
+}
+
+/* returns 0 if the device isn't sending motion packets */
+static int gen_motion(double t, double dt)
+{
+	int i, val[6], sum, offset, timer;
+	unsigned char pkt[16];
+
+	if(model == MODEL_MAGELLAN && !smag_streaming) {
+		return 0;
+	}
+	if(room() < 40) {
+		stats.dropped++;
+		return 1;
+	}
+	if(garbage_prob > 0.0 && (double)rand() / RAND_MAX < garbage_prob) {
+		gen_garbage();
+	}
+
+	/* every axis moves along its own sine wave */
+	for(i=0; i<6; i++) {
+		val[i] = (int)(amplitude * sin(t * (1.0 + 0.37 * i) + i));
+		if(noise) {
+			val[i] += rand() % (2 * noise + 1) - noise;
+		}
+		if(val[i] > max_val) val[i] = max_val;
+		if(val[i] < -max_val) val[i] = -max_val;
+	}
+
+	if(model == MODEL_MAGELLAN) {
+		/* 6 10-bit values, 4+6 bits in two characters each, and a checksum
+		 * of their sum, adjusted by how many times they wrap at 64.
+		 */
+		pkt[0] = 'd';
+		sum = offset = 0;
+		for(i=0; i<6; i++) {
+			int n = val[i] & 0x3ff;
+			pkt[i * 2 + 1] = smag_first_parity[n >> 6] | (n >> 6);
+			pkt[i * 2 + 2] = smag_second_parity[n & 0x3f] | (n & 0x3f);
+			sum += val[i];
+			offset += val[i] < 0 ? (val[i] + 1) / 64 - 1 : val[i] / 64;
+		}
+		sum = (short)sum & 0x3f;
+		sum += offset;
+		if(sum < 0) sum += 64;
+		if(sum > 63) sum -= 64;
+		pkt[13] = smag_second_parity[0];
+		pkt[14] = smag_second_parity[sum] | sum;
+		pkt[15] = '\r';
+		put(pkt, 16);
+
+	} else {
+		/* time since the last packet in 1/16 msec */
+		timer = (int)(dt * 16000.0);
+		if(timer > 0xffff) timer = 0xffff;
+
+		pkt[0] = 'D';
+		put(pkt, 1);
+		put_sball_byte(timer >> 8);
+		put_sball_byte(timer);
+		for(i=0; i<6; i++) {
+			put_sball_byte(val[i] >> 8);
+			put_sball_byte(val[i]);
+		}
+		pkt[0] = '\r';
+		put(pkt, 1);
+	}
+	stats.motion++;
+	return 1;
+}
+
+/* presses a random button, and releases it the next time */
+static void gen_button(void)
+{
+	int i, num;
+	unsigned char pkt[5];
+
+	if(model == MODEL_MAGELLAN && !smag_streaming) {
+		return;
+	}
+	if(room() < 8) {
+		stats.dropped++;
+		return;
+	}
+
+	if(pressed >= 0) {
+		button_state[buttons[pressed].byte] &= ~buttons[pressed].mask;
+		pressed = -1;
+	} else {
+		for(num=0; buttons[num].mask; num++);
+		pressed = rand() % num;
+		button_state[buttons[pressed].byte] |= buttons[pressed].mask;
+	}
+
+	switch(model) {
+	case MODEL_MAGELLAN:
+		pkt[0] = 'k';
+		for(i=1; i<4; i++) {
+			pkt[i] = smag_first_parity[button_state[i] & 0xf] | (button_state[i] & 0xf);
+		}
+		pkt[4] = '\r';
+		put(pkt, 5);
+		break;
+
+	case MODEL_4000:
+		/* 0x20: right-handed */
+		pkt[0] = '.';
+		put(pkt, 1);
+		put_sball_byte(0x40 | 0x20 | button_state[1]);
+		put_sball_byte(0x40 | button_state[2]);
+		pkt[0] = '\r';
+		put(pkt, 1);
+		break;
+
+	default:
+		pkt[0] = 'K';
+		put(pkt, 1);
+		put_sball_byte(0x40 | button_state[1]);
+		put_sball_byte(0x40 | button_state[2]);
+		pkt[0] = '\r';
+		put(pkt, 1);
+	}
+	stats.button++;
+}
+
+static void gen_error(void)
+{
+	int i, len;
+	char pkt[8];
+
+	/* spaceball error packet, 'E' and up to 6 bytes of error code. The magellan
+	 * doesn't have them, for it this is just an unknown packet.
+	 */
+	if(model == MODEL_MAGELLAN && !smag_streaming) {
+		return;	/* quiet until initialized, or it looks like a spaceball */
+	}
+
+	len = 1 + rand() % 6;
+	pkt[0] = model == MODEL_MAGELLAN ? 'e' : 'E';
+	for(i=0; i<len; i++) {
+		pkt[i + 1] = '@' + (rand() & 0x1f);
+	}
+	pkt[len + 1] = '\r';
+	put(pkt, len + 2);
+	stats.error++;
+}
+
+static void gen_reset(void)
+{
+	if(model == MODEL_MAGELLAN) {
+		/* a power cycle: back to its quiet state, with the version banner */
+		if(!smag_streaming) {
+			return;
+		}
+		smag_streaming = 0;
+		put(SMAG_VERSION_MSG, sizeof SMAG_VERSION_MSG - 1);
+	} else {
+		put(SBALL_RESET_MSG, sizeof SBALL_RESET_MSG - 1);
+	}
+	stats.reset++;
+}
+
+/* line noise: a few random bytes */
+static void gen_garbage(void)
+{
+	int i, len;
+	unsigned char buf[8];
+
+	len = 1 + rand() % sizeof buf;
+	for(i=0; i<len; i++) {
+		buf[i] = rand() & 0xff;
+	}
+	put(buf, len);
+	stats.garbage++;
+}
+
+static int flush_out(void)
+{
+	int sz;
+
+	if((sz = write(master_fd, outbuf, outlen)) == -1) {
+		if(errno == EAGAIN || errno == EINTR) {
+			return 0;
+		}
+		perror("failed to write to the pseudo-terminal");
+		return -1;
+	}
+	stats.bytes += sz;
+	outlen -= sz;
+	if(outlen) {
+		memmove(outbuf, outbuf + sz, outlen);
+	}
+	return 0;
+}
+
+static double get_time(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void print_stats(double elapsed)
+{
+	if(elapsed <= 0.0) elapsed = 1e-6;
+
+	fprintf(stderr, "%.2f sec: %lu motion, %lu button, %lu error, %lu reset, %lu garbage packets\n",
+			elapsed, stats.motion, stats.button, stats.error, stats.reset, stats.garbage);
+	fprintf(stderr, "  %lu bytes (%.0f bytes/sec, %.0f motion packets/sec), %lu dropped, %lu commands received\n",
+			stats.bytes, stats.bytes / elapsed, stats.motion / elapsed, stats.dropped, stats.commands);
+}
+
+static void sig_handler(int s)
+{
+	quit = 1;
+}
+
+static const char *usage_fmt =
+	"Usage: %s [options]\n"
+	"Simulates a serial 6dof device on a pseudo-terminal, and prints the\n"
+	"pseudo-terminal device to use as the spacenavd serial device.\n"
+	"Options:\n"
+	"  -m <model>  device: 2003, 3003, 4000 (spaceball) or magellan (default: 2003)\n"
+	"  -r <rate>   motion packets per second, 0 for as fast as possible (default: 50)\n"
+	"  -b <rate>   button presses/releases per second (default: 0.5)\n"
+	"  -e <rate>   error packets per second (default: 0)\n"
+	"  -x <rate>   device resets per second (default: 0)\n"
+	"  -a <val>    motion amplitude (default: half the range)\n"
+	"  -n <val>    amplitude of random noise added to the motion (default: 0)\n"
+	"  -g <prob>   probability of line noise before each motion packet (default: 0)\n"
+	"  -c <count>  stop after sending count motion packets\n"
+	"  -t <sec>    stop after sec seconds\n"
+	"  -l <path>   create a symbolic link to the pseudo-terminal\n"
+	"  -s <seed>   random seed\n"
+	"  -v          print the commands received from the driver\n"
+	"  -h          print this usage information and exit\n";
+
+static int parse_args(int argc, char **argv)
+{
+	int i, j;
+	char *arg, *endp;
+	double val;
+
+	for(i=1; i<argc; i++) {
+		if(argv[i][0] != '-' || !argv[i][1] || argv[i][2]) {
+			goto invalid;
+		}
+
+		switch(argv[i][1]) {
+		case 'v':
+			verbose = 1;
+			continue;
+
+		case 'h':
+			printf(usage_fmt, argv[0]);
+			exit(0);
+
+		case 'm':
+		case 'r':
+		case 'b':
+		case 'e':
+		case 'x':
+		case 'a':
+		case 'n':
+		case 'g':
+		case 'c':
+		case 't':
+		case 'l':
+		case 's':
+			break;
+
+		default:
+			goto invalid;
+		}
+
+		if(!(arg = argv[++i])) {
+			fprintf(stderr, "%s must be followed by a value\n", argv[i - 1]);
+			return -1;
+		}
+
+		if(argv[i - 1][1] == 'm') {
+			for(j=0; models[j].name; j++) {
+				if(strcmp(models[j].name, arg) == 0) {
+					model = models[j].model;
+					buttons = models[j].buttons;
+					max_val = models[j].max_val;
+					break;
+				}
+			}
+			if(!models[j].name) {
+				fprintf(stderr, "unknown model: %s\n", arg);
+				return -1;
+			}
+			continue;
+		}
+		if(argv[i - 1][1] == 'l') {
+			link_path = arg;
+			continue;
+		}
+
+		val = strtod(arg, &endp);
+		if(endp == arg || *endp || val < 0.0) {
+			fprintf(stderr, "invalid value for %s: %s\n", argv[i - 1], arg);
+			return -1;
+		}
+
+		switch(argv[i - 1][1]) {
+		case 'r':
+			motion_rate = val;
+			break;
+		case 'b':
+			button_rate = val;
+			break;
+		case 'e':
+			error_rate = val;
+			break;
+		case 'x':
+			reset_rate = val;
+			break;
+		case 'a':
+			amplitude = (int)val;
+			break;
+		case 'n':
+			noise = (int)val;
+			break;
+		case 'g':
+			garbage_prob = val;
+			break;
+		case 'c':
+			max_count = (unsigned long)val;
+			break;
+		case 't':
+			duration = val;
+			break;
+		case 's':
+			srand((unsigned int)val);
+			break;
+		}
+	}
+	return 0;
+
+invalid:
+	fprintf(stderr, "invalid argument: %s\n", argv[i]);
+	fprintf(stderr, usage_fmt, argv[0]);
+	return -1;
+}
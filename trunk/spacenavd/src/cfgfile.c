@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 enum {TX, TY, TZ, RX, RY, RZ};
 
 static const int def_axmap[] = {0, 2, 1, 3, 5, 4};
+static const int def_axmap_swapyz[] = {0, 1, 2, 3, 4, 5};
 static const int def_axinv[] = {0, 1, 1, 0, 1, 1};
 
 void default_cfg(struct cfg *cfg)
@@ -44,6 +45,20 @@ void default_cfg(struct cfg *cfg)
 
 	cfg->led = 1;
 	cfg->grab_device = 1;
+	cfg->dev_threads = 0;
+	cfg->io_uring = 0;
+	cfg->idle_suspend = 1;
+	cfg->serial_lowlat = 1;
+
+	cfg->net_forward[0] = 0;
+	cfg->net_ttl = 1;
+	cfg->net_interval = 100;
+	cfg->net_receive[0] = 0;
+	cfg->net_allow[0] = 0;
+	cfg->net_timeout = 1000;
+
+	cfg->flight_size = DEF_FLIGHT_SIZE;
+	cfg->flight_file[0] = 0;
 
 	for(i=0; i<6; i++) {
 		cfg->invert[i] = def_axinv[i];
@@ -53,17 +68,37 @@ void default_cfg(struct cfg *cfg)
 	for(i=0; i<MAX_BUTTONS; i++) {
 		cfg->map_button[i] = i;
 		cfg->kbmap_str[i] = 0;
-		cfg->kbmap[i] = 0;
 	}
+	cfg->kbemu = KBEMU_AUTO;
+	cfg->uinput = 0;
 
 	cfg->repeat_msec = -1;
 
+	cfg->low_latency = 0;
+	cfg->rt_policy = RT_POLICY_FIFO;
+	cfg->rt_priority = 10;
+	cfg->cpu_affinity = -1;
+
 	for(i=0; i<MAX_CUSTOM; i++) {
 		cfg->devname[i] = 0;
 		cfg->devid[i][0] = cfg->devid[i][1] = -1;
 	}
 }
 
+void destroy_cfg(struct cfg *cfg)
+{
+	int i;
+
+	for(i=0; i<MAX_BUTTONS; i++) {
+		free(cfg->kbmap_str[i]);
+		cfg->kbmap_str[i] = 0;
+	}
+	for(i=0; i<MAX_CUSTOM; i++) {
+		free(cfg->devname[i]);
+		cfg->devname[i] = 0;
+	}
+}
+
 #define EXPECT(cond) \
 	do { \
 		if(!(cond)) { \
@@ -264,6 +299,92 @@ int read_cfg(const char *fname, struct cfg *cfg)
 			}
 			cfg->kbmap_str[bnidx] = strdup(val_str);
 
+		} else if(strcmp(key_str, "kbemu") == 0) {
+			if(strcmp(val_str, "auto") == 0) {
+				cfg->kbemu = KBEMU_AUTO;
+			} else if(strcmp(val_str, "x11") == 0) {
+				cfg->kbemu = KBEMU_X11;
+			} else if(strcmp(val_str, "uinput") == 0) {
+				cfg->kbemu = KBEMU_UINPUT;
+			} else {
+				fprintf(stderr, "invalid configuration value for %s, expected auto, x11 or uinput\n", key_str);
+				continue;
+			}
+
+		} else if(strcmp(key_str, "idle-suspend") == 0) {
+			if(isint) {
+				cfg->idle_suspend = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->idle_suspend = 1;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->idle_suspend = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a boolean value.\n", key_str);
+					continue;
+				}
+			}
+
+		} else if(strcmp(key_str, "io-uring") == 0) {
+			if(isint) {
+				cfg->io_uring = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->io_uring = 1;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->io_uring = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a boolean value.\n", key_str);
+					continue;
+				}
+			}
+
+		} else if(strcmp(key_str, "device-threads") == 0) {
+			if(isint) {
+				cfg->dev_threads = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->dev_threads = 1;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->dev_threads = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a boolean value.\n", key_str);
+					continue;
+				}
+			}
+
+		} else if(strcmp(key_str, "low-latency") == 0) {
+			if(isint) {
+				cfg->low_latency = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->low_latency = 1;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->low_latency = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a boolean value.\n", key_str);
+					continue;
+				}
+			}
+
+		} else if(strcmp(key_str, "rt-policy") == 0) {
+			if(strcmp(val_str, "fifo") == 0) {
+				cfg->rt_policy = RT_POLICY_FIFO;
+			} else if(strcmp(val_str, "rr") == 0) {
+				cfg->rt_policy = RT_POLICY_RR;
+			} else {
+				fprintf(stderr, "invalid configuration value for %s, expected fifo or rr\n", key_str);
+				continue;
+			}
+
+		} else if(strcmp(key_str, "rt-priority") == 0) {
+			EXPECT(isint);
+			cfg->rt_priority = ival;
+
+		} else if(strcmp(key_str, "cpu-affinity") == 0) {
+			EXPECT(isint);
+			cfg->cpu_affinity = ival;
+
 		} else if(strcmp(key_str, "led") == 0) {
 			if(isint) {
 				cfg->led = ival;
@@ -292,9 +413,76 @@ int read_cfg(const char *fname, struct cfg *cfg)
 				}
 			}
 
+		} else if(strcmp(key_str, "uinput") == 0) {
+			if(isint) {
+				cfg->uinput = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->uinput = 1;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->uinput = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a boolean value.\n", key_str);
+					continue;
+				}
+			}
+
 		} else if(strcmp(key_str, "serial") == 0) {
 			strncpy(cfg->serial_dev, val_str, PATH_MAX);
 
+		} else if(strcmp(key_str, "serial-low-latency") == 0) {
+			if(isint) {
+				cfg->serial_lowlat = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->serial_lowlat = 1;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->serial_lowlat = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a boolean value.\n", key_str);
+					continue;
+				}
+			}
+
+		} else if(strcmp(key_str, "forward") == 0) {
+			strncpy(cfg->net_forward, val_str, sizeof cfg->net_forward - 1);
+
+		} else if(strcmp(key_str, "forward-ttl") == 0) {
+			EXPECT(isint && ival >= 0 && ival <= 255);
+			cfg->net_ttl = ival;
+
+		} else if(strcmp(key_str, "forward-interval") == 0) {
+			EXPECT(isint && ival > 0);
+			cfg->net_interval = ival;
+
+		} else if(strcmp(key_str, "receive") == 0) {
+			strncpy(cfg->net_receive, val_str, sizeof cfg->net_receive - 1);
+
+		} else if(strcmp(key_str, "receive-from") == 0) {
+			strncpy(cfg->net_allow, val_str, sizeof cfg->net_allow - 1);
+
+		} else if(strcmp(key_str, "receive-timeout") == 0) {
+			EXPECT(isint && ival > 0);
+			cfg->net_timeout = ival;
+
+		} else if(strcmp(key_str, "flight-recorder") == 0) {
+			if(isint) {
+				EXPECT(ival >= 0 && ival <= MAX_FLIGHT_SIZE);
+				cfg->flight_size = ival;
+			} else {
+				if(strcmp(val_str, "true") == 0 || strcmp(val_str, "on") == 0 || strcmp(val_str, "yes") == 0) {
+					cfg->flight_size = DEF_FLIGHT_SIZE;
+				} else if(strcmp(val_str, "false") == 0 || strcmp(val_str, "off") == 0 || strcmp(val_str, "no") == 0) {
+					cfg->flight_size = 0;
+				} else {
+					fprintf(stderr, "invalid configuration value for %s, expected a number or boolean value.\n", key_str);
+					continue;
+				}
+			}
+
+		} else if(strcmp(key_str, "flight-recorder-file") == 0) {
+			strncpy(cfg->flight_file, val_str, sizeof cfg->flight_file - 1);
+
 		} else if(strcmp(key_str, "device-id") == 0) {
 			unsigned int vendor, prod;
 			if(sscanf(val_str, "%x:%x", &vendor, &prod) == 2) {
@@ -396,8 +584,18 @@ int write_cfg(const char *fname, struct cfg *cfg)
 		fputs("\n\n", fp);
 	}
 
-	fprintf(fp, "# swap translation along Y and Z axes\n");
-	fprintf(fp, "swap-yz = %s\n\n", cfg->map_axis[1] == def_axmap[1] ? "false" : "true");
+	if(memcmp(cfg->map_axis, def_axmap, sizeof def_axmap) != 0 &&
+			memcmp(cfg->map_axis, def_axmap_swapyz, sizeof def_axmap_swapyz) != 0) {
+		/* not expressible with swap-yz, write out the full axis mapping */
+		fprintf(fp, "# axis mappings\n");
+		for(i=0; i<6; i++) {
+			fprintf(fp, "axismap%d = %d\n", i, cfg->map_axis[i]);
+		}
+		fputc('\n', fp);
+	} else {
+		fprintf(fp, "# swap translation along Y and Z axes\n");
+		fprintf(fp, "swap-yz = %s\n\n", cfg->map_axis[1] == def_axmap[1] ? "false" : "true");
+	}
 
 	wrote_comment = 0;
 	for(i=0; i<MAX_BUTTONS; i++) {
@@ -427,6 +625,42 @@ int write_cfg(const char *fname, struct cfg *cfg)
 		fputc('\n', fp);
 	}
 
+	if(cfg->uinput) {
+		fprintf(fp, "# publish the processed events through a uinput virtual device\n");
+		fprintf(fp, "uinput = true\n\n");
+	}
+
+	if(cfg->kbemu != KBEMU_AUTO) {
+		fprintf(fp, "# keyboard emulation method (auto, x11 or uinput)\n");
+		fprintf(fp, "kbemu = %s\n\n", cfg->kbemu == KBEMU_X11 ? "x11" : "uinput");
+	}
+
+	if(cfg->dev_threads) {
+		fprintf(fp, "# read each device in its own thread\n");
+		fprintf(fp, "device-threads = true\n\n");
+	}
+
+	if(!cfg->idle_suspend) {
+		fprintf(fp, "# keep reading the devices when there are no clients\n");
+		fprintf(fp, "idle-suspend = false\n\n");
+	}
+
+	if(cfg->io_uring) {
+		fprintf(fp, "# use io_uring for device reads and client writes\n");
+		fprintf(fp, "io-uring = true\n\n");
+	}
+
+	if(cfg->low_latency) {
+		fprintf(fp, "# realtime scheduling, locked memory, and preallocated storage\n");
+		fprintf(fp, "low-latency = true\n");
+		fprintf(fp, "rt-policy = %s\n", cfg->rt_policy == RT_POLICY_RR ? "rr" : "fifo");
+		fprintf(fp, "rt-priority = %d\n", cfg->rt_priority);
+		if(cfg->cpu_affinity >= 0) {
+			fprintf(fp, "cpu-affinity = %d\n", cfg->cpu_affinity);
+		}
+		fputc('\n', fp);
+	}
+
 	if(!cfg->led) {
 		fprintf(fp, "# disable led\n");
 		fprintf(fp, "led = 0\n\n");
@@ -451,6 +685,41 @@ int write_cfg(const char *fname, struct cfg *cfg)
 	} else {
 		fprintf(fp, "#serial = /dev/ttyS0\n");
 	}
+	if(!cfg->serial_lowlat) {
+		fprintf(fp, "serial-low-latency = false\n\n");
+	}
+
+	if(cfg->net_forward[0]) {
+		fprintf(fp, "# forward the processed events over UDP\n");
+		fprintf(fp, "forward = %s\n", cfg->net_forward);
+		if(cfg->net_ttl != 1) {
+			fprintf(fp, "forward-ttl = %d\n", cfg->net_ttl);
+		}
+		if(cfg->net_interval != 100) {
+			fprintf(fp, "forward-interval = %d\n", cfg->net_interval);
+		}
+		fputc('\n', fp);
+	}
+	if(cfg->net_receive[0]) {
+		fprintf(fp, "# receive events forwarded by another spacenavd\n");
+		fprintf(fp, "receive = %s\n", cfg->net_receive);
+		if(cfg->net_allow[0]) {
+			fprintf(fp, "receive-from = %s\n", cfg->net_allow);
+		}
+		if(cfg->net_timeout != 1000) {
+			fprintf(fp, "receive-timeout = %d\n", cfg->net_timeout);
+		}
+		fputc('\n', fp);
+	}
+
+	if(cfg->flight_size != DEF_FLIGHT_SIZE || cfg->flight_file[0]) {
+		fprintf(fp, "# flight recorder of the last input pipeline events\n");
+		fprintf(fp, "flight-recorder = %d\n", cfg->flight_size);
+		if(cfg->flight_file[0]) {
+			fprintf(fp, "flight-recorder-file = %s\n", cfg->flight_file);
+		}
+		fputc('\n', fp);
+	}
 
 	fprintf(fp, "# custom list USB device ids to open if present\n");
 	fprintf(fp, "# (multiple entries can be listed)\n");
@@ -25,23 +25,63 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MAX_BUTTONS		64
 #define MAX_CUSTOM		64
 
+/* flight recorder size in records (32 bytes each) */
+#define DEF_FLIGHT_SIZE	8192
+#define MAX_FLIGHT_SIZE	(1 << 22)
+
+/* keyboard emulation method */
+enum {
+	KBEMU_AUTO,		/* X11 if connected, otherwise uinput */
+	KBEMU_X11,
+	KBEMU_UINPUT
+};
+
+/* realtime scheduling policy of the low-latency mode */
+enum {
+	RT_POLICY_FIFO,
+	RT_POLICY_RR
+};
+
 struct cfg {
 	float sensitivity, sens_trans[3], sens_rot[3];
 	int dead_threshold[MAX_AXES];
 	int invert[MAX_AXES];
 	int map_axis[MAX_AXES];
 	int map_button[MAX_BUTTONS];
-	int kbmap[MAX_BUTTONS];
 	char *kbmap_str[MAX_BUTTONS];
+	int kbemu;
+	int uinput;		/* publish events through a uinput virtual device */
 	int led, grab_device;
+	int dev_threads;	/* read each device in its own thread */
+	int io_uring;		/* use io_uring for device reads and client writes */
+	int idle_suspend;	/* stop reading the devices while there are no clients */
 	char serial_dev[PATH_MAX];
+	int serial_lowlat;	/* ask the serial driver for low-latency input (linux) */
+
+	/* event forwarding over UDP (see dev_net.h) */
+	char net_forward[256];	/* host:port to send to, empty to disable */
+	int net_ttl;			/* multicast TTL */
+	int net_interval;		/* msec between frames repeating the state */
+	char net_receive[256];	/* [address:]port to receive on, empty to disable */
+	char net_allow[256];	/* hosts allowed to send, empty for any */
+	int net_timeout;		/* msec without frames before releasing the state */
+
+	/* flight recorder (see flightrec.h) */
+	int flight_size;			/* records to keep, 0 to disable */
+	char flight_file[PATH_MAX];	/* file to map the records to, empty for memory only */
 	int repeat_msec;
 
+	int low_latency;	/* see lowlat.h */
+	int rt_policy, rt_priority;
+	int cpu_affinity;	/* cpu to run on in low-latency mode, -1 for any */
+
 	char *devname[MAX_CUSTOM];	/* custom USB device name list */
 	int devid[MAX_CUSTOM][2];	/* custom USB vendor/product id list */
 };
 
 void default_cfg(struct cfg *cfg);
+/* frees any strings allocated by read_cfg */
+void destroy_cfg(struct cfg *cfg);
 int read_cfg(const char *fname, struct cfg *cfg);
 int write_cfg(const char *fname, struct cfg *cfg);
 
@@ -19,7 +19,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "client.h"
+#include "dev.h"
+#include "event.h"
+#include "xform.h"
+#include "proto.h"
+#include "spnavd.h"
 
 #ifdef USE_X11
 #include <X11/Xlib.h>
@@ -34,56 +40,203 @@ struct client {
 	Window win;	/* X11 client window */
 #endif
 
-	float sens;	/* sensitivity */
-	int dev_idx; /* device index */
+	struct xform *xform;	/* motion transform, null for identity */
+	struct xform *xf_stage;	/* transform being uploaded */
+
+	struct reqresp req;		/* partially received request */
+	int req_bytes;
+
+	unsigned int evmask;	/* event types to receive */
+	int all_devices;		/* receive events from any device */
+	int *devids;			/* otherwise only from these devices */
+	int num_devids, max_devids;
+
+	unsigned int serial;	/* serial number of the last event sent */
+
+	/* motion rate limiting */
+	unsigned int rate_usec;			/* minimum interval between motion events */
+	int rate_mode;
+	unsigned long long deadline;	/* earliest time the next motion can be sent */
+	int pend_count;					/* number of coalesced motion events */
+	long pend_sum[6];
+	unsigned int pend_period;
 
 	struct client *next;
+#ifdef USE_X11
+	struct client *win_next;	/* next in the window hash bucket */
+#endif
 };
 
+#ifdef USE_X11
+/* X11 clients indexed by window id. XIDs differ mostly in the low bits, with
+ * the connection's resource base in the high bits.
+ */
+#define WIN_HASH_SIZE	64
+#define WIN_HASH(w)		((unsigned int)((w) ^ ((w) >> 16)) & (WIN_HASH_SIZE - 1))
+
+static struct client *win_hash[WIN_HASH_SIZE];
+
+static void unlink_client_window(struct client *client);
+#endif
 
 static struct client *client_list = NULL;
 static struct client *client_iter;	/* iterator (used by first/next calls) */
 
+/* bumped whenever a change invalidates the per-device subscriber lists */
+static unsigned int subs_gen = 1;
+static int num_rate_limited;
+
+static int num_clients;
+
+/* preallocated client nodes (see prealloc_clients) */
+static struct client *client_pool;
+static int client_pool_size;
+static int prealloc_count;
+
+static struct client *alloc_client(void);
+static void free_client(struct client *client);
+static int reserve_subs(struct device *dev);
+
+int prealloc_clients(int count)
+{
+	struct client *c;
+
+	if(count > prealloc_count) {
+		prealloc_count = count;
+	}
+
+	while(client_pool_size + num_clients < count) {
+		if(!(c = malloc(sizeof *c))) {
+			perror("failed to preallocate clients");
+			return -1;
+		}
+		c->next = client_pool;
+		client_pool = c;
+		client_pool_size++;
+	}
+
+	reserve_device_clients(core);
+	return 0;
+}
+
+/* the subscriber lists of the devices are sized for all the clients there
+ * are, or clients were preallocated for, so that they never have to grow
+ * while dispatching.
+ */
+void reserve_device_clients(struct spnav_core *core)
+{
+	struct device *dev;
+
+	if(!core) return;
+
+	dev = get_devices(core);
+	while(dev) {
+		reserve_subs(dev);
+		dev = dev->next;
+	}
+}
+
+static int reserve_subs(struct device *dev)
+{
+	int count = num_clients > prealloc_count ? num_clients : prealloc_count;
+	struct client **tmp;
+
+	if(dev->max_subs >= count) {
+		return 0;
+	}
+	if(count < 8) count = 8;
+
+	if(!(tmp = realloc(dev->subs, count * sizeof *tmp))) {
+		perror("failed to resize device subscriber list");
+		return -1;
+	}
+	dev->subs = tmp;
+	dev->max_subs = count;
+	return 0;
+}
+
+static struct client *alloc_client(void)
+{
+	struct client *c;
+
+	/* out of preallocated clients, preallocate as many again */
+	if(!client_pool && prealloc_count) {
+		prealloc_clients(prealloc_count * 2);
+	}
+
+	if((c = client_pool)) {
+		client_pool = c->next;
+		client_pool_size--;
+		return c;
+	}
+	return malloc(sizeof *c);
+}
+
+static void free_client(struct client *client)
+{
+	xform_release(client->xform);
+	free(client->xf_stage);
+	free(client->devids);
+
+	client->next = client_pool;
+	client_pool = client;
+	client_pool_size++;
+}
+
 /* add a client to the list
- * cdata points to the socket fd for new-protocol clients, or the
- * window XID for clients talking to us through the magellan protocol
+ * cdata points to the socket fd for new-protocol clients, the uinput file
+ * descriptor for the uinput client, or the window XID for clients talking
+ * to us through the magellan protocol
  */
 struct client *add_client(int type, void *cdata)
 {
 	struct client *client;
 
 #ifdef USE_X11
-	if(!cdata || (type != CLIENT_UNIX && type != CLIENT_X11))
+	if(!cdata || (type != CLIENT_UNIX && type != CLIENT_UINPUT && type != CLIENT_NET && type != CLIENT_X11))
 #else
-	if(!cdata || type != CLIENT_UNIX)
+	if(!cdata || (type != CLIENT_UNIX && type != CLIENT_UINPUT && type != CLIENT_NET))
 #endif
 	{
 		return 0;
 	}
 
-	if(!(client = malloc(sizeof *client))) {
+	if(!(client = alloc_client())) {
 		return 0;
 	}
 
 	client->type = type;
-	if(type == CLIENT_UNIX) {
+	if(type == CLIENT_UNIX || type == CLIENT_UINPUT || type == CLIENT_NET) {
 		client->sock = *(int*)cdata;
 #ifdef USE_X11
 	} else {
+		unsigned int idx;
+
 		client->win = *(Window*)cdata;
+		idx = WIN_HASH(client->win);
+		client->win_next = win_hash[idx];
+		win_hash[idx] = client;
 #endif
 	}
 
-	client->sens = 1.0f;
-	client->dev_idx = 0; /* default/first device */
+	client->xform = client->xf_stage = 0;
+	client->req_bytes = 0;
+	client->evmask = EVMASK_ALL;
+	client->all_devices = 1;
+	client->devids = 0;
+	client->num_devids = client->max_devids = 0;
+	client->serial = 0;
+	client->rate_usec = 0;
+	client->rate_mode = RATE_LATEST;
+	client->deadline = 0;
+	client->pend_count = 0;
+
+	subs_gen++;
+	num_clients++;
+	reserve_device_clients(core);
 
-	if(client_list == NULL) {
-		client->next = NULL;
-		return (client_list = client);
-	}
 	client->next = client_list;
 	client_list = client;
-
 	return client;
 }
 
@@ -93,9 +246,21 @@ void remove_client(struct client *client)
 
 	if(iter == NULL)
 		return;
+
+	subs_gen++;
+	num_clients--;
+	if(client->rate_usec) {
+		num_rate_limited--;
+	}
+#ifdef USE_X11
+	if(client->type == CLIENT_X11) {
+		unlink_client_window(client);
+	}
+#endif
+
 	if(iter == client) {
 		client_list = iter->next;
-		free(iter);
+		free_client(iter);
 		if((iter = client_list) == NULL)
 			return;
 	}
@@ -104,7 +269,7 @@ void remove_client(struct client *client)
 		if(iter->next == client) {
 			struct client *tmp = iter->next;
 			iter->next = tmp->next;
-			free(tmp);
+			free_client(tmp);
 		} else {
 			iter = iter->next;
 		}
@@ -126,26 +291,280 @@ Window get_client_window(struct client *client)
 {
 	return client->win;
 }
+
+struct client *find_client_window(Window win)
+{
+	struct client *c = win_hash[WIN_HASH(win)];
+
+	while(c && c->win != win) {
+		c = c->win_next;
+	}
+	return c;
+}
+
+static void unlink_client_window(struct client *client)
+{
+	struct client **prev = win_hash + WIN_HASH(client->win);
+
+	while(*prev) {
+		if(*prev == client) {
+			*prev = client->win_next;
+			break;
+		}
+		prev = &(*prev)->win_next;
+	}
+}
 #endif
 
 void set_client_sensitivity(struct client *client, float sens)
 {
-	client->sens = sens;
+	struct xform xf;
+	xform_scale(&xf, sens);
+	set_client_xform(client, &xf);
+}
+
+struct xform *get_client_xform(struct client *client)
+{
+	return client->xform;
+}
+
+int set_client_xform(struct client *client, const struct xform *xf)
+{
+	struct xform *shared = 0;
+
+	if(xf && !xform_is_identity(xf) && !(shared = xform_intern(xf))) {
+		return -1;
+	}
+	xform_release(client->xform);
+	client->xform = shared;
+	return 0;
+}
+
+struct xform *get_client_xform_stage(struct client *client)
+{
+	if(!client->xf_stage) {
+		if(!(client->xf_stage = malloc(sizeof *client->xf_stage))) {
+			return 0;
+		}
+		xform_identity(client->xf_stage);
+	}
+	return client->xf_stage;
+}
+
+struct reqresp *get_client_request(struct client *client, int **count)
+{
+	*count = &client->req_bytes;
+	return &client->req;
+}
+
+void set_client_evmask(struct client *client, unsigned int mask)
+{
+	client->evmask = mask & EVMASK_ALL;
+}
+
+unsigned int get_client_evmask(struct client *client)
+{
+	return client->evmask;
+}
+
+int client_subscribe_device(struct client *client, int devid)
+{
+	if(devid == -1) {
+		client->all_devices = 1;
+		client->num_devids = 0;
+		subs_gen++;
+		return 0;
+	}
+
+	if(client->all_devices) {
+		client->all_devices = 0;
+		client->num_devids = 0;
+	} else if(client_wants_device(client, devid)) {
+		return 0;
+	}
+
+	if(client->num_devids >= client->max_devids) {
+		int newsz = client->max_devids ? client->max_devids * 2 : 4;
+		int *tmp = realloc(client->devids, newsz * sizeof *tmp);
+		if(!tmp) {
+			return -1;
+		}
+		client->devids = tmp;
+		client->max_devids = newsz;
+	}
+	client->devids[client->num_devids++] = devid;
+	subs_gen++;
+	return 0;
+}
+
+int client_unsubscribe_device(struct client *client, int devid)
+{
+	int i;
+
+	if(devid == -1) {
+		client->all_devices = 0;
+		client->num_devids = 0;
+		subs_gen++;
+		return 0;
+	}
+
+	if(client->all_devices) {
+		return -1;	/* can't unsubscribe from a device not explicitly subscribed */
+	}
+
+	for(i=0; i<client->num_devids; i++) {
+		if(client->devids[i] == devid) {
+			client->devids[i] = client->devids[--client->num_devids];
+			subs_gen++;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+int client_wants_device(struct client *client, int devid)
+{
+	int i;
+
+	if(client->all_devices) {
+		return 1;
+	}
+	for(i=0; i<client->num_devids; i++) {
+		if(client->devids[i] == devid) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+struct client **get_device_clients(struct device *dev, int *count)
+{
+	struct client *c;
+
+	if(dev->subs_gen != subs_gen) {
+		dev->num_subs = 0;
+
+		c = client_list;
+		while(c) {
+			/* never forward what was received from the network back to it */
+			if(client_wants_device(c, dev->id) && !(dev->remote && c->type == CLIENT_NET)) {
+				if(dev->num_subs >= dev->max_subs) {
+					/* the list is reserved when the device is attached and
+					 * when clients are added, only failing that can it be
+					 * short. Never allocate while dispatching, the clients
+					 * which don't fit miss the event.
+					 */
+					break;
+				}
+				dev->subs[dev->num_subs++] = c;
+			}
+			c = c->next;
+		}
+		dev->subs_gen = subs_gen;
+	}
+
+	*count = dev->num_subs;
+	return dev->subs;
+}
+
+unsigned int get_clients_generation(void)
+{
+	return subs_gen;
+}
+
+void set_client_rate(struct client *client, int max_rate, int mode)
+{
+	if(client->rate_usec) num_rate_limited--;
+
+	client->rate_usec = max_rate > 0 ? 1000000 / max_rate : 0;
+	client->rate_mode = mode == RATE_AVERAGE ? RATE_AVERAGE : RATE_LATEST;
+	client->pend_count = 0;
+	client->deadline = 0;
+
+	if(client->rate_usec) num_rate_limited++;
+}
+
+int get_client_rate(struct client *client, int *mode)
+{
+	if(mode) {
+		*mode = client->rate_mode;
+	}
+	return client->rate_usec ? 1000000 / client->rate_usec : 0;
+}
+
+int any_client_rate_limited(void)
+{
+	return num_rate_limited > 0;
+}
+
+int client_throttle_motion(struct client *client, spnav_event *ev, unsigned long long now)
+{
+	int i;
+
+	if(!client->rate_usec) {
+		return 1;
+	}
+
+	if(!client->pend_count && now >= client->deadline) {
+		client->deadline = now + client->rate_usec;
+		return 1;
+	}
+
+	if(client->rate_mode == RATE_AVERAGE) {
+		for(i=0; i<6; i++) {
+			client->pend_sum[i] = (client->pend_count ? client->pend_sum[i] : 0) + ev->motion.data[i];
+		}
+	} else {
+		for(i=0; i<6; i++) {
+			client->pend_sum[i] = ev->motion.data[i];
+		}
+	}
+	client->pend_period = (client->pend_count ? client->pend_period : 0) + ev->motion.period;
+	client->pend_count++;
+	return 0;
+}
+
+int client_pending_motion(struct client *client, spnav_event *ev, unsigned long long now, int force)
+{
+	int i;
+
+	if(!client->pend_count || (!force && now < client->deadline)) {
+		return 0;
+	}
+
+	ev->type = EVENT_MOTION;
+	ev->motion.data = &ev->motion.x;
+	for(i=0; i<6; i++) {
+		if(client->rate_mode == RATE_AVERAGE) {
+			ev->motion.data[i] = client->pend_sum[i] / client->pend_count;
+		} else {
+			ev->motion.data[i] = client->pend_sum[i];
+		}
+	}
+	ev->motion.period = client->pend_period;
+	client->pend_count = 0;
+
+	/* keep a steady rate, unless we fell behind */
+	client->deadline += client->rate_usec;
+	if(client->deadline < now) {
+		client->deadline = now + client->rate_usec;
+	}
+	return 1;
 }
 
-float get_client_sensitivity(struct client *client)
+unsigned long long client_motion_deadline(struct client *client)
 {
-	return client->sens;
+	return client->pend_count ? client->deadline : 0;
 }
 
-void set_client_device_index(struct client *client, int dev_idx)
+void set_client_serial(struct client *client, unsigned int serial)
 {
-	client->dev_idx = dev_idx;
+	client->serial = serial;
 }
 
-int get_client_device_index(struct client *client)
+unsigned int get_client_serial(struct client *client)
 {
-	return client->dev_idx;
+	return client->serial;
 }
 
 struct client *first_client(void)
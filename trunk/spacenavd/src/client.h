@@ -28,26 +28,98 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 /* client types */
 enum {
 	CLIENT_X11,		/* through the magellan X11 protocol */
-	CLIENT_UNIX		/* through the new UNIX domain socket */
+	CLIENT_UNIX,	/* through the new UNIX domain socket */
+	CLIENT_UINPUT,	/* uinput virtual device (see proto_uinput.h) */
+	CLIENT_NET		/* event forwarding over UDP (see proto_net.h) */
 };
 
 
 struct client;
+struct device;
+struct spnav_core;
+union spnav_event;
 
 struct client *add_client(int type, void *cdata);
+/* preallocates storage for count clients. Removed clients are always kept
+ * for reuse by add_client.
+ */
+int prealloc_clients(int count);
+/* sizes the subscriber lists of the devices of core for all clients (see
+ * get_device_clients), to be called when devices are added.
+ */
+void reserve_device_clients(struct spnav_core *core);
 void remove_client(struct client *client);
 
 int get_client_type(struct client *client);
 int get_client_socket(struct client *client);
 #ifdef USE_X11
 Window get_client_window(struct client *client);
+/* returns the X11 client with the given window, or null */
+struct client *find_client_window(Window win);
 #endif
 
+/* sets a uniform scaling transform, replacing any transform set before */
 void set_client_sensitivity(struct client *client, float sens);
-float get_client_sensitivity(struct client *client);
 
-void set_client_device_index(struct client *client, int dev_idx);
-int get_client_device_index(struct client *client);
+/* per-client motion transform (see xform.h), null means identity */
+struct xform *get_client_xform(struct client *client);
+/* interns and sets the transform, xf can be null for identity */
+int set_client_xform(struct client *client, const struct xform *xf);
+/* transform being assembled by the client through the UNIX socket, before
+ * committing it with set_client_xform. Allocated on first use.
+ */
+struct xform *get_client_xform_stage(struct client *client);
+
+/* buffer of a request being received from the client through the UNIX
+ * socket, and the number of bytes already in it, so that a request which
+ * arrives in pieces is put together without waiting for the rest.
+ */
+struct reqresp *get_client_request(struct client *client, int **count);
+
+/* event type mask (EVMASK_* in proto.h), defaults to all events */
+void set_client_evmask(struct client *client, unsigned int mask);
+unsigned int get_client_evmask(struct client *client);
+
+/* device subscriptions: by default clients receive events from all devices.
+ * subscribing to a specific device id switches to receiving events only from
+ * the explicitly subscribed devices. devid -1 means all devices.
+ */
+int client_subscribe_device(struct client *client, int devid);
+int client_unsubscribe_device(struct client *client, int devid);
+int client_wants_device(struct client *client, int devid);
+
+/* returns the array of clients subscribed to dev, rebuilding it if any
+ * client or subscription changed since it was last built.
+ */
+struct client **get_device_clients(struct device *dev, int *count);
+/* changes whenever the client list or any subscription changes */
+unsigned int get_clients_generation(void);
+
+/* motion rate limiting: at most max_rate motion events per second are sent to
+ * the client (0: unlimited). Motion in between is coalesced according to mode
+ * (RATE_* in proto.h), either keeping the latest sample or averaging them.
+ */
+void set_client_rate(struct client *client, int max_rate, int mode);
+int get_client_rate(struct client *client, int *mode);
+/* non-zero if any client has a rate limit */
+int any_client_rate_limited(void);
+
+/* returns 1 if the motion event should be sent to the client right away,
+ * otherwise it's coalesced with any pending motion and 0 is returned.
+ */
+int client_throttle_motion(struct client *client, union spnav_event *ev, unsigned long long now);
+/* if the client has coalesced motion pending, fills ev and returns 1. If force
+ * is zero, only does so if the client's deadline is reached.
+ */
+int client_pending_motion(struct client *client, union spnav_event *ev, unsigned long long now, int force);
+/* deadline of the client's pending motion, or 0 if there is none */
+unsigned long long client_motion_deadline(struct client *client);
+
+/* last event serial delivered to the client, used by dispatch_event to resume
+ * delivery when the subscriber list changes while an event is dispatched.
+ */
+void set_client_serial(struct client *client, unsigned int serial);
+unsigned int get_client_serial(struct client *client);
 
 /* these two can be used to iterate over all clients */
 struct client *first_client(void);
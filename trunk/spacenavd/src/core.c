@@ -0,0 +1,615 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "core.h"
+#include "core_impl.h"
+#include "dev_thread.h"
+#include "flightrec.h"
+#include "probes.h"
+
+static struct dev_event *add_dev_event(struct device *dev);
+static struct dev_event *device_event_in_use(struct device *dev);
+static void emit_event(struct dev_event *dev_ev);
+static void queue_event(struct spnav_core *core, struct device *dev, spnav_event *ev);
+static unsigned int msec_dif(struct timeval tv1, struct timeval tv2);
+
+
+struct spnav_core *spnav_core_create(struct cfg *cfg)
+{
+	struct spnav_core *core;
+
+	if(!(core = malloc(sizeof *core))) {
+		perror("failed to allocate spacenav core context");
+		return 0;
+	}
+	memset(core, 0, sizeof *core);
+	core->wake_fd[0] = core->wake_fd[1] = -1;
+
+	if(cfg) {
+		core->cfg = cfg;
+	} else {
+		default_cfg(&core->own_cfg);
+		core->cfg = &core->own_cfg;
+	}
+	return core;
+}
+
+void spnav_core_destroy(struct spnav_core *core)
+{
+	if(!core) return;
+
+	while(core->dev_list) {
+		remove_device(core->dev_list);
+	}
+	destroy_dev_threads(core);
+	while(core->dev_ev_free) {
+		struct dev_event *dev_ev = core->dev_ev_free;
+		core->dev_ev_free = dev_ev->next;
+		free(dev_ev);
+	}
+	if(core->cfg == &core->own_cfg) {
+		destroy_cfg(&core->own_cfg);
+	}
+	free(core);
+}
+
+struct cfg *spnav_core_cfg(struct spnav_core *core)
+{
+	return core->cfg;
+}
+
+void spnav_core_set_verbose(struct spnav_core *core, int verbose)
+{
+	core->verbose = verbose;
+}
+
+int spnav_core_verbose(struct spnav_core *core)
+{
+	return core->verbose;
+}
+
+int spnav_core_prealloc(struct spnav_core *core, int count)
+{
+	int i;
+	struct dev_event *dev_ev;
+
+	for(i=0; i<count; i++) {
+		if(!(dev_ev = malloc(sizeof *dev_ev))) {
+			perror("failed to preallocate device events");
+			return -1;
+		}
+		dev_ev->next = core->dev_ev_free;
+		core->dev_ev_free = dev_ev;
+	}
+	return 0;
+}
+
+void spnav_core_set_event_func(struct spnav_core *core, spnav_core_event_func func, void *cls)
+{
+	core->event_func = func;
+	core->event_cls = cls;
+}
+
+void spnav_core_set_input_func(struct spnav_core *core, spnav_core_input_func func, void *cls)
+{
+	core->input_func = func;
+	core->input_cls = cls;
+}
+
+void spnav_core_set_device_func(struct spnav_core *core, spnav_core_device_func func, void *cls)
+{
+	core->device_func = func;
+	core->device_cls = cls;
+}
+
+void device_attached(struct device *dev)
+{
+	struct spnav_core *core = dev->core;
+
+	if(core->device_func) {
+		core->device_func(dev, core->device_cls);
+	}
+}
+
+void spnav_core_set_threaded(struct spnav_core *core, int enable)
+{
+	struct device *dev = core->dev_list;
+
+	core->threaded = enable;
+
+	while(dev) {
+		if(enable && !core->suspended) {
+			start_dev_thread(dev);
+		} else {
+			stop_dev_thread(dev);
+		}
+		dev = dev->next;
+	}
+}
+
+void spnav_core_suspend(struct spnav_core *core, int suspend)
+{
+	struct dev_input inp;
+	struct device *dev = core->dev_list;
+
+	if(suspend == core->suspended) {
+		return;
+	}
+	core->suspended = suspend;
+
+	while(dev) {
+		struct device *next = dev->next;
+
+		if(dev->probing) {
+			/* detection goes on while suspended */
+		} else if(suspend) {
+			stop_dev_thread(dev);
+		} else {
+			if(dev->resync) {
+				dev->resync(dev);
+			} else {
+				/* no way to query the state, just drop the stale input */
+				while(read_device(dev, &inp) != -1);
+			}
+			if(dev->failed) {
+				remove_device(dev);
+			} else if(core->threaded) {
+				start_dev_thread(dev);
+			}
+		}
+		dev = next;
+	}
+}
+
+int spnav_core_suspended(struct spnav_core *core)
+{
+	return core->suspended;
+}
+
+int spnav_core_fdset(struct spnav_core *core, fd_set *set, int max_fd)
+{
+	int fd;
+	struct device *dev = core->dev_list;
+
+	if(!core->suspended && (fd = get_dev_threads_fd(core)) != -1) {
+		FD_SET(fd, set);
+		if(fd > max_fd) max_fd = fd;
+	}
+
+	while(dev) {
+		if(core->suspended && !dev->probing) {
+			dev = dev->next;
+			continue;
+		}
+		if(!dev->thread && !dev->ext_read && (fd = get_device_fd(dev)) != -1) {
+			FD_SET(fd, set);
+			if(fd > max_fd) max_fd = fd;
+		}
+		dev = dev->next;
+	}
+	return max_fd;
+}
+
+void spnav_core_handle(struct spnav_core *core, fd_set *set)
+{
+	int fd, failed, woken = 0;
+	struct dev_input inp;
+	struct device *dev = core->dev_list;
+
+	if(!core->suspended && (fd = get_dev_threads_fd(core)) != -1 && FD_ISSET(fd, set)) {
+		clear_dev_threads_wake(core);
+		woken = 1;
+	}
+
+	while(dev) {
+		/* keep the next pointer because the device is removed if it fails */
+		struct device *next = dev->next;
+
+		if(core->suspended && !dev->probing) {
+			/* left alone until resumed */
+		} else if(dev->thread) {
+			if(woken) {
+				/* check for failure first, everything read before it is
+				 * already in the ring.
+				 */
+				failed = dev_thread_failed(dev);
+				while(get_dev_thread_input(dev, &inp) != -1) {
+					process_input(dev, &inp);
+				}
+				if(failed) {
+					remove_device(dev);
+				}
+			}
+
+		} else if(!dev->ext_read && (fd = get_device_fd(dev)) != -1 && FD_ISSET(fd, set)) {
+			/* read an event from the device ... */
+			while(read_device(dev, &inp) != -1) {
+				/* ... and process it, possibly generating a spacenav event */
+				process_input(dev, &inp);
+			}
+			if(dev->failed) {
+				remove_device(dev);
+			}
+		}
+		dev = next;
+	}
+}
+
+void spnav_core_feed(struct device *dev, const void *data, int size)
+{
+	if(dev->feed && !dev->core->suspended) {
+		dev->feed(dev, data, size);
+	}
+}
+
+int spnav_core_timeout(struct spnav_core *core)
+{
+	long dt, min_dt = -1;
+	unsigned long long now = 0;
+	struct device *dev = core->dev_list;
+
+	while(dev) {
+		if(dev->timer) {
+			if(!now) now = dev_time_msec();
+			dt = dev->timer > now ? (long)(dev->timer - now) : 0;
+			if(min_dt < 0 || dt < min_dt) {
+				min_dt = dt;
+			}
+		}
+		dev = dev->next;
+	}
+	return min_dt;
+}
+
+void spnav_core_timers(struct spnav_core *core)
+{
+	unsigned long long now = dev_time_msec();
+	struct device *dev = core->dev_list;
+
+	while(dev) {
+		struct device *next = dev->next;
+
+		if(dev->timer && dev->timer <= now && dev->tick) {
+			dev->timer = 0;
+			frec_record(FREC_TIMER, dev->id, 0, 0, 0);
+			dev->tick(dev);
+			if(dev->failed) {
+				remove_device(dev);
+			}
+		}
+		dev = next;
+	}
+}
+
+int spnav_core_active(struct spnav_core *core)
+{
+	struct dev_event *dev_ev = core->dev_ev_list;
+
+	if(core->suspended) {
+		return 0;
+	}
+
+	while(dev_ev) {
+		if(is_device_valid(dev_ev->dev) && !in_deadzone(dev_ev->dev)) {
+			return 1;
+		}
+		dev_ev = dev_ev->next;
+	}
+	return 0;
+}
+
+void spnav_core_repeat(struct spnav_core *core)
+{
+	struct device *dev = core->dev_list;
+
+	while(dev) {
+		if(!in_deadzone(dev)) {
+			repeat_last_event(dev);
+		}
+		dev = dev->next;
+	}
+}
+
+long spnav_core_repeat_timeout(struct spnav_core *core)
+{
+	long dt, min_dt = -1;
+	struct timeval now;
+	struct dev_event *dev_ev = core->dev_ev_list;
+
+	if(core->cfg->repeat_msec < 0 || core->suspended) {
+		return -1;
+	}
+	gettimeofday(&now, 0);
+
+	while(dev_ev) {
+		if(is_device_valid(dev_ev->dev) && !in_deadzone(dev_ev->dev)) {
+			dt = core->cfg->repeat_msec * 1000L - ((now.tv_sec - dev_ev->timeval.tv_sec) * 1000000L +
+					(now.tv_usec - dev_ev->timeval.tv_usec));
+			if(dt < 0) dt = 0;
+			if(min_dt < 0 || dt < min_dt) {
+				min_dt = dt;
+			}
+		}
+		dev_ev = dev_ev->next;
+	}
+	return min_dt;
+}
+
+int spnav_core_get_event(struct spnav_core *core, spnav_event *ev, int *devid)
+{
+	struct queued_event *qev;
+
+	if(core->evq_head == core->evq_tail) {
+		return 0;
+	}
+	qev = core->evq + core->evq_tail;
+	core->evq_tail = (core->evq_tail + 1) % EVQ_SIZE;
+
+	*ev = qev->ev;
+	if(ev->type == EVENT_MOTION) {
+		ev->motion.data = &ev->motion.x;
+	}
+	if(devid) {
+		*devid = qev->devid;
+	}
+	return 1;
+}
+
+static struct dev_event *add_dev_event(struct device *dev)
+{
+	struct spnav_core *core = dev->core;
+	struct dev_event *dev_ev, *iter;
+	int i;
+
+	if((dev_ev = core->dev_ev_free)) {
+		core->dev_ev_free = dev_ev->next;
+	} else if((dev_ev = malloc(sizeof *dev_ev)) == NULL) {
+		return NULL;
+	}
+
+	dev_ev->event.motion.data = (int*)&dev_ev->event.motion.x;
+	for(i=0; i<6; i++)
+		dev_ev->event.motion.data[i] = 0;
+	gettimeofday(&dev_ev->timeval, 0);
+	dev_ev->dev = dev;
+	dev_ev->next = NULL;
+
+	if(core->dev_ev_list == NULL)
+		return core->dev_ev_list = dev_ev;
+
+	iter = core->dev_ev_list;
+	while(iter->next) {
+		iter = iter->next;
+	}
+	iter->next = dev_ev;
+	return dev_ev;
+}
+
+/* remove_dev_event takes a device pointer as argument so that upon removal of
+ * a device the pending event (if any) can be removed.
+ */
+void remove_dev_event(struct device *dev)
+{
+	struct spnav_core *core = dev->core;
+	struct dev_event dummy;
+	struct dev_event *iter;
+
+	dummy.next = core->dev_ev_list;
+	iter = &dummy;
+
+	while(iter->next) {
+		if(iter->next->dev == dev) {
+			struct dev_event *ev = iter->next;
+			iter->next = ev->next;
+
+			if(core->verbose) {
+				printf("removing pending device event of: %s\n", dev->path);
+			}
+			ev->next = core->dev_ev_free;
+			core->dev_ev_free = ev;
+		} else {
+			iter = iter->next;
+		}
+	}
+	core->dev_ev_list = dummy.next;
+}
+
+static struct dev_event *device_event_in_use(struct device *dev)
+{
+	struct dev_event *iter = dev->core->dev_ev_list;
+	while(iter) {
+		if(iter->dev == dev) {
+			return iter;
+		}
+		iter = iter->next;
+	}
+	return NULL;
+}
+
+/* process_input processes an device input event, and emits spacenav events
+ * by calling emit_event.
+ * relative inputs (INP_MOTION) are accumulated, and emitted when
+ * we get an INP_FLUSH event. Button events are emitted immediately
+ * and they implicitly flush any pending motion event.
+ */
+void process_input(struct device *dev, struct dev_input *inp)
+{
+	int sign;
+	struct dev_event *dev_ev;
+	struct spnav_core *core = dev->core;
+	struct cfg *cfg = core->cfg;
+
+	/* the inputs of a report are read together, and share one timestamp in
+	 * the flight recorder, taken at the first of them.
+	 */
+	if(!dev->frec_time) {
+		dev->frec_time = frec_time();
+	}
+
+	switch(inp->type) {
+	case INP_MOTION:
+		PROBE3(input_motion, dev->id, inp->idx, inp->val);
+		frec_record_at(dev->frec_time, FREC_READ, dev->id, inp->type, inp->idx, inp->val);
+		break;
+	case INP_BUTTON:
+		PROBE3(input_button, dev->id, inp->idx, inp->val);
+		frec_record_at(dev->frec_time, FREC_READ, dev->id, inp->type, inp->idx, inp->val);
+		dev->frec_time = 0;
+		break;
+	case INP_FLUSH:
+		PROBE1(input_flush, dev->id);
+		frec_record_at(dev->frec_time, FREC_FLUSH, dev->id, inp->tm.tv_sec, inp->tm.tv_usec, 0);
+		dev->frec_time = 0;
+		break;
+	default:
+		break;
+	}
+
+	if(core->input_func && core->input_func(dev, inp, core->input_cls)) {
+		return;
+	}
+
+	switch(inp->type) {
+	case INP_MOTION:
+		/* network devices send what the other side already processed */
+		if(dev->remote) {
+			sign = 1;
+		} else {
+			if(abs(inp->val) < cfg->dead_threshold[inp->idx] ) {
+				inp->val = 0;
+			}
+
+			inp->idx = cfg->map_axis[inp->idx];
+			sign = cfg->invert[inp->idx] ? -1 : 1;
+
+			inp->val = (int)((float)inp->val * cfg->sensitivity * (inp->idx < 3 ? cfg->sens_trans[inp->idx] : cfg->sens_rot[inp->idx - 3]));
+		}
+
+		dev_ev = device_event_in_use(dev);
+		if(core->verbose && dev_ev == NULL)
+			printf("adding dev event for device: %s\n", dev->path);
+		if(dev_ev == NULL && (dev_ev = add_dev_event(dev)) == NULL) {
+			fprintf(stderr, "failed to get dev_event\n");
+			break;
+		}
+		dev_ev->event.type = EVENT_MOTION;
+		dev_ev->event.motion.data = (int*)&dev_ev->event.motion.x;
+		dev_ev->event.motion.data[inp->idx] = sign * inp->val;
+		dev_ev->pending = 1;
+		break;
+
+	case INP_BUTTON:
+		dev_ev = device_event_in_use(dev);
+		if(dev_ev && dev_ev->pending) {
+			emit_event(dev_ev);
+			dev_ev->pending = 0;
+		}
+		if(!dev->remote) {
+			inp->idx = cfg->map_button[inp->idx];
+		}
+
+		/* button events are not queued */
+		{
+			struct dev_event dev_button_event;
+			dev_button_event.dev = dev;
+			dev_button_event.event.type = EVENT_BUTTON;
+			dev_button_event.event.button.press = inp->val;
+			dev_button_event.event.button.bnum = inp->idx;
+			emit_event(&dev_button_event);
+		}
+		break;
+
+	case INP_FLUSH:
+		dev_ev = device_event_in_use(dev);
+		if(dev_ev && dev_ev->pending) {
+			emit_event(dev_ev);
+			dev_ev->pending = 0;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+int in_deadzone(struct device *dev)
+{
+	int i;
+	struct dev_event *dev_ev;
+	if((dev_ev = device_event_in_use(dev)) == NULL)
+		return -1;
+	for(i=0; i<6; i++) {
+		if(dev_ev->event.motion.data[i] != 0)
+			return 0;
+	}
+	return 1;
+}
+
+void repeat_last_event(struct device *dev)
+{
+	struct dev_event *dev_ev;
+	if((dev_ev = device_event_in_use(dev)) == NULL)
+		return;
+	PROBE1(repeat, dev->id);
+	emit_event(dev_ev);
+}
+
+static void emit_event(struct dev_event *dev_ev)
+{
+	struct spnav_core *core = dev_ev->dev->core;
+
+	if(dev_ev->event.type == EVENT_MOTION) {
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+
+		dev_ev->event.motion.period = msec_dif(tv, dev_ev->timeval);
+		dev_ev->timeval = tv;
+	}
+
+	if(core->event_func) {
+		core->event_func(dev_ev->dev, &dev_ev->event, core->event_cls);
+	} else {
+		queue_event(core, dev_ev->dev, &dev_ev->event);
+	}
+}
+
+static void queue_event(struct spnav_core *core, struct device *dev, spnav_event *ev)
+{
+	struct queued_event *qev = core->evq + core->evq_head;
+
+	core->evq_head = (core->evq_head + 1) % EVQ_SIZE;
+	if(core->evq_head == core->evq_tail) {
+		/* full, drop the oldest event */
+		core->evq_tail = (core->evq_tail + 1) % EVQ_SIZE;
+	}
+
+	qev->devid = dev->id;
+	qev->ev = *ev;
+}
+
+static unsigned int msec_dif(struct timeval tv1, struct timeval tv2)
+{
+	unsigned int ms1, ms2;
+
+	ms1 = tv1.tv_sec * 1000 + tv1.tv_usec / 1000;
+	ms2 = tv2.tv_sec * 1000 + tv2.tv_usec / 1000;
+	return ms1 - ms2;
+}
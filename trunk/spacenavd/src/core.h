@@ -0,0 +1,150 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SPNAVD_CORE_H_
+#define SPNAVD_CORE_H_
+
+/* spacenavd core library (libspnavd-core.a): device detection and input,
+ * and the processing of device input into spacenav events (dead zone, axis
+ * and button mapping, sensitivity), driven by a configuration.
+ *
+ * All state lives in a spnav_core context. The daemon is one user of it,
+ * programs which want the events in-process without going through the
+ * daemon can use it directly:
+ *
+ *   core = spnav_core_create(0);
+ *   read_cfg("/etc/spnavrc", spnav_core_cfg(core));
+ *   init_devices(core);
+ *   for(;;) {
+ *       FD_ZERO(&rset);
+ *       max_fd = spnav_core_fdset(core, &rset, -1);
+ *       select(max_fd + 1, &rset, 0, 0, timeout);	(see spnav_core_timeout)
+ *       spnav_core_handle(core, &rset);
+ *       spnav_core_timers(core);
+ *       while(spnav_core_get_event(core, &ev, &devid)) {
+ *           ...
+ *       }
+ *   }
+ */
+
+#include <sys/select.h>
+#include "cfgfile.h"
+#include "dev.h"
+#include "event.h"
+
+#if defined(__cplusplus) || (__STDC_VERSION__ >= 199901L)
+#define INLINE	inline
+#else	/* not C++ or C99 */
+
+#ifdef __GNUC__
+#define INLINE	__inline__
+#else
+#define INLINE
+#endif
+
+#endif
+
+struct spnav_core;
+
+/* called for every processed event. ev is only valid during the call. */
+typedef void (*spnav_core_event_func)(struct device *dev, spnav_event *ev, void *cls);
+/* called for every device input before processing. Returning non-zero
+ * consumes the input.
+ */
+typedef int (*spnav_core_input_func)(struct device *dev, struct dev_input *inp, void *cls);
+/* called when a device starts being used: when it's opened by init_devices,
+ * or for serial devices, when detection completes (from spnav_core_handle or
+ * spnav_core_timers).
+ */
+typedef void (*spnav_core_device_func)(struct device *dev, void *cls);
+
+/* cfg is used as the configuration of the context, and must remain valid
+ * until it's destroyed. If it's null, the context has its own configuration,
+ * initialized to the defaults.
+ */
+struct spnav_core *spnav_core_create(struct cfg *cfg);
+/* closes all devices and frees the context */
+void spnav_core_destroy(struct spnav_core *core);
+
+struct cfg *spnav_core_cfg(struct spnav_core *core);
+void spnav_core_set_verbose(struct spnav_core *core, int verbose);
+int spnav_core_verbose(struct spnav_core *core);
+
+/* preallocates the motion state of count devices, so that processing input
+ * doesn't need to allocate memory.
+ */
+int spnav_core_prealloc(struct spnav_core *core, int count);
+
+/* without an event function, events are queued for spnav_core_get_event */
+void spnav_core_set_event_func(struct spnav_core *core, spnav_core_event_func func, void *cls);
+void spnav_core_set_input_func(struct spnav_core *core, spnav_core_input_func func, void *cls);
+void spnav_core_set_device_func(struct spnav_core *core, spnav_core_device_func func, void *cls);
+
+/* in threaded mode every device is read and parsed by its own thread, and
+ * spnav_core_handle processes what they read. Requires linking with
+ * -lpthread.
+ */
+void spnav_core_set_threaded(struct spnav_core *core, int enable);
+
+/* Suspends reading the devices (and the motion repeat), for when nobody is
+ * interested in their input. Resuming discards the input which piled up in
+ * the meantime, and reports the current state of the devices which can be
+ * queried (evdev), so that the new state is the same as if it was read all
+ * along.
+ */
+void spnav_core_suspend(struct spnav_core *core, int suspend);
+int spnav_core_suspended(struct spnav_core *core);
+
+/* adds the file descriptors of all devices to set, returns the new max fd */
+int spnav_core_fdset(struct spnav_core *core, fd_set *set, int max_fd);
+/* reads and processes input from all the devices with a descriptor in set,
+ * and any input read by the device threads.
+ */
+void spnav_core_handle(struct spnav_core *core, fd_set *set);
+
+/* Devices can have timers, for work which can't wait for input (serial device
+ * detection). spnav_core_timeout returns the milliseconds until the next one
+ * is due (-1 if there are none), to be used as the select timeout, and
+ * spnav_core_timers runs the ones which are due.
+ */
+int spnav_core_timeout(struct spnav_core *core);
+void spnav_core_timers(struct spnav_core *core);
+
+/* processes raw input the caller has read from the file descriptor of dev,
+ * instead of having spnav_core_handle read it. Only for devices with a feed
+ * function, which must also have ext_read set to keep them out of
+ * spnav_core_fdset and spnav_core_handle.
+ */
+void spnav_core_feed(struct device *dev, const void *data, int size);
+
+/* non-zero if any device is outside of the dead zone, in which case its last
+ * motion event is repeated by spnav_core_repeat (see repeat-interval).
+ */
+int spnav_core_active(struct spnav_core *core);
+void spnav_core_repeat(struct spnav_core *core);
+/* microseconds until the repeat is due, which is repeat-interval after the
+ * last motion event of an active device (0 if it's already due), or -1 if
+ * there's nothing to repeat.
+ */
+long spnav_core_repeat_timeout(struct spnav_core *core);
+
+/* pops the next queued event, returns 0 if the queue is empty. devid is the
+ * id of the device which generated it (can be null).
+ */
+int spnav_core_get_event(struct spnav_core *core, spnav_event *ev, int *devid);
+
+#endif	/* SPNAVD_CORE_H_ */
@@ -0,0 +1,71 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SPNAVD_CORE_IMPL_H_
+#define SPNAVD_CORE_IMPL_H_
+
+/* internal to the core library, not to be included by its users */
+
+#include "core.h"
+
+/* size of the pull API event queue, the oldest events are dropped when full */
+#define EVQ_SIZE	256
+
+struct dev_event {
+	spnav_event event;
+	struct timeval timeval;
+	struct device *dev;
+	int pending;
+	struct dev_event *next;
+};
+
+struct queued_event {
+	int devid;
+	spnav_event ev;
+};
+
+struct spnav_core {
+	struct cfg *cfg;
+	struct cfg own_cfg;		/* used when created without a configuration */
+	int verbose;
+
+	struct device *dev_list;
+	int next_dev_id;
+
+	struct dev_event *dev_ev_list;
+	struct dev_event *dev_ev_free;	/* preallocated, see spnav_core_prealloc */
+
+	spnav_core_event_func event_func;
+	void *event_cls;
+	spnav_core_input_func input_func;
+	void *input_cls;
+	spnav_core_device_func device_func;
+	void *device_cls;
+
+	int threaded;		/* devices are read by their own threads (dev_thread.h) */
+	int wake_fd[2];
+
+	int suspended;		/* device input suspended, see spnav_core_suspend */
+
+	struct queued_event evq[EVQ_SIZE];
+	int evq_head, evq_tail;
+};
+
+/* called by the device modules when a device starts being used */
+void device_attached(struct device *dev);
+
+#endif	/* SPNAVD_CORE_IMPL_H_ */
@@ -20,59 +20,89 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
 #include "dev.h"
 #include "dev_usb.h"
 #include "dev_serial.h"
+#include "dev_net.h"
 #include "event.h" /* remove pending events upon device removal */
-#include "spnavd.h"
+#include "core_impl.h"
+#include "dev_thread.h"
+#include "flightrec.h"
 
-static struct device *add_device(void);
-static struct device *dev_path_in_use(char const * dev_path);
-static int match_usbdev(const struct usb_device_info *devinfo);
+static struct device *add_device(struct spnav_core *core);
+static struct device *dev_path_in_use(struct spnav_core *core, char const * dev_path);
+static int match_usbdev(struct spnav_core *core, const struct usb_device_info *devinfo);
 
-static struct device *dev_list = NULL;
-
-int init_devices(void)
+int init_devices(struct spnav_core *core)
 {
 	struct device *dev;
 	int i, device_added = 0;
 	struct usb_device_info *usblist, *usbdev;
+	struct cfg *cfg = core->cfg;
 
 	/* try to open a serial device if specified in the config file */
-	if(cfg.serial_dev[0]) {
-		if(!dev_path_in_use(cfg.serial_dev)) {
-			dev = add_device();
-			strcpy(dev->path, cfg.serial_dev);
+	if(cfg->serial_dev[0]) {
+		if(!dev_path_in_use(core, cfg->serial_dev)) {
+			dev = add_device(core);
+			strcpy(dev->path, cfg->serial_dev);
+			strcpy(dev->name, "serial device");
+			/* opens the port and detects the device in the background, it
+			 * starts being used when detection completes (see dev_serial.c).
+			 */
 			if(open_dev_serial(dev) == -1) {
 				remove_device(dev);
 			} else {
-				strcpy(dev->name, "serial device");
-				printf("using device: %s\n", cfg.serial_dev);
+				device_added++;
+			}
+		}
+	}
+
+	/* receive the events forwarded by another daemon */
+	if(cfg->net_receive[0]) {
+		char path[PATH_MAX];
+		sprintf(path, "udp:%s", cfg->net_receive);
+
+		if(!dev_path_in_use(core, path)) {
+			dev = add_device(core);
+			strcpy(dev->path, path);
+			strcpy(dev->name, "network device");
+
+			if(open_dev_net(dev, cfg->net_receive) == -1) {
+				remove_device(dev);
+			} else {
+				printf("using device %d: %s\n", dev->id, dev->path);
+				device_attached(dev);
 				device_added++;
 			}
 		}
 	}
 
 	/* detect any supported USB devices */
-	usblist = find_usb_devices(match_usbdev);
+	usblist = find_usb_devices(core, match_usbdev);
 
 	usbdev = usblist;
 	while(usbdev) {
 		for(i=0; i<usbdev->num_devfiles; i++) {
-			if((dev = dev_path_in_use(usbdev->devfiles[i]))) {
-				if(verbose) {
+			if((dev = dev_path_in_use(core, usbdev->devfiles[i]))) {
+				if(core->verbose) {
 					fprintf(stderr, "already using device: %s (%s)\n", dev->name, dev->path);
 				}
 				break;
 			}
 
-			dev = add_device();
+			dev = add_device(core);
 			strcpy(dev->path, usbdev->devfiles[i]);
 
 			if(open_dev_usb(dev) == -1) {
 				remove_device(dev);
 			} else {
-				printf("using device: %s\n", dev->path);
+				printf("using device %d: %s\n", dev->id, dev->path);
+				device_attached(dev);
+				if(core->threaded && !core->suspended) {
+					start_dev_thread(dev);
+				}
 				device_added++;
 				break;
 			}
@@ -89,7 +119,7 @@ int init_devices(void)
 	return 0;
 }
 
-static struct device *add_device(void)
+static struct device *add_device(struct spnav_core *core)
 {
 	struct device *dev;
 
@@ -100,21 +130,26 @@ static struct device *add_device(void)
 
 	printf("adding device.\n");
 
+	dev->id = core->next_dev_id++;
 	dev->fd = -1;
-	dev->next = dev_list;
-	dev_list = dev;
+	frec_record(FREC_DEV_ADD, dev->id, 0, 0, 0);
+	dev->core = core;
+	dev->next = core->dev_list;
+	core->dev_list = dev;
 
-	return dev_list;
+	return dev;
 }
 
 void remove_device(struct device *dev)
 {
+	struct spnav_core *core = dev->core;
 	struct device dummy;
 	struct device *iter;
 
 	printf("removing device: %s\n", dev->name);
+	frec_record(FREC_DEV_REMOVE, dev->id, 0, 0, 0);
 
-	dummy.next = dev_list;
+	dummy.next = core->dev_list;
 	iter = &dummy;
 
 	while(iter->next) {
@@ -124,19 +159,21 @@ void remove_device(struct device *dev)
 		}
 		iter = iter->next;
 	}
-	dev_list = dummy.next;
+	core->dev_list = dummy.next;
 
+	stop_dev_thread(dev);
 	remove_dev_event(dev);
 
 	if(dev->close) {
 		dev->close(dev);
 	}
+	free(dev->subs);
 	free(dev);
 }
 
-static struct device *dev_path_in_use(char const *dev_path)
+static struct device *dev_path_in_use(struct spnav_core *core, char const *dev_path)
 {
-	struct device *iter = dev_list;
+	struct device *iter = core->dev_list;
 	while(iter) {
 		if(strcmp(iter->path, dev_path) == 0) {
 			return iter;
@@ -146,23 +183,42 @@ static struct device *dev_path_in_use(char const *dev_path)
 	return 0;
 }
 
+unsigned long long dev_time_msec(void)
+{
+	return dev_time_usec() / 1000;
+}
+
+unsigned long long dev_time_usec(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	}
+#endif
+	{
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+		return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+	}
+}
+
 int get_device_fd(struct device *dev)
 {
 	return dev ? dev->fd : -1;
 }
 
-int get_device_index(struct device *dev)
+struct device *get_device_by_id(struct spnav_core *core, int id)
 {
-	struct device *iter = dev_list;
-	int index = 0;
+	struct device *iter = core->dev_list;
 	while(iter) {
-		if(dev == iter) {
-			return index;
+		if(iter->id == id) {
+			return iter;
 		}
-		index++;
 		iter = iter->next;
 	}
-	return -1;
+	return 0;
 }
 
 int read_device(struct device *dev, struct dev_input *inp)
@@ -180,9 +236,23 @@ void set_device_led(struct device *dev, int state)
 	}
 }
 
-struct device *get_devices(void)
+void set_devices_led(struct spnav_core *core, int state)
+{
+	struct device *dev = core->dev_list;
+	while(dev) {
+		if(is_device_valid(dev)) {
+			if(core->verbose) {
+				printf("turn led %s, device: %s\n", state ? "on": "off", dev->name);
+			}
+			set_device_led(dev, state);
+		}
+		dev = dev->next;
+	}
+}
+
+struct device *get_devices(struct spnav_core *core)
 {
-	return dev_list;
+	return core->dev_list;
 }
 
 static int devid_list[][2] = {
@@ -203,9 +273,10 @@ static int devid_list[][2] = {
 	{-1, -1}
 };
 
-static int match_usbdev(const struct usb_device_info *devinfo)
+static int match_usbdev(struct spnav_core *core, const struct usb_device_info *devinfo)
 {
 	int i;
+	struct cfg *cfg = core->cfg;
 
 	/* if it's a 3Dconnexion device match it immediately */
 	if((devinfo->name && strstr(devinfo->name, "3Dconnexion"))) {
@@ -223,12 +294,12 @@ static int match_usbdev(const struct usb_device_info *devinfo)
 
 	/* match any joystick devices listed in the config file */
 	for(i=0; i<MAX_CUSTOM; i++) {
-		if(cfg.devid[i][0] != -1 && cfg.devid[i][1] != -1 &&
-				(unsigned int)cfg.devid[i][0] == devinfo->vendorid &&
-				(unsigned int)cfg.devid[i][1] == devinfo->productid) {
+		if(cfg->devid[i][0] != -1 && cfg->devid[i][1] != -1 &&
+				(unsigned int)cfg->devid[i][0] == devinfo->vendorid &&
+				(unsigned int)cfg->devid[i][1] == devinfo->productid) {
 			return 1;
 		}
-		if(cfg.devname[i] && devinfo->name && strcmp(cfg.devname[i], devinfo->name) == 0) {
+		if(cfg->devname[i] && devinfo->name && strcmp(cfg->devname[i], devinfo->name) == 0) {
 			return 1;
 		}
 	}
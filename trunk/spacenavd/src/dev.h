@@ -22,10 +22,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "config.h"
 
 struct dev_input;
+struct client;
+struct spnav_core;
 
 #define MAX_DEV_NAME	256
 
 struct device {
+	int id;		/* stable device id, assigned in order of detection, never reused */
 	int fd;
 	void *data;
 	char name[MAX_DEV_NAME];
@@ -34,24 +37,56 @@ struct device {
 	int num_axes;
 	int *minval, *maxval;	/* input value range (default: -500, 500) */
 	int *fuzz;				/* noise threshold */
+	/* motion input is within [-motion_range, motion_range], evdev input is
+	 * normalized to 500 (minval/maxval are its raw range), serial input is
+	 * not. 0 if unknown.
+	 */
+	int motion_range;
 
 	void (*close)(struct device*);
 	int (*read)(struct device*, struct dev_input*);
+	/* processes raw input read from fd by someone else (optional, evdev only) */
+	void (*feed)(struct device*, const void*, int);
+	/* discards pending input and reports the current state (optional) */
+	void (*resync)(struct device*);
+	/* called by spnav_core_timers once dev_time_msec reaches timer (if set) */
+	void (*tick)(struct device*);
+	unsigned long long timer;
 	void (*set_led)(struct device*, int);
 
+	struct spnav_core *core;	/* the core context the device belongs to */
+	struct dev_thread *thread;	/* reader thread in threaded mode */
+	int failed;		/* set by read on a fatal error, the device is removed by the caller */
+	int ext_read;	/* input is read by the caller and passed to spnav_core_feed */
+	int probing;	/* the type of device is still being detected, no input yet */
+	int remote;		/* network device, its input is already processed (dev_net.h) */
+	unsigned long long frec_time;	/* flight recorder time of the current report */
+
+	/* clients subscribed to this device, maintained by client.c */
+	struct client **subs;
+	int num_subs, max_subs;
+	unsigned int subs_gen;
+
   struct device *next;
 };
 
-int init_devices(void);
+/* detects and opens any new devices according to the configuration of core */
+int init_devices(struct spnav_core *core);
 
 void remove_device(struct device *dev);
 
 int get_device_fd(struct device *dev);
 #define is_device_valid(dev) (get_device_fd(dev) >= 0)
-int get_device_index(struct device *dev);
+struct device *get_device_by_id(struct spnav_core *core, int id);
 int read_device(struct device *dev, struct dev_input *inp);
 void set_device_led(struct device *dev, int state);
+void set_devices_led(struct spnav_core *core, int state);
+
+struct device *get_devices(struct spnav_core *core);
 
-struct device *get_devices(void);
+/* monotonic time in milliseconds, for the device timers */
+unsigned long long dev_time_msec(void);
+/* same clock in microseconds */
+unsigned long long dev_time_usec(void);
 
 #endif	/* SPNAV_DEV_H_ */
@@ -0,0 +1,524 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2012 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "dev_net.h"
+#include "dev.h"
+#include "event.h"
+#include "core_impl.h"
+
+/* inputs generated by one frame: all axes, flush, and every button */
+#define MAX_PENDING		(6 + 1 + 64)
+
+#define MAX_ALLOW		16
+
+struct net_dev {
+	struct dev_input pending[MAX_PENDING];
+	int num_pending, next_pending;
+
+	/* hosts allowed to send (receive-from), any if there are none */
+	struct in_addr allow[MAX_ALLOW];
+	int num_allow;
+
+	int active;		/* receiving from a sender */
+	struct sockaddr_in sender;
+	unsigned int session, seq;
+
+	/* state last reported as input */
+	int motion[6];
+	unsigned long long buttons;
+
+	struct net_stats st;
+};
+
+static int parse_allow(struct net_dev *nd, const char *str);
+static int resolve_host(const char *host, struct in_addr *addr);
+static void close_dev_net(struct device *dev);
+static int read_dev_net(struct device *dev, struct dev_input *inp);
+static void resync_dev_net(struct device *dev);
+static void tick_dev_net(struct device *dev);
+static int recv_frame(struct device *dev);
+static void handle_frame(struct device *dev, const unsigned char *buf, int size,
+		const struct sockaddr_in *from);
+static void set_state(struct net_dev *nd, const int *motion, unsigned long long buttons);
+static void add_input(struct net_dev *nd, int type, int idx, int val);
+static void process_pending(struct device *dev);
+
+
+int open_dev_net(struct device *dev, const char *addr)
+{
+	struct net_dev *nd;
+	struct sockaddr_in sa;
+	struct ip_mreq mreq;
+	int s, one = 1;
+
+	/* anyone who can reach the socket can inject input, including button
+	 * presses turned into keystrokes by the keyboard emulation. Without an
+	 * explicit address, only accept frames from this host.
+	 */
+	memset(&sa, 0, sizeof sa);
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(net_parse_addr(addr, &sa) == -1) {
+		fprintf(stderr, "invalid network receive address: %s\n", addr);
+		return -1;
+	}
+
+	if((s = socket(PF_INET, SOCK_DGRAM, 0)) == -1) {
+		perror("failed to create network receive socket");
+		return -1;
+	}
+	/* more than one receiver can listen to a multicast group on the same host */
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+
+	if(IN_MULTICAST(ntohl(sa.sin_addr.s_addr))) {
+		mreq.imr_multiaddr = sa.sin_addr;
+		mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+		if(setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof mreq) == -1) {
+			fprintf(stderr, "failed to join multicast group %s: %s\n", inet_ntoa(sa.sin_addr), strerror(errno));
+			close(s);
+			return -1;
+		}
+	}
+
+	if(bind(s, (struct sockaddr*)&sa, sizeof sa) == -1) {
+		fprintf(stderr, "failed to bind network receive socket to %s: %s\n", addr, strerror(errno));
+		close(s);
+		return -1;
+	}
+
+	if(!(nd = malloc(sizeof *nd))) {
+		perror("failed to allocate network device");
+		close(s);
+		return -1;
+	}
+	memset(nd, 0, sizeof *nd);
+	nd->st.latency_min_usec = -1;
+
+	if(parse_allow(nd, dev->core->cfg->net_allow) == -1) {
+		free(nd);
+		close(s);
+		return -1;
+	}
+
+	dev->fd = s;
+	dev->data = nd;
+	dev->remote = 1;
+	dev->num_axes = 6;
+	dev->close = close_dev_net;
+	dev->read = read_dev_net;
+	dev->resync = resync_dev_net;
+	dev->tick = tick_dev_net;
+
+	printf("receiving events on %s:%d\n", inet_ntoa(sa.sin_addr), ntohs(sa.sin_port));
+	return 0;
+}
+
+int get_net_stats(struct device *dev, struct net_stats *st)
+{
+	if(dev->read != read_dev_net) {
+		return -1;
+	}
+	*st = ((struct net_dev*)dev->data)->st;
+	return 0;
+}
+
+int net_parse_addr(const char *str, struct sockaddr_in *sa)
+{
+	char *host, *endp;
+	const char *portstr;
+	long port;
+
+	if((portstr = strrchr(str, ':'))) {
+		portstr++;
+	} else {
+		portstr = str;
+	}
+	port = strtol(portstr, &endp, 10);
+	if(endp == portstr || *endp || port <= 0 || port > 65535) {
+		return -1;
+	}
+	sa->sin_port = htons(port);
+
+	if(portstr == str) {
+		return 0;
+	}
+
+	if(!(host = malloc(portstr - str))) {
+		return -1;
+	}
+	memcpy(host, str, portstr - str - 1);
+	host[portstr - str - 1] = 0;
+
+	if(resolve_host(host, &sa->sin_addr) == -1) {
+		free(host);
+		return -1;
+	}
+	free(host);
+	return 0;
+}
+
+/* parses the comma separated hosts of receive-from */
+static int parse_allow(struct net_dev *nd, const char *str)
+{
+	char buf[256], *host;
+
+	strcpy(buf, str);
+
+	host = strtok(buf, ",");
+	while(host) {
+		if(nd->num_allow >= MAX_ALLOW) {
+			fprintf(stderr, "too many receive-from hosts, using the first %d\n", MAX_ALLOW);
+			break;
+		}
+		if(resolve_host(host, nd->allow + nd->num_allow) == -1) {
+			return -1;
+		}
+		nd->num_allow++;
+		host = strtok(0, ",");
+	}
+	return 0;
+}
+
+static int resolve_host(const char *host, struct in_addr *addr)
+{
+	struct hostent *ent;
+
+	if(!inet_aton(host, addr)) {
+		if(!(ent = gethostbyname(host)) || ent->h_addrtype != AF_INET) {
+			fprintf(stderr, "failed to resolve %s\n", host);
+			return -1;
+		}
+		memcpy(addr, ent->h_addr_list[0], sizeof *addr);
+	}
+	return 0;
+}
+
+static void close_dev_net(struct device *dev)
+{
+	if(dev->fd != -1) {
+		close(dev->fd);
+		dev->fd = -1;
+	}
+	free(dev->data);
+	dev->data = 0;
+}
+
+/* Every frame is turned into the inputs which take the reported state to the
+ * state in the frame, and they are returned one by one before the next frame
+ * is read.
+ */
+static int read_dev_net(struct device *dev, struct dev_input *inp)
+{
+	struct net_dev *nd = dev->data;
+
+	while(nd->next_pending >= nd->num_pending) {
+		nd->num_pending = nd->next_pending = 0;
+		if(recv_frame(dev) == -1) {
+			return -1;
+		}
+	}
+	*inp = nd->pending[nd->next_pending++];
+	return 0;
+}
+
+/* catches up with the frames sent while the input was suspended, and reports
+ * the current state.
+ */
+static void resync_dev_net(struct device *dev)
+{
+	struct net_dev *nd = dev->data;
+	int motion[6];
+	unsigned long long buttons;
+
+	while(recv_frame(dev) != -1) {
+		nd->num_pending = nd->next_pending = 0;
+	}
+
+	/* report the state as if it was reached from nothing */
+	memcpy(motion, nd->motion, sizeof motion);
+	buttons = nd->buttons;
+	memset(nd->motion, 0, sizeof nd->motion);
+	nd->buttons = 0;
+
+	set_state(nd, motion, buttons);
+	process_pending(dev);
+}
+
+/* the sender went silent: release everything */
+static void tick_dev_net(struct device *dev)
+{
+	static const int zero[6];
+	struct net_dev *nd = dev->data;
+
+	if(!nd->active) {
+		return;
+	}
+	nd->active = 0;
+	nd->st.timeouts++;
+
+	if(dev->core->verbose) {
+		printf("no frames from %s:%d, releasing the network device state\n",
+				inet_ntoa(nd->sender.sin_addr), ntohs(nd->sender.sin_port));
+	}
+
+	set_state(nd, zero, 0);
+	if(dev->core->suspended) {
+		nd->num_pending = nd->next_pending = 0;
+	} else {
+		process_pending(dev);
+	}
+}
+
+/* reads and handles one frame, returns -1 if there are none */
+static int recv_frame(struct device *dev)
+{
+	unsigned char buf[NET_FRAME_MAX_SIZE + 1];
+	struct sockaddr_in from;
+	socklen_t len = sizeof from;
+	int sz;
+
+	if((sz = recvfrom(dev->fd, buf, sizeof buf, 0, (struct sockaddr*)&from, &len)) == -1) {
+		if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			perror("network device read error");
+		}
+		return -1;
+	}
+	handle_frame(dev, buf, sz, &from);
+	return 0;
+}
+
+static void handle_frame(struct device *dev, const unsigned char *buf, int size,
+		const struct sockaddr_in *from)
+{
+	struct net_dev *nd = dev->data;
+	struct net_frame fr;
+	long long lat;
+	int i, dseq;
+
+	nd->st.frames++;
+	nd->st.bytes += size;
+
+	if(nd->num_allow) {
+		for(i=0; i<nd->num_allow; i++) {
+			if(from->sin_addr.s_addr == nd->allow[i].s_addr) break;
+		}
+		if(i >= nd->num_allow) {
+			nd->st.denied++;
+			return;
+		}
+	}
+
+	if(net_decode_frame(&fr, buf, size) == -1) {
+		nd->st.bad++;
+		return;
+	}
+
+	if(nd->active && fr.session == nd->session) {
+		if(from->sin_addr.s_addr != nd->sender.sin_addr.s_addr || from->sin_port != nd->sender.sin_port) {
+			nd->st.foreign++;
+			return;
+		}
+		dseq = (int)(fr.seq - nd->seq);
+		if(dseq <= 0) {
+			nd->st.stale++;
+			return;
+		}
+		nd->st.lost += dseq - 1;
+
+	} else if(nd->active && (from->sin_addr.s_addr != nd->sender.sin_addr.s_addr ||
+				from->sin_port != nd->sender.sin_port)) {
+		/* stick with the current sender until it goes silent */
+		nd->st.foreign++;
+		return;
+
+	} else {
+		/* new sender, or the same one restarted */
+		if(dev->core->verbose) {
+			printf("receiving frames from %s:%d\n", inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+		}
+		nd->active = 1;
+		nd->sender = *from;
+		nd->session = fr.session;
+	}
+	nd->seq = fr.seq;
+
+	lat = (long long)(dev_time_usec() - fr.time_usec);
+	nd->st.latency_samples++;
+	nd->st.latency_usec = lat;
+	nd->st.latency_total_usec += lat;
+	if(nd->st.latency_min_usec == -1 || lat < nd->st.latency_min_usec) {
+		nd->st.latency_min_usec = lat;
+	}
+	if(lat > nd->st.latency_max_usec) {
+		nd->st.latency_max_usec = lat;
+	}
+
+	dev->timer = dev_time_msec() + dev->core->cfg->net_timeout;
+
+	set_state(nd, fr.motion, fr.buttons);
+}
+
+/* queues the inputs which take the reported state to the new one. Motion is
+ * reported whenever it's non-zero (like a device would keep sending it) or
+ * changed, buttons when they change.
+ */
+static void set_state(struct net_dev *nd, const int *motion, unsigned long long buttons)
+{
+	int i, report = 0;
+	unsigned long long diff;
+
+	for(i=0; i<6; i++) {
+		if(motion[i] || motion[i] != nd->motion[i]) {
+			report = 1;
+			break;
+		}
+	}
+	if(report) {
+		for(i=0; i<6; i++) {
+			add_input(nd, INP_MOTION, i, motion[i]);
+			nd->motion[i] = motion[i];
+		}
+		add_input(nd, INP_FLUSH, 0, 0);
+	}
+
+	diff = buttons ^ nd->buttons;
+	for(i=0; diff; i++) {
+		if(diff & 1) {
+			add_input(nd, INP_BUTTON, i, (int)((buttons >> i) & 1));
+		}
+		diff >>= 1;
+	}
+	nd->buttons = buttons;
+}
+
+static void add_input(struct net_dev *nd, int type, int idx, int val)
+{
+	struct dev_input *inp = nd->pending + nd->num_pending++;
+
+	inp->type = type;
+	inp->idx = idx;
+	inp->val = val;
+	inp->tm.tv_sec = inp->tm.tv_usec = 0;
+}
+
+/* processes the queued inputs right away, outside of spnav_core_handle */
+static void process_pending(struct device *dev)
+{
+	struct net_dev *nd = dev->data;
+	struct dev_input inp;
+
+	while(nd->next_pending < nd->num_pending) {
+		inp = nd->pending[nd->next_pending++];
+		process_input(dev, &inp);
+	}
+	nd->num_pending = nd->next_pending = 0;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+	p[0] = (v >> 24) & 0xff;
+	p[1] = (v >> 16) & 0xff;
+	p[2] = (v >> 8) & 0xff;
+	p[3] = v & 0xff;
+}
+
+static unsigned long get32(const unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+		((unsigned long)p[2] << 8) | p[3];
+}
+
+int net_encode_frame(const struct net_frame *fr, unsigned char *buf)
+{
+	int i, val, axes = 0;
+	unsigned char *ptr = buf + NET_FRAME_HDR_SIZE;
+
+	for(i=0; i<6; i++) {
+		if(fr->motion[i]) {
+			val = fr->motion[i];
+			if(val > 32767) val = 32767;
+			if(val < -32768) val = -32768;
+			*ptr++ = (val >> 8) & 0xff;
+			*ptr++ = val & 0xff;
+			axes |= 1 << i;
+		}
+	}
+
+	put32(buf, NET_FRAME_MAGIC);
+	buf[4] = NET_FRAME_VERSION;
+	buf[5] = fr->flags;
+	buf[6] = axes;
+	buf[7] = 0;
+	put32(buf + 8, fr->session);
+	put32(buf + 12, fr->seq);
+	put32(buf + 16, (unsigned long)(fr->time_usec >> 32));
+	put32(buf + 20, (unsigned long)fr->time_usec);
+	put32(buf + 24, fr->period);
+	put32(buf + 28, (unsigned long)(fr->buttons >> 32));
+	put32(buf + 32, (unsigned long)fr->buttons);
+
+	return ptr - buf;
+}
+
+int net_decode_frame(struct net_frame *fr, const unsigned char *buf, int size)
+{
+	int i, axes, len = NET_FRAME_HDR_SIZE;
+	const unsigned char *ptr = buf + NET_FRAME_HDR_SIZE;
+
+	if(size < NET_FRAME_HDR_SIZE || get32(buf) != NET_FRAME_MAGIC || buf[4] != NET_FRAME_VERSION) {
+		return -1;
+	}
+	axes = buf[6];
+	if(axes & ~0x3f) {
+		return -1;
+	}
+	for(i=0; i<6; i++) {
+		if(axes & (1 << i)) len += 2;
+	}
+	if(size != len) {
+		return -1;
+	}
+
+	fr->flags = buf[5];
+	fr->session = get32(buf + 8);
+	fr->seq = get32(buf + 12);
+	fr->time_usec = ((unsigned long long)get32(buf + 16) << 32) | get32(buf + 20);
+	fr->period = get32(buf + 24);
+	fr->buttons = ((unsigned long long)get32(buf + 28) << 32) | get32(buf + 32);
+
+	for(i=0; i<6; i++) {
+		if(axes & (1 << i)) {
+			fr->motion[i] = (short)((ptr[0] << 8) | ptr[1]);
+			ptr += 2;
+		} else {
+			fr->motion[i] = 0;
+		}
+	}
+	return 0;
+}
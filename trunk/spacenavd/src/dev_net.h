@@ -0,0 +1,104 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2012 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SPNAV_DEV_NET_H_
+#define SPNAV_DEV_NET_H_
+
+#include <netinet/in.h>
+
+struct device;
+
+/* Event forwarding over UDP between daemons (see forward and receive in
+ * spnavrc): the forwarding daemon sends the state of its devices after
+ * processing, as frames carrying the absolute motion and buttons, and the
+ * receiving daemon turns them back into events of a network device.
+ *
+ * Frames are sent on every event, and repeated at an interval while there
+ * are none, so a lost frame is corrected by the next one. Frames older than
+ * the last one received (reordered, duplicated) are dropped.
+ *
+ * Frame format (big endian):
+ *   magic		4	NET_FRAME_MAGIC
+ *   version	1	NET_FRAME_VERSION
+ *   flags		1	NET_FRAME_*
+ *   axes		1	bit n set: axis n is non-zero and included below
+ *   reserved	1
+ *   session	4	random, chosen when the forwarding starts
+ *   seq		4	incremented for every frame
+ *   time		8	send time, microseconds of the sender's monotonic clock
+ *   period		4	milliseconds since the previous motion event
+ *   buttons	8	bit n set: button n held down
+ *   motion		2	for each axis in the axes mask, in order
+ */
+#define NET_FRAME_MAGIC		0x53504e56	/* "SPNV" */
+#define NET_FRAME_VERSION	1
+#define NET_FRAME_HDR_SIZE	36
+#define NET_FRAME_MAX_SIZE	(NET_FRAME_HDR_SIZE + 6 * 2)
+
+/* frame flags */
+#define NET_FRAME_REPEAT	1	/* repeated state, no new event */
+
+#define NET_DEF_PORT		11011
+
+struct net_frame {
+	int flags;
+	unsigned int session, seq;
+	unsigned long long time_usec;
+	unsigned int period;
+	unsigned long long buttons;
+	int motion[6];		/* clamped to 16 bits when encoded */
+};
+
+/* counters of a network device */
+struct net_stats {
+	unsigned long frames, bytes;
+	unsigned long bad;		/* malformed frames */
+	unsigned long lost;		/* gaps in the sequence numbers */
+	unsigned long stale;	/* reordered or duplicate frames, dropped */
+	unsigned long foreign;	/* frames from another sender, ignored */
+	unsigned long denied;	/* frames from hosts not in receive-from, ignored */
+	unsigned long timeouts;	/* sender went silent, state released */
+	/* one-way delay (receive time minus send time). The sender's clock is
+	 * used as is, so the absolute values are only meaningful on the same
+	 * host (loopback), but the spread always shows the jitter.
+	 */
+	unsigned long latency_samples;
+	long long latency_usec, latency_min_usec, latency_max_usec, latency_total_usec;
+};
+
+/* writes the frame into buf (at least NET_FRAME_MAX_SIZE bytes), returns
+ * its size.
+ */
+int net_encode_frame(const struct net_frame *fr, unsigned char *buf);
+/* returns -1 if the frame is malformed */
+int net_decode_frame(struct net_frame *fr, const unsigned char *buf, int size);
+
+/* Opens a network device receiving frames on addr, "[address:]port". If the
+ * address is a multicast group it's joined, otherwise it's the local address
+ * to receive on (default: any).
+ */
+int open_dev_net(struct device *dev, const char *addr);
+
+/* returns -1 if dev is not a network device */
+int get_net_stats(struct device *dev, struct net_stats *st);
+
+/* parses "[host:]port", returns -1 on failure. The host is left untouched if
+ * it's not part of the string.
+ */
+int net_parse_addr(const char *str, struct sockaddr_in *sa);
+
+#endif	/* SPNAV_DEV_NET_H_ */
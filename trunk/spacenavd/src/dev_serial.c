@@ -17,32 +17,384 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#if defined(__linux__)
+#include <linux/serial.h>
+#endif
 #include "dev_serial.h"
 #include "dev.h"
+#include "dev_thread.h"
 #include "event.h"
+#include "core_impl.h"
 #include "serial/sball.h"
+#include "magellan/smag.h"
+#include "magellan/smag_comm.h"
+
+/* Serial devices can't be identified without talking to them, so the type of
+ * device on the port is detected in the background, driven by the device
+ * timer and input, without ever blocking the event loop:
+ *
+ *  1. spaceball: the port is set up for a spaceball, which sends data on its
+ *     own after the port is opened.
+ *  2. magellan: the port is set up again for a magellan, which is sent the
+ *     initialization and version query commands, and should reply with its
+ *     version string.
+ *
+ * If neither answers (device missing or switched off), the port is handed to
+ * the spaceball driver, as it always was before detection.
+ */
+
+#define SBALL_WAIT_MSEC		2000
+#define SMAG_SETTLE_MSEC	1000
+#define SMAG_REPLY_MSEC		1000
+
+enum { PROBE_SBALL, PROBE_SMAG };
+enum { TYPE_SBALL, TYPE_SMAG };
+
+enum { STEP_WAIT, STEP_SEND, STEP_FLUSH, STEP_REPLY, STEP_DONE };
+
+struct probe_step {
+	int type;
+	const struct smag_cmd *cmd;	/* STEP_SEND */
+	int msec;					/* STEP_WAIT, STEP_REPLY */
+};
+
+static const struct probe_step smag_steps[] = {
+	{STEP_WAIT, 0, SMAG_SETTLE_MSEC},
+	{STEP_SEND, smag_init_cmd, 0},
+	{STEP_FLUSH, 0, 0},
+	{STEP_SEND, smag_version_cmd, 0},
+	{STEP_FLUSH, 0, 0},
+	{STEP_SEND, smag_query_cmd, 0},
+	{STEP_REPLY, 0, SMAG_REPLY_MSEC},
+	/* the version query turned everything off, initialize it again */
+	{STEP_SEND, smag_init_cmd, 0},
+	{STEP_FLUSH, 0, 0},
+	{STEP_DONE, 0, 0}
+};
+
+struct probe {
+	int state;
+	const struct probe_step *step;
+	int started;		/* the current step has started waiting */
+	int cmd, pos;		/* command and character being sent */
+	char reply[64];
+	int reply_len, got_reply;
+};
+
+static int read_probe(struct device *dev, struct dev_input *inp);
+static void close_probe(struct device *dev);
+static void tick_probe(struct device *dev);
+static void run_probe(struct device *dev);
+static void next_step(struct probe *p);
+static void start_smag_probe(struct device *dev);
+static void attach(struct device *dev, int type);
+static void set_serial_low_latency(struct device *dev);
 
 static void close_dev_serial(struct device *dev);
 static int read_dev_serial(struct device *dev, struct dev_input *inp);
+static void close_dev_smag(struct device *dev);
+static int read_dev_smag(struct device *dev, struct dev_input *inp);
+
 
 int open_dev_serial(struct device *dev)
 {
-	if(!(dev->data = sball_open(dev->path))) {
+	struct probe *p;
+
+	if(!(p = malloc(sizeof *p))) {
+		perror("failed to allocate serial device probe");
+		return -1;
+	}
+	memset(p, 0, sizeof *p);
+
+	if((dev->fd = smag_open_device(dev->path)) == -1) {
+		fprintf(stderr, "failed to open serial device %s: %s\n", dev->path, strerror(errno));
+		free(p);
+		return -1;
+	}
+	if(smag_set_port_spaceball(dev->fd) == -1) {
+		close(dev->fd);
+		dev->fd = -1;
+		free(p);
 		return -1;
 	}
-	dev->fd = sball_get_fd(dev->data);
+	p->state = PROBE_SBALL;
 
-	dev->close = close_dev_serial;
-	dev->read = read_dev_serial;
+	dev->data = p;
+	dev->probing = 1;
+	dev->read = read_probe;
+	dev->close = close_probe;
+	dev->tick = tick_probe;
+	dev->timer = dev_time_msec() + SBALL_WAIT_MSEC;
+
+	printf("detecting serial device %d: %s\n", dev->id, dev->path);
 	return 0;
 }
 
+/* never returns any input, only drives the detection */
+static int read_probe(struct device *dev, struct dev_input *inp)
+{
+	int i, sz;
+	char buf[64];
+	struct probe *p = dev->data;
+
+	if((sz = read(dev->fd, buf, sizeof buf)) <= 0) {
+		if(sz == -1 && errno != EAGAIN && errno != EINTR) {
+			perror("serial device read error");
+			dev->failed = 1;
+		}
+		return -1;
+	}
+
+	if(p->state == PROBE_SBALL) {
+		attach(dev, TYPE_SBALL);
+		return -1;
+	}
+
+	/* the device may answer the version query before the delay after sending
+	 * it is over, so collect the reply from the last flush onwards. Anything
+	 * other than the version string ('v' line) is junk.
+	 */
+	if(p->got_reply) {
+		return -1;
+	}
+	for(i=0; i<sz; i++) {
+		if(buf[i] == '\r' || buf[i] == '\n') {
+			if(p->reply_len && p->reply[0] == 'v') {
+				p->got_reply = 1;
+				if(p->step->type == STEP_REPLY) {
+					next_step(p);
+					run_probe(dev);
+				}
+				return -1;
+			}
+			p->reply_len = 0;
+		} else if(p->reply_len < (int)sizeof p->reply - 1) {
+			p->reply[p->reply_len++] = buf[i];
+			p->reply[p->reply_len] = 0;
+		}
+	}
+	return -1;
+}
+
+static void close_probe(struct device *dev)
+{
+	if(dev->fd != -1) {
+		close(dev->fd);
+		dev->fd = -1;
+	}
+	free(dev->data);
+	dev->data = 0;
+}
+
+static void tick_probe(struct device *dev)
+{
+	struct probe *p = dev->data;
+
+	if(p->state == PROBE_SBALL) {
+		start_smag_probe(dev);
+	} else {
+		run_probe(dev);
+	}
+}
+
+static void start_smag_probe(struct device *dev)
+{
+	struct probe *p = dev->data;
+
+	if(dev->core->verbose) {
+		printf("no spaceball on %s, trying magellan\n", dev->path);
+	}
+
+	close(dev->fd);
+	if((dev->fd = smag_open_device(dev->path)) == -1 || smag_set_port_magellan(dev->fd) == -1) {
+		fprintf(stderr, "failed to re-open serial device %s\n", dev->path);
+		dev->failed = 1;
+		return;
+	}
+	p->state = PROBE_SMAG;
+	p->step = smag_steps;
+	p->started = 0;
+	run_probe(dev);
+}
+
+/* executes the magellan probe steps, until one of them has to wait */
+static void run_probe(struct device *dev)
+{
+	struct probe *p = dev->data;
+	const struct smag_cmd *cmd;
+
+	for(;;) {
+		switch(p->step->type) {
+		case STEP_WAIT:
+		case STEP_REPLY:
+			if(p->step->type == STEP_REPLY && p->got_reply) {
+				next_step(p);
+				break;
+			}
+			if(!p->started) {
+				p->started = 1;
+				dev->timer = dev_time_msec() + p->step->msec;
+				return;
+			}
+			/* timed out */
+			if(p->step->type == STEP_REPLY) {
+				if(dev->core->verbose) {
+					printf("no response from %s, assuming spaceball\n", dev->path);
+				}
+				attach(dev, TYPE_SBALL);
+				return;
+			}
+			next_step(p);
+			break;
+
+		case STEP_SEND:
+			cmd = p->step->cmd + p->cmd;
+			if(!cmd->str) {
+				next_step(p);
+				break;
+			}
+			/* the device needs time between characters, and after commands */
+			if(p->pos < cmd->len) {
+				write(dev->fd, cmd->str + p->pos++, 1);
+				dev->timer = dev_time_msec() + (SMAG_DELAY_USEC + 999) / 1000;
+			} else {
+				write(dev->fd, "\r", 1);
+				p->cmd++;
+				p->pos = 0;
+				dev->timer = dev_time_msec() + SMAG_CMD_DELAY_MSEC;
+			}
+			return;
+
+		case STEP_FLUSH:
+			tcflush(dev->fd, TCIOFLUSH);
+			p->reply_len = p->got_reply = 0;
+			next_step(p);
+			break;
+
+		case STEP_DONE:
+		default:
+			attach(dev, TYPE_SMAG);
+			return;
+		}
+	}
+}
+
+static void next_step(struct probe *p)
+{
+	if(p->step->type == STEP_REPLY && p->got_reply) {
+		printf("magellan version: %s\n", p->reply + 1);
+	}
+	p->step++;
+	p->started = 0;
+	p->cmd = p->pos = 0;
+}
+
+/* hands the port over to the driver of the detected device */
+static void attach(struct device *dev, int type)
+{
+	struct smag *mag;
+
+	dev->timer = 0;
+	dev->tick = 0;
+
+	if(type == TYPE_SBALL) {
+		/* the spaceball driver opens the port itself */
+		close_probe(dev);
+		dev->close = close_dev_serial;
+		dev->read = read_dev_serial;
+
+		if(!(dev->data = sball_open(dev->path))) {
+			fprintf(stderr, "failed to open serial device %s\n", dev->path);
+			dev->failed = 1;
+			return;
+		}
+		dev->fd = sball_get_fd(dev->data);
+		dev->motion_range = SBALL_MAX_VALUE;
+		strcpy(dev->name, "Spaceball (serial)");
+
+	} else {
+		if(!(mag = smag_create(dev->fd))) {
+			perror("failed to allocate magellan device");
+			dev->failed = 1;
+			return;
+		}
+		free(dev->data);
+		dev->data = mag;
+		dev->close = close_dev_smag;
+		dev->read = read_dev_smag;
+		dev->motion_range = SMAG_MAX_VALUE;
+		strcpy(dev->name, "Magellan (serial)");
+	}
+	dev->probing = 0;
+
+	if(dev->core->cfg->serial_lowlat) {
+		set_serial_low_latency(dev);
+	}
+
+	printf("using device %d: %s (%s)\n", dev->id, dev->path, dev->name);
+	device_attached(dev);
+	if(dev->core->threaded && !dev->core->suspended) {
+		start_dev_thread(dev);
+	}
+}
+
+int get_serial_stats(struct device *dev, struct serial_stats *st)
+{
+	if(!dev->data) {
+		return -1;
+	}
+	if(dev->read == read_dev_serial) {
+		sball_get_stats(dev->data, st);
+		return 0;
+	}
+	if(dev->read == read_dev_smag) {
+		smag_get_stats(dev->data, st);
+		return 0;
+	}
+	return -1;
+}
+
+/* Serial drivers normally hold on to the input for a while, to pass it on in
+ * bigger chunks. Ask for every byte to be delivered as soon as it arrives.
+ */
+static void set_serial_low_latency(struct device *dev)
+{
+#if defined(__linux__) && defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+	struct serial_struct ser;
+
+	if(ioctl(dev->fd, TIOCGSERIAL, &ser) == -1) {
+		/* not a real serial port (pty, some usb adaptors) */
+		if(dev->core->verbose) {
+			printf("%s: low-latency mode not supported\n", dev->path);
+		}
+		return;
+	}
+	if(ser.flags & ASYNC_LOW_LATENCY) {
+		return;
+	}
+	ser.flags |= ASYNC_LOW_LATENCY;
+	if(ioctl(dev->fd, TIOCSSERIAL, &ser) == -1) {
+		fprintf(stderr, "%s: failed to set low-latency mode: %s\n", dev->path, strerror(errno));
+	} else if(dev->core->verbose) {
+		printf("%s: low-latency mode enabled\n", dev->path);
+	}
+#endif
+}
+
 static void close_dev_serial(struct device *dev)
 {
 	if(dev->data) {
 		sball_close(dev->data);
 	}
 	dev->data = 0;
+	dev->fd = -1;
 }
 
 static int read_dev_serial(struct device *dev, struct dev_input *inp)
@@ -52,3 +404,20 @@ static int read_dev_serial(struct device *dev, struct dev_input *inp)
 	}
 	return 0;
 }
+
+static void close_dev_smag(struct device *dev)
+{
+	if(dev->data) {
+		smag_destroy(dev->data);
+	}
+	dev->data = 0;
+	dev->fd = -1;
+}
+
+static int read_dev_smag(struct device *dev, struct dev_input *inp)
+{
+	if(!dev->data || !smag_get_input(dev->data, inp)) {
+		return -1;
+	}
+	return 0;
+}
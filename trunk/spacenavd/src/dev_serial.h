@@ -21,6 +21,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 struct device;
 
+/* protocol parser counters of a serial device. Malformed input is counted
+ * and skipped, the parsers resynchronize at the next packet.
+ */
+struct serial_stats {
+	unsigned long bytes, packets;
+	unsigned long bad_packets;	/* failed checks (escapes, parity, checksum, length) */
+	unsigned long unknown;		/* unknown packet types, skipped */
+	unsigned long overruns;		/* packets too long, discarded */
+	unsigned long dev_errors;	/* error packets sent by the device */
+	unsigned long resets;		/* device resets */
+	unsigned long dropped;		/* input dropped because the queue was full */
+};
+
+/* opens a serial port, and starts detecting the device on it (spaceball or
+ * magellan) in the background. The device is marked as probing until then.
+ */
 int open_dev_serial(struct device *dev);
 
+/* returns -1 if dev is not an attached serial device */
+int get_serial_stats(struct device *dev, struct serial_stats *st);
+
 #endif	/* SPNAV_DEV_SERIAL_H_ */
@@ -0,0 +1,238 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include "dev_thread.h"
+#include "core_impl.h"
+#include "ringbuf.h"
+
+/* inputs buffered per device; a full ring stalls the reader thread */
+#define DEV_RING_SIZE	512
+
+struct dev_thread {
+	struct device *dev;
+	pthread_t thread;
+	struct ringbuf ring;
+	int stop_pipe[2];
+	int failed;
+};
+
+static void *thread_func(void *arg);
+static void wake(struct spnav_core *core);
+
+
+int init_dev_threads(struct spnav_core *core)
+{
+	if(core->wake_fd[0] != -1) {
+		return 0;
+	}
+
+#ifdef __linux__
+	if((core->wake_fd[0] = eventfd(0, EFD_NONBLOCK)) != -1) {
+		core->wake_fd[1] = core->wake_fd[0];
+		return 0;
+	}
+#endif
+	if(pipe(core->wake_fd) == -1) {
+		perror("failed to create the device threads wake pipe");
+		core->wake_fd[0] = core->wake_fd[1] = -1;
+		return -1;
+	}
+	fcntl(core->wake_fd[0], F_SETFL, fcntl(core->wake_fd[0], F_GETFL) | O_NONBLOCK);
+	fcntl(core->wake_fd[1], F_SETFL, fcntl(core->wake_fd[1], F_GETFL) | O_NONBLOCK);
+	return 0;
+}
+
+void destroy_dev_threads(struct spnav_core *core)
+{
+	if(core->wake_fd[0] == -1) {
+		return;
+	}
+	if(core->wake_fd[1] != core->wake_fd[0]) {
+		close(core->wake_fd[1]);
+	}
+	close(core->wake_fd[0]);
+	core->wake_fd[0] = core->wake_fd[1] = -1;
+}
+
+int get_dev_threads_fd(struct spnav_core *core)
+{
+	return core->wake_fd[0];
+}
+
+int start_dev_thread(struct device *dev)
+{
+	int res;
+	struct dev_thread *thr;
+
+	/* network devices are just a non-blocking socket, nothing to gain */
+	if(dev->thread || dev->probing || dev->remote) {
+		return 0;
+	}
+	if(init_dev_threads(dev->core) == -1) {
+		return -1;
+	}
+
+	if(!(thr = malloc(sizeof *thr))) {
+		perror("failed to allocate device thread");
+		return -1;
+	}
+	memset(thr, 0, sizeof *thr);
+	thr->dev = dev;
+
+	if(rb_init(&thr->ring, DEV_RING_SIZE, sizeof(struct dev_input)) == -1) {
+		perror("failed to allocate device input ring");
+		free(thr);
+		return -1;
+	}
+	if(pipe(thr->stop_pipe) == -1) {
+		perror("failed to create device thread pipe");
+		rb_destroy(&thr->ring);
+		free(thr);
+		return -1;
+	}
+
+	if((res = pthread_create(&thr->thread, 0, thread_func, thr)) != 0) {
+		fprintf(stderr, "failed to start the reader thread of %s: %s\n", dev->path, strerror(res));
+		close(thr->stop_pipe[0]);
+		close(thr->stop_pipe[1]);
+		rb_destroy(&thr->ring);
+		free(thr);
+		return -1;
+	}
+	dev->thread = thr;
+
+	if(dev->core->verbose) {
+		printf("started reader thread for device %d: %s\n", dev->id, dev->path);
+	}
+	return 0;
+}
+
+void stop_dev_thread(struct device *dev)
+{
+	struct dev_thread *thr = dev->thread;
+
+	if(!thr) return;
+
+	write(thr->stop_pipe[1], "", 1);
+	pthread_join(thr->thread, 0);
+	dev->thread = 0;
+
+	close(thr->stop_pipe[0]);
+	close(thr->stop_pipe[1]);
+	rb_destroy(&thr->ring);
+	free(thr);
+}
+
+void clear_dev_threads_wake(struct spnav_core *core)
+{
+	char buf[64];
+	while(read(core->wake_fd[0], buf, sizeof buf) > 0);
+}
+
+int get_dev_thread_input(struct device *dev, struct dev_input *inp)
+{
+	struct dev_thread *thr = dev->thread;
+	return thr ? rb_pop(&thr->ring, inp) : -1;
+}
+
+int dev_thread_failed(struct device *dev)
+{
+	struct dev_thread *thr = dev->thread;
+	return thr ? __atomic_load_n(&thr->failed, __ATOMIC_ACQUIRE) : 0;
+}
+
+static void *thread_func(void *arg)
+{
+	struct dev_thread *thr = arg;
+	struct device *dev = thr->dev;
+	struct dev_input inp;
+	struct pollfd pfd[2];
+	int num_read;
+
+	pfd[0].fd = thr->stop_pipe[0];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = get_device_fd(dev);
+	pfd[1].events = POLLIN;
+
+	for(;;) {
+		if(poll(pfd, 2, -1) == -1) {
+			if(errno == EINTR) continue;
+			perror("device thread poll failed");
+			break;
+		}
+		if(pfd[0].revents) {
+			return 0;	/* asked to stop */
+		}
+		if(!pfd[1].revents) {
+			continue;
+		}
+
+		num_read = 0;
+		while(read_device(dev, &inp) != -1) {
+			while(rb_push(&thr->ring, &inp) == -1) {
+				/* the processing thread is behind, let it catch up */
+				wake(dev->core);
+				if(poll(pfd, 1, 1) > 0) {
+					return 0;
+				}
+			}
+			num_read++;
+		}
+
+		if(dev->failed) {
+			break;
+		}
+		if(num_read) {
+			wake(dev->core);
+		} else if(pfd[1].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			break;
+		}
+	}
+
+	/* the device is gone, the processing thread will remove it */
+	__atomic_store_n(&thr->failed, 1, __ATOMIC_RELEASE);
+	wake(dev->core);
+
+	/* wait to be stopped */
+	while(poll(pfd, 1, -1) <= 0 || !pfd[0].revents);
+	return 0;
+}
+
+static void wake(struct spnav_core *core)
+{
+#ifdef __linux__
+	if(core->wake_fd[0] == core->wake_fd[1]) {
+		uint64_t one = 1;
+		write(core->wake_fd[1], &one, sizeof one);
+		return;
+	}
+#endif
+	write(core->wake_fd[1], "", 1);
+}
@@ -0,0 +1,50 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DEV_THREAD_H_
+#define DEV_THREAD_H_
+
+/* Threaded device mode (internal to the core library).
+ *
+ * Each device gets a reader thread which waits on the device, reads and
+ * parses its input, and hands the results to the thread processing the
+ * input through a single producer/single consumer ring. The processing
+ * thread is woken through the core's wake descriptor (an eventfd on
+ * GNU/Linux, a pipe elsewhere).
+ */
+
+struct spnav_core;
+struct device;
+struct dev_input;
+
+/* create/destroy the wake descriptor of the core */
+int init_dev_threads(struct spnav_core *core);
+void destroy_dev_threads(struct spnav_core *core);
+int get_dev_threads_fd(struct spnav_core *core);
+
+int start_dev_thread(struct device *dev);
+void stop_dev_thread(struct device *dev);
+
+/* called by the processing thread when the wake descriptor is readable */
+void clear_dev_threads_wake(struct spnav_core *core);
+
+/* pops the next input read by the thread of dev, returns -1 if there is none */
+int get_dev_thread_input(struct device *dev, struct dev_input *inp);
+/* non-zero if the reader thread stopped because the device failed */
+int dev_thread_failed(struct device *dev);
+
+#endif	/* DEV_THREAD_H_ */
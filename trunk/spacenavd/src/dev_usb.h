@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define SPNAV_DEV_USB_H_
 
 struct device;
+struct spnav_core;
 
 int open_dev_usb(struct device *dev);
 
@@ -33,7 +34,14 @@ struct usb_device_info {
 	struct usb_device_info *next;
 };
 
-struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_info*));
+/* match is called with the core to decide which devices to include */
+struct usb_device_info *find_usb_devices(struct spnav_core *core,
+		int (*match)(struct spnav_core*, const struct usb_device_info*));
+#ifdef __linux__
+/* the part of find_usb_devices parsing /proc/bus/input/devices, or path */
+struct usb_device_info *find_usb_devices_proc(struct spnav_core *core, const char *path,
+		int (*match)(struct spnav_core*, const struct usb_device_info*));
+#endif
 void free_usb_devices_list(struct usb_device_info *list);
 void print_usb_device_info(struct usb_device_info *devinfo);
 
@@ -23,13 +23,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <IOKit/hid/IOHIDLib.h>
 #include "dev.h"
 #include "dev_usb.h"
+#include "core_impl.h"
 
 int open_dev_usb(struct device *dev)
 {
 	return -1;
 }
 
-struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_info*))
+struct usb_device_info *find_usb_devices(struct spnav_core *core,
+		int (*match)(struct spnav_core*, const struct usb_device_info*))
 {
 	struct usb_device_info *devlist = 0;
 	struct usb_device_info devinfo;
@@ -66,10 +68,10 @@ struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_in
 
 		/* TODO retrieve vendor id and product id */
 
-		if(!match || match(&devinfo)) {
+		if(!match || match(core, &devinfo)) {
 			struct usb_device_info *node = malloc(sizeof *node);
 			if(node) {
-				if(verbose) {
+				if(core->verbose) {
 					printf("found usb device: ");
 					print_usb_device_info(&devinfo);
 				}
@@ -31,9 +31,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <linux/input.h>
 #include "dev.h"
 #include "dev_usb.h"
-#include "spnavd.h"
+#include "core_impl.h"
 #include "event.h"
 #include "hotplug.h"
+#include "probes.h"
 
 #define DEF_MINVAL	(-500)
 #define DEF_MAXVAL	500
@@ -59,6 +60,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 static void close_evdev(struct device *dev);
 static int read_evdev(struct device *dev, struct dev_input *inp);
+static void feed_evdev(struct device *dev, const void *data, int size);
+static void resync_evdev(struct device *dev);
+static int evdev_input(struct device *dev, const struct input_event *iev, struct dev_input *inp);
 static void set_led_evdev(struct device *dev, int state);
 
 
@@ -83,6 +87,7 @@ int open_dev_usb(struct device *dev)
 	printf("device name: %s\n", dev->name);
 
 	/* get number of axes */
+	dev->motion_range = DEF_MAXVAL;	/* see map_range */
 	dev->num_axes = 6;	/* default to regular 6dof controller axis count */
 	if(ioctl(dev->fd, EVIOCGBIT(EV_ABS, sizeof evtype_mask), evtype_mask) == 0) {
 		dev->num_axes = 0;
@@ -97,7 +102,7 @@ int open_dev_usb(struct device *dev)
 			}
 		}
 	}
-	if(verbose) {
+	if(dev->core->verbose) {
 		printf("  Number of axes: %d\n", dev->num_axes);
 	}
 
@@ -121,7 +126,7 @@ int open_dev_usb(struct device *dev)
 			dev->maxval[i] = absinfo.maximum;
 			dev->fuzz[i] = absinfo.fuzz;
 
-			if(verbose) {
+			if(dev->core->verbose) {
 				printf("  Axis %d value range: %d - %d (fuzz: %d)\n", i, dev->minval[i], dev->maxval[i], dev->fuzz[i]);
 			}
 		}
@@ -133,7 +138,7 @@ int open_dev_usb(struct device *dev)
 		return -1;
 	}*/
 
-	if(cfg.grab_device) {
+	if(dev->core->cfg->grab_device) {
 		int grab = 1;
 		/* try to grab the device */
 		if(ioctl(dev->fd, EVIOCGRAB, &grab) == -1) {
@@ -144,13 +149,15 @@ int open_dev_usb(struct device *dev)
 	/* set non-blocking */
 	fcntl(dev->fd, F_SETFL, fcntl(dev->fd, F_GETFL) | O_NONBLOCK);
 
-	if(cfg.led) {
+	if(dev->core->cfg->led) {
 		set_led_evdev(dev, 1);
 	}
 
 	/* fill the device function pointers */
 	dev->close = close_evdev;
 	dev->read = read_evdev;
+	dev->feed = feed_evdev;
+	dev->resync = resync_evdev;
 	dev->set_led = set_led_evdev;
 
 	return 0;
@@ -181,11 +188,13 @@ static INLINE int map_range(struct device *dev, int axidx, int val)
 static int read_evdev(struct device *dev, struct dev_input *inp)
 {
 	struct input_event iev;	/* linux evdev event */
-	int rdbytes;
+	int rdbytes, res = 0;
 
 	if(!IS_DEV_OPEN(dev))
 		return -1;
 
+	PROBE1(read_evdev_entry, dev->id);
+
 	do {
 		rdbytes = read(dev->fd, &iev, sizeof iev);
 	} while(rdbytes == -1 && errno == EINTR);
@@ -194,46 +203,118 @@ static int read_evdev(struct device *dev, struct dev_input *inp)
 	if(rdbytes == -1) {
 		if(errno != EAGAIN) {
 			perror("read error");
-			remove_device(dev);
+			dev->failed = 1;
 		}
-		return -1;
+		res = -1;
+	} else if(rdbytes > 0) {
+		res = evdev_input(dev, &iev, inp);
 	}
 
-	if(rdbytes > 0) {
-		inp->tm = iev.time;
+	PROBE2(read_evdev_return, dev->id, res);
+	return res;
+}
 
-		switch(iev.type) {
-		case EV_REL:
-			inp->type = INP_MOTION;
-			inp->idx = iev.code - REL_X;
-			inp->val = iev.value;
-			/*printf("[%s] EV_REL(%d): %d\n", dev->name, inp->idx, iev.value);*/
-			break;
+static void feed_evdev(struct device *dev, const void *data, int size)
+{
+	struct input_event iev;
+	struct dev_input inp;
+	const char *ptr = data;
+
+	while(size >= (int)sizeof iev) {
+		memcpy(&iev, ptr, sizeof iev);
+		if(evdev_input(dev, &iev, &inp) != -1) {
+			process_input(dev, &inp);
+		}
+		ptr += sizeof iev;
+		size -= sizeof iev;
+	}
+}
 
-		case EV_ABS:
-			inp->type = INP_MOTION;
-			inp->idx = iev.code - ABS_X;
-			inp->val = map_range(dev, inp->idx, iev.value);
-			/*printf("[%s] EV_ABS(%d): %d (orig: %d)\n", dev->name, inp->idx, inp->val, iev.value);*/
-			break;
+static void resync_evdev(struct device *dev)
+{
+	int i, rdbytes;
+	struct input_event iev[64];
+	struct input_absinfo absinfo;
+	unsigned char keys[(KEY_MAX + 7) / 8];
+	struct dev_input inp;
 
-		case EV_KEY:
-			inp->type = INP_BUTTON;
-			inp->idx = iev.code - BTN_0;
-			inp->val = iev.value;
-			break;
+	if(!IS_DEV_OPEN(dev))
+		return;
 
-		case EV_SYN:
-			inp->type = INP_FLUSH;
-			/*printf("[%s] EV_SYN\n", dev->name);*/
-			break;
+	/* whatever is queued is stale, and has probably overflowed the evdev
+	 * buffer anyway.
+	 */
+	while((rdbytes = read(dev->fd, iev, sizeof iev)) > 0 || (rdbytes == -1 && errno == EINTR));
+	if(rdbytes == -1 && errno != EAGAIN) {
+		perror("read error");
+		dev->failed = 1;
+		return;
+	}
 
-		default:
-			return -1;
+	memset(&inp, 0, sizeof inp);
+
+	/* absolute axes report their current position, relative ones are at rest */
+	inp.type = INP_MOTION;
+	for(i=0; i<6 || i<dev->num_axes; i++) {
+		inp.idx = i;
+		inp.val = 0;
+		if(i < dev->num_axes && ioctl(dev->fd, EVIOCGABS(i), &absinfo) == 0) {
+			inp.val = map_range(dev, i, absinfo.value);
 		}
+		process_input(dev, &inp);
 	}
-	return 0;
+	inp.type = INP_FLUSH;
+	process_input(dev, &inp);
+
+	/* and any buttons held down */
+	if(ioctl(dev->fd, EVIOCGKEY(sizeof keys), keys) != -1) {
+		inp.type = INP_BUTTON;
+		inp.val = 1;
+		for(i=0; i<MAX_BUTTONS && BTN_0 + i <= KEY_MAX; i++) {
+			int code = BTN_0 + i;
+			if(keys[code / 8] & (1 << (code % 8))) {
+				inp.idx = i;
+				process_input(dev, &inp);
+			}
+		}
+	}
+}
 
+/* converts an evdev event to a device input, returns -1 for ignored events */
+static int evdev_input(struct device *dev, const struct input_event *iev, struct dev_input *inp)
+{
+	inp->tm = iev->time;
+
+	switch(iev->type) {
+	case EV_REL:
+		inp->type = INP_MOTION;
+		inp->idx = iev->code - REL_X;
+		inp->val = iev->value;
+		/*printf("[%s] EV_REL(%d): %d\n", dev->name, inp->idx, iev->value);*/
+		break;
+
+	case EV_ABS:
+		inp->type = INP_MOTION;
+		inp->idx = iev->code - ABS_X;
+		inp->val = map_range(dev, inp->idx, iev->value);
+		/*printf("[%s] EV_ABS(%d): %d (orig: %d)\n", dev->name, inp->idx, inp->val, iev->value);*/
+		break;
+
+	case EV_KEY:
+		inp->type = INP_BUTTON;
+		inp->idx = iev->code - BTN_0;
+		inp->val = iev->value;
+		break;
+
+	case EV_SYN:
+		inp->type = INP_FLUSH;
+		/*printf("[%s] EV_SYN\n", dev->name);*/
+		break;
+
+	default:
+		return -1;
+	}
+	return 0;
 }
 
 static void set_led_evdev(struct device *dev, int state)
@@ -253,30 +334,27 @@ static void set_led_evdev(struct device *dev, int state)
 	}
 }
 
-#define PROC_DEV	"/proc/bus/input/devices"
-struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_info*))
+/* parses a file in the /proc/bus/input/devices format */
+struct usb_device_info *find_usb_devices_proc(struct spnav_core *core, const char *path,
+		int (*match)(struct spnav_core*, const struct usb_device_info*))
 {
 	struct usb_device_info *devlist = 0, devinfo;
 	int buf_used, buf_len, bytes_read;
 	char buf[1024];
 	char *buf_pos, *section_start, *next_section = 0, *cur_line, *next_line;
 	FILE *fp;
-	DIR *dir;
-	struct dirent *dent;
 
-	if(verbose) {
-		printf("Device detection, parsing " PROC_DEV "\n");
+	if(core->verbose) {
+		printf("Device detection, parsing %s\n", path);
 	}
 
-	devlist = 0;
-
 	buf_pos = buf;
 	buf_len = sizeof(buf) - 1;
-	if(!(fp = fopen(PROC_DEV, "r"))) {
-		if(verbose) {
-			perror("failed to open " PROC_DEV);
+	if(!(fp = fopen(path, "r"))) {
+		if(core->verbose) {
+			fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
 		}
-		goto alt_detect;
+		return 0;
 	}
 
 	while((bytes_read = fread(buf_pos, 1, buf_len, fp)) >= 0) {
@@ -364,11 +442,11 @@ struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_in
 			/* check with the user-supplied matching callback to see if we should include
 			 * this device in the returned list or not...
 			 */
-			if(!match || match(&devinfo)) {
+			if(!match || match(core, &devinfo)) {
 				/* add it to the list */
 				struct usb_device_info *node = malloc(sizeof *node);
 				if(node) {
-					if(verbose) {
+					if(core->verbose) {
 						printf("found usb device [%x:%x]: \"%s\" (%s) \n", devinfo.vendorid, devinfo.productid,
 								devinfo.name ? devinfo.name : "unknown", devinfo.devfiles[0]);
 					}
@@ -397,14 +475,24 @@ struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_in
 			break;
 	}
 	fclose(fp);
+	return devlist;
+}
+
+#define PROC_DEV	"/proc/bus/input/devices"
+struct usb_device_info *find_usb_devices(struct spnav_core *core,
+		int (*match)(struct spnav_core*, const struct usb_device_info*))
+{
+	struct usb_device_info *devlist, devinfo;
+	char buf[1024];
+	DIR *dir;
+	struct dirent *dent;
 
-	if(devlist) {
+	if((devlist = find_usb_devices_proc(core, PROC_DEV, match))) {
 		return devlist;
 	}
 	/* otherwise try the alternative detection in case it finds something... */
 
-alt_detect:
-	if(verbose) {
+	if(core->verbose) {
 		fprintf(stderr, "trying alternative detection, querying /dev/input/ devices...\n");
 	}
 
@@ -431,7 +519,7 @@ alt_detect:
 		sprintf(devinfo.devfiles[0], "/dev/input/%s", dent->d_name);
 		devinfo.num_devfiles = 1;
 
-		if(verbose) {
+		if(core->verbose) {
 			fprintf(stderr, "  trying \"%s\" ... ", devinfo.devfiles[0]);
 		}
 
@@ -460,10 +548,10 @@ alt_detect:
 			}
 		}
 
-		if(!match || match(&devinfo)) {
+		if(!match || match(core, &devinfo)) {
 			struct usb_device_info *node = malloc(sizeof *node);
 			if(node) {
-				if(verbose) {
+				if(core->verbose) {
 					printf("found usb device [%x:%x]: \"%s\" (%s) \n", devinfo.vendorid, devinfo.productid,
 							devinfo.name ? devinfo.name : "unknown", devinfo.devfiles[0]);
 				}
@@ -24,7 +24,8 @@ static const char *message =
 	"Unfortunately this version of spacenavd does not support USB devices on your "
 	"platform yet. Make sure you are using the latest version of spacenavd.\n";
 
-struct usb_device_info *find_usb_devices(int (*match)(const struct usb_device_info*))
+struct usb_device_info *find_usb_devices(struct spnav_core *core,
+		int (*match)(struct spnav_core*, const struct usb_device_info*))
 {
 	fputs(message, stderr);
 	return 0;
@@ -19,238 +19,175 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "core.h"
 #include "event.h"
 #include "client.h"
 #include "proto_unix.h"
+#include "proto.h"
+#include "stats.h"
+#include "xform.h"
 #include "spnavd.h"
+#include "kbemu.h"
+#include "proto_uinput.h"
+#include "proto_net.h"
+#include "flightrec.h"
+#include "probes.h"
 
 #ifdef USE_X11
 #include "proto_x11.h"
-#include "kbemu.h"
 #endif
 
-enum {
-	MOT_X, MOT_Y, MOT_Z,
-	MOT_RX, MOT_RY, MOT_RZ
-};
-
-struct dev_event {
-	spnav_event event;
-	struct timeval timeval;
-	struct device *dev;
-	int pending;
-	struct dev_event *next;
-};
-
-static struct dev_event *add_dev_event(struct device *dev);
-static struct dev_event *device_event_in_use(struct device *dev);
-static void dispatch_event(struct dev_event *dev);
-static void send_event(spnav_event *ev, struct client *c);
-static unsigned int msec_dif(struct timeval tv1, struct timeval tv2);
+static int filter_input(struct device *dev, struct dev_input *inp, void *cls);
+static void dispatch_event(struct device *dev, spnav_event *event, void *cls);
+static void send_event(spnav_event *ev, struct client *c, unsigned long long ftime);
+static void record_input_delay(const struct timeval *tm);
 
-static struct dev_event *dev_ev_list = NULL;
-
-static struct dev_event *add_dev_event(struct device *dev)
+void init_dispatch(struct spnav_core *core)
 {
-	struct dev_event *dev_ev, *iter;
-	int i;
+	spnav_core_set_event_func(core, dispatch_event, 0);
+	spnav_core_set_input_func(core, filter_input, 0);
+}
 
-	if((dev_ev = malloc(sizeof *dev_ev)) == NULL) {
-		return NULL;
+static int filter_input(struct device *dev, struct dev_input *inp, void *cls)
+{
+	/* once per input report, record how long it took us to get to it */
+	if(inp->type == INP_FLUSH && (inp->tm.tv_sec || inp->tm.tv_usec)) {
+		record_input_delay(&inp->tm);
 	}
 
-	dev_ev->event.motion.data = (int*)&dev_ev->event.motion.x;
-	for(i=0; i<6; i++)
-		dev_ev->event.motion.data[i] = 0;
-	gettimeofday(&dev_ev->timeval, 0);
-	dev_ev->dev = dev;
-	dev_ev->next = NULL;
-
-	if(dev_ev_list == NULL)
-		return dev_ev_list = dev_ev;
-
-	iter = dev_ev_list;
-	while(iter->next) {
-		iter = iter->next;
+	/* check to see if we must emulate a keyboard event instead of a
+	 * regular button event for this button
+	 */
+	if(inp->type == INP_BUTTON) {
+		return kbemu_button(inp->idx, inp->val);
 	}
-	iter->next = dev_ev;
-	return dev_ev;
+	return 0;
 }
 
-/* remove_dev_event takes a device pointer as argument so that upon removal of
- * a device the pending event (if any) can be removed.
- */
-void remove_dev_event(struct device *dev)
+static void dispatch_event(struct device *dev, spnav_event *event, void *cls)
 {
-	struct dev_event dummy;
-	struct dev_event *iter;
+	static unsigned int ev_serial;
+	struct client **subs;
+	int i, num_subs, throttle;
+	unsigned int evbit, gen;
+	unsigned long long now = 0, ftime;
+	spnav_event pending, xformed;
+
+	if(event->type == EVENT_MOTION) {
+		evbit = EVMASK_MOTION;
+	} else {
+		evbit = event->button.press ? EVMASK_PRESS : EVMASK_RELEASE;
+	}
 
-	dummy.next = dev_ev_list;
-	iter = &dummy;
+	if(++ev_serial == 0) ev_serial = 1;
 
-	while(iter->next) {
-		if(iter->next->dev == dev) {
-			struct dev_event *ev = iter->next;
-			iter->next = ev->next;
+	PROBE2(dispatch_start, dev->id, event->type);
 
-			if(verbose) {
-				printf("removing pending device event of: %s\n", dev->path);
-			}
-			free(ev);
-		} else {
-			iter = iter->next;
-		}
+	/* one timestamp for the event and its dispatching to all clients */
+	ftime = frec_time();
+	if(event->type == EVENT_MOTION) {
+		frec_record_at(ftime, FREC_EVENT, dev->id, EVENT_MOTION, event->motion.period, 0);
+	} else {
+		frec_record_at(ftime, FREC_EVENT, dev->id, EVENT_BUTTON, event->button.bnum, event->button.press);
 	}
-	dev_ev_list = dummy.next;
-}
 
-static struct dev_event *device_event_in_use(struct device *dev)
-{
-	struct dev_event *iter = dev_ev_list;
-	while(iter) {
-		if(iter->dev == dev) {
-			return iter;
-		}
-		iter = iter->next;
+	if((throttle = any_client_rate_limited())) {
+		now = get_time_usec();
 	}
-	return NULL;
-}
-
-/* process_input processes an device input event, and dispatches
- * spacenav events to the clients by calling dispatch_event.
- * relative inputs (INP_MOTION) are accumulated, and dispatched when
- * we get an INP_FLUSH event. Button events are dispatched immediately
- * and they implicitly flush any pending motion event.
- */
-void process_input(struct device *dev, struct dev_input *inp)
-{
-	int sign;
-	struct dev_event *dev_ev;
 
-	switch(inp->type) {
-	case INP_MOTION:
-		if(abs(inp->val) < cfg.dead_threshold[inp->idx] ) {
-			inp->val = 0;
+	/* sending to a client may cause other clients to be removed (X errors),
+	 * in which case the subscriber list is rebuilt and we carry on with the
+	 * clients which haven't received this event yet.
+	 */
+restart:
+	gen = get_clients_generation();
+	subs = get_device_clients(dev, &num_subs);
+
+	for(i=0; i<num_subs; i++) {
+		struct client *c = subs[i];
+		struct xform *xf;
+		spnav_event *ev = event;
+
+		if(!(get_client_evmask(c) & evbit) || get_client_serial(c) == ev_serial) {
+			continue;
 		}
-
-		inp->idx = cfg.map_axis[inp->idx];
-		sign = cfg.invert[inp->idx] ? -1 : 1;
-
-		inp->val = (int)((float)inp->val * cfg.sensitivity * (inp->idx < 3 ? cfg.sens_trans[inp->idx] : cfg.sens_rot[inp->idx - 3]));
-
-		dev_ev = device_event_in_use(dev);
-		if(verbose && dev_ev == NULL)
-			printf("adding dev event for device: %s\n", dev->path);
-		if(dev_ev == NULL && (dev_ev = add_dev_event(dev)) == NULL) {
-			fprintf(stderr, "failed to get dev_event\n");
-			break;
+		set_client_serial(c, ev_serial);
+
+		if(evbit == EVMASK_MOTION && (xf = get_client_xform(c))) {
+			/* the result is cached in the shared transform, so clients with
+			 * identical transforms only cost a copy.
+			 */
+			const int *res = xform_apply(xf, ev->motion.data, ev_serial);
+			memcpy(&xformed, ev, sizeof xformed);
+			xformed.motion.data = &xformed.motion.x;
+			memcpy(xformed.motion.data, res, 6 * sizeof *res);
+			ev = &xformed;
 		}
-		dev_ev->event.type = EVENT_MOTION;
-		dev_ev->event.motion.data = (int*)&dev_ev->event.motion.x;
-		dev_ev->event.motion.data[inp->idx] = sign * inp->val;
-		dev_ev->pending = 1;
-		break;
 
-	case INP_BUTTON:
-#ifdef USE_X11
-		/* check to see if we must emulate a keyboard event instead of a
-		 * retular button event for this button
-		 */
-		if(cfg.kbmap_str[inp->idx]) {
-			if(!cfg.kbmap[inp->idx]) {
-				cfg.kbmap[inp->idx] = kbemu_keysym(cfg.kbmap_str[inp->idx]);
-				printf("mapping ``%s'' to keysym %d\n", cfg.kbmap_str[inp->idx], (int)cfg.kbmap[inp->idx]);
+		if(throttle) {
+			if(evbit == EVMASK_MOTION) {
+				if(!client_throttle_motion(c, ev, now)) {
+					continue;	/* coalesced, will be sent by send_pending_motion */
+				}
+			} else if(client_pending_motion(c, &pending, now, 1)) {
+				/* button events go out immediately, but after any motion before them */
+				send_event(&pending, c, ftime);
+				if(get_clients_generation() != gen) {
+					set_client_serial(c, 0);
+					goto restart;
+				}
 			}
-			send_kbevent(cfg.kbmap[inp->idx], inp->val);
-			break;
-		}
-#endif
-		dev_ev = device_event_in_use(dev);
-		if(dev_ev && dev_ev->pending) {
-			dispatch_event(dev_ev);
-			dev_ev->pending = 0;
-		}
-		inp->idx = cfg.map_button[inp->idx];
-
-		/* button events are not queued */
-		{
-			struct dev_event dev_button_event;
-			dev_button_event.dev = dev;
-			dev_button_event.event.type = EVENT_BUTTON;
-			dev_button_event.event.button.press = inp->val;
-			dev_button_event.event.button.bnum = inp->idx;
-			dispatch_event(&dev_button_event);
 		}
+		send_event(ev, c, ftime);
 
-		/* to have them replace motion events in the queue uncomment next section */
-		/* dev_ev = add_dev_event(dev);
-		 * dev_ev->event.type = EVENT_BUTTON;
-		 * dev_ev->event.button.press = inp->val;
-		 * dev_ev->event.button.bnum = inp->idx;
-		 * dispatch_event(dev_ev);
-		 */
-		break;
-
-	case INP_FLUSH:
-		dev_ev = device_event_in_use(dev);
-		if(dev_ev && dev_ev->pending) {
-			dispatch_event(dev_ev);
-			dev_ev->pending = 0;
+		if(get_clients_generation() != gen) {
+			goto restart;
 		}
-		break;
-
-	default:
-		break;
 	}
-}
 
-int in_deadzone(struct device *dev)
-{
-	int i;
-	struct dev_event *dev_ev;
-	if((dev_ev = device_event_in_use(dev)) == NULL)
-		return -1;
-	for(i=0; i<6; i++) {
-		if(dev_ev->event.motion.data[i] != 0)
-			return 0;
-	}
-	return 1;
-}
-
-void repeat_last_event(struct device *dev)
-{
-	struct dev_event *dev_ev;
-	if((dev_ev = device_event_in_use(dev)) == NULL)
-		return;
-	dispatch_event(dev_ev);
+	PROBE2(dispatch_end, dev->id, num_subs);
 }
 
-static void dispatch_event(struct dev_event *dev_ev)
+long send_pending_motion(void)
 {
 	struct client *c, *client_iter;
-	int dev_idx;
-
-	if(dev_ev->event.type == EVENT_MOTION) {
-		struct timeval tv;
-		gettimeofday(&tv, 0);
+	unsigned long long now, deadline, next = 0;
+	spnav_event ev;
 
-		dev_ev->event.motion.period = msec_dif(tv, dev_ev->timeval);
-		dev_ev->timeval = tv;
+	if(!any_client_rate_limited()) {
+		return -1;
 	}
+	now = get_time_usec();
 
-	dev_idx = get_device_index(dev_ev->dev);
 	client_iter = first_client();
 	while(client_iter) {
 		c = client_iter;
 		client_iter = next_client();
-		if(get_client_device_index(c) <= dev_idx) /* use <= until API changes, else == */
-			send_event(&dev_ev->event, c);
+
+		if(client_pending_motion(c, &ev, now, 0)) {
+			send_event(&ev, c, frec_time());
+		} else if((deadline = client_motion_deadline(c)) && (!next || deadline < next)) {
+			next = deadline;
+		}
 	}
+	return next ? (long)(next - now) : -1;
 }
 
-static void send_event(spnav_event *ev, struct client *c)
+/* ftime is the flight recorder timestamp (see frec_time) */
+static void send_event(spnav_event *ev, struct client *c, unsigned long long ftime)
 {
-	switch(get_client_type(c)) {
+	int type = get_client_type(c), id;
+
+	/* clients are identified by their socket, or window for X11 clients */
+#ifdef USE_X11
+	id = type == CLIENT_X11 ? (int)get_client_window(c) : get_client_socket(c);
+#else
+	id = get_client_socket(c);
+#endif
+	frec_record_at(ftime, FREC_DISPATCH, -1, type, id, ev->type);
+
+	switch(type) {
 #ifdef USE_X11
 	case CLIENT_X11:
 		send_xevent(ev, c);
@@ -261,16 +198,32 @@ static void send_event(spnav_event *ev, struct client *c)
 		send_uevent(ev, c);
 		break;
 
+	case CLIENT_UINPUT:
+		send_uinput_event(ev, c);
+		break;
+
+	case CLIENT_NET:
+		send_net_event(ev, c);
+		break;
+
 	default:
 		break;
 	}
 }
 
-static unsigned int msec_dif(struct timeval tv1, struct timeval tv2)
+static void record_input_delay(const struct timeval *tm)
 {
-	unsigned int ms1, ms2;
-
-	ms1 = tv1.tv_sec * 1000 + tv1.tv_usec / 1000;
-	ms2 = tv2.tv_sec * 1000 + tv2.tv_usec / 1000;
-	return ms1 - ms2;
+	struct timeval now;
+	long dt;
+
+	gettimeofday(&now, 0);
+	dt = (now.tv_sec - tm->tv_sec) * 1000000 + (now.tv_usec - tm->tv_usec);
+	if(dt < 0) return;	/* clock stepped */
+
+	stats.input_delays++;
+	stats.input_delay_usec = dt;
+	stats.input_delay_total_usec += dt;
+	if((unsigned long)dt > stats.input_delay_max_usec) {
+		stats.input_delay_max_usec = dt;
+	}
 }
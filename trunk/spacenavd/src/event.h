@@ -61,8 +61,10 @@ struct dev_input {
 	int val;
 };
 
+/* input processing, part of the core library (core.c) */
 void remove_dev_event(struct device *dev);
 
+/* processes a device input, emitting spacenav events through the core */
 void process_input(struct device *dev, struct dev_input *inp);
 
 /* non-zero if the last processed motion event was in the deadzone */
@@ -71,5 +73,16 @@ int in_deadzone(struct device *dev);
 /* dispatches the last event */
 void repeat_last_event(struct device *dev);
 
+/* daemon event dispatching (event.c) */
+struct spnav_core;
+
+/* registers the dispatching of the events of core to the clients */
+void init_dispatch(struct spnav_core *core);
+
+/* sends any rate-limited motion which is due, and returns the number of
+ * microseconds until the next client deadline, or -1 if nothing is pending.
+ */
+long send_pending_motion(void);
+
 
 #endif	/* EVENT_H_ */
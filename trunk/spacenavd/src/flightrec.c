@@ -0,0 +1,385 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "flightrec.h"
+#include "event.h"
+#include "client.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+static unsigned long long now_usec(void);
+static long long realtime_usec(void);
+
+static struct frec_header *hdr;
+static struct frec_entry *ring;
+static unsigned int ring_mask;
+static size_t map_size;
+static char map_path[PATH_MAX];
+
+
+int frec_init(int size, const char *path)
+{
+	int fd = -1;
+	unsigned int n = 1;
+	size_t sz;
+	void *mem;
+
+	if(size <= 0) {
+		frec_shutdown();
+		return 0;
+	}
+	while(n < (unsigned int)size) n <<= 1;
+
+	if(hdr && hdr->size == n && strcmp(path, map_path) == 0) {
+		return 0;	/* unchanged, keep recording */
+	}
+	frec_shutdown();
+
+	sz = sizeof *hdr + n * sizeof *ring;
+
+	if(path[0]) {
+		char old[PATH_MAX + 8];
+
+		sprintf(old, "%.*s.old", PATH_MAX - 1, path);
+		rename(path, old);
+
+		if((fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)) == -1) {
+			fprintf(stderr, "failed to create flight recorder file: %s: %s\n", path, strerror(errno));
+			return -1;
+		}
+		if(ftruncate(fd, sz) == -1) {
+			fprintf(stderr, "failed to resize flight recorder file: %s: %s\n", path, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		mem = mmap(0, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+	} else {
+		mem = mmap(0, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if(mem == MAP_FAILED) {
+		perror("failed to map the flight recorder");
+		return -1;
+	}
+	memset(mem, 0, sz);
+
+	hdr = mem;
+	memcpy(hdr->magic, FREC_MAGIC, 4);
+	hdr->version = FREC_VERSION;
+	hdr->size = n;
+	hdr->entry_size = sizeof *ring;
+	hdr->start_time = now_usec();
+	hdr->start_realtime = realtime_usec();
+	hdr->pid = getpid();
+	hdr->head = 1;
+
+	ring = (struct frec_entry*)(hdr + 1);
+	ring_mask = n - 1;
+	map_size = sz;
+	strncpy(map_path, path, sizeof map_path - 1);
+	map_path[sizeof map_path - 1] = 0;
+	return 0;
+}
+
+void frec_shutdown(void)
+{
+	if(hdr) {
+		munmap(hdr, map_size);
+		hdr = 0;
+		ring = 0;
+		map_path[0] = 0;
+	}
+}
+
+/* The slot is claimed with an atomic increment of the head, and its sequence
+ * number is cleared while it's being written, so that a reader copying it at
+ * the same time (seqlock style, see read_entry) can tell it apart.
+ */
+void frec_record(int type, int dev, int a0, int a1, int a2)
+{
+	if(hdr) {
+		frec_record_at(now_usec(), type, dev, a0, a1, a2);
+	}
+}
+
+unsigned long long frec_time(void)
+{
+	return hdr ? now_usec() : 0;
+}
+
+void frec_record_at(unsigned long long time, int type, int dev, int a0, int a1, int a2)
+{
+	uint32_t seq;
+	struct frec_entry *ent;
+
+	if(!hdr) return;
+	if(!time) {
+		time = now_usec();	/* recording was enabled after the time was taken */
+	}
+
+	if(!(seq = __atomic_fetch_add(&hdr->head, 1, __ATOMIC_RELAXED))) {
+		/* sequence number wrapped around, 0 is reserved */
+		seq = __atomic_fetch_add(&hdr->head, 1, __ATOMIC_RELAXED);
+	}
+	ent = ring + (seq & ring_mask);
+
+	__atomic_store_n(&ent->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	ent->time = time;
+	ent->type = type;
+	ent->dev = dev;
+	ent->arg[0] = a0;
+	ent->arg[1] = a1;
+	ent->arg[2] = a2;
+
+	__atomic_store_n(&ent->seq, seq, __ATOMIC_RELEASE);
+}
+
+int frec_dump(FILE *fp, int max)
+{
+	if(!hdr) {
+		fprintf(fp, "flight recorder disabled\n");
+		return -1;
+	}
+	frec_record(FREC_DUMP, -1, max, 0, 0);
+	return frec_print(fp, hdr, max);
+}
+
+static int read_entry(const struct frec_header *hdr, uint32_t seq, struct frec_entry *res)
+{
+	const struct frec_entry *ent = (const struct frec_entry*)(hdr + 1) + (seq & (hdr->size - 1));
+
+	if(__atomic_load_n(&ent->seq, __ATOMIC_ACQUIRE) != seq) {
+		return -1;
+	}
+	memcpy(res, ent, sizeof *res);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&ent->seq, __ATOMIC_RELAXED) != seq) {
+		return -1;	/* overwritten while copying */
+	}
+	return 0;
+}
+
+static const char *type_name(int type)
+{
+	static const char *names[] = {
+		"?", "read", "flush", "event", "dispatch", "write", "timer", "dev-add",
+		"dev-remove", "hotplug", "reload", "suspend", "dump"
+	};
+	return type > 0 && type <= FREC_DUMP ? names[type] : names[0];
+}
+
+static const char *client_name(int type)
+{
+	switch(type) {
+	case CLIENT_X11:
+		return "x11";
+	case CLIENT_UNIX:
+		return "unix";
+	case CLIENT_UINPUT:
+		return "uinput";
+	case CLIENT_NET:
+		return "net";
+	default:
+		break;
+	}
+	return "?";
+}
+
+static void print_entry(FILE *fp, const struct frec_header *hdr, const struct frec_entry *ent,
+		long long dt)
+{
+	char buf[32];
+	time_t sec;
+	struct tm *tm;
+	long long rt = hdr->start_realtime + (long long)(ent->time - hdr->start_time);
+
+	sec = rt / 1000000;
+	tm = localtime(&sec);
+	strftime(buf, sizeof buf, "%H:%M:%S", tm);
+	fprintf(fp, "%s.%06ld %+9lld ", buf, (long)(rt % 1000000), dt);
+
+	if(ent->dev >= 0) {
+		fprintf(fp, "dev %-2d ", ent->dev);
+	} else {
+		fputs("       ", fp);
+	}
+	fprintf(fp, "%-10s ", type_name(ent->type));
+
+	switch(ent->type) {
+	case FREC_READ:
+		if(ent->arg[0] == INP_MOTION) {
+			fprintf(fp, "axis %d: %d", ent->arg[1], ent->arg[2]);
+		} else if(ent->arg[0] == INP_BUTTON) {
+			fprintf(fp, "button %d: %d", ent->arg[1], ent->arg[2]);
+		}
+		break;
+
+	case FREC_FLUSH:
+		if(ent->arg[0] || ent->arg[1]) {
+			fprintf(fp, "input delay: %lld usec", rt - ((long long)ent->arg[0] * 1000000 + ent->arg[1]));
+		}
+		break;
+
+	case FREC_EVENT:
+		if(ent->arg[0] == EVENT_MOTION) {
+			fprintf(fp, "motion, period: %d msec", ent->arg[1]);
+		} else {
+			fprintf(fp, "button %d %s", ent->arg[1], ent->arg[2] ? "press" : "release");
+		}
+		break;
+
+	case FREC_DISPATCH:
+		fprintf(fp, ent->arg[0] == CLIENT_X11 ? "%s client 0x%x: %s" : "%s client %d: %s",
+				client_name(ent->arg[0]), ent->arg[1], ent->arg[2] == EVENT_MOTION ? "motion" : "button");
+		break;
+
+	case FREC_WRITE:
+		if(ent->arg[1] < 0) {
+			fprintf(fp, "client %d: %s", ent->arg[0], strerror(-ent->arg[1]));
+		} else {
+			fprintf(fp, "client %d: %d/%d bytes", ent->arg[0], ent->arg[1], ent->arg[2]);
+		}
+		break;
+
+	case FREC_RELOAD:
+		fprintf(fp, "took %d usec", ent->arg[0]);
+		break;
+
+	case FREC_SUSPEND:
+		fputs(ent->arg[0] ? "input suspended" : "input resumed", fp);
+		break;
+
+	case FREC_DUMP:
+		if(ent->arg[0]) {
+			fprintf(fp, "last %d records", ent->arg[0]);
+		}
+		break;
+
+	default:
+		break;
+	}
+	fputc('\n', fp);
+}
+
+/* Prints the records oldest first, each with its time from the previous one.
+ * The oldest ones might be overwritten by the time they are read when this is
+ * racing a busy writer, in which case they are skipped.
+ */
+int frec_print(FILE *fp, const struct frec_header *hdr, int max)
+{
+	uint32_t head, seq, count;
+	struct frec_entry ent;
+	unsigned long long prev = 0;
+	int skipped = 0;
+
+	if(memcmp(hdr->magic, FREC_MAGIC, 4) != 0 || hdr->version != FREC_VERSION ||
+			hdr->entry_size != sizeof ent || !hdr->size || (hdr->size & (hdr->size - 1))) {
+		fprintf(stderr, "invalid or incompatible flight recorder data\n");
+		return -1;
+	}
+
+	head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	count = head - 1 < hdr->size ? head - 1 : hdr->size;
+	if(max > 0 && (uint32_t)max < count) {
+		count = max;
+	}
+
+	fprintf(fp, "flight recorder of pid %u, %u records of %u\n", (unsigned int)hdr->pid,
+			(unsigned int)count, (unsigned int)hdr->size);
+
+	for(seq = head - count; seq != head; seq++) {
+		if(!seq) continue;
+		if(read_entry(hdr, seq, &ent) == -1) {
+			skipped++;
+			continue;
+		}
+		print_entry(fp, hdr, &ent, prev ? (long long)(ent.time - prev) : 0);
+		prev = ent.time;
+	}
+	if(skipped) {
+		fprintf(fp, "(%d records skipped, overwritten or incomplete)\n", skipped);
+	}
+	fflush(fp);
+	return 0;
+}
+
+int frec_print_file(FILE *fp, const char *path, int max)
+{
+	int fd, res;
+	struct stat st;
+	struct frec_header *fhdr;
+
+	if((fd = open(path, O_RDONLY)) == -1) {
+		fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof *fhdr) {
+		fprintf(stderr, "%s: not a flight recorder file\n", path);
+		close(fd);
+		return -1;
+	}
+	fhdr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(fhdr == MAP_FAILED) {
+		fprintf(stderr, "failed to map %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	if(st.st_size < (off_t)(sizeof *fhdr + (size_t)fhdr->size * sizeof(struct frec_entry))) {
+		fprintf(stderr, "%s: truncated flight recorder file\n", path);
+		res = -1;
+	} else {
+		res = frec_print(fp, fhdr, max);
+	}
+	munmap(fhdr, st.st_size);
+	return res;
+}
+
+static unsigned long long now_usec(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	}
+#endif
+	return (unsigned long long)realtime_usec();
+}
+
+static long long realtime_usec(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
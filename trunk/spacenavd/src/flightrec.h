@@ -0,0 +1,101 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef FLIGHTREC_H_
+#define FLIGHTREC_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Flight recorder: a fixed size ring of compact binary records of what went
+ * through the input pipeline, always on, for looking at what happened after
+ * the fact. Recording is lock-free: any thread may call frec_record, which
+ * claims a slot with an atomic increment and overwrites the oldest record.
+ *
+ * The ring can live in a file mapped in memory, which survives the daemon
+ * crashing, and can be read while the daemon is running (frec_print_file).
+ */
+
+#define FREC_MAGIC		"SPFR"
+#define FREC_VERSION	1
+
+/* record types, and the meaning of their arguments */
+enum {
+	FREC_READ = 1,	/* arg: input type (INP_*), index, value */
+	FREC_FLUSH,		/* arg: input timestamp (realtime sec, usec), 0 if unknown */
+	FREC_EVENT,		/* arg: event type, motion period or button number, press */
+	FREC_DISPATCH,	/* arg: client type, client socket (X11: window), event type */
+	FREC_WRITE,		/* arg: client socket, result (bytes or -errno), size */
+	FREC_TIMER,		/* device timer fired */
+	FREC_DEV_ADD,
+	FREC_DEV_REMOVE,
+	FREC_HOTPLUG,
+	FREC_RELOAD,	/* arg: duration in usec */
+	FREC_SUSPEND,	/* arg: 1 input suspended, 0 resumed */
+	FREC_DUMP		/* arg: number of records requested (0: all) */
+};
+
+struct frec_entry {
+	uint64_t time;		/* usec, monotonic clock */
+	uint32_t seq;		/* sequence number, 0 while being written */
+	uint16_t type;
+	int16_t dev;		/* device id, -1 if not device related */
+	int32_t arg[3];
+	uint32_t reserved;
+};
+
+struct frec_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t size;			/* number of entries, power of two */
+	uint32_t entry_size;
+	uint64_t start_time;	/* monotonic usec when the recorder was started ... */
+	int64_t start_realtime;	/* ... and the same instant in usec since the epoch */
+	uint32_t pid;
+	char pad0[28];
+
+	/* sequence number of the next record, the first is 1 */
+	uint32_t head;
+	char pad1[60];
+
+	/* followed by the entries */
+};
+
+/* size is in entries, rounded up to a power of two, 0 disables recording.
+ * path is a file to map the ring to, or empty for anonymous memory. An
+ * existing file is kept as <path>.old, since it holds the previous run.
+ * Calling it again with the same parameters keeps the current records.
+ */
+int frec_init(int size, const char *path);
+void frec_shutdown(void);
+
+void frec_record(int type, int dev, int a0, int a1, int a2);
+
+/* Reading the clock is most of the cost of a record, so where a burst of
+ * records belongs to the same moment (the inputs of one report, an event and
+ * its dispatching), the time is taken once with frec_time and passed to
+ * frec_record_at. frec_time returns 0 when recording is disabled.
+ */
+unsigned long long frec_time(void);
+void frec_record_at(unsigned long long time, int type, int dev, int a0, int a1, int a2);
+
+/* print the last max records (0: all) in readable form */
+int frec_dump(FILE *fp, int max);
+int frec_print(FILE *fp, const struct frec_header *hdr, int max);
+int frec_print_file(FILE *fp, const char *path, int max);
+
+#endif	/* FLIGHTREC_H_ */
@@ -95,7 +95,7 @@ int handle_hotplug(void)
 	if(verbose)
 		printf("\nhandle_hotplug called\n");
 
-	if (init_devices() == -1)
+	if (init_devices(core) == -1)
 		return -1;
 
 	return 0;
@@ -0,0 +1,681 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include "iouring.h"
+#include "spnavd.h"
+
+#if defined(__linux__) && defined(HAVE_LINUX_IO_URING_H)
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <linux/input.h>
+#include <linux/io_uring.h>
+#include "dev.h"
+#include "stats.h"
+#include "flightrec.h"
+
+#define RING_ENTRIES	256
+
+/* sends queued per round, more than that forces an early submit. Leaves
+ * room in the submission queue for the device reads.
+ */
+#define NUM_SEND_SLOTS	(RING_ENTRIES / 2)
+#define SEND_SLOT_SIZE	64
+
+/* provided buffers for the device reads */
+#define NUM_RDBUF		64
+#define RDBUF_SIZE		(64 * sizeof(struct input_event))
+#define RDBUF_GROUP		0
+
+#define MAX_READS		32
+
+/* IORING_OP_READ_MULTISHOT (linux 6.7), missing from older io_uring.h */
+#define OP_READ_MULTISHOT	49
+
+/* user_data: tag in the upper 32 bits, device id or send slot in the lower */
+#define TAG_SEND	(1ULL << 32)
+#define TAG_READ	(2ULL << 32)
+#define TAG_CANCEL	(3ULL << 32)
+#define TAG_MASK	0xffffffff00000000ULL
+
+struct ring {
+	int fd;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_size, cq_size;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned int sq_entries;
+	unsigned int tail, to_submit;
+};
+
+struct send_slot {
+	int fd, size, res;
+	int queued;
+	char data[SEND_SLOT_SIZE];
+};
+
+struct dev_read {
+	int devid, fd;
+	int armed;
+};
+
+/* the part of a completion we need (io_uring_cqe ends in a flexible array) */
+struct completion {
+	unsigned long long user_data;
+	int res;
+	unsigned int flags;
+};
+
+static int init_ring(void);
+static void destroy_ring(void);
+static struct io_uring_sqe *get_sqe(void);
+static int submit(unsigned int wait);
+static int init_bufring(void);
+static void recycle_buffer(int bid);
+static void update_reads(void);
+static void post_read(struct dev_read *rd);
+static void cancel_read(struct dev_read *rd);
+static struct dev_read *find_read(int devid);
+static void submit_sends(void);
+static void process_cqes(void);
+static void process_reads(void);
+static void process_read(const struct completion *cqe);
+
+static struct ring ring = {-1};
+
+static struct send_slot slots[NUM_SEND_SLOTS];
+static int num_slots;
+
+static struct dev_read reads[MAX_READS];
+static int num_reads;
+
+static struct io_uring_buf_ring *bufring;
+static size_t bufring_size;
+static unsigned short bufring_tail;
+static char *rdbuf;
+static int multishot = 1;
+
+/* Read completions waiting to be processed. Each one either holds one of the
+ * provided buffers, or ends a read, which bounds how many can be pending.
+ */
+#define READQ_SIZE		128
+static struct completion readq[READQ_SIZE];
+static int readq_head, readq_tail;
+static int feeding;
+
+
+int set_uring(int enable)
+{
+	int i;
+	struct device *dev;
+
+	if(enable) {
+		if(ring.fd != -1) {
+			return 0;
+		}
+		if(init_ring() == -1) {
+			fprintf(stderr, "io_uring is not available (%s), using select and write\n", strerror(errno));
+			return -1;
+		}
+		if(init_bufring() == -1) {
+			fprintf(stderr, "io_uring provided buffers are not available (%s), device reads will use select\n",
+					strerror(errno));
+		}
+		if(verbose) {
+			printf("using io_uring for %s\n", bufring ? "device reads and client writes" : "client writes");
+		}
+		return 0;
+	}
+
+	if(ring.fd == -1) {
+		return 0;
+	}
+	submit_sends();
+
+	/* hand the devices back to the select loop, closing the ring cancels
+	 * their reads.
+	 */
+	for(i=0; i<num_reads; i++) {
+		if((dev = get_device_by_id(core, reads[i].devid))) {
+			dev->ext_read = 0;
+		}
+	}
+	num_reads = 0;
+	readq_head = readq_tail = 0;
+	destroy_ring();
+	return 0;
+}
+
+int get_uring_fd(void)
+{
+	return ring.fd;
+}
+
+void handle_uring(fd_set *rset)
+{
+	if(ring.fd == -1 || !FD_ISSET(ring.fd, rset)) {
+		return;
+	}
+	process_cqes();
+	process_reads();
+}
+
+void flush_uring(void)
+{
+	if(ring.fd == -1) {
+		return;
+	}
+	/* processing the reads which completed with the sends can queue more */
+	while(num_slots) {
+		submit_sends();
+		process_reads();
+	}
+	update_reads();
+	if(ring.to_submit) {
+		submit(0);
+	}
+}
+
+int uring_send(int fd, const void *data, int size)
+{
+	struct send_slot *slot;
+
+	if(ring.fd == -1 || size > SEND_SLOT_SIZE) {
+		return -1;
+	}
+	if(num_slots >= NUM_SEND_SLOTS) {
+		submit_sends();
+	}
+
+	slot = slots + num_slots++;
+	slot->fd = fd;
+	slot->size = size;
+	slot->res = 0;
+	slot->queued = 0;
+	memcpy(slot->data, data, size);
+	return 0;
+}
+
+/* Submits all the queued sends, and waits for their completion. The sends
+ * don't wait for socket space (MSG_DONTWAIT), so they complete during the
+ * submission. The ones which didn't fit, and the ones after them in the
+ * same link chain, are written directly afterwards.
+ */
+static void submit_sends(void)
+{
+	int i, j, res, pending = 0;
+	struct io_uring_sqe *sqe, *prev;
+
+	/* link the sends to each client in a chain, so that a failed send
+	 * cancels the following ones instead of letting them overtake it.
+	 */
+	for(i=0; i<num_slots; i++) {
+		if(slots[i].queued) continue;
+
+		prev = 0;
+		for(j=i; j<num_slots; j++) {
+			struct send_slot *slot = slots + j;
+			if(slot->queued || slot->fd != slots[i].fd) {
+				continue;
+			}
+			if(!(sqe = get_sqe())) {
+				break;
+			}
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = slot->fd;
+			sqe->addr = (unsigned long)slot->data;
+			sqe->len = slot->size;
+			sqe->msg_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+			sqe->user_data = TAG_SEND | j;
+
+			if(prev) {
+				prev->flags |= IOSQE_IO_LINK;
+			}
+			prev = sqe;
+			slot->queued = 1;
+			slot->res = 1;	/* no completion yet */
+			pending++;
+		}
+	}
+
+	if(pending) {
+		submit(pending);
+		stats.uring_sends += pending;
+
+		for(;;) {
+			process_cqes();
+
+			pending = 0;
+			for(i=0; i<num_slots; i++) {
+				if(slots[i].queued && slots[i].res == 1) pending++;
+			}
+			if(!pending || submit(1) == -1) break;
+		}
+	}
+
+	for(i=0; i<num_slots; i++) {
+		struct send_slot *slot = slots + i;
+		int offs;
+
+		if(slot->queued) {
+			frec_record(FREC_WRITE, -1, slot->fd, slot->res, slot->size);
+		}
+
+		if(!slot->queued || slot->res == -EAGAIN || slot->res == -ECANCELED || slot->res == -EINTR) {
+			offs = 0;
+		} else if(slot->res >= 0 && slot->res < slot->size) {
+			offs = slot->res;	/* partial send, also cancels the rest of the chain */
+		} else {
+			continue;
+		}
+		while((res = write(slot->fd, slot->data + offs, slot->size - offs)) == -1 && errno == EINTR);
+		frec_record(FREC_WRITE, -1, slot->fd, res == -1 ? -errno : res, slot->size - offs);
+		stats.uring_send_direct++;
+	}
+	num_slots = 0;
+}
+
+/* Consumes all completions. The sends are marked done, the reads are queued,
+ * to be processed by process_reads outside of any send submission.
+ */
+static void process_cqes(void)
+{
+	unsigned int head;
+	struct io_uring_cqe *cqe;
+	struct completion comp;
+
+	while((head = *ring.cq_head) != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+		cqe = ring.cqes + (head & *ring.cq_mask);
+		comp.user_data = cqe->user_data;
+		comp.res = cqe->res;
+		comp.flags = cqe->flags;
+		__atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+
+		switch(comp.user_data & TAG_MASK) {
+		case TAG_SEND:
+			slots[comp.user_data & 0xffffffff].res = comp.res;
+			break;
+
+		case TAG_READ:
+			readq[readq_tail] = comp;
+			readq_tail = (readq_tail + 1) & (READQ_SIZE - 1);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+/* Feeds the queued reads to the core, in order. The resulting events can fill
+ * the send slots and submit them, which brings in more reads; those are picked
+ * up by the same loop rather than a nested one, which would pass later input
+ * to the core before the rest of the current buffer.
+ */
+static void process_reads(void)
+{
+	struct completion comp;
+
+	if(feeding) return;
+	feeding = 1;
+
+	while(readq_head != readq_tail) {
+		comp = readq[readq_head];
+		readq_head = (readq_head + 1) & (READQ_SIZE - 1);
+		process_read(&comp);
+	}
+	feeding = 0;
+}
+
+static void process_read(const struct completion *cqe)
+{
+	int devid = cqe->user_data & 0xffffffff;
+	struct dev_read *rd = find_read(devid);
+	struct device *dev = get_device_by_id(core, devid);
+
+	if(cqe->flags & IORING_CQE_F_BUFFER) {
+		int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+		if(cqe->res > 0 && rd && dev) {
+			spnav_core_feed(dev, rdbuf + bid * RDBUF_SIZE, cqe->res);
+			stats.uring_reads++;
+		}
+		recycle_buffer(bid);
+	}
+
+	if(!rd || (cqe->flags & IORING_CQE_F_MORE)) {
+		return;
+	}
+	rd->armed = 0;	/* posted again by flush_uring */
+
+	if(cqe->res > 0) {
+		return;
+	}
+	switch(-cqe->res) {
+	case EINVAL:
+		if(multishot) {
+			if(verbose) {
+				printf("io_uring: no multishot reads, falling back to single reads\n");
+			}
+			multishot = 0;
+			return;
+		}
+		break;
+
+	case ENOBUFS:
+	case EAGAIN:
+	case EINTR:
+	case ECANCELED:
+		return;
+
+	default:
+		break;
+	}
+
+	/* end of file or read error, the device is gone */
+	if(dev) {
+		fprintf(stderr, "read error on %s: %s\n", dev->path, cqe->res ? strerror(-cqe->res) : "end of file");
+		remove_device(dev);
+	}
+}
+
+static void update_reads(void)
+{
+	int i;
+	struct device *dev;
+
+	/* drop the reads of devices which went away, are read by their own
+	 * thread now, or are suspended.
+	 */
+	for(i=0; i<num_reads; i++) {
+		dev = get_device_by_id(core, reads[i].devid);
+		if(!dev || dev->fd != reads[i].fd || dev->thread || spnav_core_suspended(core)) {
+			if(dev) dev->ext_read = 0;
+			cancel_read(reads + i);
+			reads[i--] = reads[--num_reads];
+		}
+	}
+
+	if(!bufring || spnav_core_suspended(core)) {
+		return;
+	}
+
+	dev = get_devices(core);
+	while(dev) {
+		if(dev->feed && !dev->thread && !dev->ext_read && dev->fd >= 0 && num_reads < MAX_READS) {
+			struct dev_read *rd = reads + num_reads++;
+			rd->devid = dev->id;
+			rd->fd = dev->fd;
+			rd->armed = 0;
+			dev->ext_read = 1;
+
+			if(verbose) {
+				printf("io_uring: reading device %d: %s\n", dev->id, dev->path);
+			}
+		}
+		dev = dev->next;
+	}
+
+	for(i=0; i<num_reads; i++) {
+		if(!reads[i].armed) {
+			post_read(reads + i);
+		}
+	}
+}
+
+static void post_read(struct dev_read *rd)
+{
+	struct io_uring_sqe *sqe;
+
+	if(!(sqe = get_sqe())) {
+		return;
+	}
+	sqe->opcode = multishot ? OP_READ_MULTISHOT : IORING_OP_READ;
+	sqe->fd = rd->fd;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = RDBUF_GROUP;
+	sqe->len = multishot ? 0 : RDBUF_SIZE;
+	sqe->user_data = TAG_READ | rd->devid;
+	rd->armed = 1;
+}
+
+static void cancel_read(struct dev_read *rd)
+{
+	struct io_uring_sqe *sqe;
+
+	if(!rd->armed || !(sqe = get_sqe())) {
+		return;
+	}
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = TAG_READ | rd->devid;
+	sqe->user_data = TAG_CANCEL;
+}
+
+static struct dev_read *find_read(int devid)
+{
+	int i;
+	for(i=0; i<num_reads; i++) {
+		if(reads[i].devid == devid) {
+			return reads + i;
+		}
+	}
+	return 0;
+}
+
+static int init_ring(void)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof p);
+	if((ring.fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p)) == -1) {
+		return -1;
+	}
+
+	ring.sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring.cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		if(ring.cq_size > ring.sq_size) ring.sq_size = ring.cq_size;
+		ring.cq_size = ring.sq_size;
+	}
+
+	ring.sq_ptr = mmap(0, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring.fd, IORING_OFF_SQ_RING);
+	if(ring.sq_ptr == MAP_FAILED) {
+		goto err;
+	}
+	if(p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring.cq_ptr = ring.sq_ptr;
+	} else {
+		ring.cq_ptr = mmap(0, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ring.fd, IORING_OFF_CQ_RING);
+		if(ring.cq_ptr == MAP_FAILED) {
+			munmap(ring.sq_ptr, ring.sq_size);
+			goto err;
+		}
+	}
+
+	ring.sqes = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+	if(ring.sqes == MAP_FAILED) {
+		munmap(ring.sq_ptr, ring.sq_size);
+		if(ring.cq_ptr != ring.sq_ptr) munmap(ring.cq_ptr, ring.cq_size);
+		goto err;
+	}
+
+	ring.sq_head = (unsigned int*)((char*)ring.sq_ptr + p.sq_off.head);
+	ring.sq_tail = (unsigned int*)((char*)ring.sq_ptr + p.sq_off.tail);
+	ring.sq_mask = (unsigned int*)((char*)ring.sq_ptr + p.sq_off.ring_mask);
+	ring.sq_array = (unsigned int*)((char*)ring.sq_ptr + p.sq_off.array);
+	ring.cq_head = (unsigned int*)((char*)ring.cq_ptr + p.cq_off.head);
+	ring.cq_tail = (unsigned int*)((char*)ring.cq_ptr + p.cq_off.tail);
+	ring.cq_mask = (unsigned int*)((char*)ring.cq_ptr + p.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe*)((char*)ring.cq_ptr + p.cq_off.cqes);
+	ring.sq_entries = p.sq_entries;
+	ring.tail = *ring.sq_tail;
+	ring.to_submit = 0;
+	return 0;
+
+err:
+	close(ring.fd);
+	ring.fd = -1;
+	return -1;
+}
+
+static void destroy_ring(void)
+{
+	if(bufring) {
+		munmap(bufring, bufring_size);
+		bufring = 0;
+	}
+	free(rdbuf);
+	rdbuf = 0;
+
+	munmap(ring.sqes, ring.sq_entries * sizeof(struct io_uring_sqe));
+	if(ring.cq_ptr != ring.sq_ptr) {
+		munmap(ring.cq_ptr, ring.cq_size);
+	}
+	munmap(ring.sq_ptr, ring.sq_size);
+	close(ring.fd);
+	ring.fd = -1;
+}
+
+static struct io_uring_sqe *get_sqe(void)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+	if(ring.tail - head >= ring.sq_entries) {
+		/* full, submit what we have to make room */
+		submit(0);
+		head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+		if(ring.tail - head >= ring.sq_entries) {
+			return 0;
+		}
+	}
+
+	sqe = ring.sqes + (ring.tail & *ring.sq_mask);
+	memset(sqe, 0, sizeof *sqe);
+	ring.sq_array[ring.tail & *ring.sq_mask] = ring.tail & *ring.sq_mask;
+	ring.tail++;
+	ring.to_submit++;
+	return sqe;
+}
+
+static int submit(unsigned int wait)
+{
+	int res;
+
+	__atomic_store_n(ring.sq_tail, ring.tail, __ATOMIC_RELEASE);
+
+	do {
+		res = syscall(__NR_io_uring_enter, ring.fd, ring.to_submit, wait,
+				wait ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+	} while(res == -1 && errno == EINTR);
+
+	stats.uring_enters++;
+	if(res == -1) {
+		perror("io_uring_enter failed");
+		return -1;
+	}
+	ring.to_submit -= res < (int)ring.to_submit ? res : ring.to_submit;
+	return 0;
+}
+
+static int init_bufring(void)
+{
+	int i;
+	struct io_uring_buf_reg reg;
+
+	bufring_size = NUM_RDBUF * sizeof(struct io_uring_buf);
+	bufring = mmap(0, bufring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(bufring == MAP_FAILED) {
+		bufring = 0;
+		return -1;
+	}
+	if(!(rdbuf = malloc(NUM_RDBUF * RDBUF_SIZE))) {
+		goto err;
+	}
+
+	memset(&reg, 0, sizeof reg);
+	reg.ring_addr = (unsigned long)bufring;
+	reg.ring_entries = NUM_RDBUF;
+	reg.bgid = RDBUF_GROUP;
+	if(syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+		goto err;
+	}
+
+	bufring_tail = 0;
+	for(i=0; i<NUM_RDBUF; i++) {
+		recycle_buffer(i);
+	}
+	return 0;
+
+err:
+	munmap(bufring, bufring_size);
+	bufring = 0;
+	free(rdbuf);
+	rdbuf = 0;
+	return -1;
+}
+
+static void recycle_buffer(int bid)
+{
+	struct io_uring_buf *buf = bufring->bufs + (bufring_tail & (NUM_RDBUF - 1));
+
+	buf->addr = (unsigned long)(rdbuf + bid * RDBUF_SIZE);
+	buf->len = RDBUF_SIZE;
+	buf->bid = bid;
+	__atomic_store_n(&bufring->tail, ++bufring_tail, __ATOMIC_RELEASE);
+}
+
+#else	/* no io_uring */
+
+int set_uring(int enable)
+{
+	if(enable) {
+		fprintf(stderr, "io_uring support was not compiled in, using select and write\n");
+	}
+	return -1;
+}
+
+int get_uring_fd(void)
+{
+	return -1;
+}
+
+void handle_uring(fd_set *rset)
+{
+}
+
+void flush_uring(void)
+{
+}
+
+int uring_send(int fd, const void *data, int size)
+{
+	return -1;
+}
+#endif
@@ -0,0 +1,52 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef IOURING_H_
+#define IOURING_H_
+
+#include "config.h"
+#include <sys/select.h>
+
+/* io_uring I/O backend (GNU/Linux, enabled with the io-uring config option).
+ *
+ * Device input: a multishot read, with buffers from a provided buffer ring,
+ * stays posted on every evdev device, and the data is passed to the core
+ * with spnav_core_feed. Kernels without multishot reads get a single read,
+ * posted again after every completion.
+ *
+ * Client output: uring_send queues the sends to the UNIX socket clients, and
+ * flush_uring submits all of them with a single system call once per round
+ * of the main loop. Consecutive sends to the same client are linked, to keep
+ * their order.
+ *
+ * If io_uring is not available, everything falls back to the select loop and
+ * plain writes.
+ */
+int set_uring(int enable);
+int get_uring_fd(void);
+
+/* processes the completions, when the ring descriptor is readable */
+void handle_uring(fd_set *rset);
+/* posts reads for new devices and submits the queued sends */
+void flush_uring(void);
+
+/* queues data to be sent to a socket, returns -1 if io_uring is not in use
+ * (and the caller should write it itself).
+ */
+int uring_send(int fd, const void *data, int size);
+
+#endif	/* IOURING_H_ */
@@ -16,47 +16,441 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/* Keyboard emulation: buttons mapped to key chords with kbmapN in the config
+ * file. Key names and keycodes are resolved when the config is loaded, so
+ * a button press only sends the key events.
+ *
+ * With an X server, keys are injected with the XTEST extension if available,
+ * which works with every client. Without XTEST we fall back to sending
+ * synthetic key events to the focus window, which some clients ignore.
+ * Without X (or with kbemu = uinput) a uinput virtual keyboard is used.
+ */
 #include "config.h"
 
-#ifdef USE_X11
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include "kbemu.h"
+#include "spnavd.h"
+
+#ifdef USE_X11
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+
+#ifdef USE_XCB
+#ifdef HAVE_XCB_XTEST_H
+#include <xcb/xtest.h>
+#endif
+#else
+#ifdef HAVE_X11_EXTENSIONS_XTEST_H
+#include <X11/extensions/XTest.h>
+#endif
+#endif
+#endif	/* USE_X11 */
+
+struct chord {
+	int count;
+	int evcode[KBEMU_MAX_CHORD];		/* linux key codes for uinput, -1 if unknown */
+#ifdef USE_X11
+	KeySym sym[KBEMU_MAX_CHORD];
+	unsigned int keycode[KBEMU_MAX_CHORD];	/* 0 if not on the keyboard */
+	unsigned int modmask;		/* modifier state implied by the chord */
+#endif
+};
+
+static int parse_chord(struct chord *ch, const char *str);
+static int use_uinput(void);
+
+#ifdef USE_X11
+static unsigned int modifier_mask(KeySym sym);
+/* implemented by the xlib and xcb parts below */
+static int x11_connected(void);
+static void resolve_keycodes(void);
+static void send_x11_chord(struct chord *ch, int press);
+#endif
+
+static struct chord chords[MAX_BUTTONS];
+static int num_chords;
+static int uinput_active, uinput_failed;
+
+
+void kbemu_config(void)
+{
+	int i;
+
+	num_chords = 0;
+	for(i=0; i<MAX_BUTTONS; i++) {
+		chords[i].count = 0;
+		if(cfg.kbmap_str[i] && parse_chord(chords + i, cfg.kbmap_str[i]) != -1) {
+			if(verbose) {
+				printf("mapping button %d to keys: %s\n", i, cfg.kbmap_str[i]);
+			}
+			num_chords++;
+		}
+	}
+	kbemu_refresh();
+
+	/* the uinput keyboard is opened here if explicitly requested. In auto mode
+	 * it's opened on first use, if there's no X server to talk to.
+	 */
+	uinput_failed = 0;
+	if(num_chords && cfg.kbemu == KBEMU_UINPUT) {
+		use_uinput();
+	} else if(!num_chords || cfg.kbemu == KBEMU_X11) {
+		kbemu_cleanup();
+	}
+}
+
+void kbemu_refresh(void)
+{
+#ifdef USE_X11
+	if(x11_connected()) {
+		resolve_keycodes();
+	}
+#endif
+}
+
+int kbemu_active(void)
+{
+	return num_chords > 0;
+}
+
+int kbemu_button(int bidx, int press)
+{
+	struct chord *ch;
+
+	if(bidx < 0 || bidx >= MAX_BUTTONS || !chords[bidx].count) {
+		return 0;
+	}
+	ch = chords + bidx;
+
+#ifdef USE_X11
+	if(cfg.kbemu != KBEMU_UINPUT && x11_connected()) {
+		send_x11_chord(ch, press);
+		return 1;
+	}
+#endif
+	if(cfg.kbemu != KBEMU_X11 && use_uinput()) {
+		kbemu_uinput_send(ch->evcode, ch->count, press);
+	}
+	return 1;
+}
+
+void kbemu_cleanup(void)
+{
+	if(uinput_active) {
+		kbemu_uinput_close();
+		uinput_active = 0;
+	}
+}
+
+static int use_uinput(void)
+{
+	if(!uinput_active && !uinput_failed) {
+		if(kbemu_uinput_open() == -1) {
+			uinput_failed = 1;	/* don't retry until the next config reload */
+		} else {
+			uinput_active = 1;
+		}
+	}
+	return uinput_active;
+}
+
+static int parse_chord(struct chord *ch, const char *str)
+{
+	char buf[256], *tok, *end;
+	int evcode;
+#ifdef USE_X11
+	KeySym sym;
+
+	ch->modmask = 0;
+#endif
+	ch->count = 0;
+
+	strncpy(buf, str, sizeof buf - 1);
+	buf[sizeof buf - 1] = 0;
+
+	for(tok = strtok(buf, "+"); tok; tok = strtok(0, "+")) {
+		while(isspace((unsigned char)*tok)) tok++;
+		end = tok + strlen(tok);
+		while(end > tok && isspace((unsigned char)end[-1])) {
+			*--end = 0;
+		}
+		if(!*tok) continue;
+
+		if(ch->count >= KBEMU_MAX_CHORD) {
+			fprintf(stderr, "kbmap: too many keys in \"%s\" (max: %d)\n", str, KBEMU_MAX_CHORD);
+			ch->count = 0;
+			return -1;
+		}
 
+		evcode = kbemu_uinput_code(tok);
+#ifdef USE_X11
+		if((sym = XStringToKeysym(tok)) == NoSymbol && evcode == -1) {
+			goto unknown;
+		}
+		ch->sym[ch->count] = sym;
+		ch->keycode[ch->count] = 0;
+		ch->modmask |= modifier_mask(sym);
+#else
+		if(evcode == -1) {
+			goto unknown;
+		}
+#endif
+		ch->evcode[ch->count++] = evcode;
+	}
+
+	if(!ch->count) {
+		fprintf(stderr, "kbmap: no keys in \"%s\"\n", str);
+		return -1;
+	}
+	return 0;
+
+unknown:
+	fprintf(stderr, "kbmap: unknown key \"%s\" in \"%s\"\n", tok, str);
+	ch->count = 0;
+	return -1;
+}
+
+#ifdef USE_X11
+static unsigned int modifier_mask(KeySym sym)
+{
+	switch(sym) {
+	case XK_Shift_L:
+	case XK_Shift_R:
+		return ShiftMask;
+	case XK_Control_L:
+	case XK_Control_R:
+		return ControlMask;
+	case XK_Alt_L:
+	case XK_Alt_R:
+	case XK_Meta_L:
+	case XK_Meta_R:
+		return Mod1Mask;
+	case XK_Super_L:
+	case XK_Super_R:
+		return Mod4Mask;
+	default:
+		break;
+	}
+	return 0;
+}
+
+#ifdef USE_XCB
+static xcb_keycode_t keysym_to_keycode(xcb_get_keyboard_mapping_reply_t *kbmap,
+		xcb_keycode_t min_keycode, KeySym sym);
+
+static xcb_connection_t *conn;
+static xcb_window_t root;
+static int have_xtest;
+
+void kbemu_set_connection(xcb_connection_t *c)
+{
+	conn = c;
+	root = c ? xcb_setup_roots_iterator(xcb_get_setup(c)).data->root : 0;
+
+	have_xtest = 0;
+#ifdef HAVE_XCB_XTEST_H
+	if(conn) {
+		const xcb_query_extension_reply_t *ext = xcb_get_extension_data(conn, &xcb_test_id);
+		have_xtest = ext && ext->present;
+	}
+#endif
+	if(conn && !have_xtest && verbose) {
+		printf("XTEST not available, keyboard emulation will use synthetic events\n");
+	}
+
+	kbemu_refresh();
+}
+
+static int x11_connected(void)
+{
+	return conn != 0;
+}
+
+static void resolve_keycodes(void)
+{
+	int i, j;
+	const xcb_setup_t *setup = xcb_get_setup(conn);
+	xcb_get_keyboard_mapping_cookie_t cookie;
+	xcb_get_keyboard_mapping_reply_t *kbmap;
+
+	cookie = xcb_get_keyboard_mapping(conn, setup->min_keycode,
+			setup->max_keycode - setup->min_keycode + 1);
+	if(!(kbmap = xcb_get_keyboard_mapping_reply(conn, cookie, 0))) {
+		return;
+	}
+
+	for(i=0; i<MAX_BUTTONS; i++) {
+		struct chord *ch = chords + i;
+		for(j=0; j<ch->count; j++) {
+			ch->keycode[j] = keysym_to_keycode(kbmap, setup->min_keycode, ch->sym[j]);
+		}
+	}
+	free(kbmap);
+}
+
+static void send_x11_chord(struct chord *ch, int press)
+{
+	int i, idx;
+	xcb_key_press_event_t xevent;
+	static xcb_window_t focus;
+
+#ifdef HAVE_XCB_XTEST_H
+	if(have_xtest) {
+		for(i=0; i<ch->count; i++) {
+			idx = press ? i : ch->count - 1 - i;
+			if(ch->keycode[idx]) {
+				xcb_test_fake_input(conn, press ? XCB_KEY_PRESS : XCB_KEY_RELEASE,
+						ch->keycode[idx], XCB_CURRENT_TIME, XCB_NONE, 0, 0, 0);
+			}
+		}
+		xcb_flush(conn);
+		return;
+	}
+#endif
+
+	/* synthetic events: the focus is only queried on press, and the chord's
+	 * modifiers are passed in the event state of the other keys.
+	 */
+	if(press || !focus) {
+		xcb_get_input_focus_reply_t *rep;
+		if(!(rep = xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), 0))) {
+			return;
+		}
+		focus = rep->focus;
+		free(rep);
+	}
+
+	memset(&xevent, 0, sizeof xevent);
+	xevent.response_type = press ? XCB_KEY_PRESS : XCB_KEY_RELEASE;
+	xevent.time = XCB_CURRENT_TIME;
+	xevent.root = root;
+	xevent.event = focus;
+	xevent.child = XCB_NONE;
+	xevent.root_x = xevent.root_y = 1;
+	xevent.event_x = xevent.event_y = 1;
+	xevent.state = ch->modmask;
+	xevent.same_screen = 1;
+
+	for(i=0; i<ch->count; i++) {
+		idx = press ? i : ch->count - 1 - i;
+		if(ch->keycode[idx] && !modifier_mask(ch->sym[idx])) {
+			xevent.detail = ch->keycode[idx];
+			xcb_send_event(conn, 1, focus, press ? XCB_EVENT_MASK_KEY_PRESS : XCB_EVENT_MASK_KEY_RELEASE,
+					(const char*)&xevent);
+		}
+	}
+	xcb_flush(conn);
+}
+
+static xcb_keycode_t keysym_to_keycode(xcb_get_keyboard_mapping_reply_t *kbmap,
+		xcb_keycode_t min_keycode, KeySym sym)
+{
+	int i, count;
+	xcb_keysym_t *syms;
+
+	/* unassigned slots in the keymap are NoSymbol too */
+	if(sym == NoSymbol) {
+		return 0;
+	}
+
+	syms = xcb_get_keyboard_mapping_keysyms(kbmap);
+	count = xcb_get_keyboard_mapping_keysyms_length(kbmap);
+
+	for(i=0; i<count; i++) {
+		if(syms[i] == sym) {
+			return min_keycode + i / kbmap->keysyms_per_keycode;
+		}
+	}
+	return 0;
+}
+
+#else	/* !USE_XCB */
 static Display *dpy;
+static int have_xtest;
 
 void kbemu_set_display(Display *d)
 {
 	dpy = d;
+
+	have_xtest = 0;
+#ifdef HAVE_X11_EXTENSIONS_XTEST_H
+	if(dpy) {
+		int evbase, errbase, major, minor;
+		have_xtest = XTestQueryExtension(dpy, &evbase, &errbase, &major, &minor);
+	}
+#endif
+	if(dpy && !have_xtest && verbose) {
+		printf("XTEST not available, keyboard emulation will use synthetic events\n");
+	}
+
+	kbemu_refresh();
 }
 
-KeySym kbemu_keysym(const char *str)
+static int x11_connected(void)
 {
-	return XStringToKeysym(str);
+	return dpy != 0;
+}
+
+static void resolve_keycodes(void)
+{
+	int i, j;
+
+	for(i=0; i<MAX_BUTTONS; i++) {
+		struct chord *ch = chords + i;
+		for(j=0; j<ch->count; j++) {
+			ch->keycode[j] = ch->sym[j] == NoSymbol ? 0 : XKeysymToKeycode(dpy, ch->sym[j]);
+		}
+	}
 }
 
-void send_kbevent(KeySym key, int press)
+static void send_x11_chord(struct chord *ch, int press)
 {
+	int i, idx, rev_state;
 	XEvent xevent;
-	Window win;
-	int rev_state;
+	static Window focus;
 
-	if(!dpy) return;
+#ifdef HAVE_X11_EXTENSIONS_XTEST_H
+	if(have_xtest) {
+		for(i=0; i<ch->count; i++) {
+			idx = press ? i : ch->count - 1 - i;
+			if(ch->keycode[idx]) {
+				XTestFakeKeyEvent(dpy, ch->keycode[idx], press, CurrentTime);
+			}
+		}
+		XFlush(dpy);
+		return;
+	}
+#endif
 
-	XGetInputFocus(dpy, &win, &rev_state);
+	/* synthetic events: the focus is only queried on press, and the chord's
+	 * modifiers are passed in the event state of the other keys.
+	 */
+	if(press || !focus) {
+		XGetInputFocus(dpy, &focus, &rev_state);
+	}
 
 	xevent.type = press ? KeyPress : KeyRelease;
 	xevent.xkey.display = dpy;
 	xevent.xkey.root = DefaultRootWindow(dpy);
-	xevent.xkey.window = win;
+	xevent.xkey.window = focus;
 	xevent.xkey.subwindow = None;
-	xevent.xkey.keycode = XKeysymToKeycode(dpy, key);
-	xevent.xkey.state = 0;
+	xevent.xkey.state = ch->modmask;
 	xevent.xkey.time = CurrentTime;
 	xevent.xkey.x = xevent.xkey.y = 1;
 	xevent.xkey.x_root = xevent.xkey.y_root = 1;
+	xevent.xkey.same_screen = True;
 
-	XSendEvent(dpy, win, True, press ? KeyPressMask : KeyReleaseMask, &xevent);
+	for(i=0; i<ch->count; i++) {
+		idx = press ? i : ch->count - 1 - i;
+		if(ch->keycode[idx] && !modifier_mask(ch->sym[idx])) {
+			xevent.xkey.keycode = ch->keycode[idx];
+			XSendEvent(dpy, focus, True, press ? KeyPressMask : KeyReleaseMask, &xevent);
+		}
+	}
 	XFlush(dpy);
 }
+#endif	/* USE_XCB */
 #endif	/* USE_X11 */
@@ -18,12 +18,48 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef KBEMU_H_
 #define KBEMU_H_
 
+#include "config.h"
+
+/* maximum number of keys in a chord */
+#define KBEMU_MAX_CHORD	4
+
+#ifdef USE_X11
+#ifdef USE_XCB
+#include <xcb/xcb.h>
+
+void kbemu_set_connection(xcb_connection_t *conn);
+#else
 #include <X11/Xlib.h>
-#include <X11/keysym.h>
 
 void kbemu_set_display(Display *dpy);
-KeySym kbemu_keysym(const char *str);
+#endif
+#endif	/* USE_X11 */
+
+/* parses the kbmapN strings of the current configuration into key chords, and
+ * resolves their keycodes. A chord is a list of key names joined with '+',
+ * pressed in order and released in reverse order (e.g. Control_L+Shift_L+z).
+ * Must be called after every configuration (re)load.
+ */
+void kbemu_config(void);
+/* resolves the X keycodes again, after a keyboard mapping change */
+void kbemu_refresh(void);
+
+/* emulates the key chord mapped to button bidx, if any. Returns 1 if the
+ * button is mapped to keys, or 0 if it should be handled as a regular button.
+ */
+int kbemu_button(int bidx, int press);
+/* non-zero if any button is mapped to keys */
+int kbemu_active(void);
+
+void kbemu_cleanup(void);
 
-void send_kbevent(KeySym key, int press);
+/* uinput keyboard backend (kbemu_uinput.c), used when there is no X server,
+ * or when configured with kbemu = uinput.
+ */
+int kbemu_uinput_open(void);
+void kbemu_uinput_close(void);
+/* linux key code for a key name (X keysym names), -1 if unknown */
+int kbemu_uinput_code(const char *name);
+void kbemu_uinput_send(const int *codes, int count, int press);
 
 #endif	/* KBEMU_H_ */
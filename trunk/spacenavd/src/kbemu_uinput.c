@@ -0,0 +1,193 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include "kbemu.h"
+
+#ifdef __linux__
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include "spnavd.h"
+
+static int uinput_fd = -1;
+
+/* key names follow the X keysym names, so that the same kbmap strings work
+ * with both the X11 and the uinput keyboard emulation.
+ */
+static struct {
+	const char *name;
+	int code;
+} keys[] = {
+	{"a", KEY_A}, {"b", KEY_B}, {"c", KEY_C}, {"d", KEY_D}, {"e", KEY_E},
+	{"f", KEY_F}, {"g", KEY_G}, {"h", KEY_H}, {"i", KEY_I}, {"j", KEY_J},
+	{"k", KEY_K}, {"l", KEY_L}, {"m", KEY_M}, {"n", KEY_N}, {"o", KEY_O},
+	{"p", KEY_P}, {"q", KEY_Q}, {"r", KEY_R}, {"s", KEY_S}, {"t", KEY_T},
+	{"u", KEY_U}, {"v", KEY_V}, {"w", KEY_W}, {"x", KEY_X}, {"y", KEY_Y},
+	{"z", KEY_Z},
+	{"0", KEY_0}, {"1", KEY_1}, {"2", KEY_2}, {"3", KEY_3}, {"4", KEY_4},
+	{"5", KEY_5}, {"6", KEY_6}, {"7", KEY_7}, {"8", KEY_8}, {"9", KEY_9},
+	{"F1", KEY_F1}, {"F2", KEY_F2}, {"F3", KEY_F3}, {"F4", KEY_F4},
+	{"F5", KEY_F5}, {"F6", KEY_F6}, {"F7", KEY_F7}, {"F8", KEY_F8},
+	{"F9", KEY_F9}, {"F10", KEY_F10}, {"F11", KEY_F11}, {"F12", KEY_F12},
+	{"Escape", KEY_ESC}, {"Tab", KEY_TAB}, {"Return", KEY_ENTER},
+	{"BackSpace", KEY_BACKSPACE}, {"Delete", KEY_DELETE}, {"Insert", KEY_INSERT},
+	{"Home", KEY_HOME}, {"End", KEY_END}, {"Prior", KEY_PAGEUP}, {"Page_Up", KEY_PAGEUP},
+	{"Next", KEY_PAGEDOWN}, {"Page_Down", KEY_PAGEDOWN},
+	{"Left", KEY_LEFT}, {"Right", KEY_RIGHT}, {"Up", KEY_UP}, {"Down", KEY_DOWN},
+	{"space", KEY_SPACE}, {"minus", KEY_MINUS}, {"equal", KEY_EQUAL},
+	{"bracketleft", KEY_LEFTBRACE}, {"bracketright", KEY_RIGHTBRACE},
+	{"semicolon", KEY_SEMICOLON}, {"apostrophe", KEY_APOSTROPHE}, {"grave", KEY_GRAVE},
+	{"backslash", KEY_BACKSLASH}, {"comma", KEY_COMMA}, {"period", KEY_DOT},
+	{"slash", KEY_SLASH},
+	{"Shift_L", KEY_LEFTSHIFT}, {"Shift_R", KEY_RIGHTSHIFT},
+	{"Control_L", KEY_LEFTCTRL}, {"Control_R", KEY_RIGHTCTRL},
+	{"Alt_L", KEY_LEFTALT}, {"Alt_R", KEY_RIGHTALT},
+	{"Meta_L", KEY_LEFTALT}, {"Meta_R", KEY_RIGHTALT},
+	{"Super_L", KEY_LEFTMETA}, {"Super_R", KEY_RIGHTMETA},
+	{"Caps_Lock", KEY_CAPSLOCK}, {"Print", KEY_SYSRQ}, {"Pause", KEY_PAUSE},
+	{"Menu", KEY_COMPOSE},
+	{"KP_Add", KEY_KPPLUS}, {"KP_Subtract", KEY_KPMINUS},
+	{"KP_Multiply", KEY_KPASTERISK}, {"KP_Divide", KEY_KPSLASH},
+	{"KP_Enter", KEY_KPENTER},
+	{"XF86AudioMute", KEY_MUTE}, {"XF86AudioLowerVolume", KEY_VOLUMEDOWN},
+	{"XF86AudioRaiseVolume", KEY_VOLUMEUP}, {"XF86AudioPlay", KEY_PLAYPAUSE},
+	{"XF86AudioNext", KEY_NEXTSONG}, {"XF86AudioPrev", KEY_PREVIOUSSONG},
+	{0, 0}
+};
+
+int kbemu_uinput_code(const char *name)
+{
+	int i;
+	char lower[2];
+
+	/* single letters map to the same key regardless of case */
+	if(name[0] && !name[1] && isalpha((unsigned char)name[0])) {
+		lower[0] = tolower((unsigned char)name[0]);
+		lower[1] = 0;
+		name = lower;
+	}
+
+	for(i=0; keys[i].name; i++) {
+		if(strcmp(keys[i].name, name) == 0) {
+			return keys[i].code;
+		}
+	}
+	return -1;
+}
+
+int kbemu_uinput_open(void)
+{
+	int i;
+	struct uinput_user_dev udev;
+
+	if(uinput_fd != -1) return 0;
+
+	if((uinput_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK)) == -1 &&
+			(uinput_fd = open("/dev/input/uinput", O_WRONLY | O_NONBLOCK)) == -1) {
+		fprintf(stderr, "failed to open uinput for keyboard emulation: %s\n", strerror(errno));
+		return -1;
+	}
+
+	ioctl(uinput_fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(uinput_fd, UI_SET_EVBIT, EV_SYN);
+	for(i=0; keys[i].name; i++) {
+		ioctl(uinput_fd, UI_SET_KEYBIT, keys[i].code);
+	}
+
+	memset(&udev, 0, sizeof udev);
+	strcpy(udev.name, "spacenavd virtual keyboard");
+	udev.id.bustype = BUS_VIRTUAL;
+	udev.id.version = 1;
+
+	if(write(uinput_fd, &udev, sizeof udev) != sizeof udev || ioctl(uinput_fd, UI_DEV_CREATE) == -1) {
+		fprintf(stderr, "failed to create uinput keyboard: %s\n", strerror(errno));
+		close(uinput_fd);
+		uinput_fd = -1;
+		return -1;
+	}
+
+	if(verbose) {
+		printf("created uinput keyboard for keyboard emulation\n");
+	}
+	return 0;
+}
+
+void kbemu_uinput_close(void)
+{
+	if(uinput_fd != -1) {
+		ioctl(uinput_fd, UI_DEV_DESTROY);
+		close(uinput_fd);
+		uinput_fd = -1;
+	}
+}
+
+void kbemu_uinput_send(const int *codes, int count, int press)
+{
+	int i, n = 0;
+	struct input_event ev[KBEMU_MAX_CHORD + 1];
+
+	if(uinput_fd == -1) return;
+
+	memset(ev, 0, sizeof ev);
+	for(i=0; i<count && i<KBEMU_MAX_CHORD; i++) {
+		int code = codes[press ? i : count - 1 - i];
+		if(code != -1) {
+			ev[n].type = EV_KEY;
+			ev[n].code = code;
+			ev[n].value = press;
+			n++;
+		}
+	}
+	if(!n) return;
+
+	ev[n].type = EV_SYN;
+	ev[n].code = SYN_REPORT;
+	n++;
+
+	/* the whole chord and the sync event in a single write */
+	if(write(uinput_fd, ev, n * sizeof *ev) == -1) {
+		fprintf(stderr, "failed to send uinput key events: %s\n", strerror(errno));
+	}
+}
+
+#else	/* !__linux__ */
+
+int kbemu_uinput_code(const char *name)
+{
+	return -1;
+}
+
+int kbemu_uinput_open(void)
+{
+	return -1;
+}
+
+void kbemu_uinput_close(void)
+{
+}
+
+void kbemu_uinput_send(const int *codes, int count, int press)
+{
+}
+#endif	/* __linux__ */
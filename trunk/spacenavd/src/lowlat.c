@@ -0,0 +1,146 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#define _GNU_SOURCE	/* for sched_setaffinity */
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "lowlat.h"
+#include "spnavd.h"
+#include "client.h"
+
+/* nice level used when realtime scheduling is not permitted */
+#define LOWLAT_NICE		(-10)
+
+/* storage preallocated for the event path */
+#define PREALLOC_CLIENTS		32
+
+static void set_sched(int enable);
+static void set_affinity(int cpu);
+
+static int active, prealloc_done;
+
+
+int set_low_latency(int enable)
+{
+	if(!enable) {
+		if(active) {
+			set_sched(0);
+			set_affinity(-1);
+			munlockall();
+			active = 0;
+			if(verbose) {
+				printf("low-latency mode disabled\n");
+			}
+		}
+		return 0;
+	}
+
+	/* allocate everything the event path needs up-front, so that nothing
+	 * has to be allocated (and faulted in) while processing input.
+	 */
+	if(!prealloc_done) {
+		spnav_core_prealloc(core, MAX_DEVICES);
+		prealloc_clients(PREALLOC_CLIENTS);
+		prealloc_done = 1;
+	}
+
+	if(!active) {
+		if(mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+			fprintf(stderr, "low-latency: failed to lock memory: %s\n", strerror(errno));
+		}
+		active = 1;
+	}
+
+	set_sched(1);
+	set_affinity(cfg.cpu_affinity);
+	return 0;
+}
+
+static void set_sched(int enable)
+{
+	struct sched_param sp;
+	int policy = cfg.rt_policy == RT_POLICY_RR ? SCHED_RR : SCHED_FIFO;
+
+	memset(&sp, 0, sizeof sp);
+
+	if(!enable) {
+		sched_setscheduler(0, SCHED_OTHER, &sp);
+		setpriority(PRIO_PROCESS, 0, 0);
+		return;
+	}
+
+	sp.sched_priority = cfg.rt_priority;
+	if(sp.sched_priority < sched_get_priority_min(policy)) {
+		sp.sched_priority = sched_get_priority_min(policy);
+	}
+	if(sp.sched_priority > sched_get_priority_max(policy)) {
+		sp.sched_priority = sched_get_priority_max(policy);
+	}
+
+	if(sched_setscheduler(0, policy, &sp) == 0) {
+		if(verbose) {
+			printf("low-latency: using %s scheduling, priority %d\n",
+					policy == SCHED_RR ? "SCHED_RR" : "SCHED_FIFO", sp.sched_priority);
+		}
+		return;
+	}
+	fprintf(stderr, "low-latency: failed to set realtime scheduling: %s, falling back to nice %d\n",
+			strerror(errno), LOWLAT_NICE);
+
+	if(setpriority(PRIO_PROCESS, 0, LOWLAT_NICE) == -1) {
+		fprintf(stderr, "low-latency: failed to set the nice level: %s\n", strerror(errno));
+	}
+}
+
+static void set_affinity(int cpu)
+{
+#if defined(__linux__) && defined(CPU_SET)
+	int i;
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	if(cpu >= 0) {
+		if(cpu >= CPU_SETSIZE) {
+			fprintf(stderr, "low-latency: invalid cpu-affinity: %d\n", cpu);
+			return;
+		}
+		CPU_SET(cpu, &set);
+	} else {
+		/* back to any cpu */
+		for(i=0; i<CPU_SETSIZE; i++) {
+			CPU_SET(i, &set);
+		}
+	}
+
+	if(sched_setaffinity(0, sizeof set, &set) == -1) {
+		if(cpu >= 0) {
+			fprintf(stderr, "low-latency: failed to pin to cpu %d: %s\n", cpu, strerror(errno));
+		}
+	} else if(verbose && cpu >= 0) {
+		printf("low-latency: pinned to cpu %d\n", cpu);
+	}
+#else
+	if(cpu >= 0) {
+		fprintf(stderr, "low-latency: cpu-affinity is not supported on this platform\n");
+	}
+#endif
+}
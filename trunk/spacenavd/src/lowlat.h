@@ -1,6 +1,6 @@
 /*
 spacenavd - a free software replacement driver for 6dof space-mice.
-Copyright (C) 2007-2010 John Tsiombikas <nuclear@member.fsf.org>
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
 
 This program is free software: you can redistribute it and/or modify
 it under the terms of the GNU General Public License as published by
@@ -15,34 +15,18 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
-
-#include <stdlib.h>
-#include "smag_event.h"
-
-int evpool_size = 0;
-static struct smag_event *ev_free_list;
-
-struct smag_event *alloc_event(void)
-{
-	struct smag_event *ev;
-
-	if(ev_free_list) {
-		ev = ev_free_list;
-		ev_free_list = ev->next;
-	} else {
-		ev = malloc(sizeof *ev);
-		evpool_size++;
-	}
-	return ev;
-}
-
-void free_event(struct smag_event *ev)
-{
-	if(evpool_size > 512) {
-		free(ev);
-		evpool_size--;
-	} else {
-		ev->next = ev_free_list;
-		ev_free_list = ev;
-	}
-}
+#ifndef LOWLAT_H_
+#define LOWLAT_H_
+
+/* Low-latency mode: realtime scheduling (falling back to a raised nice
+ * level), locked memory, preallocated event and client storage, and
+ * optionally a fixed CPU. Enabled with -l/--low-latency or the low-latency
+ * config option; the scheduling parameters come from rt-policy, rt-priority
+ * and cpu-affinity.
+ *
+ * set_low_latency applies the current configuration and can be called again
+ * after every reload; disabling it returns to normal scheduling.
+ */
+int set_low_latency(int enable);
+
+#endif	/* LOWLAT_H_ */
@@ -17,46 +17,82 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
-#include <termios.h>
-#include <sys/ioctl.h>
 #include "magellan/smag.h"
 #include "magellan/smag_comm.h"
-#include "magellan/smag_event.h"
 #include "magellan/serialconstants.h"
+#include "dev_serial.h"
+
+/* The magellan sends lines of printable characters, terminated by a carriage
+ * return, with the packet type in the first character. The parser is driven
+ * by the packet table: the type selects the expected length and the function
+ * which processes the packet. Anything which doesn't fit is counted and
+ * skipped up to the next carriage return.
+ *
+ * The input of a read is queued in a fixed ring, and handed out by
+ * smag_get_input before reading again. Reads are limited to SMAG_READ_SIZE,
+ * so that the ring always has room: at most 10 button changes per 5-byte key
+ * packet.
+ */
+#define SMAG_EVRING_SIZE	512		/* power of two */
+
+enum { ST_START, ST_PACKET, ST_SKIP };
+
+struct smag {
+	int fd;
+
+	int state;
+	const struct packet_type *ptype;
+	unsigned char packet_buf[MAXPACKETSIZE];
+	int packet_buf_pos;
 
-static void gen_disp_events(int *newval);
-static void proc_disp_packet(void);
-static void gen_button_event(int button, int new_state);
-static void read_copy(void);
-static void proc_disp_packet(void);
-static void proc_bn_k_packet(void);
-static void proc_bn_c_packet(void);
-static void proc_bn_n_packet(void);
-static void proc_bn_q_packet(void);
-static void clean_input();
+	struct dev_input evring[SMAG_EVRING_SIZE];
+	unsigned int evrd, evwr;
 
+	int oldval[6];		/* last reported motion */
+	int buttons;		/* last reported button state */
 
-static int dev_fd;
+	/* settings reported by the device (c, n, q packets) */
+	int mode, zero_radius, sens_rot, sens_trans;
 
-struct input_struct {
-	char rbuf[MAXREADSIZE];
-	int rbuf_sz;
-	char packet_buf[MAXPACKETSIZE];
-	int packet_buf_pos;
-	struct smag_event *evhead;
-	struct smag_event *evtail;
-} input;
+	struct serial_stats st;
+};
 
-static int first_byte_parity[16] = {
+struct packet_type {
+	int type;
+	int len;		/* including the type character, 0 for any up to MAXPACKETSIZE */
+	void (*proc)(struct smag*);
+};
+
+static void proc_disp_packet(struct smag *mag);
+static void proc_bn_k_packet(struct smag *mag);
+static void proc_bn_c_packet(struct smag *mag);
+static void proc_bn_n_packet(struct smag *mag);
+static void proc_bn_q_packet(struct smag *mag);
+
+static const struct packet_type packet_types[] = {
+	{'d', 15, proc_disp_packet},	/* displacement */
+	{'k', 4, proc_bn_k_packet},		/* keys */
+	{'c', 3, proc_bn_c_packet},		/* mode */
+	{'n', 2, proc_bn_n_packet},		/* zero radius */
+	{'q', 3, proc_bn_q_packet},		/* sensitivity */
+	{'v', 0, 0},					/* version string (detection) */
+	{'b', 0, 0},					/* beep acknowledgement */
+	{'z', 0, 0},					/* zero acknowledgement */
+	{0, 0, 0}
+};
+
+/* the values are sent 4 and 6 bits at a time, in characters with parity bits
+ * in the upper bits.
+ */
+static const int first_byte_parity[16] = {
 	0xE0, 0xA0, 0xA0, 0x60, 0xA0, 0x60, 0x60, 0xA0,
 	0x90, 0x50, 0x50, 0x90, 0xD0, 0x90, 0x90, 0x50
 };
 
-static int second_byte_parity[64] = {
+static const int second_byte_parity[64] = {
 	0x80, 0x40, 0x40, 0x80, 0x40, 0x80, 0x80, 0x40,
 	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
 	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x40, 0x80,
@@ -67,357 +103,307 @@ static int second_byte_parity[64] = {
 	0x40, 0x80, 0x80, 0x40, 0x80, 0x40, 0x00, 0x80
 };
 
-void smag_init_device(int fd)
-{
-	smag_write(fd, "", 0);
-	smag_write(fd, "\r\rm0", 4);
-	smag_write(fd, "pAA", 3);
-	smag_write(fd, "q00", 3);	/*default translation and rotation */
-	smag_write(fd, "nM", 2);	/*zero radius. 0-15 defaults to 13 */
-	smag_write(fd, "z", 1);		/*zero device */
-	smag_write(fd, "c33", 3);	/*set translation, rotation on and dominant axis off */
-	smag_write(fd, "l2\r\0", 4);
-	smag_write(fd, "\r\r", 2);
-	smag_write(fd, "l300", 4);
-	smag_write(fd, "b9", 2);	/*these are beeps */
-	smag_write(fd, "b9", 2);
-
-	usleep(SMAG_DELAY_USEC);
-	tcflush(fd, TCIOFLUSH);
-	clean_input();
-}
+/* built from the above by init_tables: the value of every possible character,
+ * or -1 if its parity is wrong.
+ */
+static signed char first_decode[256], second_decode[256];
+static const struct packet_type *packet_table[256];
+static int tables_valid;
+
+/* button bits of the key packet */
+static const struct {
+	int byte, mask;
+} key_bits[] = {
+	{1, 0x01}, {1, 0x02}, {1, 0x04}, {1, 0x08},	/* 1-4 */
+	{2, 0x01}, {2, 0x02}, {2, 0x04}, {2, 0x08},	/* 5-8 */
+	/* the asterisk (3, 0x01) comes in through other packets */
+	{3, 0x02}, {3, 0x04},						/* left, right (magellan plus) */
+	{0, 0}
+};
+
+const struct smag_cmd smag_init_cmd[] = {
+	{"", 0},
+	{"\r\rm0", 4},
+	{"pAA", 3},
+	{"q00", 3},		/*default translation and rotation */
+	{"nM", 2},		/*zero radius. 0-15 defaults to 13 */
+	{"z", 1},		/*zero device */
+	{"c33", 3},		/*set translation, rotation on and dominant axis off */
+	{"l2\r\0", 4},
+	{"\r\r", 2},
+	{"l300", 4},
+	{"b9", 2},		/*these are beeps */
+	{"b9", 2},
+	{0, 0}
+};
+
+/* puts the device in a quiet state, so that the version string is the only
+ * thing it sends after the query.
+ */
+const struct smag_cmd smag_version_cmd[] = {
+	{"\r\rm0", 4},
+	{"", 0},
+	{"\r\rm0", 4},
+	{"c03", 3},
+	{"z", 1},
+	{"Z", 1},
+	{"l000", 4},
+	{0, 0}
+};
 
-static void read_copy(void)
+const struct smag_cmd smag_query_cmd[] = {
+	{"vQ", 2},
+	{0, 0}
+};
+
+static void init_tables(void)
 {
 	int i;
 
-	for(i=0; i<input.rbuf_sz; i++) {
-		if(input.rbuf[i] == '\n' || input.rbuf[i] == '\r') {
-			input.packet_buf[input.packet_buf_pos] = 0;	/* terminate string */
-
-			if(input.packet_buf[0] == 'd' && input.packet_buf_pos == 15) {
-				proc_disp_packet();
-			} else if(input.packet_buf[0] == 'k' && input.packet_buf_pos == 4) {
-				proc_bn_k_packet();
-			} else if(input.packet_buf[0] == 'c' && input.packet_buf_pos == 3) {
-				proc_bn_c_packet();
-			} else if(input.packet_buf[0] == 'n' && input.packet_buf_pos == 2) {
-				proc_bn_n_packet();
-			} else if(input.packet_buf[0] == 'q' && input.packet_buf_pos == 3) {
-				proc_bn_q_packet();
-			} else {
-				fprintf(stderr, "unknown packet   %s\n", input.packet_buf);
-			}
-			input.packet_buf_pos = 0;
-		} else {
-			input.packet_buf[input.packet_buf_pos] = input.rbuf[i];
-			input.packet_buf_pos++;
-			if(input.packet_buf_pos == MAXPACKETSIZE) {
-				input.packet_buf_pos = 0;
-				fprintf(stderr, "packet buffer overrun\n");
-			}
-		}
+	if(tables_valid) return;
+
+	for(i=0; i<256; i++) {
+		first_decode[i] = (i & 0xf0) == first_byte_parity[i & 0x0f] ? i & 0x0f : -1;
+		second_decode[i] = (i & 0xc0) == second_byte_parity[i & 0x3f] ? i & 0x3f : -1;
+	}
+	for(i=0; packet_types[i].type; i++) {
+		packet_table[packet_types[i].type] = packet_types + i;
 	}
+	tables_valid = 1;
 }
 
-int open_smag(const char *devfile)
+
+struct smag *smag_create(int fd)
 {
-	if((dev_fd = smag_open_device(devfile)) == -1) {
-		return -1;
+	struct smag *mag;
+
+	init_tables();
+
+	if(!(mag = malloc(sizeof *mag))) {
+		return 0;
 	}
-	smag_set_port_magellan(dev_fd);
-	smag_init_device(dev_fd);
-	clean_input();
-	return 0;
+	memset(mag, 0, sizeof *mag);
+	mag->fd = fd;
+	return mag;
 }
 
-int close_smag()
+void smag_destroy(struct smag *mag)
 {
-	smag_write(dev_fd, "l000", 4);
-	close(dev_fd);
-	return 0;
+	if(mag->fd >= 0) {
+		smag_write(mag->fd, "l000", 4);
+		close(mag->fd);
+	}
+	free(mag);
 }
 
-int read_smag(struct dev_input *inp)
+int smag_get_fd(struct smag *mag)
 {
-	/*need to return 1 if we fill in inp or 0 if no events */
-	struct smag_event *ev;
+	return mag->fd;
+}
 
-	input.rbuf_sz = smag_read(dev_fd, input.rbuf, MAXREADSIZE);
-	if(input.rbuf_sz > 0) {
-		read_copy();
+int smag_get_input(struct smag *mag, struct dev_input *inp)
+{
+	int sz;
+	char buf[SMAG_READ_SIZE];
+
+	/* only read when everything from the previous read has been handed out */
+	if(mag->evrd == mag->evwr) {
+		mag->evrd = mag->evwr = 0;
+		if(mag->fd < 0 || (sz = smag_read(mag->fd, buf, sizeof buf)) <= 0) {
+			return 0;
+		}
+		smag_parse(mag, buf, sz);
+		if(mag->evrd == mag->evwr) {
+			return 0;
+		}
 	}
-	ev = input.evhead;
-	if(ev) {
-		input.evhead = input.evhead->next;
 
-		*inp = ev->data;
-		free_event(ev);
-		return 1;
-	}
-	return 0;
+	*inp = mag->evring[mag->evrd++ & (SMAG_EVRING_SIZE - 1)];
+	return 1;
 }
 
-int get_fd_smag()
+void smag_get_stats(struct smag *mag, struct serial_stats *st)
 {
-	return dev_fd;
+	*st = mag->st;
 }
 
-void get_version_string(int fd, char *buf, int sz)
+int smag_parse(struct smag *mag, const void *data, int sz)
 {
-	int bytesrd;
-	char tmpbuf[MAXREADSIZE];
-
-	smag_write(fd, "\r\rm0", 4);
-	smag_write(fd, "", 0);
-	smag_write(fd, "\r\rm0", 4);
-	smag_write(fd, "c03", 3);
-	smag_write(fd, "z", 1);
-	smag_write(fd, "Z", 1);
-	smag_write(fd, "l000", 4);
-	usleep(SMAG_DELAY_USEC);
-	tcflush(fd, TCIOFLUSH);
-	clean_input();
-	smag_write(fd, "vQ", 2);
-
-	bytesrd = smag_read(fd, tmpbuf, MAXREADSIZE);
-	if(bytesrd > 0 && bytesrd < sz) {
-		strcpy(buf, tmpbuf);
+	int c;
+	unsigned int start = mag->evwr;
+	const unsigned char *ptr = data;
+	const unsigned char *end = ptr + sz;
+
+	mag->st.bytes += sz;
+
+	while(ptr < end) {
+		c = *ptr++;
+
+		if(c == '\r' || c == '\n') {
+			if(mag->state == ST_PACKET) {
+				if(!mag->ptype->len || mag->packet_buf_pos == mag->ptype->len) {
+					mag->st.packets++;
+					if(mag->ptype->proc) {
+						mag->ptype->proc(mag);
+					}
+				} else {
+					mag->st.bad_packets++;	/* cut short */
+				}
+			}
+			mag->state = ST_START;
+			continue;
+		}
+
+		switch(mag->state) {
+		case ST_START:
+			if(!(mag->ptype = packet_table[c])) {
+				mag->st.unknown++;
+				mag->state = ST_SKIP;
+				break;
+			}
+			mag->packet_buf[0] = c;
+			mag->packet_buf_pos = 1;
+			mag->state = ST_PACKET;
+			break;
+
+		case ST_PACKET:
+			if(mag->packet_buf_pos >= (mag->ptype->len ? mag->ptype->len : MAXPACKETSIZE)) {
+				if(mag->ptype->len) {
+					mag->st.overruns++;
+				}
+				mag->state = ST_SKIP;
+				break;
+			}
+			mag->packet_buf[mag->packet_buf_pos++] = c;
+			break;
+
+		case ST_SKIP:
+		default:
+			break;
+		}
 	}
-	clean_input();
+	return mag->evwr - start;
 }
 
+static void append_event(struct smag *mag, int type, int idx, int val)
+{
+	struct dev_input *inp;
+
+	if(mag->evwr - mag->evrd >= SMAG_EVRING_SIZE) {
+		mag->st.dropped++;
+		return;
+	}
+	inp = mag->evring + (mag->evwr++ & (SMAG_EVRING_SIZE - 1));
+	inp->type = type;
+	inp->idx = idx;
+	inp->val = val;
+	/* no device timestamp for serial input */
+	inp->tm.tv_sec = inp->tm.tv_usec = 0;
+}
 
-static void gen_disp_events(int *newval)
+static void gen_disp_events(struct smag *mag, int *newval)
 {
-	int i, pending;
-	static int oldval[6] = {0, 0, 0, 0, 0, 0};
-	struct smag_event *newev;
+	int i, pending = 0;
 
-	pending = 0;
 	for(i=0; i<6; i++) {
-		if(newval[i] == oldval[i]) {
-			continue;
-		}
-		oldval[i] = newval[i];
-
-		newev = alloc_event();
-		if(newev) {
-			newev->data.type = INP_MOTION;
-			newev->data.idx = i;
-			newev->data.val = newval[i];
-			newev->next = 0;
-
-			if(input.evhead) {
-				input.evtail->next = newev;
-				input.evtail = newev;
-			} else
-				input.evhead = input.evtail = newev;
+		if(newval[i] != mag->oldval[i]) {
+			mag->oldval[i] = newval[i];
+			append_event(mag, INP_MOTION, i, newval[i]);
 			pending = 1;
 		}
 	}
 
 	if(pending) {
-		newev = alloc_event();
-		if(newev) {
-			newev->data.type = INP_FLUSH;
-			newev->next = 0;
-		}
-
-		if(input.evhead) {
-			input.evtail->next = newev;
-			input.evtail = newev;
-		} else {
-			input.evhead = input.evtail = newev;
-		}
+		append_event(mag, INP_FLUSH, 0, 0);
 	}
 }
 
-static void proc_disp_packet(void)
+static void proc_disp_packet(struct smag *mag)
 {
-	int i, last_bytes, offset, values[6];
-	short int accum_last, number, accum_last_adj;
+	int i, hi, lo, number, accum_last, offset, values[6];
+	unsigned char *packet_buf = mag->packet_buf;
 
 	accum_last = offset = 0;
 
-	for(i=1; i<13; i+=2) {
-		/*first byte check */
-		unsigned char low, up;
-
-		low = input.packet_buf[i] & 0x0F;
-		up = input.packet_buf[i] & 0xF0;
-		if(up != first_byte_parity[low]) {
-			fprintf(stderr, "bad first packet\n");
-			return;
-		}
-
-		/*second byte check */
-		low = input.packet_buf[i + 1] & 0x3F;
-		up = input.packet_buf[i + 1] & 0xC0;
-		if(up != second_byte_parity[low]) {
-			fprintf(stderr, "bad second packet\n");
+	for(i=0; i<6; i++) {
+		hi = first_decode[packet_buf[i * 2 + 1]];
+		lo = second_decode[packet_buf[i * 2 + 2]];
+		if(hi < 0 || lo < 0) {
+			mag->st.bad_packets++;	/* parity */
 			return;
 		}
 
-		number = (short int)((input.packet_buf[i] << 6 & 0x03C0) | (input.packet_buf[i + 1] & 0x3F));
+		/* 10 bit signed */
+		number = (hi << 6) | lo;
 		if(number > 512) {
 			number -= 1024;
 		}
 		accum_last += number;
 
 		if(number < 0) {
-			offset += ((int)(number + 1) / 64) - 1;
+			offset += (number + 1) / 64 - 1;
 		} else {
-			offset += (int)number / 64;
+			offset += number / 64;
 		}
-		/*printf("%8i ", number); */
-		values[(i + 1) / 2 - 1] = number;
+		values[i] = number;
 	}
 
-	/*last byte of packet is a sum of 6 numbers and a factor of 64. use as a packet check.
-	   still not sure what the second to last byte is for. */
-	accum_last_adj = accum_last & 0x003F;
-	accum_last_adj += offset;
-	if(accum_last_adj < 0) {
-		accum_last_adj += 64;
+	/* the last character of the packet is the sum of the 6 numbers, adjusted
+	 * by the number of times they wrap at 64, as a packet check. still not
+	 * sure what the one before it is for.
+	 */
+	accum_last = (short)accum_last & 0x3f;
+	accum_last += offset;
+	if(accum_last < 0) {
+		accum_last += 64;
 	}
-	if(accum_last_adj > 63) {
-		accum_last_adj -= 64;
+	if(accum_last > 63) {
+		accum_last -= 64;
 	}
 
-	last_bytes = (short int)(input.packet_buf[14] & 0x3F);
-
-	if(accum_last_adj != last_bytes) {
-		printf("   bad packet\n");
+	if(accum_last != (packet_buf[14] & 0x3f)) {
+		mag->st.bad_packets++;	/* checksum */
 		return;
 	}
-	gen_disp_events(values);
-	return;
+	gen_disp_events(mag, values);
 }
 
-static void gen_button_event(int button, int new_state)
+static void proc_bn_k_packet(struct smag *mag)
 {
-	struct smag_event *newev = alloc_event();
-
-	if(!newev) {
-		return;
-	}
-
-	newev->data.type = INP_BUTTON;
-	newev->data.idx = button;
-	newev->data.val = new_state;
-	newev->next = 0;
-
-	if(input.evhead) {
-		input.evtail->next = newev;
-		input.evtail = newev;
-	} else {
-		input.evhead = input.evtail = newev;
-	}
-}
-
-static void proc_bn_k_packet(void)
-{
-	static char old_state[5] = { 0, 0, 0, 0, 0 };
-
-	if(input.packet_buf[1] != old_state[1]) {
-		if((input.packet_buf[1] & 0x01) != (old_state[1] & 0x01)) {
-			gen_button_event(0, input.packet_buf[1] & 0x01);
-		}
-		if((input.packet_buf[1] & 0x02) != (old_state[1] & 0x02)) {
-			gen_button_event(1, input.packet_buf[1] & 0x02);
-		}
-		if((input.packet_buf[1] & 0x04) != (old_state[1] & 0x04)) {
-			gen_button_event(2, input.packet_buf[1] & 0x04);
-		}
-		if((input.packet_buf[1] & 0x08) != (old_state[1] & 0x08)) {
-			gen_button_event(3, input.packet_buf[1] & 0x08);
-		}
-	}
+	int i, bit, state = 0;
 
-	if(input.packet_buf[2] != old_state[2]) {
-		if((input.packet_buf[2] & 0x01) != (old_state[2] & 0x01)) {
-			gen_button_event(4, input.packet_buf[2] & 0x01);
-		}
-		if((input.packet_buf[2] & 0x02) != (old_state[2] & 0x02)) {
-			gen_button_event(5, input.packet_buf[2] & 0x02);
-		}
-		if((input.packet_buf[2] & 0x04) != (old_state[2] & 0x04)) {
-			gen_button_event(6, input.packet_buf[2] & 0x04);
-		}
-		if((input.packet_buf[2] & 0x08) != (old_state[2] & 0x08)) {
-			gen_button_event(7, input.packet_buf[2] & 0x08);
+	for(i=0; key_bits[i].mask; i++) {
+		if(mag->packet_buf[key_bits[i].byte] & key_bits[i].mask) {
+			state |= 1 << i;
 		}
 	}
 
-	/*skipping asterisk button. asterisk function come in through other packets. */
-	/*magellan plus has left and right (10, 11) buttons not magellan classic */
-	/*not sure if we need to filter out lower button events for magellan classic */
-
-	if(input.packet_buf[3] != old_state[3]) {
-		/*
-		   if (input.packet_buf[3] & 0x01)
-		   printf("button asterisk   ");
-		 */
-		if((input.packet_buf[3] & 0x02) != (old_state[3] & 0x02)) {
-			gen_button_event(8, input.packet_buf[3] & 0x02);	/*left button */
-		}
-		if((input.packet_buf[3] & 0x04) != (old_state[3] & 0x04)) {
-			gen_button_event(9, input.packet_buf[3] & 0x04);	/*right button */
+	for(i=0; key_bits[i].mask; i++) {
+		bit = 1 << i;
+		if((state & bit) != (mag->buttons & bit)) {
+			append_event(mag, INP_BUTTON, i, (state & bit) ? 1 : 0);
 		}
 	}
-
-	strcpy(old_state, input.packet_buf);
+	mag->buttons = state;
 }
 
-static void proc_bn_c_packet(void)
+/* These are implemented at the device, and these packets are to keep the
+ * driver in sync. They answer the commands sent by the detection.
+ */
+static void proc_bn_c_packet(struct smag *mag)
 {
-	/*these are implemented at device and these signals are to keep the driver in sync */
-	if(input.packet_buf[1] & 0x02) {
-		printf("translation is on   ");
-	} else {
-		printf("translation is off   ");
-	}
-
-	if(input.packet_buf[1] & 0x01) {
-		printf("rotation is on   ");
-	} else {
-		printf("rotation is off   ");
-	}
-
-	if(input.packet_buf[1] & 0x04) {
-		printf("dominant axis is on   ");
-	} else {
-		printf("dominant axis is off   ");
-	}
-
-	printf("\n");
-	/*printf("%s\n", input.packet_buf); */
+	/* 1: rotation on, 2: translation on, 4: dominant axis on */
+	mag->mode = mag->packet_buf[1] & 0x07;
 }
 
-static void proc_bn_n_packet(void)
+static void proc_bn_n_packet(struct smag *mag)
 {
-	int radius;
-
-	radius = (int)input.packet_buf[1] & 0x0F;
-	printf("zero radius set to %i\n", radius);
+	mag->zero_radius = mag->packet_buf[1] & 0x0f;
 }
 
-static void proc_bn_q_packet(void)
+static void proc_bn_q_packet(struct smag *mag)
 {
 	/* this has no effect on the device numbers. Driver is to implement any scale of numbers */
-	int rotation, translation;
-
-	rotation = (int)input.packet_buf[1] & 0x07;
-	translation = (int)input.packet_buf[2] & 0x07;
-	printf("rotation = %i   translation = %i\n", rotation, translation);
-}
-
-
-static void clean_input(void)
-{
-	memset(input.rbuf, 0x00, MAXREADSIZE);
-	input.rbuf_sz = 0;
-	memset(input.packet_buf, 0x00, MAXPACKETSIZE);
-	input.packet_buf_pos = 0;
+	mag->sens_rot = mag->packet_buf[1] & 0x07;
+	mag->sens_trans = mag->packet_buf[2] & 0x07;
 }
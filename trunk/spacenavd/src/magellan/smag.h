@@ -17,15 +17,51 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#ifndef SMAG_H_
+#define SMAG_H_
+
 #include "event.h"
 
-int open_smag(const char *devfile);
-int close_smag();
-int read_smag(struct dev_input *inp);
-int get_fd_smag();
+/* most bytes smag_parse can take at a time */
+#define SMAG_READ_SIZE	128
+/* motion values are 10 bit signed */
+#define SMAG_MAX_VALUE	512
+
+struct smag;
+struct serial_stats;
+
+/* a command for the device. The device is slow, so the characters are sent
+ * one at a time (SMAG_DELAY_USEC apart), followed by a carriage return
+ * (and SMAG_CMD_DELAY_MSEC).
+ */
+struct smag_cmd {
+	const char *str;
+	int len;
+};
+
+/* command sequences, terminated by a null str */
+extern const struct smag_cmd smag_init_cmd[];		/* initialize the device */
+extern const struct smag_cmd smag_version_cmd[];	/* prepare for the version query */
+extern const struct smag_cmd smag_query_cmd[];		/* query the version string */
+
+/* takes over fd, which must be set up with smag_set_port_magellan, and the
+ * device initialized (smag_init_cmd). fd can be -1 to only use the parser
+ * (smag_parse).
+ */
+struct smag *smag_create(int fd);
+void smag_destroy(struct smag *mag);
+
+int smag_get_fd(struct smag *mag);
+/* returns 1 and fills inp if there is pending input, 0 otherwise. The device
+ * is only read when all input from the previous read has been returned.
+ */
+int smag_get_input(struct smag *mag, struct dev_input *inp);
 
-void get_version_string(int fd, char *buf, int sz);
+/* parses sz bytes of device data (up to SMAG_READ_SIZE), which can end
+ * anywhere in a packet, and queues the resulting input for smag_get_input.
+ * Returns the number of inputs queued.
+ */
+int smag_parse(struct smag *mag, const void *data, int sz);
+void smag_get_stats(struct smag *mag, struct serial_stats *st);
 
-void smag_init_device(int fd);
-void clearInput(void);
-void readCopy(void);
+#endif	/* SMAG_H_ */
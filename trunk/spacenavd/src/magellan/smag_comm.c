@@ -22,8 +22,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <sys/select.h>
-#include <sys/time.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <termios.h>
@@ -60,6 +58,9 @@ int smag_set_port_spaceball(int fd)
 	}
 
 	if(ioctl(fd, TIOCMGET, &status) == -1) {
+		if(errno == ENOTTY || errno == EINVAL) {
+			return 0;	/* no modem control lines (pseudo-terminal) */
+		}
 		perror("error TIOMCGET");
 		return -1;
 	}
@@ -97,6 +98,9 @@ int smag_set_port_magellan(int fd)
 	}
 
 	if(ioctl(fd, TIOCMGET, &status) == -1) {
+		if(errno == ENOTTY || errno == EINVAL) {
+			return 0;	/* no modem control lines (pseudo-terminal) */
+		}
 		perror("error TIOCMGET");
 		return -1;
 	}
@@ -109,8 +113,6 @@ int smag_set_port_magellan(int fd)
 	return 0;
 }
 
-#define LONG_DELAY	150000
-
 void smag_write(int fd, const char *buf, int sz)
 {
 	int i;
@@ -120,7 +122,6 @@ void smag_write(int fd, const char *buf, int sz)
 		usleep(SMAG_DELAY_USEC);
 	}
 	write(fd, "\r", 1);
-	usleep(LONG_DELAY);
 }
 
 int smag_read(int fd, char *buf, int sz)
@@ -133,21 +134,3 @@ int smag_read(int fd, char *buf, int sz)
 	return bytesrd;
 }
 
-int smag_wait_read(int fd, char *buf, int sz, int wait_sec)
-{
-	int res;
-	fd_set set;
-	struct timeval tv;
-
-	FD_ZERO(&set);
-	FD_SET(fd, &set);
-
-	tv.tv_sec = wait_sec;
-	tv.tv_usec = 0;
-
-	do {
-		res = select(fd + 1, &set, 0, 0, &tv);
-	} while(res == -1 && errno == EINTR);
-
-	return res == -1 ? -1 : smag_read(fd, buf, sz);
-}
@@ -20,13 +20,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef SMAG_COMM_H_
 #define SMAG_COMM_H_
 
-#define SMAG_DELAY_USEC	2000
+/* delay between the characters of a command, and after the whole command */
+#define SMAG_DELAY_USEC		2000
+#define SMAG_CMD_DELAY_MSEC	150
 
 int smag_open_device(const char *fname);
 int smag_set_port_spaceball(int fd);
 int smag_set_port_magellan(int fd);
+/* writes a command, blocks for sz * SMAG_DELAY_USEC */
 void smag_write(int fd, const char *buf, int sz);
 int smag_read(int fd, char *buf, int sz);
-int smag_wait_read(int fd, char *buf, int sz, int wait_sec);
 
 #endif
@@ -1,25 +0,0 @@
-/*
-serial magellan device support for spacenavd
-
-Copyright (C) 2012 John Tsiombikas <nuclear@member.fsf.org>
-Copyright (C) 2010 Thomas Anderson <ta@nextgenengineering.com>
-
-This program is free software: you can redistribute it and/or modify
-it under the terms of the GNU General Public License as published by
-the Free Software Foundation, either version 3 of the License, or
-(at your option) any later version.
-
-This program is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the GNU General Public License
-along with this program.  If not, see <http://www.gnu.org/licenses/>.
-*/
-#ifndef SMAG_DETECT_H_
-#define SMAG_DETECT_H_
-
-int smag_detect(const char *fname, char *buf, int sz);
-
-#endif	/* SMAG_DETECT_H_ */
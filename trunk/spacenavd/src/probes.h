@@ -0,0 +1,54 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PROBES_H_
+#define PROBES_H_
+
+#include "config.h"
+
+/* USDT static probes of the spacenavd provider, for tracing with bpftrace,
+ * perf or systemtap (see doc/bpftrace). A probe is a single nop until it's
+ * traced, and they are compiled out if sys/sdt.h is not available.
+ *
+ *   read_evdev_entry(devid)            read_evdev_return(devid, result)
+ *   input_motion(devid, axis, value)   input_button(devid, button, press)
+ *   input_flush(devid)                 repeat(devid)
+ *   dispatch_start(devid, evtype)      dispatch_end(devid, subscribers)
+ *   send_uevent(socket, bytes)         send_uevent_return(socket, result)
+ *   send_xevent(window, bytes)
+ *   hotplug_start()                    hotplug_end(result)
+ *   reload_start()                     reload_end(usec)
+ *
+ * Write results are the bytes written or -errno, and 0 for a send queued to
+ * io_uring.
+ */
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE(name)					DTRACE_PROBE(spacenavd, name)
+#define PROBE1(name, a)				DTRACE_PROBE1(spacenavd, name, a)
+#define PROBE2(name, a, b)			DTRACE_PROBE2(spacenavd, name, a, b)
+#define PROBE3(name, a, b, c)		DTRACE_PROBE3(spacenavd, name, a, b, c)
+#else
+#define PROBE(name)					((void)0)
+#define PROBE1(name, a)				((void)(a))
+#define PROBE2(name, a, b)			((void)(a), (void)(b))
+#define PROBE3(name, a, b, c)		((void)(a), (void)(b), (void)(c))
+#endif
+
+#endif	/* PROBES_H_ */
@@ -0,0 +1,191 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "proto_net.h"
+#include "dev_net.h"
+#include "spnavd.h"
+#include "stats.h"
+
+static int send_frame(int flags);
+
+static int sock = -1;
+static struct client *nclient;
+static char cur_addr[sizeof cfg.net_forward];
+static int cur_ttl;
+
+static struct net_frame state;
+static unsigned long long last_send;
+
+
+int init_net(void)
+{
+	struct sockaddr_in sa;
+	unsigned char ttl, loop = 1;
+
+	if(!cfg.net_forward[0]) {
+		close_net();
+		return 0;
+	}
+	if(sock != -1) {
+		if(strcmp(cfg.net_forward, cur_addr) == 0 && cfg.net_ttl == cur_ttl) {
+			return 0;
+		}
+		close_net();
+	}
+
+	memset(&sa, 0, sizeof sa);
+	sa.sin_family = AF_INET;
+	if(!strchr(cfg.net_forward, ':') || net_parse_addr(cfg.net_forward, &sa) == -1) {
+		fprintf(stderr, "invalid forward address: %s, expected host:port\n", cfg.net_forward);
+		return -1;
+	}
+
+	if((sock = socket(PF_INET, SOCK_DGRAM, 0)) == -1) {
+		perror("failed to create forwarding socket");
+		return -1;
+	}
+	fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+	if(IN_MULTICAST(ntohl(sa.sin_addr.s_addr))) {
+		ttl = cfg.net_ttl;
+		setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof ttl);
+		/* so that receivers on this host get it too */
+		setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof loop);
+	}
+
+	if(connect(sock, (struct sockaddr*)&sa, sizeof sa) == -1) {
+		fprintf(stderr, "failed to set the forward address %s: %s\n", cfg.net_forward, strerror(errno));
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+
+	if(!(nclient = add_client(CLIENT_NET, &sock))) {
+		fprintf(stderr, "failed to add the forwarding client\n");
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+
+	strcpy(cur_addr, cfg.net_forward);
+	cur_ttl = cfg.net_ttl;
+
+	/* a new session, receivers start over instead of taking the restarted
+	 * sequence numbers for old frames.
+	 */
+	memset(&state, 0, sizeof state);
+	state.session = (unsigned int)getpid() ^ (unsigned int)get_time_usec();
+
+	printf("forwarding events to %s:%d\n", inet_ntoa(sa.sin_addr), ntohs(sa.sin_port));
+	send_frame(0);
+	return 0;
+}
+
+void close_net(void)
+{
+	if(nclient) {
+		remove_client(nclient);
+		nclient = 0;
+	}
+	if(sock != -1) {
+		close(sock);
+		sock = -1;
+	}
+	cur_addr[0] = 0;
+}
+
+void send_net_event(spnav_event *ev, struct client *c)
+{
+	int i;
+	unsigned long long bit;
+
+	if(sock == -1) return;
+
+	switch(ev->type) {
+	case EVENT_MOTION:
+		for(i=0; i<6; i++) {
+			state.motion[i] = ev->motion.data[i];
+		}
+		state.period = ev->motion.period;
+		break;
+
+	case EVENT_BUTTON:
+		if(ev->button.bnum < 0 || ev->button.bnum >= 64) {
+			return;
+		}
+		bit = 1ULL << ev->button.bnum;
+		if(ev->button.press) {
+			state.buttons |= bit;
+		} else {
+			state.buttons &= ~bit;
+		}
+		break;
+
+	default:
+		return;
+	}
+
+	send_frame(0);
+}
+
+long send_net_repeat(void)
+{
+	unsigned long long now, interval;
+
+	if(sock == -1) {
+		return -1;
+	}
+	now = get_time_usec();
+	interval = (unsigned long long)cfg.net_interval * 1000;
+
+	if(now >= last_send + interval) {
+		send_frame(NET_FRAME_REPEAT);
+		stats.net_repeats++;
+		return (long)interval;
+	}
+	return (long)(last_send + interval - now);
+}
+
+static int send_frame(int flags)
+{
+	unsigned char buf[NET_FRAME_MAX_SIZE];
+	int size;
+
+	state.flags = flags;
+	state.seq++;
+	state.time_usec = last_send = get_time_usec();
+	size = net_encode_frame(&state, buf);
+
+	stats.net_frames++;
+	if(send(sock, buf, size, 0) == -1) {
+		/* nobody listening (ICMP port unreachable on unicast), or a full
+		 * socket buffer. Either way the next frame has the same state.
+		 */
+		stats.net_send_errors++;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,44 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PROTO_NET_H_
+#define PROTO_NET_H_
+
+#include "config.h"
+#include "event.h"
+#include "client.h"
+
+/* Forwards the processed motion and button events of the local devices over
+ * UDP to the forward address (unicast or multicast), for another spacenavd
+ * to receive them as a network device (see dev_net.h). Every frame carries
+ * the absolute state, and the state is repeated every forward-interval while
+ * there are no events, so the receivers ride out lost frames.
+ *
+ * init_net creates, re-creates or removes the socket to match the current
+ * configuration, and must be called whenever it changes.
+ */
+int init_net(void);
+void close_net(void);
+
+void send_net_event(spnav_event *ev, struct client *c);
+
+/* sends a frame repeating the state if one is due, returns the microseconds
+ * until the next one, or -1 if forwarding is disabled.
+ */
+long send_net_repeat(void);
+
+#endif	/* PROTO_NET_H_ */
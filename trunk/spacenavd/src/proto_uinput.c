@@ -0,0 +1,249 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <stdio.h>
+#include "proto_uinput.h"
+#include "spnavd.h"
+
+#ifdef __linux__
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include "dev.h"
+
+/* motion range of devices which don't know theirs */
+#define DEF_INPUT_RANGE		500
+
+#define NUM_BUTTONS		50
+
+static int create_device(const int *range);
+static void destroy_device(void);
+static void calc_range(int *range);
+static int button_code(int bnum);
+
+static int ufd = -1;
+static struct client *uclient;
+static int cur_range[6];
+
+
+int init_uinput(void)
+{
+	int range[6];
+
+	if(!cfg.uinput) {
+		close_uinput();
+		return 0;
+	}
+
+	calc_range(range);
+	if(ufd != -1) {
+		if(memcmp(range, cur_range, sizeof range) == 0) {
+			return 0;
+		}
+		/* the axis ranges can't be changed on a live uinput device */
+		if(verbose) {
+			printf("motion range changed, re-creating the uinput device\n");
+		}
+		destroy_device();
+	}
+
+	if(create_device(range) == -1) {
+		return -1;
+	}
+
+	if(!uclient && !(uclient = add_client(CLIENT_UINPUT, &ufd))) {
+		fprintf(stderr, "failed to add the uinput client\n");
+		destroy_device();
+		return -1;
+	}
+	return 0;
+}
+
+void update_uinput(void)
+{
+	if(ufd != -1) {
+		init_uinput();
+	}
+}
+
+void close_uinput(void)
+{
+	if(uclient) {
+		remove_client(uclient);
+		uclient = 0;
+	}
+	destroy_device();
+}
+
+void send_uinput_event(spnav_event *ev, struct client *c)
+{
+	int i, n = 0, code;
+	struct input_event iev[7];
+
+	if(ufd == -1) return;
+
+	memset(iev, 0, sizeof iev);
+
+	switch(ev->type) {
+	case EVENT_MOTION:
+		for(i=0; i<6; i++) {
+			int val = ev->motion.data[i];
+			if(val > cur_range[i]) val = cur_range[i];
+			if(val < -cur_range[i]) val = -cur_range[i];
+
+			iev[n].type = EV_ABS;
+			iev[n].code = ABS_X + i;
+			iev[n].value = val;
+			n++;
+		}
+		break;
+
+	case EVENT_BUTTON:
+		if((code = button_code(ev->button.bnum)) == -1) {
+			return;
+		}
+		iev[n].type = EV_KEY;
+		iev[n].code = code;
+		iev[n].value = ev->button.press;
+		n++;
+		break;
+
+	default:
+		return;
+	}
+
+	iev[n].type = EV_SYN;
+	iev[n].code = SYN_REPORT;
+	n++;
+
+	/* the whole report in a single write */
+	while(write(ufd, iev, n * sizeof *iev) == -1 && errno == EINTR);
+}
+
+static int create_device(const int *range)
+{
+	int i;
+	struct uinput_user_dev udev;
+
+	if((ufd = open("/dev/uinput", O_WRONLY | O_NONBLOCK)) == -1 &&
+			(ufd = open("/dev/input/uinput", O_WRONLY | O_NONBLOCK)) == -1) {
+		fprintf(stderr, "failed to open uinput: %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(&udev, 0, sizeof udev);
+	strcpy(udev.name, "spacenavd virtual 6dof device");
+	udev.id.bustype = BUS_VIRTUAL;
+	udev.id.version = 1;
+
+	ioctl(ufd, UI_SET_EVBIT, EV_SYN);
+	ioctl(ufd, UI_SET_EVBIT, EV_ABS);
+	for(i=0; i<6; i++) {
+		ioctl(ufd, UI_SET_ABSBIT, ABS_X + i);
+		udev.absmin[ABS_X + i] = -range[i];
+		udev.absmax[ABS_X + i] = range[i];
+	}
+	ioctl(ufd, UI_SET_EVBIT, EV_KEY);
+	for(i=0; i<NUM_BUTTONS; i++) {
+		ioctl(ufd, UI_SET_KEYBIT, button_code(i));
+	}
+
+	if(write(ufd, &udev, sizeof udev) != sizeof udev || ioctl(ufd, UI_DEV_CREATE) == -1) {
+		fprintf(stderr, "failed to create uinput device: %s\n", strerror(errno));
+		close(ufd);
+		ufd = -1;
+		return -1;
+	}
+	memcpy(cur_range, range, sizeof cur_range);
+
+	if(verbose) {
+		printf("created uinput device, axis ranges: %d %d %d %d %d %d\n", range[0],
+				range[1], range[2], range[3], range[4], range[5]);
+	}
+	return 0;
+}
+
+static void destroy_device(void)
+{
+	if(ufd != -1) {
+		ioctl(ufd, UI_DEV_DESTROY);
+		close(ufd);
+		ufd = -1;
+	}
+}
+
+/* the axis ranges cover the largest motion range of the attached devices.
+ * They don't follow the sensitivity, since changing them means re-creating
+ * the device under the programs using it. Scaled motion beyond them is
+ * clamped by send_uinput_event.
+ */
+static void calc_range(int *range)
+{
+	int i, in_range = 0;
+	struct device *dev = core ? get_devices(core) : 0;
+
+	while(dev) {
+		if(!dev->probing) {
+			int r = dev->motion_range > 0 ? dev->motion_range : DEF_INPUT_RANGE;
+			if(r > in_range) in_range = r;
+		}
+		dev = dev->next;
+	}
+	if(!in_range) {
+		in_range = DEF_INPUT_RANGE;
+	}
+
+	for(i=0; i<6; i++) {
+		range[i] = in_range;
+	}
+}
+
+static int button_code(int bnum)
+{
+	if(bnum < 0 || bnum >= NUM_BUTTONS) {
+		return -1;
+	}
+	return bnum < 10 ? BTN_0 + bnum : BTN_TRIGGER_HAPPY1 + bnum - 10;
+}
+
+#else	/* !__linux__ */
+
+int init_uinput(void)
+{
+	if(cfg.uinput) {
+		fprintf(stderr, "uinput output is only supported on GNU/Linux\n");
+	}
+	return -1;
+}
+
+void update_uinput(void)
+{
+}
+
+void close_uinput(void)
+{
+}
+
+void send_uinput_event(spnav_event *ev, struct client *c)
+{
+}
+#endif	/* __linux__ */
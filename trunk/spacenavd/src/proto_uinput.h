@@ -0,0 +1,42 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PROTO_UINPUT_H_
+#define PROTO_UINPUT_H_
+
+#include "config.h"
+#include "event.h"
+#include "client.h"
+
+/* Publishes the processed motion and button events as a uinput virtual
+ * device, for programs which can only read evdev devices. Enabled with the
+ * uinput config option.
+ *
+ * init_uinput creates or removes the virtual device to match the current
+ * configuration, and must be called whenever it changes.
+ *
+ * The axis ranges are those of the devices, and don't change with the
+ * sensitivity. update_uinput checks them when a device is attached,
+ * re-creating the virtual device if they changed.
+ */
+int init_uinput(void);
+void update_uinput(void);
+void close_uinput(void);
+
+void send_uinput_event(spnav_event *ev, struct client *c);
+
+#endif	/* PROTO_UINPUT_H_ */
@@ -16,6 +16,10 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE	/* for struct ucred */
+#endif
+
 #include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -26,7 +30,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/stat.h>
 #include <sys/un.h>
 #include "proto_unix.h"
+#include "proto.h"
+#include "dev.h"
+#include "xform.h"
 #include "spnavd.h"
+#include "proto_uinput.h"
+#include "iouring.h"
+#include "flightrec.h"
+#include "probes.h"
+
+#ifdef USE_X11
+#include "proto_x11.h"
+#endif
 
 enum {
 	UEV_TYPE_MOTION,
@@ -34,6 +49,10 @@ enum {
 	UEV_TYPE_RELEASE
 };
 
+static int read_request(int s, struct reqresp *req, int *count);
+static void handle_request(struct client *c, struct reqresp *req);
+static int is_privileged(int s);
+
 static int lsock;
 
 int init_unix(void)
@@ -90,19 +109,15 @@ int get_unix_socket(void)
 
 void send_uevent(spnav_event *ev, struct client *c)
 {
-	int i, data[8] = {0};
-	float motion_mul;
-
-	if(!lsock) return;
+	int i, res, data[8] = {0};
+	int s = get_client_socket(c);
 
 	switch(ev->type) {
 	case EVENT_MOTION:
 		data[0] = UEV_TYPE_MOTION;
 
-		motion_mul = get_client_sensitivity(c);
 		for(i=0; i<6; i++) {
-			float val = (float)ev->motion.data[i] * motion_mul;
-			data[i + 1] = (int)val;
+			data[i + 1] = ev->motion.data[i];
 		}
 		data[7] = ev->motion.period;
 		break;
@@ -116,7 +131,16 @@ void send_uevent(spnav_event *ev, struct client *c)
 		break;
 	}
 
-	while(write(get_client_socket(c), data, sizeof data) == -1 && errno == EINTR);
+	PROBE2(send_uevent, s, (int)sizeof data);
+
+	if(uring_send(s, data, sizeof data) == -1) {
+		while((res = write(s, data, sizeof data)) == -1 && errno == EINTR);
+		if(res == -1) res = -errno;
+		frec_record(FREC_WRITE, -1, s, res, sizeof data);
+	} else {
+		res = 0;	/* queued, see flush_uring */
+	}
+	PROBE2(send_uevent_return, s, res);
 }
 
 int handle_uevents(fd_set *rset)
@@ -150,23 +174,403 @@ int handle_uevents(fd_set *rset)
 			int s = get_client_socket(c);
 
 			if(FD_ISSET(s, rset)) {
-				int rdbytes;
-				float sens;
-
-				/* got a request from a client, decode and execute it */
-				/* XXX currently only sensitivity comes from clients */
-
-				while((rdbytes = read(s, &sens, sizeof sens)) <= 0 && errno == EINTR);
-				if(rdbytes <= 0) {	/* something went wrong... disconnect client */
+				int res, *count;
+				struct reqresp *req = get_client_request(c, &count);
+
+				/* got (part of) a request from a client, decode and execute it
+				 * once it's all here
+				 */
+				if((res = read_request(s, req, count)) == -1) {
+					/* something went wrong... disconnect client */
 					close(get_client_socket(c));
 					remove_client(c);
 					continue;
 				}
-
-				set_client_sensitivity(c, sens);
+				if(!res) {
+					continue;
+				}
+				*count = 0;
+
+				if(IS_REQUEST(req->type)) {
+					handle_request(c, req);
+				} else {
+					/* old-style request, the first 4 bytes are the sensitivity */
+					float sens;
+					memcpy(&sens, &req->type, sizeof sens);
+					set_client_sensitivity(c, sens);
+				}
 			}
 		}
 	}
 
 	return 0;
 }
+
+/* reads either a tagged request, or a bare sensitivity float from older
+ * clients, in which case only req->type is filled. Only what's available is
+ * read, never blocking, with count keeping track of what's in req so far.
+ * Returns 1 when the request is complete, 0 if more is to come, and -1 on
+ * errors or when the client disconnected.
+ */
+static int read_request(int s, struct reqresp *req, int *count)
+{
+	int rdbytes, size;
+
+	for(;;) {
+		size = sizeof req->type;
+		if(*count >= size && IS_REQUEST(req->type)) {
+			size = sizeof *req;
+		}
+		if(*count >= size) {
+			return 1;
+		}
+
+		while((rdbytes = recv(s, (char*)req + *count, size - *count, MSG_DONTWAIT)) == -1 && errno == EINTR);
+		if(rdbytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			return 0;
+		}
+		if(rdbytes <= 0) {
+			return -1;
+		}
+		*count += rdbytes;
+	}
+}
+
+static INLINE float int_to_float(int x)
+{
+	float f;
+	memcpy(&f, &x, sizeof f);
+	return f;
+}
+
+static INLINE int float_to_int(float f)
+{
+	int x;
+	memcpy(&x, &f, sizeof x);
+	return x;
+}
+
+static void handle_request(struct client *c, struct reqresp *req)
+{
+	int i, type, status = 0;
+
+	type = REQ_TYPE(req->type);
+
+	/* anything that modifies the global configuration, is restricted to root
+	 * and the user running the daemon.
+	 */
+	if((type >= REQ_GET_SENS && type < REQ_CFG_SAVE && (type & 1)) ||
+			(type >= REQ_CFG_SAVE && type < REQ_SET_EVMASK)) {
+		if(!is_privileged(get_client_socket(c))) {
+			if(verbose) {
+				fprintf(stderr, "denied request %x from unprivileged client\n", type);
+			}
+			req->data[REQ_STATUS] = -1;
+			while(write(get_client_socket(c), req, sizeof *req) == -1 && errno == EINTR);
+			return;
+		}
+	}
+
+	switch(type) {
+	case REQ_NOP:
+		break;
+
+	case REQ_GET_SENS:
+		req->data[0] = float_to_int(cfg.sensitivity);
+		break;
+
+	case REQ_SET_SENS:
+		/* non-finite or absurd sensitivities would overflow the conversions of
+		 * scaled motion back to integers
+		 */
+		if(!xform_valid_coef(int_to_float(req->data[0]))) {
+			status = -1;
+			break;
+		}
+		cfg.sensitivity = int_to_float(req->data[0]);
+		break;
+
+	case REQ_GET_SENS_AXIS:
+		for(i=0; i<3; i++) {
+			req->data[i] = float_to_int(cfg.sens_trans[i]);
+			req->data[i + 3] = float_to_int(cfg.sens_rot[i]);
+		}
+		break;
+
+	case REQ_SET_SENS_AXIS:
+		for(i=0; i<6; i++) {
+			if(!xform_valid_coef(int_to_float(req->data[i]))) break;
+		}
+		if(i < 6) {
+			status = -1;
+			break;
+		}
+		for(i=0; i<3; i++) {
+			cfg.sens_trans[i] = int_to_float(req->data[i]);
+			cfg.sens_rot[i] = int_to_float(req->data[i + 3]);
+		}
+		break;
+
+	case REQ_GET_DEADZONE:
+		if(req->data[0] < 0 || req->data[0] >= MAX_AXES) {
+			status = -1;
+			break;
+		}
+		req->data[1] = cfg.dead_threshold[req->data[0]];
+		break;
+
+	case REQ_SET_DEADZONE:
+		if(req->data[1] < 0) {
+			status = -1;
+		} else if(req->data[0] == -1) {
+			for(i=0; i<6; i++) {
+				cfg.dead_threshold[i] = req->data[1];
+			}
+		} else if(req->data[0] >= 0 && req->data[0] < MAX_AXES) {
+			cfg.dead_threshold[req->data[0]] = req->data[1];
+		} else {
+			status = -1;
+		}
+		break;
+
+	case REQ_GET_INVERT:
+		for(i=0; i<6; i++) {
+			req->data[i] = cfg.invert[i];
+		}
+		break;
+
+	case REQ_SET_INVERT:
+		for(i=0; i<6; i++) {
+			cfg.invert[i] = req->data[i] ? 1 : 0;
+		}
+		break;
+
+	case REQ_GET_AXISMAP:
+		if(req->data[0] < 0 || req->data[0] >= MAX_AXES) {
+			status = -1;
+			break;
+		}
+		req->data[1] = cfg.map_axis[req->data[0]];
+		break;
+
+	case REQ_SET_AXISMAP:
+		if(req->data[0] < 0 || req->data[0] >= MAX_AXES || req->data[1] < 0 || req->data[1] >= 6) {
+			status = -1;
+			break;
+		}
+		cfg.map_axis[req->data[0]] = req->data[1];
+		break;
+
+	case REQ_GET_BNMAP:
+		if(req->data[0] < 0 || req->data[0] >= MAX_BUTTONS) {
+			status = -1;
+			break;
+		}
+		req->data[1] = cfg.map_button[req->data[0]];
+		break;
+
+	case REQ_SET_BNMAP:
+		if(req->data[0] < 0 || req->data[0] >= MAX_BUTTONS || req->data[1] < 0 || req->data[1] >= MAX_BUTTONS) {
+			status = -1;
+			break;
+		}
+		cfg.map_button[req->data[0]] = req->data[1];
+		break;
+
+	case REQ_GET_LED:
+		req->data[0] = cfg.led;
+		break;
+
+	case REQ_SET_LED:
+		if((req->data[0] != 0) != (cfg.led != 0)) {
+			cfg.led = req->data[0] ? 1 : 0;
+			set_devices_led(core, cfg.led);
+		}
+		break;
+
+	case REQ_GET_REPEAT:
+		req->data[0] = cfg.repeat_msec;
+		break;
+
+	case REQ_SET_REPEAT:
+		/* 0 would make the repeat permanently due */
+		if(req->data[0] != -1 && req->data[0] <= 0) {
+			status = -1;
+			break;
+		}
+		cfg.repeat_msec = req->data[0];
+		break;
+
+	case REQ_CFG_SAVE:
+		status = save_cfg();
+		break;
+
+	case REQ_CFG_RELOAD:
+		schedule_cfg_reload();
+		break;
+
+	case REQ_FLIGHT_DUMP:
+		if(req->data[0] < 0) {
+			status = -1;
+			break;
+		}
+		status = frec_dump(stdout, req->data[0]);
+		break;
+
+	case REQ_SET_EVMASK:
+		set_client_evmask(c, req->data[0]);
+		break;
+
+	case REQ_GET_EVMASK:
+		req->data[0] = get_client_evmask(c);
+		break;
+
+	case REQ_SUBSCRIBE_DEV:
+		status = client_subscribe_device(c, req->data[0]);
+		break;
+
+	case REQ_UNSUBSCRIBE_DEV:
+		status = client_unsubscribe_device(c, req->data[0]);
+		break;
+
+	case REQ_GET_DEV_IDS:
+		{
+			struct device *dev = get_devices(core);
+			int skip = req->data[0];
+
+			while(dev && skip-- > 0) {
+				dev = dev->next;
+			}
+			for(i=0; i<6; i++) {
+				req->data[i] = dev ? dev->id : -1;
+				if(dev) dev = dev->next;
+			}
+		}
+		break;
+
+	case REQ_GET_DEV_NAME:
+		{
+			struct device *dev = get_device_by_id(core, req->data[0]);
+			int len, offs = req->data[1];
+
+			if(!dev || offs < 0 || offs >= MAX_DEV_NAME) {
+				status = -1;
+				break;
+			}
+			len = strlen(dev->name + offs);
+			if(len > 4 * sizeof *req->data) {
+				len = 4 * sizeof *req->data;
+			}
+			memset(req->data + 2, 0, 4 * sizeof *req->data);
+			memcpy(req->data + 2, dev->name + offs, len);
+		}
+		break;
+
+	case REQ_SET_RATE:
+		if(req->data[0] < 0) {
+			status = -1;
+			break;
+		}
+		set_client_rate(c, req->data[0], req->data[1]);
+		break;
+
+	case REQ_GET_RATE:
+		req->data[0] = get_client_rate(c, req->data + 1);
+		break;
+
+	case REQ_XFORM_ROW:
+	case REQ_XFORM_DEADZONE:
+	case REQ_XFORM_CLAMP:
+		{
+			struct xform *xf = get_client_xform_stage(c);
+			if(!xf) {
+				status = -1;
+				break;
+			}
+			if(type == REQ_XFORM_ROW) {
+				int row = req->data[REQ_STATUS];
+				if(row < 0 || row >= 6) {
+					status = -1;
+					break;
+				}
+				/* reject the whole row if any coefficient is NaN, infinite or
+				 * large enough to overflow the output
+				 */
+				for(i=0; i<6; i++) {
+					if(!xform_valid_coef(int_to_float(req->data[i]))) {
+						status = -1;
+						break;
+					}
+				}
+				if(status == -1) break;
+
+				for(i=0; i<6; i++) {
+					xf->mat[row * 6 + i] = int_to_float(req->data[i]);
+				}
+			} else {
+				for(i=0; i<6; i++) {
+					if(type == REQ_XFORM_DEADZONE) {
+						xf->deadzone[i] = req->data[i];
+					} else {
+						xf->clamp[i] = req->data[i];
+					}
+				}
+			}
+		}
+		break;
+
+	case REQ_XFORM_COMMIT:
+		{
+			struct xform *xf = get_client_xform_stage(c);
+			status = xf ? set_client_xform(c, xf) : -1;
+		}
+		break;
+
+	case REQ_XFORM_RESET:
+		if(get_client_xform_stage(c)) {
+			xform_identity(get_client_xform_stage(c));
+		}
+		set_client_xform(c, 0);
+		break;
+
+#ifdef USE_X11
+	case REQ_X11_START:
+		status = init_x11();
+		break;
+
+	case REQ_X11_STOP:
+		close_x11();
+		break;
+#endif
+
+	default:
+		if(verbose) {
+			fprintf(stderr, "invalid request: %x\n", type);
+		}
+		status = -1;
+		break;
+	}
+
+	req->data[REQ_STATUS] = status;
+	while(write(get_client_socket(c), req, sizeof *req) == -1 && errno == EINTR);
+}
+
+#ifdef SO_PEERCRED
+static int is_privileged(int s)
+{
+	struct ucred cred;
+	socklen_t len = sizeof cred;
+
+	if(getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1) {
+		perror("failed to get client credentials");
+		return 0;
+	}
+	return cred.uid == 0 || cred.uid == geteuid();
+}
+#else
+/* no way to tell who's on the other end, rely on the socket permissions */
+static int is_privileged(int s)
+{
+	return 1;
+}
+#endif
@@ -18,7 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "config.h"
 
-#ifdef USE_X11
+#if defined(USE_X11) && !defined(USE_XCB)
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,7 +36,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "client.h"
 #include "spnavd.h"
 #include "xdetect.h"
+#include "xout.h"
 #include "kbemu.h"
+#include "probes.h"
 
 
 enum cmd_msg {
@@ -46,22 +48,25 @@ enum cmd_msg {
 };
 
 
+static void set_client_window_sens(Window win, float sens);
 static int xerr(Display *dpy, XErrorEvent *err);
 static int xioerr(Display *dpy);
 
+static void make_xevent(XEvent *xev, Display *d, const struct xout_msg *msg);
+
 static Display *dpy;
 static Window win;
 static Atom xa_event_motion, xa_event_bpress, xa_event_brelease, xa_event_cmd;
 
-/* XXX This stands in for the client sensitivity. Due to the
- * bad design of the original magellan protocol, we can't know
- * which client requested the sensitivity change, so we have
- * to keep it global for all X clients.
- */
-static float x11_sens = 1.0;
-
 static jmp_buf jbuf;
 
+/* connection used by the output thread (see xout.h), and the jump buffer used
+ * by the I/O error handler to bail out of Xlib calls in that thread.
+ */
+static Display *out_dpy;
+static jmp_buf out_jbuf;
+static int out_lost;
+
 
 int init_x11(void)
 {
@@ -75,6 +80,15 @@ int init_x11(void)
 
 	if(dpy) return 0;
 
+	{
+		static int threads_init;
+		if(!threads_init) {
+			/* the output thread uses Xlib concurrently with the main thread */
+			XInitThreads();
+			threads_init = 1;
+		}
+	}
+
 	/* if the server started from init, it probably won't have a DISPLAY env var
 	 * so let's add a default one.
 	 */
@@ -168,6 +182,11 @@ int init_x11(void)
 	kbemu_set_display(dpy);
 
 	xdet_stop();	/* stop X server detection if it was running */
+
+	/* send events from a separate thread, if that fails we'll send them
+	 * directly from send_xevent.
+	 */
+	xout_start();
 	return 0;
 }
 
@@ -176,6 +195,8 @@ void close_x11(void)
 	int i, scr_count;
 	struct client *cnode;
 
+	xout_stop();
+
 	if(dpy && setjmp(jbuf) == 0) {
 		if(verbose) {
 			printf("closing X11 connection to display \"%s\"\n", getenv("DISPLAY"));
@@ -215,49 +236,121 @@ int get_x11_socket(void)
 
 void send_xevent(spnav_event *ev, struct client *c)
 {
-	int i;
 	XEvent xevent;
+	struct xout_msg msg;
 
 	if(!dpy) return;
 
+	PROBE2(send_xevent, get_client_window(c), 32);	/* X events are 32 bytes */
+
+	if(xout_running()) {
+		xout_send(get_client_window(c), ev);
+		return;
+	}
+
 	if(setjmp(jbuf)) {
 		return;
 	}
 
-	xevent.type = ClientMessage;
-	xevent.xclient.send_event = False;
-	xevent.xclient.display = dpy;
-	xevent.xclient.window = get_client_window(c);
+	xout_make_msg(&msg, get_client_window(c), ev);
+	make_xevent(&xevent, dpy, &msg);
 
-	switch(ev->type) {
-	case EVENT_MOTION:
-		xevent.xclient.message_type = xa_event_motion;
-		xevent.xclient.format = 16;
+	XSendEvent(dpy, msg.win, False, 0, &xevent);
+	XFlush(dpy);
+}
 
+static void make_xevent(XEvent *xev, Display *d, const struct xout_msg *msg)
+{
+	int i;
+
+	memset(xev, 0, sizeof *xev);
+	xev->type = ClientMessage;
+	xev->xclient.send_event = False;
+	xev->xclient.display = d;
+	xev->xclient.window = msg->win;
+	xev->xclient.format = 16;
+
+	switch(msg->type) {
+	case XOUT_MOTION:
+		xev->xclient.message_type = xa_event_motion;
 		for(i=0; i<6; i++) {
-			float val = (float)ev->motion.data[i] * x11_sens;
-			xevent.xclient.data.s[i + 2] = (short)val;
+			xev->xclient.data.s[i + 2] = msg->data[i];
 		}
-		xevent.xclient.data.s[0] = xevent.xclient.data.s[1] = 0;
-		xevent.xclient.data.s[8] = ev->motion.period;
+		xev->xclient.data.s[8] = msg->data[6];
 		break;
 
-	case EVENT_BUTTON:
-		xevent.xclient.message_type = ev->button.press ? xa_event_bpress : xa_event_brelease;
-		xevent.xclient.format = 16;
-		xevent.xclient.data.s[2] = ev->button.bnum;
+	case XOUT_PRESS:
+	case XOUT_RELEASE:
+		xev->xclient.message_type = msg->type == XOUT_PRESS ? xa_event_bpress : xa_event_brelease;
+		xev->xclient.data.s[2] = msg->data[0];
 		break;
+	}
+}
 
-	default:
-		break;
+/* output thread backend, see xout.h */
+void *xout_backend_open(void)
+{
+	out_lost = 0;
+	return out_dpy = XOpenDisplay(0);
+}
+
+void xout_backend_close(void *conn)
+{
+	if(conn && !out_lost) {
+		XCloseDisplay(conn);
 	}
+	out_dpy = 0;
+}
 
-	XSendEvent(dpy, get_client_window(c), False, 0, &xevent);
-	XFlush(dpy);
+int xout_backend_fd(void *conn)
+{
+	return ConnectionNumber((Display*)conn);
+}
+
+int xout_backend_send(void *conn, const struct xout_msg *msg)
+{
+	XEvent xevent;
+
+	if(setjmp(out_jbuf)) {
+		return -1;
+	}
+	make_xevent(&xevent, conn, msg);
+	XSendEvent(conn, msg->win, False, 0, &xevent);
+	return 0;
+}
+
+int xout_backend_flush(void *conn)
+{
+	if(setjmp(out_jbuf)) {
+		return -1;
+	}
+	XFlush(conn);
+	return 0;
+}
+
+int xout_backend_process(void *conn)
+{
+	XEvent xev;
+
+	if(setjmp(out_jbuf)) {
+		return -1;
+	}
+	/* errors are reported through xerr while reading */
+	while(XPending(conn)) {
+		XNextEvent(conn, &xev);
+	}
+	return 0;
+}
+
+void flush_x11(void)
+{
+	/* send_xevent flushes immediately */
 }
 
 int handle_xevents(fd_set *rset)
 {
+	xout_handle_events(rset);
+
 	if(!dpy) {
 		if(xdet_get_fd() != -1) {
 			handle_xdet_events(rset);
@@ -275,7 +368,16 @@ int handle_xevents(fd_set *rset)
 			XEvent xev;
 			XNextEvent(dpy, &xev);
 
-			if(xev.type == ClientMessage && xev.xclient.message_type == xa_event_cmd) {
+			if(xev.type == MappingNotify) {
+				/* keyboard mapping changed, update the emulated keys */
+				XRefreshKeyboardMapping(&xev.xmapping);
+				kbemu_refresh();
+
+			} else if(xev.type == DestroyNotify) {
+				/* a client window went away, stop sending events to it */
+				remove_client_window(xev.xdestroywindow.window);
+
+			} else if(xev.type == ClientMessage && xev.xclient.message_type == xa_event_cmd) {
 				unsigned int win_id;
 
 				switch(xev.xclient.data.s[2]) {
@@ -287,7 +389,7 @@ int handle_xevents(fd_set *rset)
 					break;
 
 				case CMD_APP_SENS:
-					x11_sens = *(float*)xev.xclient.data.s;	/* see decl of x11_sens for details */
+					set_client_window_sens(xev.xclient.window, *(float*)xev.xclient.data.s);
 					break;
 
 				default:
@@ -304,7 +406,6 @@ int handle_xevents(fd_set *rset)
 void set_client_window(Window win)
 {
 	int i, scr_count;
-	struct client *cnode;
 
 	/* When a magellan application exits, the SDK sets another window to avoid
 	 * crashing the original proprietary daemon.  The new free SDK will set
@@ -319,31 +420,56 @@ void set_client_window(Window win)
 	}
 
 	/* make sure we don't already have that client */
-	cnode = first_client();
-	while(cnode) {
-		if(get_client_window(cnode) == win) {
-			return;
-		}
-		cnode = next_client();
+	if(find_client_window(win)) {
+		return;
 	}
 
-	add_client(CLIENT_X11, &win);
+	if(add_client(CLIENT_X11, &win)) {
+		/* get a DestroyNotify when the client window goes away. If it's
+		 * already gone, the BadWindow error will remove the client.
+		 */
+		XSelectInput(dpy, win, StructureNotifyMask);
+		XFlush(dpy);
+	}
 }
 
-void remove_client_window(Window win)
+/* The original magellan protocol doesn't say which client requested the
+ * sensitivity change. libspnav passes its window in the message, so use that
+ * if it's one of our clients, otherwise change the sensitivity of all X11
+ * clients, like we always did.
+ */
+static void set_client_window_sens(Window win, float sens)
 {
 	struct client *c, *cnode;
+	int found = 0;
+
+	if((c = find_client_window(win))) {
+		set_client_sensitivity(c, sens);
+		return;
+	}
 
 	cnode = first_client();
 	while(cnode) {
 		c = cnode;
 		cnode = next_client();
 
-		if(get_client_window(c) == win) {
-			remove_client(c);
-			return;
+		if(get_client_type(c) == CLIENT_X11) {
+			set_client_sensitivity(c, sens);
+			found++;
 		}
 	}
+	if(verbose && !found) {
+		fprintf(stderr, "got sensitivity change with no X11 clients\n");
+	}
+}
+
+void remove_client_window(Window win)
+{
+	struct client *c;
+
+	if((c = find_client_window(win))) {
+		remove_client(c);
+	}
 }
 
 
@@ -356,6 +482,14 @@ static int xerr(Display *dpy, XErrorEvent *err)
 		fprintf(stderr, "xerr(%p, %p)\n", (void*)dpy, (void*)err);
 	}
 
+	if(dpy == out_dpy) {
+		/* error on the output thread connection, let the main thread handle it */
+		if(err->error_code == BadWindow) {
+			xout_bad_window((Window)err->resourceid);
+		}
+		return 0;
+	}
+
 	if(err->error_code == BadWindow) {
 		/* we may get a BadWindow error when trying to send events to
 		 * clients that have disconnected in the meanwhile.
@@ -373,6 +507,12 @@ static int xerr(Display *dpy, XErrorEvent *err)
  */
 static int xioerr(Display *display)
 {
+	if(display == out_dpy) {
+		/* called from the output thread, which will notify the main thread */
+		out_lost = 1;
+		longjmp(out_jbuf, 1);
+	}
+
 	fprintf(stderr, "Lost the X server!\n");
 	dpy = 0;
 	close_x11();
@@ -385,4 +525,4 @@ static int xioerr(Display *display)
 
 #else
 int spacenavd_proto_x11_shut_up_empty_source_warning;
-#endif	/* USE_X11 */
+#endif	/* USE_X11 && !USE_XCB */
@@ -31,7 +31,12 @@ void close_x11(void);
 
 int get_x11_socket(void);
 
+/* queues an event for an X11 client, some implementations only send it on
+ * the next call to flush_x11.
+ */
 void send_xevent(spnav_event *ev, struct client *c);
+/* flushes any queued events, called once per main loop iteration */
+void flush_x11(void);
 int handle_xevents(fd_set *rset);
 
 void set_client_window(Window win);
@@ -0,0 +1,529 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* XCB implementation of the magellan X11 protocol.
+ *
+ * Events to clients are queued with unchecked xcb_send_event requests and
+ * flushed once per main loop iteration by flush_x11. Errors (BadWindow for
+ * clients which went away) come back asynchronously through the event queue
+ * and are handled in handle_xevents, and a broken connection is detected with
+ * xcb_connection_has_error, so none of this needs setjmp/longjmp.
+ */
+#include "config.h"
+
+#if defined(USE_X11) && defined(USE_XCB)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_ALLOCA_H
+#include <alloca.h>
+#endif
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <unistd.h>
+#include <pwd.h>
+#include <xcb/xcb.h>
+#include "proto_x11.h"
+#include "client.h"
+#include "spnavd.h"
+#include "xdetect.h"
+#include "xout.h"
+#include "kbemu.h"
+#include "probes.h"
+
+
+enum cmd_msg {
+	CMD_NONE,
+	CMD_APP_WINDOW = 27695,	/* set client window */
+	CMD_APP_SENS			/* set app sensitivity */
+};
+
+enum {
+	ATOM_MOTION,
+	ATOM_BPRESS,
+	ATOM_BRELEASE,
+	ATOM_CMD,
+	ATOM_CMD_TYPE,
+	ATOM_WM_PROTOCOLS,
+	ATOM_WM_DELETE,
+
+	NUM_ATOMS
+};
+
+static const char *atom_names[NUM_ATOMS] = {
+	"MotionEvent",
+	"ButtonPressEvent",
+	"ButtonReleaseEvent",
+	"CommandEvent",
+	"MagellanCmdType",
+	"WM_PROTOCOLS",
+	"WM_DELETE_WINDOW"
+};
+
+static void make_xevent(xcb_client_message_event_t *xev, const struct xout_msg *msg);
+static void set_client_window_sens(Window win, float sens);
+static void handle_xerror(xcb_generic_error_t *err);
+static int check_connection(void);
+
+static xcb_connection_t *conn;
+static xcb_window_t *roots;
+static int num_roots;
+static xcb_window_t win;
+static xcb_atom_t atoms[NUM_ATOMS];
+static int flush_pending;
+
+
+int init_x11(void)
+{
+	int i, scr_num;
+	xcb_screen_t *scr = 0;
+	xcb_screen_iterator_t sit;
+	xcb_intern_atom_cookie_t atom_cookie[NUM_ATOMS];
+	uint32_t attr[3];
+	static const char win_title[] = "Magellan Window";
+	static const char win_class[] = "magellan\0magellan_win";
+
+	if(conn) return 0;
+
+	/* if the server started from init, it probably won't have a DISPLAY env var
+	 * so let's add a default one.
+	 */
+	if(!getenv("DISPLAY")) {
+		putenv("DISPLAY=:0.0");
+	}
+
+	/* ... also there won't be an XAUTHORITY env var, so set one up */
+	if(!getenv("XAUTHORITY")) {
+		struct passwd *p = getpwuid(getuid());
+		char *home, *buf;
+		if(!p || !p->pw_dir) {
+			if(!p) {
+				fprintf(stderr, "getpwuid failed: %s\n", strerror(errno));
+			}
+			fprintf(stderr, "falling back to getting the home directory from the HOME env var...\n");
+			if(!(home = getenv("HOME"))) {
+				fprintf(stderr, "HOME env var not found, using /tmp as a home directory...\n");
+				home = "/tmp";
+			}
+		} else {
+			home = p->pw_dir;
+		}
+
+		buf = alloca(strlen("XAUTHORITY=") + strlen(home) + strlen("/.Xauthority") + 1);
+		sprintf(buf, "XAUTHORITY=%s/.Xauthority", home);
+		putenv(buf);
+	}
+
+	if(verbose) {
+		printf("trying to open X11 display \"%s\" (xcb)\n", getenv("DISPLAY"));
+		printf("   XAUTHORITY=%s\n", getenv("XAUTHORITY"));
+	}
+
+	conn = xcb_connect(0, &scr_num);
+	if(xcb_connection_has_error(conn)) {
+		fprintf(stderr, "failed to open X11 display \"%s\"\n", getenv("DISPLAY"));
+		xcb_disconnect(conn);
+		conn = 0;
+
+		xdet_start();
+		return -1;
+	}
+
+	/* intern the various atoms used for communicating with the magellan
+	 * clients. Send all the requests before waiting for any reply.
+	 */
+	for(i=0; i<NUM_ATOMS; i++) {
+		atom_cookie[i] = xcb_intern_atom(conn, 0, strlen(atom_names[i]), atom_names[i]);
+	}
+	for(i=0; i<NUM_ATOMS; i++) {
+		xcb_intern_atom_reply_t *rep = xcb_intern_atom_reply(conn, atom_cookie[i], 0);
+		atoms[i] = rep ? rep->atom : XCB_ATOM_NONE;
+		free(rep);
+	}
+
+	sit = xcb_setup_roots_iterator(xcb_get_setup(conn));
+	num_roots = sit.rem;
+	if(!(roots = malloc(num_roots * sizeof *roots))) {
+		perror("failed to allocate root window list");
+		xcb_disconnect(conn);
+		conn = 0;
+		return -1;
+	}
+	for(i=0; sit.rem; i++, xcb_screen_next(&sit)) {
+		roots[i] = sit.data->root;
+		if(i == scr_num) {
+			scr = sit.data;
+		}
+	}
+	if(!scr) {
+		scr = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
+	}
+
+	/* Create a dummy window, so that clients are able to send us events
+	 * through the magellan API. No need to map the window.
+	 */
+	attr[0] = scr->black_pixel;
+	attr[1] = scr->black_pixel;
+	attr[2] = scr->default_colormap;
+
+	win = xcb_generate_id(conn);
+	xcb_create_window(conn, XCB_COPY_FROM_PARENT, win, scr->root, 0, 0, 10, 10, 0,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT, scr->root_visual,
+			XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL | XCB_CW_COLORMAP, attr);
+
+	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, win, atoms[ATOM_WM_PROTOCOLS],
+			XCB_ATOM_ATOM, 32, 1, &atoms[ATOM_WM_DELETE]);
+	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, win, XCB_ATOM_WM_NAME,
+			XCB_ATOM_STRING, 8, sizeof win_title - 1, win_title);
+	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, win, XCB_ATOM_WM_CLASS,
+			XCB_ATOM_STRING, 8, sizeof win_class, win_class);
+
+	/* the magellan API expects to find the CommandEvent property on the root
+	 * window, containing our window id (see proto_x11.c).
+	 */
+	for(i=0; i<num_roots; i++) {
+		xcb_change_property(conn, XCB_PROP_MODE_REPLACE, roots[i], atoms[ATOM_CMD],
+				atoms[ATOM_CMD_TYPE], 32, 1, &win);
+	}
+	xcb_flush(conn);
+
+	/* pass the connection to the keyboard emulation module */
+	kbemu_set_connection(conn);
+
+	xdet_stop();	/* stop X server detection if it was running */
+
+	/* send events from a separate thread with its own connection */
+	xout_start();
+	return 0;
+}
+
+void close_x11(void)
+{
+	int i;
+	struct client *cnode;
+
+	xout_stop();
+
+	if(conn) {
+		if(!xcb_connection_has_error(conn)) {
+			if(verbose) {
+				printf("closing X11 connection to display \"%s\"\n", getenv("DISPLAY"));
+			}
+
+			/* first delete all the CommandEvent properties from all root windows */
+			for(i=0; i<num_roots; i++) {
+				xcb_delete_property(conn, roots[i], atoms[ATOM_CMD]);
+			}
+			xcb_destroy_window(conn, win);
+			xcb_flush(conn);
+		}
+		xcb_disconnect(conn);
+		conn = 0;
+		flush_pending = 0;
+
+		free(roots);
+		roots = 0;
+		num_roots = 0;
+
+		/* stop the kbemu module from using an invalid connection */
+		kbemu_set_connection(0);
+	}
+
+	/* also remove all x11 clients from the client list */
+	cnode = first_client();
+	while(cnode) {
+		struct client *c = cnode;
+		cnode = next_client();
+
+		if(get_client_type(c) == CLIENT_X11) {
+			remove_client(c);
+		}
+	}
+}
+
+int get_x11_socket(void)
+{
+	return conn ? xcb_get_file_descriptor(conn) : xdet_get_fd();
+}
+
+void send_xevent(spnav_event *ev, struct client *c)
+{
+	xcb_client_message_event_t xevent;
+	struct xout_msg msg;
+
+	if(!conn) return;
+
+	PROBE2(send_xevent, get_client_window(c), 32);	/* X events are 32 bytes */
+
+	if(xout_running()) {
+		xout_send(get_client_window(c), ev);
+		return;
+	}
+
+	xout_make_msg(&msg, get_client_window(c), ev);
+	make_xevent(&xevent, &msg);
+
+	/* unchecked: a BadWindow error will show up in handle_xevents */
+	xcb_send_event(conn, 0, xevent.window, 0, (const char*)&xevent);
+	flush_pending = 1;
+}
+
+static void make_xevent(xcb_client_message_event_t *xev, const struct xout_msg *msg)
+{
+	int i;
+
+	memset(xev, 0, sizeof *xev);
+	xev->response_type = XCB_CLIENT_MESSAGE;
+	xev->format = 16;
+	xev->window = msg->win;
+
+	switch(msg->type) {
+	case XOUT_MOTION:
+		xev->type = atoms[ATOM_MOTION];
+		for(i=0; i<6; i++) {
+			xev->data.data16[i + 2] = msg->data[i];
+		}
+		xev->data.data16[8] = msg->data[6];
+		break;
+
+	case XOUT_PRESS:
+	case XOUT_RELEASE:
+		xev->type = msg->type == XOUT_PRESS ? atoms[ATOM_BPRESS] : atoms[ATOM_BRELEASE];
+		xev->data.data16[2] = msg->data[0];
+		break;
+	}
+}
+
+/* output thread backend, see xout.h. The atoms are only written by init_x11
+ * before the thread starts.
+ */
+void *xout_backend_open(void)
+{
+	xcb_connection_t *c = xcb_connect(0, 0);
+	if(xcb_connection_has_error(c)) {
+		xcb_disconnect(c);
+		return 0;
+	}
+	return c;
+}
+
+void xout_backend_close(void *c)
+{
+	if(c) {
+		xcb_disconnect(c);
+	}
+}
+
+int xout_backend_fd(void *c)
+{
+	return xcb_get_file_descriptor(c);
+}
+
+int xout_backend_send(void *c, const struct xout_msg *msg)
+{
+	xcb_client_message_event_t xevent;
+
+	make_xevent(&xevent, msg);
+	xcb_send_event(c, 0, xevent.window, 0, (const char*)&xevent);
+	return xcb_connection_has_error(c) ? -1 : 0;
+}
+
+int xout_backend_flush(void *c)
+{
+	return xcb_flush(c) > 0 ? 0 : -1;
+}
+
+int xout_backend_process(void *c)
+{
+	xcb_generic_event_t *xev;
+
+	while((xev = xcb_poll_for_event(c))) {
+		if((xev->response_type & 0x7f) == 0) {
+			xcb_generic_error_t *err = (xcb_generic_error_t*)xev;
+			if(err->error_code == XCB_WINDOW) {
+				xout_bad_window((Window)err->resource_id);
+			}
+		}
+		free(xev);
+	}
+	return xcb_connection_has_error(c) ? -1 : 0;
+}
+
+void flush_x11(void)
+{
+	if(conn && flush_pending) {
+		xcb_flush(conn);
+		flush_pending = 0;
+		check_connection();
+	}
+}
+
+int handle_xevents(fd_set *rset)
+{
+	xcb_generic_event_t *xev;
+
+	xout_handle_events(rset);
+
+	if(!conn) {
+		if(xdet_get_fd() != -1) {
+			handle_xdet_events(rset);
+		}
+		return -1;
+	}
+
+	/* process any pending X events */
+	if(FD_ISSET(xcb_get_file_descriptor(conn), rset)) {
+		while(conn && (xev = xcb_poll_for_event(conn))) {
+			int type = xev->response_type & 0x7f;
+
+			if(type == 0) {
+				handle_xerror((xcb_generic_error_t*)xev);
+
+			} else if(type == XCB_MAPPING_NOTIFY) {
+				/* keyboard mapping changed, update the emulated keys */
+				kbemu_refresh();
+
+			} else if(type == XCB_DESTROY_NOTIFY) {
+				/* a client window went away, stop sending events to it */
+				remove_client_window(((xcb_destroy_notify_event_t*)xev)->window);
+
+			} else if(type == XCB_CLIENT_MESSAGE) {
+				xcb_client_message_event_t *cmsg = (xcb_client_message_event_t*)xev;
+
+				if(cmsg->type == atoms[ATOM_CMD]) {
+					unsigned int win_id;
+					float sens;
+
+					switch(cmsg->data.data16[2]) {
+					case CMD_APP_WINDOW:
+						win_id = cmsg->data.data16[1];
+						win_id |= (unsigned int)cmsg->data.data16[0] << 16;
+
+						set_client_window((Window)win_id);
+						break;
+
+					case CMD_APP_SENS:
+						memcpy(&sens, cmsg->data.data16, sizeof sens);
+						set_client_window_sens(cmsg->window, sens);
+						break;
+
+					default:
+						break;
+					}
+				}
+			}
+			free(xev);
+		}
+
+		check_connection();
+	}
+
+	return 0;
+}
+
+/* adds a new X11 client to the list, IF it does not already exist */
+void set_client_window(Window win)
+{
+	int i;
+	uint32_t mask = XCB_EVENT_MASK_STRUCTURE_NOTIFY;
+
+	/* the SDK sets the root window when an application exits, ignore it */
+	for(i=0; i<num_roots; i++) {
+		if(win == roots[i]) {
+			return;
+		}
+	}
+
+	/* make sure we don't already have that client */
+	if(find_client_window(win)) {
+		return;
+	}
+
+	if(add_client(CLIENT_X11, &win)) {
+		/* get a DestroyNotify when the client window goes away. If it's
+		 * already gone, the BadWindow error will remove the client.
+		 */
+		xcb_change_window_attributes(conn, win, XCB_CW_EVENT_MASK, &mask);
+		flush_pending = 1;
+	}
+}
+
+/* see set_client_window_sens in proto_x11.c */
+static void set_client_window_sens(Window win, float sens)
+{
+	struct client *c, *cnode;
+
+	if((c = find_client_window(win))) {
+		set_client_sensitivity(c, sens);
+		return;
+	}
+
+	cnode = first_client();
+	while(cnode) {
+		c = cnode;
+		cnode = next_client();
+
+		if(get_client_type(c) == CLIENT_X11) {
+			set_client_sensitivity(c, sens);
+		}
+	}
+}
+
+void remove_client_window(Window win)
+{
+	struct client *c;
+
+	if((c = find_client_window(win))) {
+		remove_client(c);
+	}
+}
+
+static void handle_xerror(xcb_generic_error_t *err)
+{
+	if(verbose) {
+		fprintf(stderr, "X error %d, request %d, resource %x\n", (int)err->error_code,
+				(int)err->major_code, (unsigned int)err->resource_id);
+	}
+
+	if(err->error_code == XCB_WINDOW) {
+		/* we may get a BadWindow error when trying to send events to
+		 * clients that have disconnected in the meanwhile.
+		 */
+		remove_client_window((Window)err->resource_id);
+	} else {
+		fprintf(stderr, "Caught unexpected X error: %d\n", (int)err->error_code);
+	}
+}
+
+/* if the connection broke, clean up and go back to waiting for an X server */
+static int check_connection(void)
+{
+	if(conn && xcb_connection_has_error(conn)) {
+		fprintf(stderr, "Lost the X server!\n");
+		close_x11();
+		xdet_start();
+		return -1;
+	}
+	return 0;
+}
+
+#else
+int spacenavd_proto_x11_xcb_shut_up_empty_source_warning;
+#endif	/* USE_X11 && USE_XCB */
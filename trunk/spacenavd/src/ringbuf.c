@@ -0,0 +1,75 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "ringbuf.h"
+
+int rb_init(struct ringbuf *rb, unsigned int size, unsigned int elem_size)
+{
+	unsigned int sz = 1;
+
+	while(sz < size) sz <<= 1;
+
+	memset(rb, 0, sizeof *rb);
+	if(!(rb->buf = malloc(sz * elem_size))) {
+		return -1;
+	}
+	rb->size = sz;
+	rb->elem_size = elem_size;
+	return 0;
+}
+
+void rb_destroy(struct ringbuf *rb)
+{
+	free(rb->buf);
+	rb->buf = 0;
+}
+
+/* head and tail increase monotonically and wrap around naturally, the
+ * element index is taken modulo the (power of two) size.
+ */
+int rb_push(struct ringbuf *rb, const void *elem)
+{
+	unsigned int head = rb->head;
+	unsigned int tail = __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+
+	if(head - tail >= rb->size) {
+		return -1;
+	}
+	memcpy(rb->buf + (head & (rb->size - 1)) * rb->elem_size, elem, rb->elem_size);
+	__atomic_store_n(&rb->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int rb_pop(struct ringbuf *rb, void *elem)
+{
+	unsigned int tail = rb->tail;
+	unsigned int head = __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE);
+
+	if(head == tail) {
+		return -1;
+	}
+	memcpy(elem, rb->buf + (tail & (rb->size - 1)) * rb->elem_size, rb->elem_size);
+	__atomic_store_n(&rb->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int rb_empty(struct ringbuf *rb)
+{
+	return __atomic_load_n(&rb->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&rb->tail, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,52 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef RINGBUF_H_
+#define RINGBUF_H_
+
+/* Lock-free single producer, single consumer ring buffer of fixed size
+ * elements. Exactly one thread may call rb_push, and exactly one (possibly
+ * different) thread may call rb_pop.
+ */
+
+#define RB_CACHE_LINE	64
+
+struct ringbuf {
+	/* written only by the producer */
+	unsigned int head;
+	char pad0[RB_CACHE_LINE - sizeof(unsigned int)];
+	/* written only by the consumer */
+	unsigned int tail;
+	char pad1[RB_CACHE_LINE - sizeof(unsigned int)];
+
+	unsigned int size;	/* number of elements, power of two */
+	unsigned int elem_size;
+	char *buf;
+};
+
+/* size is rounded up to the next power of two */
+int rb_init(struct ringbuf *rb, unsigned int size, unsigned int elem_size);
+void rb_destroy(struct ringbuf *rb);
+
+/* returns -1 if the ring is full */
+int rb_push(struct ringbuf *rb, const void *elem);
+/* returns -1 if the ring is empty */
+int rb_pop(struct ringbuf *rb, void *elem);
+
+int rb_empty(struct ringbuf *rb);
+
+#endif	/* RINGBUF_H_ */
@@ -48,31 +48,29 @@ permission notice:
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <unistd.h>
 
 #include "sball.h"
 #include "sballserial.h"
+#include "dev_serial.h"
 
-struct event {
-	struct dev_input data;
-	struct event *next;
-};
-
-static struct event *ev_free_list;
-int evpool_size;
-
-static struct event *alloc_event(void);
-static void free_event(struct event *ev);
+/* Input parsed from a read is kept in a fixed ring in the handle, and handed
+ * out by sball_get_input without reading again until it's drained. A read is
+ * limited to SBALL_READ_SIZE bytes, so that the input it produces always fits:
+ * at most 16 button changes per 4-byte key packet (plus one packet left over
+ * from the previous read).
+ */
+#define SBALL_EVRING_SIZE	1024	/* power of two */
 
+struct packet_type;
 
 typedef struct {
 	SBallCommHandle commhandle;
 	unsigned char buf[256];
 	char resetstring[256];
 	int bufpos;		/* current char position in packet buffer */
-	int packtype;		/* what kind of packet is it */
-	int packlen;		/* how many bytes do we ultimately expect? */
+	const struct packet_type *ptype;	/* what kind of packet is it */
+	int packlen;		/* how many bytes did the last packet have */
 	int escapedchar;	/* if set, we're processing an escape sequence */
 	int erroroccured;	/* if set, we've received an error packet or packets */
 	int resetoccured;	/* if set, ball was reset, so have to reinitialize it */
@@ -86,11 +84,76 @@ typedef struct {
 	int nulltrans[3];	/* translational null region values */
 	int nullrot[3];		/* rotational null region values */
 
-	/* event list added for spacenavd integration */
-	struct event *evhead, *evtail;
+	/* input ring added for spacenavd integration */
+	struct dev_input evring[SBALL_EVRING_SIZE];
+	unsigned int evrd, evwr;
+
+	struct serial_stats st;
 } sballhandle;
 
+/* packet types, added for spacenavd integration: the first character of a
+ * packet selects its length, and the function which processes it.
+ */
+struct packet_type {
+	int type;
+	int len;	/* length including the type, or maximum length with PKT_CR_TERM */
+	int flags;
+	void (*proc)(sballhandle*);
+};
+
+#define PKT_CR_TERM		1	/* variable length, terminated by a carriage return */
+#define PKT_CHECK_CR	2	/* must end with a carriage return, or it's garbage */
+
+static int parse(sballhandle *handle, const unsigned char *data, int sz);
+static void proc_disp(sballhandle *handle);
+static void proc_key(sballhandle *handle);
+static void proc_key4000(sballhandle *handle);
+static void proc_reset(sballhandle *handle);
+static void proc_error(sballhandle *handle);
+
+static const struct packet_type packet_types[] = {
+	{'D', 16, PKT_CHECK_CR, proc_disp},		/* Displacement packet, 15 bytes */
+	{'K', 4, PKT_CHECK_CR, proc_key},		/* Button/Key packet, 3 bytes */
+	{'.', 4, PKT_CHECK_CR, proc_key4000},	/* Spaceball 4000 FLX "advanced" button press event */
+	{'C', 4, 0, 0},			/* Communications mode packet */
+	{'F', 4, 0, 0},			/* Spaceball sensitization mode packet */
+	{'M', 5, 0, 0},			/* Movement mode packet */
+	{'N', 3, 0, 0},			/* Null region packet */
+	{'P', 6, 0, 0},			/* Update rate packet */
+	{'\v', 1, 0, 0},		/* XON at poweron */
+	{'\n', 1, 0, 0},		/* carriage return at poweron */
+	{'\r', 1, 0, 0},		/* carriage return at poweron */
+	{'@', 62, PKT_CR_TERM, proc_reset},	/* Spaceball Hard/Soft Reset packet, up to 62 */
+	{'E', 8, PKT_CR_TERM, proc_error},	/* Error packet, up to 7 bytes */
+	{'Z', 14, 0, 0},		/* Zero packet (Spaceball 2003/3003/4000 FLX), hardware dependent */
+	{0, 0, 0, 0}
+};
+
+static const struct packet_type *packet_table[256];
+static unsigned char unescape_table[256];
+static int tables_valid;
+
+static void init_tables(void)
+{
+	int i;
+
+	if(tables_valid)
+		return;
+
+	for(i = 0; packet_types[i].type; i++) {
+		packet_table[packet_types[i].type] = packet_types + i;
+	}
+
+	/* ^^ is a ^, and ^Q, ^S, ^M are the XON, XOFF and CR characters */
+	unescape_table['^'] = '^';
+	unescape_table['Q'] = 'Q' & 0x1f;
+	unescape_table['S'] = 'S' & 0x1f;
+	unescape_table['M'] = 'M' & 0x1f;
+	tables_valid = 1;
+}
+
 
+static void append_event(sballhandle *handle, int type, int idx, int val);
 static void generate_motion_events(sballhandle *handle, int *prev_val, int *new_val, int timer);
 static void generate_button_events(sballhandle *handle, int prevstate, int newstate);
 
@@ -142,8 +205,8 @@ SBallHandle sball_open(const char *sballname)
 
 	/* clear all values in sballhandle to 0 */
 	memset(handle, 0, sizeof(sballhandle));
-	handle->packlen = 1;
 	handle->resetoccured = 0;
+	init_tables();
 
 	if(sball_comm_open(sballname, &handle->commhandle) == -1) {
 		free(handle);
@@ -155,6 +218,20 @@ SBallHandle sball_open(const char *sballname)
 	return handle;		/* successfull open */
 }
 
+/* added for spacenavd: a handle without a serial port, for sball_parse */
+SBallHandle sball_open_parser(void)
+{
+	sballhandle *handle;
+
+	if(!(handle = malloc(sizeof *handle)))
+		return NULL;
+
+	memset(handle, 0, sizeof *handle);
+	handle->resetoccured = 1;	/* don't try to reset it */
+	init_tables();
+	return handle;
+}
+
 
 int sball_close(SBallHandle voidhandle)
 {
@@ -171,344 +248,206 @@ int sball_close(SBallHandle voidhandle)
 
 static int sball_update(SBallHandle voidhandle)
 {
-	int i, num, packs;
-
-	unsigned char rawbuf[1024];
+	int num;
+	char rawbuf[SBALL_READ_SIZE];
 
 	sballhandle *handle = voidhandle;
 
 	if(handle == NULL)
 		return -1;
 
-	packs = 0;		/* no packs received yet */
+	num = sball_comm_read(handle->commhandle, rawbuf, sizeof rawbuf);
+	if(num <= 0)
+		return 0;
 
-	num = sball_comm_read(handle->commhandle, (char *)rawbuf, 1023);
+	return parse(handle, (unsigned char*)rawbuf, num);
+}
+
+/* Table-driven packet parser, rewritten for spacenavd. Takes any amount of
+ * data (which can end anywhere in a packet), and returns the number of
+ * complete packets. Malformed input is counted in the handle stats and
+ * skipped.
+ */
+static int parse(sballhandle *handle, const unsigned char *data, int sz)
+{
+	int i, c, escaped, packs = 0;
+	const struct packet_type *pt;
 
-	if(num > 0) {
-		for(i = 0; i < num; i++) {
+	handle->st.bytes += sz;
 
+	for(i = 0; i < sz; i++) {
+		c = data[i];
+		escaped = 0;
 
-			/* process potentially occuring escaped character sequences */
-			if(rawbuf[i] == '^') {
-				if(!handle->escapedchar) {
-					handle->escapedchar = 1;
-					continue;	/* eat the escape character from buffer */
-				}
+		/* process potentially occuring escaped character sequences */
+		if(handle->escapedchar) {
+			handle->escapedchar = 0;
+			if(unescape_table[c]) {
+				c = unescape_table[c];	/* convert character to unescaped form */
+				escaped = 1;
+			} else {
+				handle->st.bad_packets++;	/* bad escape sequence, leave it as is */
 			}
+		} else if(c == '^') {
+			handle->escapedchar = 1;
+			continue;	/* eat the escape character */
+		}
 
-			if(handle->escapedchar) {
-				handle->escapedchar = 0;
-
-				switch(rawbuf[i]) {
-				case '^':	/* leave char in buffer unchanged */
-					break;
+		/* figure out what kind of packet we received */
+		if(handle->bufpos == 0) {
+			if(!(handle->ptype = packet_table[c])) {
+				handle->st.unknown++;
+				continue;
+			}
+		}
+		pt = handle->ptype;
 
-				case 'Q':
-				case 'S':
-				case 'M':
-					rawbuf[i] &= 0x1F;	/* convert character to unescaped form */
-					break;
+		handle->buf[handle->bufpos++] = c;
 
-				default:
-#if defined(DEBUG)
-					printf("\nGot a bad escape sequence! 0x%02x", rawbuf[i]);
-					if(isprint(rawbuf[i]))
-						printf(" (%c)", rawbuf[i]);
-					else
-						printf(" (unprintable)");
-					printf("\n");
-#endif
-					break;
+		if(pt->flags & PKT_CR_TERM) {
+			/* variable length, up to the (unescaped) carriage return */
+			if(c != '\r' || escaped) {
+				if(handle->bufpos >= pt->len) {
+					handle->st.overruns++;
+					handle->bufpos = 0;
 				}
+				continue;
+			}
+		} else {
+			if(handle->bufpos < pt->len) {
+				continue;
+			}
+			if((pt->flags & PKT_CHECK_CR) && c != '\r') {
+				handle->st.bad_packets++;	/* not terminated, probably garbage */
+				handle->bufpos = 0;
+				continue;
 			}
+		}
 
+		handle->packlen = handle->bufpos;
+		handle->bufpos = 0;
+		handle->st.packets++;
+		packs++;
 
-			/* figure out what kind of packet we received */
-			if(handle->bufpos == 0) {
-				switch(rawbuf[i]) {
-				case 'D':	/* Displacement packet */
-					handle->packtype = 'D';
-					handle->packlen = 16;	/* D packets are 15 bytes long */
-					break;
-
-				case 'K':	/* Button/Key packet */
-					handle->packtype = 'K';
-					handle->packlen = 4;	/* K packets are 3 bytes long */
-					break;
-
-				case '.':	/* Spaceball 4000 FLX "advanced" button press event */
-					handle->packtype = '.';
-					handle->packlen = 4;	/* . packets are 3 bytes long */
-					break;
-
-				case 'C':	/* Communications mode packet */
-					handle->packtype = 'C';
-					handle->packlen = 4;
-					break;
-
-				case 'F':	/* Spaceball sensitization mode packet */
-					handle->packtype = 'F';
-					handle->packlen = 4;
-					break;
-
-				case 'M':	/* Movement mode packet */
-					handle->packtype = 'M';
-					handle->packlen = 5;
-					break;
-
-				case 'N':	/* Null region packet */
-					handle->packtype = 'N';
-					handle->packlen = 3;
-					break;
-
-				case 'P':	/* Update rate packet */
-					handle->packtype = 'P';
-					handle->packlen = 6;
-					break;
-
-				case '\v':	/* XON at poweron */
-					handle->packtype = '\v';
-					handle->packlen = 1;
-					break;
-
-				case '\n':	/* carriage return at poweron */
-				case '\r':	/* carriage return at poweron */
-					handle->packtype = '\r';
-					handle->packlen = 1;
-					break;
-
-				case '@':	/* Spaceball Hard/Soft Reset packet */
-					handle->resetoccured = 1;
-					handle->packtype = '@';
-					handle->packlen = 62;	/* Resets aren't longer than 62 chars */
-					break;
-
-				case 'E':	/* Error packet */
-					handle->packtype = 'E';
-					handle->packlen = 8;	/* E packets are up to 7 bytes long */
-					break;
-
-				case 'Z':	/* Zero packet (Spaceball 2003/3003/4000 FLX) */
-					handle->packtype = 'Z';
-					handle->packlen = 14;	/* Z packets are hardware dependent */
-					break;
-
-				default:	/* Unknown packet! */
-#if defined(DEBUG)
-					printf("\nUnknown packet (1): 0x%02x \n ", rawbuf[i]);
-					printf("                char:  ");
-					if(isprint(rawbuf[i]))
-						printf("%c", rawbuf[i]);
-					else
-						printf(" (unprintable)");
-					printf("\n");
-#endif
-					continue;
-				}
-			}
+		if(pt->proc) {
+			pt->proc(handle);
+		}
+	}
 
+	return packs;
+}
 
-			handle->buf[handle->bufpos] = rawbuf[i];
-			handle->bufpos++;
+static void proc_disp(sballhandle *handle)
+{
+	/* modified by John Tsiombikas for spacenavd integration */
+	unsigned int tx, ty, tz, rx, ry, rz;
+	int i, prev_val[6], new_val[6];
+
+	/* number of 1/16ths of milliseconds since last */
+	/* ball displacement packet */
+	handle->timer = ((handle->buf[1]) << 8) | (handle->buf[2]);
+
+	tx = ((handle->buf[3]) << 8) | ((handle->buf[4]));
+	ty = ((handle->buf[5]) << 8) | ((handle->buf[6]));
+	tz = ((handle->buf[7]) << 8) | ((handle->buf[8]));
+	rx = ((handle->buf[9]) << 8) | ((handle->buf[10]));
+	ry = ((handle->buf[11]) << 8) | ((handle->buf[12]));
+	rz = ((handle->buf[13]) << 8) | ((handle->buf[14]));
+
+	for(i=0; i<3; i++) {
+		prev_val[i] = handle->trans[i];
+		prev_val[i + 3] = handle->rot[i];
+	}
 
-			/* Reset packet processing */
-			if(handle->packtype == '@') {
-				if(rawbuf[i] != '\r')
-					continue;
-				else
-					handle->packlen = handle->bufpos;
-			}
+	new_val[0] = (((int)tx) << 16) >> 16;
+	new_val[1] = (((int)ty) << 16) >> 16;
+	new_val[2] = (((int)tz) << 16) >> 16;
+	new_val[3] = (((int)rx) << 16) >> 16;
+	new_val[4] = (((int)ry) << 16) >> 16;
+	new_val[5] = (((int)rz) << 16) >> 16;
 
-			/* Error packet processing */
-			if(handle->packtype == 'E') {
-				if(rawbuf[i] != '\r')
-					continue;
-				else
-					handle->packlen = handle->bufpos;
-			} else if(handle->bufpos != handle->packlen)
-				continue;
+	generate_motion_events(handle, prev_val, new_val, handle->timer);
 
-			switch(handle->packtype) {
-			case 'D':	/* ball displacement event */
-				/* modified by John Tsiombikas for spacenavd integration */
-				{
-					unsigned int tx, ty, tz, rx, ry, rz;
-					int i, prev_val[6], new_val[6];
-
-					/* number of 1/16ths of milliseconds since last */
-					/* ball displacement packet */
-					handle->timer = ((handle->buf[1]) << 8) | (handle->buf[2]);
-
-					tx = ((handle->buf[3]) << 8) | ((handle->buf[4]));
-					ty = ((handle->buf[5]) << 8) | ((handle->buf[6]));
-					tz = ((handle->buf[7]) << 8) | ((handle->buf[8]));
-					rx = ((handle->buf[9]) << 8) | ((handle->buf[10]));
-					ry = ((handle->buf[11]) << 8) | ((handle->buf[12]));
-					rz = ((handle->buf[13]) << 8) | ((handle->buf[14]));
-
-					for(i=0; i<3; i++) {
-						prev_val[i] = handle->trans[i];
-						prev_val[i + 3] = handle->rot[i];
-					}
-
-					new_val[0] = (((int)tx) << 16) >> 16;
-					new_val[1] = (((int)ty) << 16) >> 16;
-					new_val[2] = (((int)tz) << 16) >> 16;
-					new_val[3] = (((int)rx) << 16) >> 16;
-					new_val[4] = (((int)ry) << 16) >> 16;
-					new_val[5] = (((int)rz) << 16) >> 16;
-
-					generate_motion_events(handle, prev_val, new_val, handle->timer);
-
-					for(i=0; i<3; i++) {
-						handle->trans[i] = new_val[i];
-						handle->rot[i] = new_val[i + 3];
-					}
-				}
-				break;
-
-			case 'K':	/* button press event */
-				/* modified by John Tsiombikas for spacenavd integration */
-				{
-					int newstate;
-
-					/* Spaceball 2003A, 2003B, 2003 FLX, 3003 FLX, 4000 FLX       */
-					/* button packet. (4000 only for backwards compatibility)     */
-					/* The lowest 5 bits of the first byte are buttons 5-9        */
-					/* Button '8' on a Spaceball 2003 is the rezero button        */
-					/* The lowest 4 bits of the second byte are buttons 1-4       */
-					/* For Spaceball 2003, we'll map the buttons 1-7 normally     */
-					/* skip 8, as its a hardware "rezero button" on that device   */
-					/* and call the "pick" button "8".                            */
-					/* On the Spaceball 3003, the "right" button also triggers    */
-					/* the "pick" bit.  We OR the 2003/3003 rezero bits together  */
-
-					/* if we have found a Spaceball 4000, then we ignore the 'K'  */
-					/* packets entirely, and only use the '.' packets.            */
-					if(handle->spaceball4000)
-						break;
-
-					newstate = ((handle->buf[1] & 0x10) << 3) |	/* 2003 pick button is "8" */
-						((handle->buf[1] & 0x20) << 9) |	/* 3003 rezero button      */
-						((handle->buf[1] & 0x08) << 11) |	/* 2003 rezero button      */
-						((handle->buf[1] & 0x07) << 4) |	/* 5,6,7    (2003/4000)    */
-						((handle->buf[2] & 0x30) << 8) |	/* 3003 Left/Right buttons */
-						((handle->buf[2] & 0x0F));	/* 1,2,3,4  (2003/4000)    */
-
-					generate_button_events(handle, handle->buttons, newstate);
-					handle->buttons = newstate;
-				}
-				break;
-
-			case '.':	/* button press event (4000) */
-				/* modified by John Tsiombikas for spacenavd integration */
-				{
-					int newstate;
-					/* Spaceball 4000 FLX "expanded" button packet, with 12 buttons */
-
-					/* extra packet validity check, since we use this packet type */
-					/* to override the 'K' button packets, and determine if its a */
-					/* Spaceball 4000 or not...                                   */
-					if(handle->buf[3] != '\r') {
-						break;	/* if not terminated with a '\r', probably garbage */
-					}
-
-					/* if we got a valid '.' packet, this must be a Spaceball 4000 */
-#if defined(DEBUG)
-					if(!handle->spaceball4000)
-						printf("\nDetected a Spaceball 4000 FLX\n");
-#endif
-					handle->spaceball4000 = 1;	/* Must be talking to a Spaceball 4000 */
+	for(i=0; i<3; i++) {
+		handle->trans[i] = new_val[i];
+		handle->rot[i] = new_val[i + 3];
+	}
+}
 
-					/* Spaceball 4000 series "expanded" button press event      */
-					/* includes data for 12 buttons, and left/right orientation */
-					newstate = (((~handle->buf[1]) & 0x20) << 10) |	/* "left handed" mode  */
-						((handle->buf[1] & 0x1F) << 7) |	/* 8,9,10,11,12        */
-						((handle->buf[2] & 0x3F)) |	/* 1,2,3,4,5,6 (4000)  */
-						((handle->buf[2] & 0x80) >> 1);	/* 7           (4000)  */
+static void proc_key(sballhandle *handle)
+{
+	/* modified by John Tsiombikas for spacenavd integration */
+	int newstate;
+
+	/* Spaceball 2003A, 2003B, 2003 FLX, 3003 FLX, 4000 FLX       */
+	/* button packet. (4000 only for backwards compatibility)     */
+	/* The lowest 5 bits of the first byte are buttons 5-9        */
+	/* Button '8' on a Spaceball 2003 is the rezero button        */
+	/* The lowest 4 bits of the second byte are buttons 1-4       */
+	/* For Spaceball 2003, we'll map the buttons 1-7 normally     */
+	/* skip 8, as its a hardware "rezero button" on that device   */
+	/* and call the "pick" button "8".                            */
+	/* On the Spaceball 3003, the "right" button also triggers    */
+	/* the "pick" bit.  We OR the 2003/3003 rezero bits together  */
+
+	/* if we have found a Spaceball 4000, then we ignore the 'K'  */
+	/* packets entirely, and only use the '.' packets.            */
+	if(handle->spaceball4000)
+		return;
+
+	newstate = ((handle->buf[1] & 0x10) << 3) |	/* 2003 pick button is "8" */
+		((handle->buf[1] & 0x20) << 9) |	/* 3003 rezero button      */
+		((handle->buf[1] & 0x08) << 11) |	/* 2003 rezero button      */
+		((handle->buf[1] & 0x07) << 4) |	/* 5,6,7    (2003/4000)    */
+		((handle->buf[2] & 0x30) << 8) |	/* 3003 Left/Right buttons */
+		((handle->buf[2] & 0x0F));	/* 1,2,3,4  (2003/4000)    */
+
+	generate_button_events(handle, handle->buttons, newstate);
+	handle->buttons = newstate;
+}
 
-					generate_button_events(handle, handle->buttons, newstate);
-					handle->buttons = newstate;
+static void proc_key4000(sballhandle *handle)
+{
+	/* modified by John Tsiombikas for spacenavd integration */
+	int newstate;
 
-#if defined(DEBUG)
-					if(handle->leftymode4000 != ((handle->buf[1] & 0x20) == 0))
-						printf("\nSpaceball 4000 mode changed to: %s\n",
-							   (((handle->buf[1] & 0x20) ==
-							 0) ? "left handed" : "right handed"));
-#endif
-					/* set "lefty" orientation mode if "lefty bit" is _clear_ */
-					if((handle->buf[1] & 0x20) == 0)
-						handle->leftymode4000 = 1;	/* left handed mode */
-					else
-						handle->leftymode4000 = 0;	/* right handed mode */
-				}
-				break;
-
-			case 'C':	/* Communications mode packet */
-			case 'F':	/* Spaceball sensitization packet */
-			case 'P':	/* Spaceball update rate packet */
-			case 'M':	/* Spaceball movement mode packet */
-			case 'N':	/* Null region packet */
-			case '\r':	/* carriage return at poweron */
-			case '\v':	/* XON at poweron */
-				/* eat and ignore these packets */
-				break;
-
-			case '@':	/* Reset packet */
-#ifdef DEBUG
-				printf("Spaceball reset: ");
-				for(j = 0; j < handle->packlen; j++) {
-					if(isprint(handle->buf[j]))
-						printf("%c", handle->buf[j]);
-				}
-				printf("\n");
-#endif
-				/* if we get a reset packet, we have to re-initialize       */
-				/* the device, and assume that its completely schizophrenic */
-				/* at this moment, we must reset it again at this point     */
-				handle->resetoccured = 1;
-				sball_hwreset(handle);
-				break;
-
-
-			case 'E':	/* Error packet, hardware/software problem */
-				handle->erroroccured++;
-#ifdef DEBUG
-				printf("\nSpaceball Error!!    ");
-				printf("Error code: ");
-				for(j = 0; j < handle->packlen; j++) {
-					printf(" 0x%02x ", handle->buf[j]);
-				}
-				printf("\n");
-#endif
-				break;
-
-			case 'Z':	/* Zero packet (Spaceball 2003/3003/4000 FLX) */
-				/* We just ignore these... */
-				break;
-
-			default:
-#ifdef DEBUG
-				printf("Unknown packet (2): 0x%02x\n", handle->packtype);
-				printf("              char:  ");
-				if(isprint(handle->packtype))
-					printf("%c", handle->packtype);
-				else
-					printf(" (unprintable)");
-				printf("\n");
-#endif
-				break;
-			}
+	/* Spaceball 4000 FLX "expanded" button packet, with 12 buttons */
 
-			/* reset */
-			handle->bufpos = 0;
-			handle->packtype = 0;
-			handle->packlen = 1;
-			packs++;
-		}
-	}
+	/* if we got a valid '.' packet, this must be a Spaceball 4000 */
+	handle->spaceball4000 = 1;	/* Must be talking to a Spaceball 4000 */
 
-	return packs;
+	/* Spaceball 4000 series "expanded" button press event      */
+	/* includes data for 12 buttons, and left/right orientation */
+	newstate = (((~handle->buf[1]) & 0x20) << 10) |	/* "left handed" mode  */
+		((handle->buf[1] & 0x1F) << 7) |	/* 8,9,10,11,12        */
+		((handle->buf[2] & 0x3F)) |	/* 1,2,3,4,5,6 (4000)  */
+		((handle->buf[2] & 0x80) >> 1);	/* 7           (4000)  */
+
+	generate_button_events(handle, handle->buttons, newstate);
+	handle->buttons = newstate;
+
+	/* set "lefty" orientation mode if "lefty bit" is _clear_ */
+	if((handle->buf[1] & 0x20) == 0)
+		handle->leftymode4000 = 1;	/* left handed mode */
+	else
+		handle->leftymode4000 = 0;	/* right handed mode */
+}
+
+static void proc_reset(sballhandle *handle)
+{
+	/* if we get a reset packet, we have to re-initialize       */
+	/* the device, and assume that its completely schizophrenic */
+	/* at this moment, we must reset it again at this point     */
+	handle->st.resets++;
+	handle->resetoccured = 1;
+	sball_hwreset(handle);
+}
+
+static void proc_error(sballhandle *handle)
+{
+	/* Error packet, hardware/software problem */
+	handle->erroroccured++;
+	handle->st.dev_errors++;
 }
 
 
@@ -629,21 +568,39 @@ int sball_getstatus(SBallHandle voidhandle, int *tx, int *ty, int *tz,
  */
 int sball_get_input(SBallHandle voidhandle, struct dev_input *inp)
 {
-	struct event *ev;
 	sballhandle *handle = voidhandle;
 
-	/* read pending packets from the device and append them in the event list */
-	sball_update(handle);
+	/* only read from the device when everything parsed from the previous
+	 * read has been handed out. A read normally brings in whole packets, and
+	 * all the input they produce is returned by the following calls without
+	 * touching the device again.
+	 */
+	if(handle->evrd == handle->evwr) {
+		handle->evrd = handle->evwr = 0;
+		sball_update(handle);
+		if(handle->evrd == handle->evwr) {
+			return 0;
+		}
+	}
 
-	/* if there are any events in the list, grab the first and return it */
-	if((ev = handle->evhead)) {
-		handle->evhead = handle->evhead->next;
+	*inp = handle->evring[handle->evrd++ & (SBALL_EVRING_SIZE - 1)];
+	return 1;
+}
 
-		*inp = ev->data;
-		free_event(ev);
-		return 1;
-	}
-	return 0;
+int sball_parse(SBallHandle voidhandle, const void *data, int sz)
+{
+	sballhandle *handle = voidhandle;
+	unsigned int start = handle->evwr;
+
+	parse(handle, data, sz);
+	return handle->evwr - start;
+}
+
+void sball_get_stats(SBallHandle voidhandle, struct serial_stats *st)
+{
+	sballhandle *handle = voidhandle;
+
+	*st = handle->st;
 }
 
 int sball_get_fd(SBallHandle voidhandle)
@@ -653,69 +610,35 @@ int sball_get_fd(SBallHandle voidhandle)
 	return sball_comm_fd(sball->commhandle);
 }
 
-static struct event *alloc_event(void)
+static void append_event(sballhandle *handle, int type, int idx, int val)
 {
-	struct event *ev;
-
-	if(ev_free_list) {
-		ev = ev_free_list;
-		ev_free_list = ev->next;
-	} else {
-		ev = malloc(sizeof *ev);
-		evpool_size++;
-	}
-	return ev;
-}
+	struct dev_input *inp;
 
-static void free_event(struct event *ev)
-{
-	if(evpool_size > 512) {
-		free(ev);
-		evpool_size--;
-	} else {
-		ev->next = ev_free_list;
-		ev_free_list = ev;
+	if(handle->evwr - handle->evrd >= SBALL_EVRING_SIZE) {
+		handle->st.dropped++;	/* can't happen with the read size limit */
+		return;
 	}
+	inp = handle->evring + (handle->evwr++ & (SBALL_EVRING_SIZE - 1));
+	inp->type = type;
+	inp->idx = idx;
+	inp->val = val;
+	/* no device timestamp for serial input */
+	inp->tm.tv_sec = inp->tm.tv_usec = 0;
 }
 
 static void generate_motion_events(sballhandle *handle, int *prev_val, int *new_val, int timer)
 {
 	int i, pending = 0;
-	struct event *ev;
 
 	for(i=0; i<6; i++) {
-		if(prev_val[i] == new_val[i]) {
-			continue;
-		}
-
-		if((ev = alloc_event())) {
-			ev->data.type = INP_MOTION;
-			ev->data.idx = i;
-			ev->data.val = new_val[i];
-			ev->next = 0;
-
-			if(handle->evhead) {
-				handle->evtail->next = ev;
-				handle->evtail = ev;
-			} else {
-				handle->evhead = handle->evtail = ev;
-			}
+		if(prev_val[i] != new_val[i]) {
+			append_event(handle, INP_MOTION, i, new_val[i]);
 			pending = 1;
 		}
 	}
 
 	if(pending) {
-		if((ev = alloc_event())) {
-			ev->data.type = INP_FLUSH;
-			ev->next = 0;
-		}
-
-		if(handle->evhead) {
-			handle->evtail->next = ev;
-			handle->evtail = ev;
-		} else {
-			handle->evhead = handle->evtail = ev;
-		}
+		append_event(handle, INP_FLUSH, 0, 0);
 	}
 }
 
@@ -727,20 +650,7 @@ static void generate_button_events(sballhandle *handle, int prevstate, int newst
 		int newbit = (newstate >> i) & 1;
 		if(newbit != ((prevstate >> i) & 1)) {
 			/* state changed, trigger event */
-			struct event *ev = alloc_event();
-			if(!ev) continue;
-
-			ev->data.type = INP_BUTTON;
-			ev->data.idx = i;
-			ev->data.val = newbit;
-			ev->next = 0;
-
-			if(handle->evhead) {
-				handle->evtail->next = ev;
-				handle->evtail = ev;
-			} else {
-				handle->evhead = handle->evtail = ev;
-			}
+			append_event(handle, INP_BUTTON, i, newbit);
 		}
 	}
 }
@@ -48,6 +48,13 @@ permission notice:
 
 #include "event.h"
 
+/* most bytes sball_parse can take at a time */
+#define SBALL_READ_SIZE		128
+/* motion values are 16 bit signed */
+#define SBALL_MAX_VALUE		32767
+
+struct serial_stats;
+
 #ifdef  __cplusplus
 extern "C" {
 #endif
@@ -125,9 +132,29 @@ int sball_getstatus(SBallHandle voidhandle, int *tx, int *ty, int *tz, int *rx,
  *
  * returns the first of any pending events through inp.
  * returns 1 if it got an event, 0 if there where none pending
+ * The device is only read when all input from the previous read has been
+ * returned, so call it until it returns 0.
  */
 int sball_get_input(SBallHandle voidhandle, struct dev_input *inp);
 
+/* sball_open_parser() - Added for spacenavd integration.
+ *
+ * creates a handle without a serial port, to feed data to with sball_parse
+ * (testing, benchmarks). Release it with sball_close. */
+SBallHandle sball_open_parser(void);
+
+/* sball_parse() - Added for spacenavd integration.
+ *
+ * parses sz bytes of device data (up to SBALL_READ_SIZE), which can end
+ * anywhere in a packet, and queues the resulting input for sball_get_input.
+ * returns the number of inputs queued */
+int sball_parse(SBallHandle voidhandle, const void *data, int sz);
+
+/* sball_get_stats() - Added for spacenavd integration.
+ *
+ * retrieves the parser counters (packets, malformed input) */
+void sball_get_stats(SBallHandle voidhandle, struct serial_stats *st);
+
 /* sball_get_fd() - Added for spacenavd integration by John Tsiombikas.
  *
  * retreives the device file descriptor */
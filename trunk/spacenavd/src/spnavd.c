@@ -24,16 +24,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 #include "spnavd.h"
 #include "dev.h"
 #include "hotplug.h"
 #include "client.h"
 #include "proto_unix.h"
+#include "stats.h"
+#include "kbemu.h"
+#include "proto_uinput.h"
+#include "proto_net.h"
+#include "lowlat.h"
+#include "iouring.h"
+#include "flightrec.h"
+#include "probes.h"
 #ifdef USE_X11
 #include "proto_x11.h"
+#include "xout.h"
 #endif
 
 static void cleanup(void);
@@ -41,15 +54,45 @@ static void daemonize(void);
 static int write_pid_file(void);
 static int find_running_daemon(void);
 static void handle_events(fd_set *rset);
+static void handle_sig_events(void);
+static int init_cfg_watch(void);
+static void handle_cfg_watch(void);
+static void reload_cfg(void);
+static void update_idle(void);
+static void dev_attached(struct device *dev, void *cls);
 static void sig_handler(int s);
 
+struct cfg cfg;
+int verbose;
+struct spnav_core *core;
+
+/* self-pipe used to move signal handling out of signal context */
+static int sig_pipe[2] = {-1, -1};
+/* inotify watch for changes to the config file */
+static int cfg_watch_fd = -1;
+
+/* low-latency mode requested on the command line */
+static int lowlat_cmdline;
+
+/* reload_pending flags */
+enum {
+	RELOAD_FORCE = 1,	/* explicit reload request (SIGHUP or control socket) */
+	RELOAD_WATCH = 2	/* config file changed on disk */
+};
+static int reload_pending;
+/* identifies the config file as last written by save_cfg */
+static struct stat saved_cfg_stat;
+
 
 int main(int argc, char **argv)
 {
 	int i, pid, ret, become_daemon = 1;
 
 	for(i=1; i<argc; i++) {
-		if(argv[i][0] == '-' && argv[i][2] == 0) {
+		if(strcmp(argv[i], "--low-latency") == 0) {
+			lowlat_cmdline = 1;
+
+		} else if(argv[i][0] == '-' && argv[i][2] == 0) {
 			switch(argv[i][1]) {
 			case 'd':
 				become_daemon = !become_daemon;
@@ -59,11 +102,16 @@ int main(int argc, char **argv)
 				verbose = 1;
 				break;
 
+			case 'l':
+				lowlat_cmdline = 1;
+				break;
+
 			case 'h':
 				printf("usage: %s [options]\n", argv[0]);
 				printf("options:\n");
 				printf("  -d\tdo not daemonize\n");
 				printf("  -v\tverbose output\n");
+				printf("  -l, --low-latency\n\trealtime scheduling, locked memory (see low-latency in spnavrc)\n");
 				printf("  -h\tprint this usage information\n");
 				return 0;
 
@@ -89,7 +137,18 @@ int main(int argc, char **argv)
 
 	puts("Spacenav daemon " VERSION);
 
-	read_cfg("/etc/spnavrc", &cfg);
+	read_cfg(CFGFILE, &cfg);
+	kbemu_config();
+	frec_init(cfg.flight_size, cfg.flight_file);
+
+	if(pipe(sig_pipe) == -1) {
+		perror("failed to create signal self-pipe");
+		return 1;
+	}
+	fcntl(sig_pipe[0], F_SETFL, fcntl(sig_pipe[0], F_GETFL) | O_NONBLOCK);
+	fcntl(sig_pipe[1], F_SETFL, fcntl(sig_pipe[1], F_GETFL) | O_NONBLOCK);
+
+	init_cfg_watch();
 
 	signal(SIGINT, sig_handler);
 	signal(SIGTERM, sig_handler);
@@ -97,11 +156,24 @@ int main(int argc, char **argv)
 	signal(SIGHUP, sig_handler);
 	signal(SIGUSR1, sig_handler);
 	signal(SIGUSR2, sig_handler);
+	signal(SIGQUIT, sig_handler);
 
-	init_devices();
+	if(!(core = spnav_core_create(&cfg))) {
+		return 1;
+	}
+	spnav_core_set_verbose(core, verbose);
+	spnav_core_set_device_func(core, dev_attached, 0);
+	init_dispatch(core);
+	set_low_latency(lowlat_cmdline || cfg.low_latency);
+	spnav_core_set_threaded(core, cfg.dev_threads);
+	set_uring(cfg.io_uring);
+
+	init_devices(core);
 	init_hotplug();
 
 	init_unix();
+	init_uinput();
+	init_net();
 #ifdef USE_X11
 	init_x11();
 #endif
@@ -112,17 +184,24 @@ int main(int argc, char **argv)
 		fd_set rset;
 		int fd, max_fd = 0;
 		struct client *client_iter;
-		struct device *dev;
+
+		update_idle();
 
 		FD_ZERO(&rset);
 
-		dev = get_devices();
-		while(dev) {
-			if((fd = get_device_fd(dev)) != -1) {
-				FD_SET(fd, &rset);
-				if(fd > max_fd) max_fd = fd;
-			}
-			dev = dev->next;
+		FD_SET(sig_pipe[0], &rset);
+		max_fd = sig_pipe[0];
+
+		if(cfg_watch_fd != -1) {
+			FD_SET(cfg_watch_fd, &rset);
+			if(cfg_watch_fd > max_fd) max_fd = cfg_watch_fd;
+		}
+
+		max_fd = spnav_core_fdset(core, &rset, max_fd);
+
+		if((fd = get_uring_fd()) != -1) {
+			FD_SET(fd, &rset);
+			if(fd > max_fd) max_fd = fd;
 		}
 
 		if((fd = get_hotplug_fd()) != -1) {
@@ -155,64 +234,104 @@ int main(int argc, char **argv)
 			FD_SET(fd, &rset);
 			if(fd > max_fd) max_fd = fd;
 		}
+		/* notifications from the X11 output thread */
+		if((fd = xout_get_fd()) != -1) {
+			FD_SET(fd, &rset);
+			if(fd > max_fd) max_fd = fd;
+		}
 #endif
 
 		do {
-			/* if there is at least one device out of the deadzone and repeat is enabled
-			 * wait for only as long as specified in cfg.repeat_msec
+			/* Each of these keeps its own deadline, and returns the time left
+			 * until it (-1 if there is none). Whichever is nearest is the select
+			 * timeout, and after select each one is checked on its own, since
+			 * more than one can be due at the same time.
 			 */
 			struct timeval tv, *timeout = 0;
-			if(cfg.repeat_msec >= 0) {
-				dev = get_devices();
-				while(dev) {
-					if(is_device_valid(dev) && !in_deadzone(dev)) {
-						tv.tv_sec = cfg.repeat_msec / 1000;
-						tv.tv_usec = cfg.repeat_msec % 1000;
-						timeout = &tv;
-						break;
-					}
-					dev = dev->next;
-				}
+			long usec, min_usec = -1;
+
+			/* if there is at least one device out of the deadzone and repeat
+			 * is enabled, repeat-interval after its last motion event
+			 */
+			if((usec = spnav_core_repeat_timeout(core)) >= 0) {
+				min_usec = usec;
 			}
 
+			/* the device timers (serial device detection) */
+			if((usec = spnav_core_timeout(core)) >= 0) {
+				usec *= 1000;
+				if(min_usec < 0 || usec < min_usec) min_usec = usec;
+			}
+
+			/* repeating the state to the network receivers, sent if due */
+			if((usec = send_net_repeat()) >= 0) {
+				if(min_usec < 0 || usec < min_usec) min_usec = usec;
+			}
+
+			/* the next rate-limited client deadline, motion sent if due */
+			if((usec = send_pending_motion()) >= 0) {
+				if(min_usec < 0 || usec < min_usec) min_usec = usec;
+			}
+
+			if(min_usec >= 0) {
+				tv.tv_sec = min_usec / 1000000;
+				tv.tv_usec = min_usec % 1000000;
+				timeout = &tv;
+			}
+
+#ifdef USE_X11
+			flush_x11();
+#endif
+			flush_uring();
 			ret = select(max_fd + 1, &rset, 0, 0, timeout);
 		} while(ret == -1 && errno == EINTR);
 
+		if(stats.idle_start) {
+			stats.idle_wakeups++;
+		}
+
 		if(ret > 0) {
 			handle_events(&rset);
-		} else {
-			if(cfg.repeat_msec >= 0) {
-				dev = get_devices();
-				while(dev) {
-					if(!in_deadzone(dev)) {
-						repeat_last_event(dev);
-					}
-					dev = dev->next;
-				}
-			}
 		}
+		/* due repeat-interval after the last motion event, so any new input
+		 * postpones it
+		 */
+		if(spnav_core_repeat_timeout(core) == 0) {
+			spnav_core_repeat(core);
+		}
+		spnav_core_timers(core);
 	}
 	return 0;	/* unreachable */
 }
 
 static void cleanup(void)
 {
-	struct device *dev;
-
 #ifdef USE_X11
 	close_x11();	/* call to avoid leaving garbage in the X server's root windows */
 #endif
 	close_unix();
+	close_uinput();
+	close_net();
+	kbemu_cleanup();
 
 	shutdown_hotplug();
 
-	dev = get_devices();
-	while(dev) {
-		struct device *tmp = dev;
-		dev = dev->next;
-		remove_device(tmp);
+	if(cfg_watch_fd != -1) {
+		close(cfg_watch_fd);
+		cfg_watch_fd = -1;
 	}
 
+	/* before destroying the core, for the device statistics */
+	if(verbose) {
+		print_stats(stdout);
+	}
+
+	set_uring(0);
+	spnav_core_destroy(core);
+	core = 0;
+
+	frec_shutdown();
+
 	remove(PIDFILE);
 }
 
@@ -294,9 +413,15 @@ static int find_running_daemon(void)
 
 static void handle_events(fd_set *rset)
 {
-	int dev_fd, hotplug_fd;
-	struct device *dev;
-	struct dev_input inp;
+	int hotplug_fd, res;
+
+	/* deferred signal handling and config file change notifications */
+	if(FD_ISSET(sig_pipe[0], rset)) {
+		handle_sig_events();
+	}
+	if(cfg_watch_fd != -1 && FD_ISSET(cfg_watch_fd, rset)) {
+		handle_cfg_watch();
+	}
 
 	/* handle anything coming through the UNIX socket */
 	handle_uevents(rset);
@@ -307,52 +432,277 @@ static void handle_events(fd_set *rset)
 #endif
 
 	/* finally read any pending device input data */
-	dev = get_devices();
-	while(dev) {
-		/* keep the next pointer because read_device can potentially destroy
-		 * the device node if the read fails.
-		 */
-		struct device *next = dev->next;
+	handle_uring(rset);
+	spnav_core_handle(core, rset);
+
+	if((hotplug_fd = get_hotplug_fd()) != -1) {
+		if(FD_ISSET(hotplug_fd, rset)) {
+			frec_record(FREC_HOTPLUG, -1, 0, 0, 0);
+			PROBE(hotplug_start);
+			res = handle_hotplug();
+			PROBE1(hotplug_end, res);
+		}
+	}
+
+	/* config reloads are applied last, after all pending input has been
+	 * processed with the previous configuration.
+	 */
+	if(reload_pending) {
+		reload_cfg();
+	}
+}
+
+/* suspends device input while nothing needs it: no clients, and no buttons
+ * mapped to keys.
+ */
+static void update_idle(void)
+{
+	int idle = cfg.idle_suspend && !first_client() && !kbemu_active();
+
+	if(idle == spnav_core_suspended(core)) {
+		return;
+	}
+
+	if(idle) {
+		if(verbose) {
+			printf("no clients, suspending device input\n");
+		}
+		stats.idle_periods++;
+		stats.idle_start = get_time_usec();
+	} else {
+		if(verbose) {
+			printf("resuming device input\n");
+		}
+		stats.idle_usec += get_time_usec() - stats.idle_start;
+		stats.idle_start = 0;
+	}
+	frec_record(FREC_SUSPEND, -1, idle, 0, 0);
+	spnav_core_suspend(core, idle);
+}
+
+static void handle_sig_events(void)
+{
+	unsigned char sig[32];
+	int i, sz;
+
+	while((sz = read(sig_pipe[0], sig, sizeof sig)) > 0) {
+		for(i=0; i<sz; i++) {
+			switch(sig[i]) {
+			case SIGHUP:
+				reload_pending |= RELOAD_FORCE;
+				break;
+
+			case SIGQUIT:
+				frec_dump(stdout, 0);
+				break;
+
+#ifdef USE_X11
+			case SIGUSR1:
+				init_x11();
+				break;
 
-		if((dev_fd = get_device_fd(dev)) != -1 && FD_ISSET(dev_fd, rset)) {
-			/* read an event from the device ... */
-			while(read_device(dev, &inp) != -1) {
-				/* ... and process it, possibly dispatching a spacenav event to clients */
-				process_input(dev, &inp);
+			case SIGUSR2:
+				close_x11();
+				break;
+#endif
+
+			default:
+				break;
 			}
 		}
-		dev = next;
 	}
+}
 
-	if((hotplug_fd = get_hotplug_fd()) != -1) {
-		if(FD_ISSET(hotplug_fd, rset)) {
-			handle_hotplug();
+#ifdef __linux__
+static int init_cfg_watch(void)
+{
+	if((cfg_watch_fd = inotify_init()) == -1) {
+		perror("failed to create inotify queue, config file will not be watched");
+		return -1;
+	}
+	fcntl(cfg_watch_fd, F_SETFL, fcntl(cfg_watch_fd, F_GETFL) | O_NONBLOCK);
+
+	/* watch the directory instead of the file itself, so that we also catch
+	 * editors which write a new file and rename it over the old one.
+	 */
+	if(inotify_add_watch(cfg_watch_fd, "/etc", IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+		perror("failed to watch /etc for config file changes");
+		close(cfg_watch_fd);
+		cfg_watch_fd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static void handle_cfg_watch(void)
+{
+	char buf[4096];
+	char *ptr, *cfgname;
+	int sz;
+
+	cfgname = strrchr(CFGFILE, '/') + 1;
+
+	while((sz = read(cfg_watch_fd, buf, sizeof buf)) > 0) {
+		ptr = buf;
+		while(ptr < buf + sz) {
+			struct inotify_event *ev = (struct inotify_event*)ptr;
+
+			if(ev->len && strcmp(ev->name, cfgname) == 0) {
+				reload_pending |= RELOAD_WATCH;
+			}
+			ptr += sizeof *ev + ev->len;
+		}
+	}
+}
+#else
+static int init_cfg_watch(void)
+{
+	return -1;
+}
+
+static void handle_cfg_watch(void)
+{
+}
+#endif	/* __linux__ */
+
+void schedule_cfg_reload(void)
+{
+	reload_pending |= RELOAD_FORCE;
+}
+
+int save_cfg(void)
+{
+	if(write_cfg(CFGFILE, &cfg) == -1) {
+		return -1;
+	}
+	/* remember what we wrote, to avoid reloading it when the file watch fires */
+	if(stat(CFGFILE, &saved_cfg_stat) == -1) {
+		memset(&saved_cfg_stat, 0, sizeof saved_cfg_stat);
+	}
+	return 0;
+}
+
+/* returns non-zero if the config file is the one we wrote in save_cfg */
+static int cfg_unchanged(void)
+{
+	struct stat st;
+
+	if(!saved_cfg_stat.st_ino || stat(CFGFILE, &st) == -1) {
+		return 0;
+	}
+	return st.st_ino == saved_cfg_stat.st_ino && st.st_size == saved_cfg_stat.st_size &&
+		st.st_mtime == saved_cfg_stat.st_mtime;
+}
+
+/* returns non-zero if someone (spnavcfg for instance) is still holding a write
+ * lock on the config file.
+ */
+static int cfg_locked(void)
+{
+	int fd, res;
+	struct flock flk;
+
+	if((fd = open(CFGFILE, O_RDONLY)) == -1) {
+		return 0;
+	}
+	flk.l_type = F_RDLCK;
+	flk.l_start = flk.l_len = 0;
+	flk.l_whence = SEEK_SET;
+
+	res = fcntl(fd, F_GETLK, &flk) == 0 && flk.l_type != F_UNLCK;
+	close(fd);
+	return res;
+}
+
+/* Parses the config file into a fresh cfg structure and swaps it in place of
+ * the current one. This is only ever called from the main loop between event
+ * processing rounds, so nothing can observe a half-updated configuration.
+ */
+static void reload_cfg(void)
+{
+	int prev_led = cfg.led;
+	unsigned long long start;
+	unsigned long dur;
+	struct cfg newcfg;
+
+	/* don't block waiting for a writer to release the lock; we'll get another
+	 * notification when it's done, and try again then.
+	 */
+	if(cfg_locked()) {
+		if(verbose) {
+			printf("config file locked, deferring reload\n");
 		}
+		return;
+	}
+
+	if(reload_pending == RELOAD_WATCH && cfg_unchanged()) {
+		/* just our own save_cfg, nothing to reload */
+		reload_pending = 0;
+		return;
+	}
+	reload_pending = 0;
+
+	PROBE(reload_start);
+	start = get_time_usec();
+
+	read_cfg(CFGFILE, &newcfg);
+	destroy_cfg(&cfg);
+	cfg = newcfg;
+	kbemu_config();
+	frec_init(cfg.flight_size, cfg.flight_file);
+	init_uinput();
+	init_net();
+	set_low_latency(lowlat_cmdline || cfg.low_latency);
+	spnav_core_set_threaded(core, cfg.dev_threads);
+	set_uring(cfg.io_uring);
+
+	dur = (unsigned long)(get_time_usec() - start);
+	frec_record(FREC_RELOAD, -1, dur, 0, 0);
+	PROBE1(reload_end, dur);
+	stats.cfg_reloads++;
+	stats.cfg_reload_usec = dur;
+	if(dur > stats.cfg_reload_max_usec) {
+		stats.cfg_reload_max_usec = dur;
+	}
+	if(verbose) {
+		printf("reloaded config file in %lu usec\n", dur);
+	}
+
+	if(cfg.led != prev_led) {
+		set_devices_led(core, cfg.led);
 	}
 }
 
 /* signals usr1 & usr2 are sent by the spnav_x11 script to start/stop the
- * daemon's connection to the X server.
+ * daemon's connection to the X server, and SIGQUIT dumps the flight recorder
+ * to the log.
+ * SIGHUP, SIGQUIT, SIGUSR1 and SIGUSR2 are only forwarded through the
+ * self-pipe, and handled by the main loop in handle_sig_events.
+ */
+/* sizes the subscriber lists of new devices before they produce any events,
+ * dispatching never allocates them. The uinput axis ranges follow the motion
+ * range of the devices, so they're checked here too.
  */
+static void dev_attached(struct device *dev, void *cls)
+{
+	reserve_device_clients(dev->core);
+	update_uinput();
+}
+
 static void sig_handler(int s)
 {
-	int prev_led = cfg.led;
+	unsigned char c;
+	int saved_errno;
 
 	switch(s) {
 	case SIGHUP:
-		read_cfg("/etc/spnavrc", &cfg);
-		if(cfg.led != prev_led) {
-			struct device *dev = get_devices();
-			while(dev) {
-				if(is_device_valid(dev)) {
-					if(verbose) {
-						printf("turn led %s, device: %s\n", cfg.led ? "on": "off", dev->name);
-					}
-					set_device_led(dev, cfg.led);
-				}
-				dev = dev->next;
-			}
-		}
+	case SIGQUIT:
+	case SIGUSR1:
+	case SIGUSR2:
+		saved_errno = errno;
+		c = s;
+		write(sig_pipe[1], &c, 1);
+		errno = saved_errno;
 		break;
 
 	case SIGSEGV:
@@ -361,16 +711,6 @@ static void sig_handler(int s)
 	case SIGTERM:
 		exit(0);
 
-#ifdef USE_X11
-	case SIGUSR1:
-		init_x11();
-		break;
-
-	case SIGUSR2:
-		close_x11();
-		break;
-#endif
-
 	default:
 		break;
 	}
@@ -21,30 +21,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "config.h"
 #include "cfgfile.h"
+#include "core.h"
 
 #define SOCK_NAME	"/var/run/spnav.sock"
 #define PIDFILE		"/var/run/spnavd.pid"
 #define LOGFILE		"/var/log/spnavd.log"
+#define CFGFILE		"/etc/spnavrc"
 /* Multiple devices support */
 #ifndef MAX_DEVICES
 #define MAX_DEVICES 8
 #endif
 
-#if defined(__cplusplus) || (__STDC_VERSION__ >= 199901L)
-#define INLINE	inline
-#else	/* not C++ or C99 */
+extern struct cfg cfg;
+extern int verbose;
+/* the core context handling the devices and their input */
+extern struct spnav_core *core;
 
-#ifdef __GNUC__
-#define INLINE	__inline__
-#else
-#define INLINE
-#endif
-
-#endif
-
-
-
-struct cfg cfg;
-int verbose;
+/* re-read the config file at the end of the current processing round */
+void schedule_cfg_reload(void);
+/* write the current configuration to the config file */
+int save_cfg(void);
 
 #endif	/* SPNAVD_H_ */
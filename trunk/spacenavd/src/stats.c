@@ -0,0 +1,97 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+#include <time.h>
+#include <sys/time.h>
+#include "stats.h"
+#include "spnavd.h"
+#include "dev.h"
+#include "dev_serial.h"
+#include "dev_net.h"
+
+struct stats stats;
+
+unsigned long long get_time_usec(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	}
+#endif
+	{
+		struct timeval tv;
+		gettimeofday(&tv, 0);
+		return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+	}
+}
+
+void print_stats(FILE *fp)
+{
+	struct device *dev;
+	struct serial_stats ser;
+	struct net_stats net;
+
+	fprintf(fp, "statistics:\n");
+	fprintf(fp, "  config reloads: %lu (last: %lu usec, max: %lu usec)\n", stats.cfg_reloads,
+			stats.cfg_reload_usec, stats.cfg_reload_max_usec);
+	if(stats.input_delays) {
+		fprintf(fp, "  input delay: %lu usec (avg: %lu usec, max: %lu usec, samples: %lu)\n",
+				stats.input_delay_usec, (unsigned long)(stats.input_delay_total_usec / stats.input_delays),
+				stats.input_delay_max_usec, stats.input_delays);
+	}
+	if(stats.idle_periods) {
+		unsigned long long idle_usec = stats.idle_usec;
+		if(stats.idle_start) {
+			idle_usec += get_time_usec() - stats.idle_start;
+		}
+		fprintf(fp, "  idle: %lu periods, %lu sec, %.2f wakeups/min\n", stats.idle_periods,
+				(unsigned long)(idle_usec / 1000000), idle_usec ? stats.idle_wakeups * 60000000.0 / idle_usec : 0.0);
+	}
+	if(stats.uring_enters) {
+		fprintf(fp, "  io_uring: %lu submits, %lu sends (%lu written directly), %lu device reads\n",
+				stats.uring_enters, stats.uring_sends, stats.uring_send_direct, stats.uring_reads);
+	}
+	if(stats.net_frames) {
+		fprintf(fp, "  forwarding: %lu frames (%lu repeats), %lu send errors\n",
+				stats.net_frames, stats.net_repeats, stats.net_send_errors);
+	}
+	for(dev = core ? get_devices(core) : 0; dev; dev = dev->next) {
+		if(get_serial_stats(dev, &ser) == 0) {
+			fprintf(fp, "  device %d (%s): %lu bytes, %lu packets, %lu bad, %lu unknown, %lu overruns, %lu device errors, %lu resets\n",
+					dev->id, dev->name, ser.bytes, ser.packets, ser.bad_packets, ser.unknown, ser.overruns,
+					ser.dev_errors, ser.resets);
+		}
+		if(get_net_stats(dev, &net) == 0) {
+			fprintf(fp, "  device %d (%s): %lu frames, %lu bytes, %lu lost (%.2f%%), %lu stale, %lu bad, %lu foreign, %lu denied, %lu timeouts\n",
+					dev->id, dev->name, net.frames, net.bytes, net.lost,
+					net.frames + net.lost ? net.lost * 100.0 / (net.frames + net.lost) : 0.0,
+					net.stale, net.bad, net.foreign, net.denied, net.timeouts);
+			if(net.latency_samples) {
+				fprintf(fp, "    latency: %lld usec (avg: %lld usec, min: %lld usec, max: %lld usec, samples: %lu)\n",
+						net.latency_usec, net.latency_total_usec / (long long)net.latency_samples,
+						net.latency_min_usec, net.latency_max_usec, net.latency_samples);
+			}
+		}
+	}
+#ifdef USE_X11
+	fprintf(fp, "  X11 output: %lu motion events coalesced, %lu events dropped\n",
+			stats.x11_coalesced, stats.x11_dropped);
+#endif
+}
@@ -0,0 +1,63 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdio.h>
+
+struct stats {
+	unsigned long cfg_reloads;
+	unsigned long cfg_reload_usec;		/* duration of the last reload */
+	unsigned long cfg_reload_max_usec;	/* longest reload so far */
+
+	unsigned long x11_coalesced;	/* motion events merged by the X11 output thread */
+	unsigned long x11_dropped;		/* events dropped by the X11 output thread for lack of memory */
+
+	/* delay from the device input timestamp to processing it (scheduling
+	 * delay), for devices which timestamp their input.
+	 */
+	unsigned long input_delays;
+	unsigned long input_delay_usec;		/* last */
+	unsigned long input_delay_max_usec;
+	unsigned long long input_delay_total_usec;
+
+	unsigned long uring_enters;		/* io_uring_enter calls */
+	unsigned long uring_sends;		/* client writes submitted through io_uring */
+	unsigned long uring_send_direct;	/* ... which had to be written directly */
+	unsigned long uring_reads;		/* device reads completed through io_uring */
+
+	/* idle mode: device input suspended while nobody needs it */
+	unsigned long idle_periods;
+	unsigned long idle_wakeups;		/* main loop wakeups while idle */
+	unsigned long long idle_usec;	/* total, excluding the current period */
+	unsigned long long idle_start;	/* start of the current period, 0 if not idle */
+
+	/* event forwarding (proto_net.h) */
+	unsigned long net_frames;		/* frames sent */
+	unsigned long net_repeats;		/* ... of which repeated the state without an event */
+	unsigned long net_send_errors;
+};
+
+extern struct stats stats;
+
+/* monotonic timestamp in microseconds, for measuring intervals */
+unsigned long long get_time_usec(void);
+
+void print_stats(FILE *fp);
+
+#endif	/* STATS_H_ */
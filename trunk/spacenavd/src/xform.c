@@ -0,0 +1,190 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "xform.h"
+
+/* the largest float below INT_MAX, anything beyond doesn't fit in an int */
+#define MAX_OUT		2147483520.0f
+
+static int to_int(float val, int clamp);
+static unsigned int calc_hash(const struct xform *xf);
+static int xform_equal(const struct xform *a, const struct xform *b);
+
+static struct xform *xform_list;
+
+void xform_identity(struct xform *xf)
+{
+	xform_scale(xf, 1.0f);
+}
+
+void xform_scale(struct xform *xf, float s)
+{
+	int i;
+
+	memset(xf, 0, sizeof *xf);
+	for(i=0; i<6; i++) {
+		xf->mat[i * 6 + i] = s;
+	}
+}
+
+int xform_is_identity(const struct xform *xf)
+{
+	struct xform ident;
+	xform_identity(&ident);
+	return xform_equal(xf, &ident);
+}
+
+int xform_valid_coef(float f)
+{
+	return fabs(f) <= XFORM_MAX_COEF;	/* false for NaN too */
+}
+
+struct xform *xform_intern(const struct xform *xf)
+{
+	struct xform *iter;
+	unsigned int hash;
+
+	if(xform_is_identity(xf)) {
+		return 0;
+	}
+
+	hash = calc_hash(xf);
+
+	iter = xform_list;
+	while(iter) {
+		if(iter->hash == hash && xform_equal(iter, xf)) {
+			iter->ref++;
+			return iter;
+		}
+		iter = iter->next;
+	}
+
+	if(!(iter = malloc(sizeof *iter))) {
+		perror("failed to allocate transform");
+		return 0;
+	}
+	memcpy(iter->mat, xf->mat, sizeof iter->mat);
+	memcpy(iter->deadzone, xf->deadzone, sizeof iter->deadzone);
+	memcpy(iter->clamp, xf->clamp, sizeof iter->clamp);
+	iter->ref = 1;
+	iter->hash = hash;
+	iter->cache_serial = 0;
+
+	iter->next = xform_list;
+	xform_list = iter;
+	return iter;
+}
+
+void xform_release(struct xform *xf)
+{
+	struct xform dummy, *iter;
+
+	if(!xf || --xf->ref > 0) {
+		return;
+	}
+
+	dummy.next = xform_list;
+	iter = &dummy;
+	while(iter->next) {
+		if(iter->next == xf) {
+			iter->next = xf->next;
+			break;
+		}
+		iter = iter->next;
+	}
+	xform_list = dummy.next;
+	free(xf);
+}
+
+const int *xform_apply(struct xform *xf, const int *in, unsigned int serial)
+{
+	int i, j;
+	float vin[6], vout[6];
+
+	if(serial && xf->cache_serial == serial) {
+		return xf->cache;
+	}
+
+	for(i=0; i<6; i++) {
+		vin[i] = abs(in[i]) < xf->deadzone[i] ? 0.0f : (float)in[i];
+	}
+
+	/* plain loops over fixed-size arrays, simple enough for the compiler to
+	 * vectorize.
+	 */
+	for(i=0; i<6; i++) {
+		const float *row = xf->mat + i * 6;
+		float sum = 0.0f;
+		for(j=0; j<6; j++) {
+			sum += row[j] * vin[j];
+		}
+		vout[i] = sum;
+	}
+
+	for(i=0; i<6; i++) {
+		xf->cache[i] = to_int(vout[i], xf->clamp[i]);
+	}
+	xf->cache_serial = serial;
+	return xf->cache;
+}
+
+/* clamps in float, before the conversion, which is undefined for values out
+ * of the int range, and rounds to nearest rather than truncating towards 0.
+ */
+static int to_int(float val, int clamp)
+{
+	float lim = clamp > 0 && clamp < MAX_OUT ? (float)clamp : MAX_OUT;
+
+	if(val != val) {
+		return 0;	/* NaN */
+	}
+	if(val > lim) val = lim;
+	if(val < -lim) val = -lim;
+	return (int)lrintf(val);
+}
+
+static unsigned int calc_hash(const struct xform *xf)
+{
+	/* FNV-1a over the parameters */
+	const unsigned char *ptr;
+	unsigned int i, hash = 2166136261u;
+
+	ptr = (const unsigned char*)xf->mat;
+	for(i=0; i<sizeof xf->mat; i++) {
+		hash = (hash ^ ptr[i]) * 16777619u;
+	}
+	ptr = (const unsigned char*)xf->deadzone;
+	for(i=0; i<sizeof xf->deadzone; i++) {
+		hash = (hash ^ ptr[i]) * 16777619u;
+	}
+	ptr = (const unsigned char*)xf->clamp;
+	for(i=0; i<sizeof xf->clamp; i++) {
+		hash = (hash ^ ptr[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static int xform_equal(const struct xform *a, const struct xform *b)
+{
+	return memcmp(a->mat, b->mat, sizeof a->mat) == 0 &&
+		memcmp(a->deadzone, b->deadzone, sizeof a->deadzone) == 0 &&
+		memcmp(a->clamp, b->clamp, sizeof a->clamp) == 0;
+}
@@ -0,0 +1,66 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef XFORM_H_
+#define XFORM_H_
+
+/* Per-client motion transformation. Incoming motion values first go through
+ * a per-axis dead zone, then get multiplied by a 6x6 matrix, and finally each
+ * output axis is clamped to [-clamp, clamp] (0: no clamping).
+ *
+ * Transforms are interned: identical transforms are shared between clients,
+ * and the result of applying a transform to an event is cached, so that it's
+ * computed only once for all clients sharing it.
+ */
+/* largest magnitude of a matrix coefficient clients may set */
+#define XFORM_MAX_COEF	1e4f
+
+struct xform {
+	float mat[36];		/* row-major: out[i] = sum(mat[i * 6 + j] * in[j]) */
+	int deadzone[6];
+	int clamp[6];
+
+	/* the rest is maintained by xform.c */
+	int ref;
+	unsigned int hash;
+	unsigned int cache_serial;
+	int cache[6];
+	struct xform *next;
+};
+
+/* initializes a transform to identity, with no dead zone or clamping */
+void xform_identity(struct xform *xf);
+/* initializes a transform to a uniform scaling of all axes */
+void xform_scale(struct xform *xf, float s);
+
+int xform_is_identity(const struct xform *xf);
+/* non-zero if f is usable as a matrix coefficient (finite, not absurd) */
+int xform_valid_coef(float f);
+
+/* returns a shared transform identical to xf, with its reference count
+ * incremented. Returns null if xf is identity (no transform needed), or on
+ * failure.
+ */
+struct xform *xform_intern(const struct xform *xf);
+void xform_release(struct xform *xf);
+
+/* transforms a motion vector. serial identifies the input vector, if the same
+ * serial was transformed last time, the cached result is returned.
+ */
+const int *xform_apply(struct xform *xf, const int *in, unsigned int serial);
+
+#endif	/* XFORM_H_ */
@@ -0,0 +1,504 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "config.h"
+
+#ifdef USE_X11
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include "xout.h"
+#include "ringbuf.h"
+#include "proto_x11.h"
+#include "stats.h"
+#include "spnavd.h"
+
+#define QUEUE_SIZE	1024
+#define BATCH_SIZE	128
+
+/* queued button event, seq orders it against the pending motion */
+struct xout_item {
+	struct xout_msg msg;
+	unsigned long seq;
+};
+
+/* latest motion event for a window, not sent yet */
+struct motion_slot {
+	struct xout_msg msg;
+	unsigned long seq;
+	int pending;
+};
+
+/* button events which didn't fit in the ring */
+struct overflow {
+	struct xout_item item;
+	struct overflow *next;
+};
+
+static void *thread_func(void *arg);
+static int set_motion(struct xout_item *item);
+static int queue_button(struct xout_item *item);
+static int take_overflow(struct xout_item *items, int max);
+static int take_motion(Window win, unsigned long seq, struct xout_msg *msg);
+static int take_all_motion(struct xout_msg *msgs, int max);
+static int send_item(struct xout_item *item);
+static void free_queues(void);
+static void close_pipes(void);
+
+static pthread_t thread;
+static int running;
+static void *conn;
+
+/* shared between the main and the output thread, accessed atomically */
+static int quit, sleeping, lost;
+
+static int wake_pipe[2] = {-1, -1};		/* main -> output thread */
+static int notify_pipe[2] = {-1, -1};	/* output thread -> main */
+static struct ringbuf outq;		/* button events to send */
+static struct ringbuf badq;		/* invalid client windows */
+
+/* motion slots and the overflow list, shared between the two threads.
+ * The counts are also read by the output thread without the lock, to decide
+ * whether to sleep, so they're accessed atomically.
+ */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct motion_slot *slots;
+static int num_slots, max_slots;
+static struct overflow *ovf_head, *ovf_tail;
+static int motion_pending, ovf_pending;
+static unsigned long next_seq;
+
+int xout_start(void)
+{
+	int i, res;
+
+	if(running) return 0;
+
+	if(rb_init(&outq, QUEUE_SIZE, sizeof(struct xout_item)) == -1 ||
+			rb_init(&badq, 64, sizeof(Window)) == -1) {
+		perror("failed to allocate X11 output queues");
+		goto err;
+	}
+	if(pipe(wake_pipe) == -1 || pipe(notify_pipe) == -1) {
+		perror("failed to create X11 output thread pipes");
+		goto err;
+	}
+	for(i=0; i<2; i++) {
+		fcntl(wake_pipe[i], F_SETFL, fcntl(wake_pipe[i], F_GETFL) | O_NONBLOCK);
+		fcntl(notify_pipe[i], F_SETFL, fcntl(notify_pipe[i], F_GETFL) | O_NONBLOCK);
+	}
+
+	if(!(conn = xout_backend_open())) {
+		fprintf(stderr, "failed to open X11 output connection\n");
+		goto err;
+	}
+
+	quit = sleeping = lost = 0;
+	if((res = pthread_create(&thread, 0, thread_func, 0)) != 0) {
+		fprintf(stderr, "failed to start X11 output thread: %s\n", strerror(res));
+		xout_backend_close(conn);
+		conn = 0;
+		goto err;
+	}
+	running = 1;
+
+	if(verbose) {
+		printf("started X11 output thread\n");
+	}
+	return 0;
+
+err:
+	close_pipes();
+	rb_destroy(&outq);
+	rb_destroy(&badq);
+	free_queues();
+	return -1;
+}
+
+void xout_stop(void)
+{
+	if(!running) return;
+
+	__atomic_store_n(&quit, 1, __ATOMIC_SEQ_CST);
+	write(wake_pipe[1], "", 1);
+	pthread_join(thread, 0);
+	running = 0;
+
+	xout_backend_close(conn);
+	conn = 0;
+
+	close_pipes();
+	rb_destroy(&outq);
+	rb_destroy(&badq);
+	free_queues();
+
+	if(verbose) {
+		printf("stopped X11 output thread\n");
+	}
+}
+
+int xout_running(void)
+{
+	return running;
+}
+
+void xout_make_msg(struct xout_msg *msg, Window win, const spnav_event *ev)
+{
+	int i;
+
+	memset(msg, 0, sizeof *msg);
+	msg->win = win;
+
+	if(ev->type == EVENT_MOTION) {
+		msg->type = XOUT_MOTION;
+		for(i=0; i<6; i++) {
+			msg->data[i] = (short)ev->motion.data[i];
+		}
+		msg->data[6] = ev->motion.period;
+	} else {
+		msg->type = ev->button.press ? XOUT_PRESS : XOUT_RELEASE;
+		msg->data[0] = ev->button.bnum;
+	}
+}
+
+int xout_send(Window win, const spnav_event *ev)
+{
+	int res;
+	struct xout_item item;
+
+	xout_make_msg(&item.msg, win, ev);
+
+	pthread_mutex_lock(&lock);
+	item.seq = next_seq++;
+	if(item.msg.type == XOUT_MOTION) {
+		res = set_motion(&item);
+	} else {
+		res = queue_button(&item);
+	}
+	pthread_mutex_unlock(&lock);
+
+	if(res == -1) {
+		__atomic_fetch_add(&stats.x11_dropped, 1, __ATOMIC_RELAXED);
+		return -1;
+	}
+
+	/* wake up the output thread if it's waiting. The fence orders the
+	 * publishing of the event before the load of sleeping, pairing with the
+	 * one in thread_func.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&sleeping, __ATOMIC_RELAXED)) {
+		write(wake_pipe[1], "", 1);
+	}
+	return 0;
+}
+
+int xout_get_fd(void)
+{
+	return running ? notify_pipe[0] : -1;
+}
+
+void xout_handle_events(fd_set *rset)
+{
+	char buf[64];
+	Window win;
+
+	if(!running || !FD_ISSET(notify_pipe[0], rset)) {
+		return;
+	}
+
+	while(read(notify_pipe[0], buf, sizeof buf) > 0);
+
+	while(rb_pop(&badq, &win) != -1) {
+		remove_client_window(win);
+	}
+
+	if(__atomic_load_n(&lost, __ATOMIC_ACQUIRE)) {
+		/* fall back to sending from the main thread until the next reconnect */
+		fprintf(stderr, "X11 output thread lost its connection\n");
+		xout_stop();
+	}
+}
+
+void xout_bad_window(Window win)
+{
+	rb_push(&badq, &win);
+	write(notify_pipe[1], "", 1);
+}
+
+/* called with the lock held. Overwrites the pending motion of the window, if
+ * the output thread didn't get to it yet, so motion never waits in the ring
+ * behind stale motion.
+ */
+static int set_motion(struct xout_item *item)
+{
+	int i, period, free_slot = -1;
+	struct motion_slot *slot, *tmp;
+
+	for(i=0; i<num_slots; i++) {
+		if(slots[i].msg.win == item->msg.win) break;
+		if(free_slot == -1 && !slots[i].pending) {
+			free_slot = i;
+		}
+	}
+
+	if(i < num_slots) {
+		slot = slots + i;
+	} else if(free_slot != -1) {
+		slot = slots + free_slot;
+	} else {
+		if(num_slots >= max_slots) {
+			int newsz = max_slots ? max_slots * 2 : 8;
+			if(!(tmp = realloc(slots, newsz * sizeof *slots))) {
+				return -1;
+			}
+			slots = tmp;
+			max_slots = newsz;
+		}
+		slot = slots + num_slots++;
+		slot->pending = 0;
+	}
+
+	period = item->msg.data[6];
+	if(slot->pending && slot->msg.win == item->msg.win) {
+		/* superseded, carry the period over to the later event */
+		period += slot->msg.data[6];
+		if(period > SHRT_MAX) period = SHRT_MAX;
+		__atomic_fetch_add(&stats.x11_coalesced, 1, __ATOMIC_RELAXED);
+	}
+
+	slot->msg = item->msg;
+	slot->msg.data[6] = period;
+	slot->seq = item->seq;
+	if(!slot->pending) {
+		slot->pending = 1;
+		__atomic_fetch_add(&motion_pending, 1, __ATOMIC_RELAXED);
+	}
+	return 0;
+}
+
+/* called with the lock held. Button events are never dropped, a lost release
+ * would leave the button held down in the client. Once the ring fills up,
+ * they go to the overflow list until the output thread drains it.
+ */
+static int queue_button(struct xout_item *item)
+{
+	struct overflow *node;
+
+	if(!ovf_head && rb_push(&outq, item) != -1) {
+		return 0;
+	}
+
+	if(!(node = malloc(sizeof *node))) {
+		return -1;
+	}
+	node->item = *item;
+	node->next = 0;
+
+	if(ovf_head) {
+		ovf_tail->next = node;
+	} else {
+		ovf_head = node;
+	}
+	ovf_tail = node;
+	__atomic_store_n(&ovf_pending, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* takes events from the overflow list, once the ring has been drained. While
+ * the list isn't empty, the main thread queues everything on it, so nothing
+ * in the ring can be newer.
+ */
+static int take_overflow(struct xout_item *items, int max)
+{
+	int count = 0;
+	struct overflow *node;
+
+	pthread_mutex_lock(&lock);
+	if(rb_empty(&outq)) {
+		while(count < max && ovf_head) {
+			node = ovf_head;
+			ovf_head = node->next;
+			items[count++] = node->item;
+			free(node);
+		}
+		if(!ovf_head) {
+			ovf_tail = 0;
+			__atomic_store_n(&ovf_pending, 0, __ATOMIC_RELAXED);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return count;
+}
+
+/* takes the pending motion of a window, if it precedes event seq */
+static int take_motion(Window win, unsigned long seq, struct xout_msg *msg)
+{
+	int i, res = 0;
+
+	pthread_mutex_lock(&lock);
+	for(i=0; i<num_slots; i++) {
+		if(slots[i].msg.win == win) {
+			if(slots[i].pending && slots[i].seq < seq) {
+				*msg = slots[i].msg;
+				slots[i].pending = 0;
+				__atomic_fetch_sub(&motion_pending, 1, __ATOMIC_RELAXED);
+				res = 1;
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return res;
+}
+
+/* takes pending motion for any window, but only when no button events are
+ * queued, which would have to go out first.
+ */
+static int take_all_motion(struct xout_msg *msgs, int max)
+{
+	int i, count = 0;
+
+	pthread_mutex_lock(&lock);
+	if(rb_empty(&outq) && !ovf_head) {
+		for(i=0; i<num_slots && count < max; i++) {
+			if(slots[i].pending) {
+				msgs[count++] = slots[i].msg;
+				slots[i].pending = 0;
+				__atomic_fetch_sub(&motion_pending, 1, __ATOMIC_RELAXED);
+			}
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return count;
+}
+
+/* sends a button event, preceded by any older motion for the same window */
+static int send_item(struct xout_item *item)
+{
+	struct xout_msg motion;
+
+	if(take_motion(item->msg.win, item->seq, &motion) &&
+			xout_backend_send(conn, &motion) == -1) {
+		return -1;
+	}
+	return xout_backend_send(conn, &item->msg);
+}
+
+static void *thread_func(void *arg)
+{
+	struct xout_item batch[BATCH_SIZE];
+	struct xout_msg motion[BATCH_SIZE];
+	struct pollfd pfd[2];
+	char buf[64];
+	int i, count, nmotion;
+
+	pfd[0].fd = wake_pipe[0];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = xout_backend_fd(conn);
+	pfd[1].events = POLLIN;
+
+	while(!__atomic_load_n(&quit, __ATOMIC_ACQUIRE)) {
+		count = 0;
+		while(count < BATCH_SIZE && rb_pop(&outq, batch + count) != -1) {
+			count++;
+		}
+		if(!count && __atomic_load_n(&ovf_pending, __ATOMIC_RELAXED)) {
+			count = take_overflow(batch, BATCH_SIZE);
+		}
+		for(i=0; i<count; i++) {
+			if(send_item(batch + i) == -1) break;
+		}
+		if(i < count) break;
+
+		nmotion = take_all_motion(motion, BATCH_SIZE);
+		for(i=0; i<nmotion; i++) {
+			if(xout_backend_send(conn, motion + i) == -1) break;
+		}
+		if(i < nmotion) break;
+
+		if(count || nmotion) {
+			if(xout_backend_flush(conn) == -1) {
+				break;
+			}
+			continue;
+		}
+
+		/* nothing queued, wait for the main thread or the X server */
+		__atomic_store_n(&sleeping, 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if(!rb_empty(&outq) || __atomic_load_n(&motion_pending, __ATOMIC_RELAXED) ||
+				__atomic_load_n(&ovf_pending, __ATOMIC_RELAXED) ||
+				__atomic_load_n(&quit, __ATOMIC_ACQUIRE)) {
+			__atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		while(poll(pfd, 2, -1) == -1 && errno == EINTR);
+		__atomic_store_n(&sleeping, 0, __ATOMIC_RELAXED);
+
+		if(pfd[0].revents) {
+			while(read(wake_pipe[0], buf, sizeof buf) > 0);
+		}
+		if(pfd[1].revents && xout_backend_process(conn) == -1) {
+			break;
+		}
+	}
+
+	if(!__atomic_load_n(&quit, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&lost, 1, __ATOMIC_RELEASE);
+		write(notify_pipe[1], "", 1);
+	}
+	return 0;
+}
+
+static void free_queues(void)
+{
+	struct overflow *node;
+
+	while(ovf_head) {
+		node = ovf_head;
+		ovf_head = node->next;
+		free(node);
+	}
+	ovf_tail = 0;
+	ovf_pending = 0;
+
+	free(slots);
+	slots = 0;
+	num_slots = max_slots = motion_pending = 0;
+}
+
+static void close_pipes(void)
+{
+	int i;
+	for(i=0; i<2; i++) {
+		if(wake_pipe[i] != -1) close(wake_pipe[i]);
+		if(notify_pipe[i] != -1) close(notify_pipe[i]);
+		wake_pipe[i] = notify_pipe[i] = -1;
+	}
+}
+
+#else
+int spacenavd_xout_shut_up_empty_source_warning;
+#endif	/* USE_X11 */
@@ -0,0 +1,79 @@
+/*
+spacenavd - a free software replacement driver for 6dof space-mice.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef XOUT_H_
+#define XOUT_H_
+
+#include "config.h"
+
+#ifdef USE_X11
+#include <sys/select.h>
+#include <X11/Xlib.h>
+#include "event.h"
+
+/* X11 output thread.
+ * Events for magellan X11 clients are queued by the main thread, and sent by
+ * a separate thread with its own X server connection, so that a stalled X
+ * server can't delay the main loop. Motion events don't queue up: each window
+ * has a single pending motion event, which the main thread overwrites if the
+ * thread falls behind. Button events are queued in order and never dropped.
+ * Clients whose windows have gone away are reported back to the main thread.
+ */
+
+enum {
+	XOUT_MOTION,
+	XOUT_PRESS,
+	XOUT_RELEASE
+};
+
+struct xout_msg {
+	Window win;
+	int type;
+	short data[7];	/* motion: 6 axes and period, buttons: button number */
+};
+
+/* starts the output thread, the backend must be connected already */
+int xout_start(void);
+void xout_stop(void);
+int xout_running(void);
+
+/* main thread: queue an event for a client window */
+int xout_send(Window win, const spnav_event *ev);
+
+void xout_make_msg(struct xout_msg *msg, Window win, const spnav_event *ev);
+
+/* main thread: notification fd and handler for windows found to be invalid */
+int xout_get_fd(void);
+void xout_handle_events(fd_set *rset);
+
+/* called by the backend from the output thread */
+void xout_bad_window(Window win);
+
+/* implemented by the X11 backend (proto_x11.c or proto_x11_xcb.c), these are
+ * called only from the output thread.
+ */
+void *xout_backend_open(void);
+void xout_backend_close(void *conn);
+int xout_backend_fd(void *conn);
+/* these return -1 if the connection is lost */
+int xout_backend_send(void *conn, const struct xout_msg *msg);
+int xout_backend_flush(void *conn);
+int xout_backend_process(void *conn);
+
+#endif	/* USE_X11 */
+
+#endif	/* XOUT_H_ */
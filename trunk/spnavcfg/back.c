@@ -22,22 +22,33 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <errno.h>
 #include <ctype.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "cfgfile.h"
 #include "cmd.h"
+#include "proto.h"
 
 #define CFGFILE		"/etc/spnavrc"
 #define PIDFILE		"/var/run/spnavd.pid"
+#define SOCK_NAME	"/var/run/spnav.sock"
 
 int get_daemon_pid(void);
 static int update_cfg(void);
+static int update_cfg_file(void);
+static int connect_daemon(void);
+static int request(int type, int *data);
 static void sig(int s);
 
-static struct cfg cfg;
+static struct cfg cfg, prev_cfg;
+static int prev_valid;		/* prev_cfg holds what the daemon currently has */
+static int dirty;			/* live changes not yet written to the config file */
 static int dpid = -1;
+static int sock = -1;
 
 int backend(int pfd)
 {
 	signal(SIGTERM, sig);
+	signal(SIGPIPE, SIG_IGN);
 
 	for(;;) {
 		ssize_t res;
@@ -45,14 +56,23 @@ int backend(int pfd)
 
 		/* get command */
 		cmd = 0;
-		if(read(pfd, &cmd, 1) == -1 && errno != EINTR) {
-			perror("pipe read blew up in my face! wtf");
-			return -1;
+		if((res = read(pfd, &cmd, 1)) <= 0) {
+			if(res == -1 && errno == EINTR) {
+				continue;
+			}
+			if(res == -1) {
+				perror("pipe read blew up in my face! wtf");
+			}
+			break;	/* frontend went away */
 		}
 
 		switch(cmd) {
 		case CMD_PING:
-			tmp = (dpid = get_daemon_pid()) != -1;
+			if(request(REQ_NOP, 0) == 0) {
+				tmp = 1;
+			} else {
+				tmp = (dpid = get_daemon_pid()) != -1;
+			}
 			write(pfd, &tmp, 1);
 			break;
 
@@ -71,6 +91,10 @@ int backend(int pfd)
 
 		case CMD_STARTX:
 		case CMD_STOPX:
+			if(request(cmd == CMD_STARTX ? REQ_X11_START : REQ_X11_STOP, 0) != -1) {
+				break;
+			}
+			/* no control socket, fallback to signalling the daemon */
 			if(dpid == -1) {
 				if((dpid = get_daemon_pid()) == -1) {
 					return -1;
@@ -90,6 +114,10 @@ int backend(int pfd)
 		}
 	}
 
+	/* the frontend is closing, make the live changes permanent */
+	if(dirty && request(REQ_CFG_SAVE, 0) == -1) {
+		update_cfg_file();
+	}
 	return 0;
 }
 
@@ -112,12 +140,89 @@ int get_daemon_pid(void)
 	return atoi(buf);
 }
 
+static int float_bits(float f)
+{
+	int x;
+	memcpy(&x, &f, sizeof x);
+	return x;
+}
+
+/* sends only the parameters which changed since the last update to the daemon
+ * through its control socket. If the daemon can't be reached, falls back to
+ * rewriting the config file and signalling the daemon to re-read it.
+ */
 static int update_cfg(void)
+{
+	int i, data[6];
+
+	if(connect_daemon() == -1) {
+		prev_valid = 0;
+		return update_cfg_file();
+	}
+
+	if(!prev_valid || cfg.sensitivity != prev_cfg.sensitivity) {
+		data[0] = float_bits(cfg.sensitivity);
+		if(request(REQ_SET_SENS, data) == -1) goto fail;
+	}
+	if(!prev_valid || memcmp(cfg.sens_trans, prev_cfg.sens_trans, sizeof cfg.sens_trans) != 0 ||
+			memcmp(cfg.sens_rot, prev_cfg.sens_rot, sizeof cfg.sens_rot) != 0) {
+		for(i=0; i<3; i++) {
+			data[i] = float_bits(cfg.sens_trans[i]);
+			data[i + 3] = float_bits(cfg.sens_rot[i]);
+		}
+		if(request(REQ_SET_SENS_AXIS, data) == -1) goto fail;
+	}
+	for(i=0; i<6; i++) {
+		if(!prev_valid || cfg.dead_threshold[i] != prev_cfg.dead_threshold[i]) {
+			data[0] = i;
+			data[1] = cfg.dead_threshold[i];
+			if(request(REQ_SET_DEADZONE, data) == -1) goto fail;
+		}
+	}
+	if(!prev_valid || memcmp(cfg.invert, prev_cfg.invert, sizeof cfg.invert) != 0) {
+		memcpy(data, cfg.invert, sizeof data);
+		if(request(REQ_SET_INVERT, data) == -1) goto fail;
+	}
+	for(i=0; i<6; i++) {
+		if(!prev_valid || cfg.map_axis[i] != prev_cfg.map_axis[i]) {
+			data[0] = i;
+			data[1] = cfg.map_axis[i];
+			if(request(REQ_SET_AXISMAP, data) == -1) goto fail;
+		}
+	}
+	for(i=0; i<MAX_BUTTONS; i++) {
+		if(!prev_valid || cfg.map_button[i] != prev_cfg.map_button[i]) {
+			data[0] = i;
+			data[1] = cfg.map_button[i];
+			if(request(REQ_SET_BNMAP, data) == -1) goto fail;
+		}
+	}
+	if(!prev_valid || cfg.led != prev_cfg.led) {
+		data[0] = cfg.led;
+		if(request(REQ_SET_LED, data) == -1) goto fail;
+	}
+	if(!prev_valid || cfg.repeat_msec != prev_cfg.repeat_msec) {
+		data[0] = cfg.repeat_msec;
+		if(request(REQ_SET_REPEAT, data) == -1) goto fail;
+	}
+
+	prev_cfg = cfg;
+	prev_valid = 1;
+	dirty = 1;
+	return 0;
+
+fail:
+	prev_valid = 0;
+	return update_cfg_file();
+}
+
+static int update_cfg_file(void)
 {
 	if(write_cfg(CFGFILE, &cfg) == -1) {
 		fprintf(stderr, "failed to update config file\n");
 		return -1;
 	}
+	dirty = 0;
 
 	if(dpid == -1) {
 		if((dpid = get_daemon_pid()) == -1) {
@@ -133,6 +238,85 @@ static int update_cfg(void)
 	return 0;
 }
 
+static int connect_daemon(void)
+{
+	struct sockaddr_un addr;
+
+	if(sock != -1) {
+		return 0;
+	}
+
+	if((sock = socket(PF_UNIX, SOCK_STREAM, 0)) == -1) {
+		perror("failed to create socket");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, SOCK_NAME);
+
+	if(connect(sock, (struct sockaddr*)&addr, sizeof addr) == -1) {
+		close(sock);
+		sock = -1;
+		return -1;
+	}
+
+	/* the connection stays open while the configurator runs, but the socket is
+	 * only read during requests. Don't let events pile up in it, or the daemon
+	 * would block writing to us.
+	 */
+	request(REQ_SET_EVMASK, 0);
+	return sock == -1 ? -1 : 0;
+}
+
+/* sends a request to the daemon and waits for the response, discarding any
+ * events which arrive in the meantime. The response data are written back to
+ * data, if it's not null.
+ */
+static int request(int type, int *data)
+{
+	struct reqresp req;
+	char *ptr;
+	int sz, res;
+
+	if(connect_daemon() == -1) {
+		return -1;
+	}
+
+	memset(&req, 0, sizeof req);
+	req.type = type | REQ_TAG;
+	if(data) {
+		memcpy(req.data, data, 6 * sizeof *data);
+	}
+
+	while(write(sock, &req, sizeof req) == -1) {
+		if(errno != EINTR) goto disconnected;
+	}
+
+	do {
+		ptr = (char*)&req;
+		sz = sizeof req;
+		while(sz > 0) {
+			if((res = read(sock, ptr, sz)) <= 0) {
+				if(res == -1 && errno == EINTR) continue;
+				goto disconnected;
+			}
+			ptr += res;
+			sz -= res;
+		}
+	} while(req.type != (type | REQ_TAG));
+
+	if(data) {
+		memcpy(data, req.data, 6 * sizeof *data);
+	}
+	return req.data[REQ_STATUS];
+
+disconnected:
+	close(sock);
+	sock = -1;
+	return -1;
+}
+
 static void sig(int s)
 {
 	_exit(0);
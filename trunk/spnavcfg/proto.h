@@ -0,0 +1,111 @@
+/*
+spnavcfg - an interactive GUI configurator for the spacenavd daemon.
+Copyright (C) 2007-2013 John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PROTO_H_
+#define PROTO_H_
+
+/* copy of spacenavd/src/proto.h, keep them in sync */
+
+/* Requests are sent through the UNIX domain socket as 8 ints, just like
+ * events. The first int is the request type, tagged with REQ_TAG. The tag makes
+ * it a NaN if interpreted as a float, which is how the daemon tells requests
+ * apart from the plain sensitivity floats sent by older clients.
+ *
+ * Every request is answered with a packet of the same layout, carrying the
+ * tagged request type in the first int, any returned values in data[0-5], and
+ * the status (0 for success, -1 for failure) in data[6]. Clients must be
+ * prepared to receive events while waiting for the response.
+ *
+ * Float values are transmitted as their bit pattern.
+ */
+#define REQ_TAG			0x7faa0000
+#define REQ_TAG_MASK	0xffff0000
+#define IS_REQUEST(x)	(((x) & REQ_TAG_MASK) == REQ_TAG)
+#define REQ_TYPE(x)		((x) & ~REQ_TAG_MASK)
+
+#define REQ_STATUS		6
+
+struct reqresp {
+	int type;
+	int data[7];
+};
+
+enum {
+	REQ_NOP,
+
+	/* configuration requests, these change the global daemon configuration.
+	 * Setting a sensitivity which isn't finite or is beyond +-1e4, a negative
+	 * dead zone, or a repeat interval other than -1 or positive, fails.
+	 */
+	REQ_GET_SENS = 0x100,	/* data[0]: global sensitivity (float) */
+	REQ_SET_SENS,
+	REQ_GET_SENS_AXIS,		/* data[0-5]: translation/rotation sensitivity (float) */
+	REQ_SET_SENS_AXIS,
+	REQ_GET_DEADZONE,		/* data[0]: device axis (-1: all on set), data[1]: dead zone */
+	REQ_SET_DEADZONE,
+	REQ_GET_INVERT,			/* data[0-5]: non-zero for inverted axes */
+	REQ_SET_INVERT,
+	REQ_GET_AXISMAP,		/* data[0]: device axis, data[1]: mapped axis (0-5) */
+	REQ_SET_AXISMAP,
+	REQ_GET_BNMAP,			/* data[0]: device button, data[1]: mapped button */
+	REQ_SET_BNMAP,
+	REQ_GET_LED,			/* data[0]: led on/off */
+	REQ_SET_LED,
+	REQ_GET_REPEAT,			/* data[0]: repeat interval in msec (-1: disabled) */
+	REQ_SET_REPEAT,
+
+	/* daemon control requests */
+	REQ_CFG_SAVE = 0x200,	/* write the current configuration to the config file */
+	REQ_CFG_RELOAD,			/* discard changes, re-read the config file */
+	REQ_X11_START,			/* connect to the X server */
+	REQ_X11_STOP,			/* disconnect from the X server */
+	REQ_FLIGHT_DUMP,		/* data[0]: records (0: all), dump the flight recorder to the log */
+
+	/* per-client requests, these only affect the client making them */
+	REQ_SET_EVMASK = 0x300,	/* data[0]: mask of event types to receive (EVMASK_*) */
+	REQ_GET_EVMASK,
+	REQ_SUBSCRIBE_DEV,		/* data[0]: device id to receive events from (-1: all devices) */
+	REQ_UNSUBSCRIBE_DEV,	/* data[0]: device id (-1: none), must be explicitly subscribed */
+	REQ_GET_DEV_IDS,		/* data[0]: start index, returns data[0-5]: device ids, -1 terminated */
+	REQ_GET_DEV_NAME,		/* data[0]: device id, data[1]: offset, returns data[2-5]: name bytes */
+	REQ_SET_RATE,			/* data[0]: max motion events per second (0: unlimited), data[1]: RATE_* */
+	REQ_GET_RATE,
+
+	/* per-client motion transform, uploaded in pieces and applied on commit.
+	 * Sensitivity set by older clients replaces any uploaded transform.
+	 * Rows with non-finite coefficients, or any beyond +-1e4, fail.
+	 */
+	REQ_XFORM_ROW,			/* data[0-5]: matrix row (float), data[6]: row index (0-5) */
+	REQ_XFORM_DEADZONE,		/* data[0-5]: dead zone of each input axis */
+	REQ_XFORM_CLAMP,		/* data[0-5]: clamp of each output axis (0: none) */
+	REQ_XFORM_COMMIT,		/* start using the uploaded transform */
+	REQ_XFORM_RESET			/* revert to identity, discarding any uploaded transform */
+};
+
+/* motion coalescing modes, for REQ_SET_RATE */
+enum {
+	RATE_LATEST,	/* send the latest motion sample */
+	RATE_AVERAGE	/* send the average of the samples since the last event */
+};
+
+/* event type mask, for REQ_SET_EVMASK */
+#define EVMASK_MOTION	1
+#define EVMASK_PRESS	2
+#define EVMASK_RELEASE	4
+#define EVMASK_ALL		(EVMASK_MOTION | EVMASK_PRESS | EVMASK_RELEASE)
+
+#endif	/* PROTO_H_ */
@@ -46,7 +46,10 @@ int main(int argc, char **argv)
 		/* parent, GUI frontend */
 		close(pipefd[0]);
 		frontend(pipefd[1]);
-		kill(cpid, SIGTERM);
+		/* closing the pipe tells the backend to save any pending changes and exit */
+		signal(SIGCHLD, SIG_DFL);
+		close(pipefd[1]);
+		waitpid(cpid, 0, 0);
 	}
 	return 0;
 }